@@ -20,7 +20,7 @@
 
 /**
  * @file easy_track.h
- * This file contains FeatureMatchTrack class and KcfTrack class.
+ * This file contains FeatureMatchTrack class, IoUMatchTrack class and KcfTrack class.
  * Its purpose is to achieve object tracking.
  */
 
@@ -152,8 +152,21 @@ class FeatureMatchTrack : public EasyTrack {
    * @param max_iou_distance[in] Threshold of iou distance
    * @param max_age[in] Object stay alive for [max_age] after disappeared
    * @param n_init[in] After matched [n_init] times in a row, object is turned from TENTATIVE to CONFIRMED
+   * @param max_tracks[in] Tracker keeps at most [max_tracks] objects, the least recently updated ones are
+   *                       evicted when exceeded. 0 means unlimited
    */
-  void SetParams(float max_cosine_distance, int nn_budget, float max_iou_distance, int max_age, int n_init);
+  void SetParams(float max_cosine_distance, int nn_budget, float max_iou_distance, int max_age, int n_init,
+                 int max_tracks = 0);
+
+  /**
+   * @brief Enable computing cascade match cost matrix on a worker pool shared by all trackers.
+   *
+   * @param threshold[in] Cost matrix is computed in parallel when there are at least [threshold] detections
+   *                      in one frame. 0 means always serial, which is the default
+   *
+   * @note Match result is the same as serial computing.
+   */
+  void SetParallelThreshold(uint32_t threshold);
 
   /**
    * @brief Update object status and do tracking using cascade matching and IOU matching.
@@ -164,6 +177,20 @@ class FeatureMatchTrack : public EasyTrack {
    */
   void UpdateFrame(const TrackFrame &frame, const Objects &detects, Objects *tracks) override;
 
+  /**
+   * @brief Get approximate memory usage of track objects and their features.
+   *
+   * @return Memory usage in bytes
+   */
+  size_t GetMemoryUsage();
+
+  /**
+   * @brief Get number of alive track objects.
+   *
+   * @return Number of track objects
+   */
+  uint32_t GetTrackNum();
+
  private:
   FeatureMatchPrivate *fm_p_;
   friend class FeatureMatchPrivate;
@@ -172,8 +199,64 @@ class FeatureMatchTrack : public EasyTrack {
   int max_age_ = 30;
   int n_init_ = 3;
   uint32_t nn_budget_ = 100;
+  uint32_t max_tracks_ = 0;
+  uint32_t parallel_threshold_ = 0;
 };  // class FeatureMatchTrack
 
+class IoUMatchPrivate;
+
+/**
+ * @brief Track objects based on IOU only, without appearance feature.
+ *
+ * @note Detections are divided into high score and low score ones. Tracks are first matched with
+ *       high score detections, then remained tracks are matched with low score detections.
+ *       Both stages match by IOU between detections and Kalman predicted positions of tracks,
+ *       so frame data is never accessed.
+ */
+class IoUMatchTrack : public EasyTrack {
+ public:
+  /**
+   * @brief Constructor of the IoUMatchTrack class.
+   */
+  IoUMatchTrack();
+
+  /**
+   * @brief Destroy the IoUMatchTrack object.
+   */
+  ~IoUMatchTrack();
+
+  /**
+   * @brief Set params related to Tracking algorithm.
+   *
+   * @param max_iou_distance[in] Threshold of iou distance
+   * @param max_age[in] Object stay alive for [max_age] after disappeared
+   * @param n_init[in] After matched [n_init] times in a row, object is turned from TENTATIVE to CONFIRMED
+   * @param high_score_threshold[in] Detections with score not lower than it are matched in the first stage,
+   *                                 and unmatched ones are initialized as new tracks
+   * @param low_score_threshold[in] Detections with score lower than it are ignored
+   */
+  void SetParams(float max_iou_distance, int max_age, int n_init, float high_score_threshold,
+                 float low_score_threshold);
+
+  /**
+   * @brief Update object status and do tracking using two stage IOU matching.
+   *
+   * @param frame[in] Track frame, unused
+   * @param detects[in] Detected objects
+   * @param tracks[out] Tracked objects
+   */
+  void UpdateFrame(const TrackFrame &frame, const Objects &detects, Objects *tracks) override;
+
+ private:
+  IoUMatchPrivate *iou_p_;
+  friend class IoUMatchPrivate;
+  float max_iou_distance_ = 0.7;
+  int max_age_ = 30;
+  int n_init_ = 3;
+  float high_score_threshold_ = 0.5;
+  float low_score_threshold_ = 0.1;
+};  // class IoUMatchTrack
+
 class KcfTrackPrivate;
 
 /**
@@ -131,4 +131,13 @@ Matrix KalmanFilter::GatingDistance(const std::vector<BoundingBox> &measurements
   return square_maha;
 }
 
+BoundingBox KalmanFilter::GetState() const {
+  BoundingBox xyah;
+  xyah.x = mean_[0][0];
+  xyah.y = mean_[0][1];
+  xyah.width = mean_[0][2];
+  xyah.height = mean_[0][3];
+  return xyah;
+}
+
 }  // namespace edk
@@ -43,6 +43,11 @@ class KalmanFilter {
    */
   Matrix GatingDistance(const std::vector<BoundingBox>& measurements);
 
+  /**
+   * @brief Get current state in (center x, center y, aspect ratio, height) form
+   */
+  BoundingBox GetState() const;
+
  private:
   Matrix motion_mat_;
   Matrix update_mat_;
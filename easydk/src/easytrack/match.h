@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <map>
+#include <string>
 #include <vector>
 
 #include "easytrack/easy_track.h"
@@ -24,9 +25,13 @@ class MatchAlgorithm {
     hungarian_.Solve(cost_matrix, assignment);
   }
 
+  // distance functions are registered on construction and read only afterwards, so they could be used
+  // from several threads
+  const DistanceFunc &GetDistanceFunc(const std::string &dist_func) const { return distance_algo_.at(dist_func); }
+
   template <class... Args>
-  float Distance(const std::string &dist_func, Args &&... args) {
-    return distance_algo_[dist_func](std::forward<Args>(args)...);
+  float Distance(const std::string &dist_func, Args &&... args) const {
+    return GetDistanceFunc(dist_func)(std::forward<Args>(args)...);
   }
 
  private:
@@ -19,6 +19,7 @@
  *************************************************************************/
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <memory>
 #include <mutex>
 #include <numeric>
@@ -30,6 +31,7 @@
 #include "kalmanfilter.h"
 #include "match.h"
 #include "track_data_type.h"
+#include "worker_pool.h"
 
 #define CLIP(x) ((x) < 0 ? 0 : ((x) > 1 ? 1 : (x)))
 
@@ -37,16 +39,52 @@
 constexpr const float gating_threshold = 9.4877;
 
 static edk::BoundingBox to_xyah(const edk::BoundingBox &bbox) {
+  // keep the aspect ratio finite for degenerate boxes
+  constexpr float min_height = 1e-6f;
+  float height = bbox.height > min_height ? bbox.height : min_height;
   edk::BoundingBox xyah;
   xyah.x = bbox.x + bbox.width / 2;
   xyah.y = bbox.y + bbox.height / 2;
-  xyah.width = bbox.width / bbox.height;
-  xyah.height = bbox.height;
+  xyah.width = bbox.width / height;
+  xyah.height = height;
   return xyah;
 }
 
 namespace edk {
 
+/**
+ * Keeps the latest [capacity] features of a track. When it is full, the oldest feature is overwritten
+ * in place, so no reallocation happens once the ring is warmed up.
+ */
+class FeatureRing {
+ public:
+  void Reset(uint32_t capacity) {
+    capacity_ = capacity;
+    next_ = 0;
+    data_.clear();
+  }
+  void Push(const std::vector<float> &feature) {
+    if (capacity_ == 0) return;
+    if (data_.size() < capacity_) {
+      data_.push_back(feature);
+    } else {
+      data_[next_].assign(feature.begin(), feature.end());
+    }
+    next_ = (next_ + 1) % capacity_;
+  }
+  const std::vector<std::vector<float>> &Data() const { return data_; }
+  size_t MemoryUsage() const {
+    size_t bytes = data_.capacity() * sizeof(std::vector<float>);
+    for (auto &feature : data_) bytes += feature.capacity() * sizeof(float);
+    return bytes;
+  }
+
+ private:
+  std::vector<std::vector<float>> data_;
+  uint32_t capacity_ = 0;
+  uint32_t next_ = 0;
+};  // class FeatureRing
+
 struct FeatureMatchTrackObject {
   Rect pos;
   int class_id;
@@ -55,10 +93,11 @@ struct FeatureMatchTrackObject {
   TrackState state;
   int age = 1;
   int time_since_last_update = 0;
-  std::vector<std::vector<float>> features;
+  FeatureRing features;
   bool has_feature;
   bool feature_unmatched = false;
-  KalmanFilter *kf;
+  bool in_use = false;
+  KalmanFilter *kf = nullptr;
 };
 
 class FeatureMatchPrivate {
@@ -69,13 +108,20 @@ class FeatureMatchPrivate {
   }
   MatchResult &MatchCascade();
   MatchResult &MatchIou(std::vector<int> detect_matrices, std::vector<int> track_matrices);
-  void InitNewTrack(const DetectObject &obj);
+  int InitNewTrack(const DetectObject &obj);
   void MarkMiss(FeatureMatchTrackObject *track);
+  void ReleaseTrack(int index);
+  void EvictTracks();
 
   FeatureMatchTrack *fm_;
 
   MatchAlgorithm *match_algo_;
+  /* track slab, indices of track objects are stable during their lifetime,
+     released slots are recycled through free_slots_ */
   std::vector<FeatureMatchTrackObject> tracks_;
+  std::vector<int> free_slots_;
+  std::vector<int> active_track_;
+  uint32_t active_num_ = 0;
   std::vector<int> unconfirmed_track_;
   std::vector<int> confirmed_track_;
   std::vector<int> assignments_;
@@ -98,18 +144,41 @@ FeatureMatchTrack::~FeatureMatchTrack() {
 }
 
 void FeatureMatchTrack::SetParams(float max_cosine_distance, int nn_budget, float max_iou_distance, int max_age,
-                                  int n_init) {
+                                  int n_init, int max_tracks) {
   VLOG(3) << "FeatureMatchTrack Params -----";
   VLOG(3) << "   max cosine distance: " << max_cosine_distance;
   VLOG(3) << "   max IoU distance: " << max_iou_distance;
   VLOG(3) << "   max age: " << max_age;
   VLOG(3) << "   nn budget: " << nn_budget;
   VLOG(3) << "   n_init: " << n_init;
+  VLOG(3) << "   max tracks: " << max_tracks;
   max_cosine_distance_ = max_cosine_distance;
   max_iou_distance_ = max_iou_distance;
   nn_budget_ = nn_budget;
   max_age_ = max_age;
   n_init_ = n_init;
+  max_tracks_ = max_tracks > 0 ? max_tracks : 0;
+}
+
+void FeatureMatchTrack::SetParallelThreshold(uint32_t threshold) {
+  VLOG(3) << "FeatureMatchTrack parallel threshold: " << threshold;
+  std::lock_guard<std::mutex> lk(fm_p_->update_mutex_);
+  parallel_threshold_ = threshold;
+}
+
+size_t FeatureMatchTrack::GetMemoryUsage() {
+  std::lock_guard<std::mutex> lk(fm_p_->update_mutex_);
+  size_t bytes = sizeof(FeatureMatchPrivate) + fm_p_->tracks_.capacity() * sizeof(FeatureMatchTrackObject);
+  for (auto &obj : fm_p_->tracks_) {
+    if (obj.kf) bytes += sizeof(KalmanFilter);
+    bytes += obj.features.MemoryUsage();
+  }
+  return bytes;
+}
+
+uint32_t FeatureMatchTrack::GetTrackNum() {
+  std::lock_guard<std::mutex> lk(fm_p_->update_mutex_);
+  return fm_p_->active_num_;
 }
 
 MatchResult &FeatureMatchPrivate::MatchCascade() {
@@ -126,6 +195,7 @@ MatchResult &FeatureMatchPrivate::MatchCascade() {
   std::set<int> remained_detections;
   remained_detections.insert(res.unmatched_detections.begin(), res.unmatched_detections.end());
   VLOG(5) << "MatchCascade) Match scale, detects " << det_objs.size() << " tracks " << confirmed_track_.size();
+  bool parallel = fm_->parallel_threshold_ > 0 && det_objs.size() >= fm_->parallel_threshold_;
   for (int age = 0; age < fm_->max_age_; ++age) {
     VLOG(6) << "Cascade: Number of remained detections ----- " << remained_detections.size();
     // no remained detections or no confirmed tracks, end match
@@ -151,16 +221,23 @@ MatchResult &FeatureMatchPrivate::MatchCascade() {
     for (size_t i = 0; i < det_num; ++i) {
       measurements.push_back(to_xyah(det_objs[res.unmatched_detections[i]].bbox));
     }
-    for (size_t i = 0; i < tra_num; ++i) {
+    // each row only depends on its own track, result is the same in serial and parallel
+    const DistanceFunc &cosine_distance = match_algo_->GetDistanceFunc("Cosine");
+    auto calc_cost_row = [&](size_t i) {
       Matrix gating_dist = tracks_[track_indices[i]].kf->GatingDistance(measurements);
       for (size_t j = 0; j < det_num; ++j) {
-        cost_matrix[i][j] = match_algo_->Distance("Cosine", tracks_[track_indices[i]].features,
-                                                  det_objs[res.unmatched_detections[j]].feature);
+        cost_matrix[i][j] = cosine_distance(tracks_[track_indices[i]].features.Data(),
+                                            det_objs[res.unmatched_detections[j]].feature);
         if (cost_matrix[i][j] > fm_->max_cosine_distance_ || gating_dist[0][j] > gating_threshold) {
           VLOG(4) << "object " << i << " - " << j << " feature distance is larger than max_cosine_distance";
           cost_matrix[i][j] = fm_->max_cosine_distance_ + 1e-5;
         }
       }
+    };
+    if (parallel) {
+      WorkerPool::Instance()->ParallelFor(tra_num, calc_cost_row);
+    } else {
+      for (size_t i = 0; i < tra_num; ++i) calc_cost_row(i);
     }
 
     // min cost match
@@ -230,26 +307,71 @@ MatchResult &FeatureMatchPrivate::MatchIou(std::vector<int> detect_indices, std:
   return res;
 }
 
-void FeatureMatchPrivate::InitNewTrack(const DetectObject &det) {
-  FeatureMatchTrackObject obj;
+int FeatureMatchPrivate::InitNewTrack(const DetectObject &det) {
+  int index;
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    index = tracks_.size();
+    tracks_.emplace_back();
+    tracks_[index].kf = new KalmanFilter;
+  }
+  FeatureMatchTrackObject &obj = tracks_[index];
+  obj.in_use = true;
   obj.age = 1;
+  obj.time_since_last_update = 0;
+  obj.track_id = -1;
   obj.class_id = det.label;
+  obj.score = det.score;
   obj.pos = BoundingBox2Rect(det.bbox);
   obj.state = TrackState::TENTATIVE;
-  obj.features.clear();
+  obj.features.Reset(fm_->nn_budget_);
   obj.has_feature = false;
+  obj.feature_unmatched = false;
   if (!det.feature.empty()) {
     for (auto& val : det.feature) {
       if (val != 0) {
         obj.has_feature = true;
-        obj.features.emplace_back(det.feature);
+        obj.features.Push(det.feature);
         break;
       }
     }
   }
-  obj.kf = new KalmanFilter;
   obj.kf->Initiate(to_xyah(det.bbox));
-  tracks_.push_back(obj);
+  active_num_++;
+  return index;
+}
+
+void FeatureMatchPrivate::ReleaseTrack(int index) {
+  FeatureMatchTrackObject &obj = tracks_[index];
+  VLOG(4) << "delete track: " << obj.track_id;
+  obj.in_use = false;
+  obj.features.Reset(0);
+  free_slots_.push_back(index);
+  active_num_--;
+}
+
+void FeatureMatchPrivate::EvictTracks() {
+  if (fm_->max_tracks_ == 0 || active_num_ <= fm_->max_tracks_) return;
+  active_track_.clear();
+  for (size_t i = 0; i < tracks_.size(); ++i) {
+    if (tracks_[i].in_use) active_track_.push_back(i);
+  }
+  // least recently updated tracks go first, younger ones first among them
+  size_t evict_num = active_num_ - fm_->max_tracks_;
+  std::nth_element(active_track_.begin(), active_track_.begin() + evict_num, active_track_.end(),
+                   [this](int a, int b) {
+                     const FeatureMatchTrackObject &ta = tracks_[a], &tb = tracks_[b];
+                     if (ta.time_since_last_update != tb.time_since_last_update) {
+                       return ta.time_since_last_update > tb.time_since_last_update;
+                     }
+                     return ta.age < tb.age;
+                   });
+  for (size_t i = 0; i < evict_num; ++i) {
+    VLOG(4) << "evict track: " << tracks_[active_track_[i]].track_id;
+    ReleaseTrack(active_track_[i]);
+  }
 }
 
 void FeatureMatchPrivate::MarkMiss(FeatureMatchTrackObject *track) {
@@ -268,9 +390,9 @@ void FeatureMatchTrack::UpdateFrame(const TrackFrame &frame, const Objects &dete
 
   uint32_t detect_num = detects.size();
   uint32_t track_num = fm_p_->tracks_.size();
-  VLOG(4) << "FeatureMatch) Track scale, detects " << detect_num << " tracks " << track_num;
+  VLOG(4) << "FeatureMatch) Track scale, detects " << detect_num << " tracks " << fm_p_->active_num_;
   // no tracks, first enter
-  if (fm_p_->tracks_.empty()) {
+  if (fm_p_->active_num_ == 0) {
     fm_p_->tracks_.reserve(detect_num);
     for (size_t i = 0; i < detect_num; ++i) {
       fm_p_->InitNewTrack(detects[i]);
@@ -283,6 +405,7 @@ void FeatureMatchTrack::UpdateFrame(const TrackFrame &frame, const Objects &dete
     fm_p_->unconfirmed_track_.clear();
     fm_p_->confirmed_track_.clear();
     for (size_t i = 0; i < track_num; ++i) {
+      if (!fm_p_->tracks_[i].in_use) continue;
       // update track indices
       if (fm_p_->tracks_[i].state == TrackState::CONFIRMED && fm_p_->tracks_[i].has_feature) {
         fm_p_->confirmed_track_.push_back(i);
@@ -333,10 +456,7 @@ void FeatureMatchTrack::UpdateFrame(const TrackFrame &frame, const Objects &dete
       tracks->rbegin()->track_id = ptrack_obj->track_id;
       tracks->rbegin()->detect_id = pair.first;
       if (!ptrack_obj->feature_unmatched) {
-        ptrack_obj->features.emplace_back(pdetect_obj->feature);
-        if (ptrack_obj->features.size() > nn_budget_) {
-          ptrack_obj->features.erase(ptrack_obj->features.begin());
-        }
+        ptrack_obj->features.Push(pdetect_obj->feature);
       }
       ptrack_obj->time_since_last_update = 0;
       ptrack_obj->age++;
@@ -349,9 +469,9 @@ void FeatureMatchTrack::UpdateFrame(const TrackFrame &frame, const Objects &dete
 
     // unmatched detections: init new track
     for (auto &idx : res_iou.unmatched_detections) {
-      fm_p_->InitNewTrack(detects[idx]);
+      int track_index = fm_p_->InitNewTrack(detects[idx]);
       tracks->push_back(detects[idx]);
-      tracks->rbegin()->track_id = fm_p_->tracks_.rbegin()->track_id;
+      tracks->rbegin()->track_id = fm_p_->tracks_[track_index].track_id;
       tracks->rbegin()->detect_id = idx;
     }
 
@@ -361,17 +481,15 @@ void FeatureMatchTrack::UpdateFrame(const TrackFrame &frame, const Objects &dete
       fm_p_->MarkMiss(&(fm_p_->tracks_[idx]));
     }
 
-    // erase dead track object
-    for (auto iter = fm_p_->tracks_.begin(); iter != fm_p_->tracks_.end();) {
-      if (iter->state == TrackState::DELETED || iter->time_since_last_update > max_age_) {
-        VLOG(4) << "delete track: " << iter->track_id;
-        delete iter->kf;
-        iter = fm_p_->tracks_.erase(iter);
-      } else {
-        iter++;
+    // release dead track object, slot is recycled by later new tracks
+    for (size_t i = 0; i < fm_p_->tracks_.size(); ++i) {
+      FeatureMatchTrackObject &obj = fm_p_->tracks_[i];
+      if (obj.in_use && (obj.state == TrackState::DELETED || obj.time_since_last_update > max_age_)) {
+        fm_p_->ReleaseTrack(i);
       }
     }
   }
+  fm_p_->EvictTracks();
 }
 
 }  // namespace edk
@@ -0,0 +1,288 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "easytrack/easy_track.h"
+#include "kalmanfilter.h"
+#include "match.h"
+#include "track_data_type.h"
+
+static edk::BoundingBox to_xyah(const edk::BoundingBox &bbox) {
+  // keep the aspect ratio finite for degenerate boxes
+  constexpr float min_height = 1e-6f;
+  float height = bbox.height > min_height ? bbox.height : min_height;
+  edk::BoundingBox xyah;
+  xyah.x = bbox.x + bbox.width / 2;
+  xyah.y = bbox.y + bbox.height / 2;
+  xyah.width = bbox.width / height;
+  xyah.height = height;
+  return xyah;
+}
+
+static edk::Rect xyah_to_rect(const edk::BoundingBox &xyah) {
+  edk::Rect rect;
+  float width = xyah.width * xyah.height;
+  rect.xmin = xyah.x - width / 2;
+  rect.ymin = xyah.y - xyah.height / 2;
+  rect.xmax = rect.xmin + width;
+  rect.ymax = rect.ymin + xyah.height;
+  return rect;
+}
+
+namespace edk {
+
+struct IoUMatchTrackObject {
+  Rect pos;
+  int class_id;
+  int track_id = -1;
+  TrackState state;
+  int age = 1;
+  int time_since_last_update = 0;
+  KalmanFilter kf;
+};
+
+class IoUMatchPrivate {
+ private:
+  explicit IoUMatchPrivate(IoUMatchTrack *iou) {
+    iou_ = iou;
+    match_algo_ = MatchAlgorithm::Instance();
+  }
+  void MatchIou(const std::vector<int> &detect_indices, const std::vector<int> &track_indices, MatchResult *res);
+  void InitNewTrack(const DetectObject &obj);
+  void MarkMiss(IoUMatchTrackObject *track);
+  void UpdateMatched(const MatchResult &res, Objects *tracks);
+
+  IoUMatchTrack *iou_;
+
+  MatchAlgorithm *match_algo_;
+  std::vector<IoUMatchTrackObject> tracks_;
+  std::vector<int> high_detections_;
+  std::vector<int> low_detections_;
+  std::vector<int> track_indices_;
+  std::vector<int> assignments_;
+  std::vector<Rect> det_rects_;
+  std::vector<Rect> tra_rects_;
+  MatchResult res_high_;
+  MatchResult res_low_;
+  const Objects *detects_ = nullptr;
+  std::mutex update_mutex_;
+
+  uint64_t next_id_ = 0;
+  friend class IoUMatchTrack;
+};  // class IoUMatchPrivate
+
+IoUMatchTrack::IoUMatchTrack() { iou_p_ = new IoUMatchPrivate(this); }
+
+IoUMatchTrack::~IoUMatchTrack() { delete iou_p_; }
+
+void IoUMatchTrack::SetParams(float max_iou_distance, int max_age, int n_init, float high_score_threshold,
+                              float low_score_threshold) {
+  VLOG(3) << "IoUMatchTrack Params -----";
+  VLOG(3) << "   max IoU distance: " << max_iou_distance;
+  VLOG(3) << "   max age: " << max_age;
+  VLOG(3) << "   n_init: " << n_init;
+  VLOG(3) << "   high score threshold: " << high_score_threshold;
+  VLOG(3) << "   low score threshold: " << low_score_threshold;
+  max_iou_distance_ = max_iou_distance;
+  max_age_ = max_age;
+  n_init_ = n_init;
+  high_score_threshold_ = high_score_threshold;
+  low_score_threshold_ = low_score_threshold;
+}
+
+void IoUMatchPrivate::MatchIou(const std::vector<int> &detect_indices, const std::vector<int> &track_indices,
+                               MatchResult *res) {
+  res->matches.clear();
+  res->unmatched_detections.clear();
+  res->unmatched_tracks.clear();
+  if (detect_indices.empty() || track_indices.empty()) {
+    res->unmatched_detections.insert(res->unmatched_detections.end(), detect_indices.begin(), detect_indices.end());
+    res->unmatched_tracks.insert(res->unmatched_tracks.end(), track_indices.begin(), track_indices.end());
+    return;
+  }
+  VLOG(4) << "MatchIoU) Match scale, detects " << detect_indices.size() << " tracks " << track_indices.size();
+  const Objects &det_objs = *detects_;
+  det_rects_.clear();
+  tra_rects_.clear();
+  for (auto &idx : detect_indices) {
+    det_rects_.push_back(BoundingBox2Rect(det_objs[idx].bbox));
+  }
+  for (auto &idx : track_indices) {
+    tra_rects_.push_back(tracks_[idx].pos);
+  }
+
+  // rows are tracks, cols are detections
+  CostMatrix cost_matrix = match_algo_->IoUCost(tra_rects_, det_rects_);
+  match_algo_->HungarianMatch(cost_matrix, &assignments_);
+
+  std::vector<bool> det_matched(detect_indices.size(), false);
+  for (size_t i = 0; i < assignments_.size(); ++i) {
+    if (assignments_[i] < 0 || cost_matrix[i][assignments_[i]] > iou_->max_iou_distance_) {
+      res->unmatched_tracks.push_back(track_indices[i]);
+    } else {
+      res->matches.push_back(std::make_pair(detect_indices[assignments_[i]], track_indices[i]));
+      det_matched[assignments_[i]] = true;
+    }
+  }
+  for (size_t j = 0; j < detect_indices.size(); ++j) {
+    if (!det_matched[j]) res->unmatched_detections.push_back(detect_indices[j]);
+  }
+}
+
+void IoUMatchPrivate::InitNewTrack(const DetectObject &det) {
+  IoUMatchTrackObject obj;
+  obj.age = 1;
+  obj.class_id = det.label;
+  obj.pos = BoundingBox2Rect(det.bbox);
+  obj.state = TrackState::TENTATIVE;
+  obj.kf.Initiate(to_xyah(det.bbox));
+  tracks_.push_back(std::move(obj));
+}
+
+void IoUMatchPrivate::MarkMiss(IoUMatchTrackObject *track) {
+  if (track->state == TrackState::TENTATIVE || track->time_since_last_update > iou_->max_age_) {
+    track->state = TrackState::DELETED;
+  }
+}
+
+void IoUMatchPrivate::UpdateMatched(const MatchResult &res, Objects *tracks) {
+  const Objects &det_objs = *detects_;
+  for (auto &pair : res.matches) {
+    IoUMatchTrackObject *ptrack_obj = &tracks_[pair.second];
+    const DetectObject *pdetect_obj = &det_objs[pair.first];
+    ptrack_obj->kf.Update(to_xyah(pdetect_obj->bbox));
+    ptrack_obj->pos = BoundingBox2Rect(pdetect_obj->bbox);
+    ptrack_obj->time_since_last_update = 0;
+    ptrack_obj->age++;
+    if (ptrack_obj->state == TrackState::TENTATIVE && ptrack_obj->age > iou_->n_init_) {
+      VLOG(4) << "new track: " << next_id_;
+      ptrack_obj->state = TrackState::CONFIRMED;
+      ptrack_obj->track_id = next_id_++;
+    }
+    tracks->push_back(*pdetect_obj);
+    tracks->rbegin()->track_id = ptrack_obj->track_id;
+    tracks->rbegin()->detect_id = pair.first;
+  }
+}
+
+void IoUMatchTrack::UpdateFrame(const TrackFrame &frame, const Objects &detects, Objects *tracks) {
+  if (tracks == nullptr) {
+    throw EasyTrackError("parameter 'tracks' is nullptr");
+  }
+
+  // guard track state
+  std::lock_guard<std::mutex> lk(iou_p_->update_mutex_);
+
+  uint32_t detect_num = detects.size();
+  uint32_t track_num = iou_p_->tracks_.size();
+  VLOG(4) << "IoUMatch) Track scale, detects " << detect_num << " tracks " << track_num;
+  iou_p_->detects_ = &detects;
+
+  // predict position of all tracks
+  iou_p_->track_indices_.clear();
+  for (size_t i = 0; i < track_num; ++i) {
+    IoUMatchTrackObject &track = iou_p_->tracks_[i];
+    track.time_since_last_update++;
+    track.kf.Predict();
+    track.pos = xyah_to_rect(track.kf.GetState());
+    iou_p_->track_indices_.push_back(i);
+  }
+
+  // divide detections by score
+  iou_p_->high_detections_.clear();
+  iou_p_->low_detections_.clear();
+  for (size_t i = 0; i < detect_num; ++i) {
+    // boxes without area cannot be matched by IoU, report them without track
+    if (detects[i].bbox.width <= 0 || detects[i].bbox.height <= 0) continue;
+    if (detects[i].score >= high_score_threshold_) {
+      iou_p_->high_detections_.push_back(i);
+    } else if (detects[i].score >= low_score_threshold_) {
+      iou_p_->low_detections_.push_back(i);
+    }
+  }
+
+  tracks->reserve(tracks->size() + detect_num);
+  std::vector<bool> det_handled(detect_num, false);
+
+  // first stage: match all tracks with high score detections
+  MatchResult &res_high = iou_p_->res_high_;
+  iou_p_->MatchIou(iou_p_->high_detections_, iou_p_->track_indices_, &res_high);
+  VLOG(6) << "IoUMatch) High score result, matched " << res_high.matches.size() << " unmatched detects "
+          << res_high.unmatched_detections.size() << " unmatched tracks " << res_high.unmatched_tracks.size();
+  iou_p_->UpdateMatched(res_high, tracks);
+  for (auto &pair : res_high.matches) det_handled[pair.first] = true;
+
+  // second stage: match remained confirmed tracks with low score detections
+  iou_p_->track_indices_.clear();
+  for (auto idx : res_high.unmatched_tracks) {
+    if (iou_p_->tracks_[idx].state == TrackState::CONFIRMED) {
+      iou_p_->track_indices_.push_back(idx);
+    } else {
+      VLOG(5) << "Object " << idx << " missed";
+      iou_p_->MarkMiss(&(iou_p_->tracks_[idx]));
+    }
+  }
+  MatchResult &res_low = iou_p_->res_low_;
+  iou_p_->MatchIou(iou_p_->low_detections_, iou_p_->track_indices_, &res_low);
+  VLOG(6) << "IoUMatch) Low score result, matched " << res_low.matches.size() << " unmatched detects "
+          << res_low.unmatched_detections.size() << " unmatched tracks " << res_low.unmatched_tracks.size();
+  iou_p_->UpdateMatched(res_low, tracks);
+  for (auto &pair : res_low.matches) det_handled[pair.first] = true;
+
+  // unmatched tracks: mark missed
+  for (auto idx : res_low.unmatched_tracks) {
+    VLOG(5) << "Object " << idx << " missed";
+    iou_p_->MarkMiss(&(iou_p_->tracks_[idx]));
+  }
+
+  // unmatched high score detections: init new track
+  for (auto &idx : res_high.unmatched_detections) {
+    iou_p_->InitNewTrack(detects[idx]);
+    tracks->push_back(detects[idx]);
+    tracks->rbegin()->track_id = -1;
+    tracks->rbegin()->detect_id = idx;
+    det_handled[idx] = true;
+  }
+
+  // low score and ignored detections are reported without track
+  for (size_t i = 0; i < detect_num; ++i) {
+    if (det_handled[i]) continue;
+    tracks->push_back(detects[i]);
+    tracks->rbegin()->track_id = -1;
+    tracks->rbegin()->detect_id = i;
+  }
+
+  // erase dead track object
+  auto &all_tracks = iou_p_->tracks_;
+  int max_age = max_age_;
+  all_tracks.erase(std::remove_if(all_tracks.begin(), all_tracks.end(),
+                                  [max_age](const IoUMatchTrackObject &track) {
+                                    return track.state == TrackState::DELETED ||
+                                           track.time_since_last_update > max_age;
+                                  }),
+                   all_tracks.end());
+}
+
+}  // namespace edk
@@ -0,0 +1,120 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "worker_pool.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace edk {
+
+// workers besides the calling thread
+constexpr const size_t kMaxWorkerNum = 7;
+
+struct WorkerPool::Job {
+  Job(size_t num, const std::function<void(size_t)> &f) : n(num), func(f) {}
+  // run remained items of this job, return after all items are taken
+  void Run() {
+    size_t i;
+    while ((i = next.fetch_add(1)) < n) {
+      func(i);
+      if (finished.fetch_add(1) + 1 == n) {
+        std::lock_guard<std::mutex> lk(mtx);
+        done_cond.notify_all();
+      }
+    }
+  }
+
+  size_t n;
+  const std::function<void(size_t)> &func;
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> finished{0};
+  std::mutex mtx;
+  std::condition_variable done_cond;
+};  // struct WorkerPool::Job
+
+WorkerPool *WorkerPool::Instance() {
+  static WorkerPool pool([]() -> size_t {
+    size_t core_num = std::thread::hardware_concurrency();
+    return core_num > 1 ? std::min(core_num - 1, kMaxWorkerNum) : 1;
+  }());
+  return &pool;
+}
+
+WorkerPool::WorkerPool(size_t thread_num) {
+  VLOG(3) << "Create track worker pool, threads: " << thread_num;
+  threads_.reserve(thread_num);
+  for (size_t i = 0; i < thread_num; ++i) {
+    threads_.emplace_back(&WorkerPool::WorkLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  for (auto &th : threads_) {
+    if (th.joinable()) th.join();
+  }
+}
+
+void WorkerPool::RemoveJob(const std::shared_ptr<Job> &job) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  auto iter = std::find(jobs_.begin(), jobs_.end(), job);
+  if (iter != jobs_.end()) jobs_.erase(iter);
+}
+
+void WorkerPool::WorkLoop() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      cond_.wait(lk, [this]() { return !running_ || !jobs_.empty(); });
+      if (!running_) return;
+      job = jobs_.front();
+    }
+    job->Run();
+    RemoveJob(job);
+  }
+}
+
+void WorkerPool::ParallelFor(size_t n, const std::function<void(size_t)> &func) {
+  if (n == 0) return;
+  if (n == 1) {
+    func(0);
+    return;
+  }
+  auto job = std::make_shared<Job>(n, func);
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    jobs_.push_back(job);
+  }
+  cond_.notify_all();
+  job->Run();
+  RemoveJob(job);
+  // wait for items taken by workers
+  std::unique_lock<std::mutex> lk(job->mtx);
+  job->done_cond.wait(lk, [&job]() { return job->finished.load() == job->n; });
+}
+
+}  // namespace edk
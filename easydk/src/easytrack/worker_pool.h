@@ -0,0 +1,67 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef EASYTRACK_WORKER_POOL_H_
+#define EASYTRACK_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace edk {
+
+/**
+ * Small worker pool shared by all trackers in the process, used to split per-frame work
+ * (e.g. rows of a cost matrix) over idle cores.
+ */
+class WorkerPool {
+ public:
+  static WorkerPool *Instance();
+
+  /**
+   * Run func(i) for i in [0, n) and block until all of them are done.
+   * The calling thread takes part in the work, so it is safe to call from several threads at the same time.
+   */
+  void ParallelFor(size_t n, const std::function<void(size_t)> &func);
+
+  size_t ThreadNum() const { return threads_.size() + 1; }
+
+ private:
+  struct Job;
+
+  explicit WorkerPool(size_t thread_num);
+  ~WorkerPool();
+  void WorkLoop();
+  void RemoveJob(const std::shared_ptr<Job> &job);
+
+  std::vector<std::thread> threads_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  bool running_ = true;
+};  // class WorkerPool
+
+}  // namespace edk
+
+#endif  // EASYTRACK_WORKER_POOL_H_
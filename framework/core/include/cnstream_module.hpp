@@ -132,6 +132,19 @@ class Module : private NonCopyable {
    */
   virtual int Process(std::shared_ptr<CNFrameInfo> data) = 0;
 
+  /**
+   * Notifies the module that a stream has reached its end.
+   *
+   * @param data The EOS frame of the stream.
+   *
+   * @return Void.
+   *
+   * @note This function is called by the pipeline for modules which do not transmit data by themselves,
+   *       after all the frames of the stream have been processed by this module, and in the same thread.
+   *       Per-stream resources could be released here.
+   */
+  virtual void OnEos(std::shared_ptr<CNFrameInfo> data) {}
+
   /**
    * Gets the name of this module.
    *
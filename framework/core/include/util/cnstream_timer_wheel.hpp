@@ -0,0 +1,384 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_CORE_INCLUDE_CNSTREAM_TIMER_WHEEL_HPP_
+#define MODULES_CORE_INCLUDE_CNSTREAM_TIMER_WHEEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cnstream {
+
+/// Timer wheel utilities
+/****************************************************************************
+  class TimerWheel is a hierarchical timer wheel for a large number of timers
+  which are postponed much more often than they expire, e.g. liveness timers
+  of streams postponed at each received frame. Adding, removing and
+  rescheduling a timer are O(1). Rescheduling only stores the new deadline,
+  a timer is moved in the wheel when its slot is reached, and it expires if
+  the deadline is passed. Timers are one-shot, and expire in the thread of the
+  wheel, at most one tick late. The thread only wakes up at occupied slots of
+  the first level and when higher levels are cascaded down, and sleeps until a
+  timer is added if there is none.
+  Samples are as follows:
+
+  TimerWheel wheel(std::chrono::milliseconds(10));
+  TimerWheel::TimerId id = wheel.Add(std::chrono::seconds(2), [] { ... });
+  wheel.Reschedule(id);  // expires 2 seconds later than now
+  wheel.Remove(id);
+
+  A wheel constructed with ManualTime has no thread, its time only goes on
+  by Advance, which calls the expiry actions, e.g. to drive it in tests:
+
+  TimerWheel wheel(std::chrono::milliseconds(1), TimerWheel::ManualTime());
+  wheel.Add(std::chrono::milliseconds(20), [] { ... });
+  wheel.Advance(std::chrono::milliseconds(20));  // the timer expires
+
+  ***************************************************************************/
+
+/**
+ * @brief a hierarchical timer wheel
+ */
+class TimerWheel {
+ public:
+  using TimerId = uint64_t;  ///< 0 is an invalid timer id
+  using ExpiryAction = std::function<void()>;
+  using Clock = std::chrono::steady_clock;
+  struct ManualTime {};  ///< tag of a wheel driven by Advance
+
+  /**
+   * @brief constructor, start the thread of the wheel
+   *
+   * @param tick precision of timers
+   */
+  explicit TimerWheel(std::chrono::microseconds tick = std::chrono::milliseconds(10))
+      : tick_us_(tick.count() > 0 ? tick.count() : 1), start_(Clock::now()) {
+    for (int level = 0; level < kLevelNum; ++level) {
+      slots_[level].assign(level ? kSlotNum : kFirstSlotNum, static_cast<int32_t>(kNil));
+    }
+    thread_ = std::thread(&TimerWheel::Run, this);
+  }
+
+  /**
+   * @brief constructor, the wheel has no thread, its time starts at 0 and goes on by Advance
+   *
+   * @param tick precision of timers
+   */
+  TimerWheel(std::chrono::microseconds tick, ManualTime)
+      : tick_us_(tick.count() > 0 ? tick.count() : 1), start_(Clock::now()), manual_(true) {
+    for (int level = 0; level < kLevelNum; ++level) {
+      slots_[level].assign(level ? kSlotNum : kFirstSlotNum, static_cast<int32_t>(kNil));
+    }
+  }
+
+  ~TimerWheel() {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    tick_cond_.notify_all();
+    if (thread_.joinable()) thread_.join();
+  }
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  /**
+   * @brief add a timer
+   *
+   * @param timeout the timer expires timeout later, and the same timeout later than now when it is rescheduled
+   * @param action expiry action, called in the thread of the wheel
+   * @return id of the timer
+   */
+  TimerId Add(std::chrono::microseconds timeout, ExpiryAction action) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    // ticks of an empty wheel are skipped instead of being walked through by the thread
+    if (entries_.size() == free_.size()) current_tick_ = std::max(current_tick_, NowUs() / tick_us_);
+    int32_t index;
+    if (free_.empty()) {
+      index = static_cast<int32_t>(entries_.size());
+      entries_.emplace_back();
+    } else {
+      index = free_.back();
+      free_.pop_back();
+    }
+    Entry &entry = entries_[index];
+    entry.action = std::move(action);
+    entry.timeout_us = timeout.count();
+    entry.deadline_us = NowUs() + entry.timeout_us;
+    entry.active = true;
+    const bool wake = Insert(index) < wake_tick_;
+    const TimerId id = MakeId(index, entry.generation);
+    lk.unlock();
+    // the thread sleeps longer than the timeout
+    if (wake) tick_cond_.notify_one();
+    return id;
+  }
+
+  /**
+   * @brief postpone the deadline of a timer to timeout later than now, the timer is not moved in the wheel
+   *
+   * @param id id of the timer
+   * @return return false if the timer is expired or removed
+   */
+  bool Reschedule(TimerId id) {
+    int64_t now_us = NowUs();
+    std::lock_guard<std::mutex> lk(mutex_);
+    Entry *entry = Find(id);
+    if (!entry) return false;
+    entry->deadline_us = now_us + entry->timeout_us;
+    return true;
+  }
+
+  /**
+   * @brief remove a timer, wait for its expiry action if it is running in another thread
+   *
+   * @param id id of the timer
+   * @return return false if the timer is expired or removed
+   */
+  bool Remove(TimerId id) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    Entry *entry = Find(id);
+    if (!entry) {
+      if (id && id == running_id_ && std::this_thread::get_id() != running_thread_) {
+        action_cond_.wait(lk, [&] { return running_id_ != id; });
+      }
+      return false;
+    }
+    Unlink(static_cast<int32_t>(id & 0xffffffff));
+    Free(static_cast<int32_t>(id & 0xffffffff));
+    return true;
+  }
+
+  /**
+   * @brief advance the time of a wheel constructed with ManualTime, expired timers are called in this thread
+   *
+   * @param elapsed time to advance
+   */
+  void Advance(std::chrono::microseconds elapsed) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (!manual_) return;
+    manual_now_us_ += elapsed.count();
+    ExpireUntilNow(&lk);
+  }
+
+  /**
+   * @brief get number of timers
+   *
+   * @return number of timers not expired or removed
+   */
+  size_t Size() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return entries_.size() - free_.size();
+  }
+
+ private:
+  static constexpr int kLevelNum = 4;
+  static constexpr int kFirstSlotBits = 8;
+  static constexpr int kSlotBits = 6;
+  static constexpr int64_t kFirstSlotNum = 1 << kFirstSlotBits;
+  static constexpr int64_t kSlotNum = 1 << kSlotBits;
+  static constexpr int64_t kMaxTicks = int64_t(1) << (kFirstSlotBits + (kLevelNum - 1) * kSlotBits);
+  static constexpr int32_t kNil = -1;
+  static constexpr int64_t kNoWake = INT64_MAX;
+
+  struct Entry {
+    ExpiryAction action;
+    int64_t timeout_us = 0;
+    int64_t deadline_us = 0;  // updated by Reschedule, checked when the slot of the entry is reached
+    uint32_t generation = 1;
+    bool active = false;
+    int level = 0;
+    int64_t slot = 0;
+    int32_t prev = kNil;
+    int32_t next = kNil;
+  };
+
+  int64_t NowUs() const {
+    if (manual_) return manual_now_us_.load();
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_).count();
+  }
+
+  static TimerId MakeId(int32_t index, uint32_t generation) {
+    return (static_cast<TimerId>(generation) << 32) | static_cast<uint32_t>(index);
+  }
+
+  Entry *Find(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id & 0xffffffff);
+    if (index >= entries_.size()) return nullptr;
+    Entry &entry = entries_[index];
+    if (!entry.active || entry.generation != static_cast<uint32_t>(id >> 32)) return nullptr;
+    return &entry;
+  }
+
+  // put the entry in the slot of its deadline, the slot of the last level is used if the deadline is too far,
+  // return the tick of the slot
+  int64_t Insert(int32_t index) {
+    Entry &entry = entries_[index];
+    int64_t expires = (entry.deadline_us + tick_us_ - 1) / tick_us_;
+    if (expires <= current_tick_) expires = current_tick_ + 1;
+    int64_t delta = expires - current_tick_;
+    if (delta >= kMaxTicks) {
+      expires = current_tick_ + kMaxTicks - 1;
+      delta = kMaxTicks - 1;
+    }
+    int level = 0;
+    int64_t slot = expires & (kFirstSlotNum - 1);
+    for (int i = 1; i < kLevelNum; ++i) {
+      if (delta < (int64_t(1) << (kFirstSlotBits + i * kSlotBits - kSlotBits))) break;
+      level = i;
+      slot = (expires >> (kFirstSlotBits + (i - 1) * kSlotBits)) & (kSlotNum - 1);
+    }
+    entry.level = level;
+    entry.slot = slot;
+    entry.prev = kNil;
+    entry.next = slots_[level][slot];
+    if (entry.next != kNil) entries_[entry.next].prev = index;
+    slots_[level][slot] = index;
+    return expires;
+  }
+
+  void Unlink(int32_t index) {
+    Entry &entry = entries_[index];
+    if (entry.prev != kNil) {
+      entries_[entry.prev].next = entry.next;
+    } else {
+      slots_[entry.level][entry.slot] = entry.next;
+    }
+    if (entry.next != kNil) entries_[entry.next].prev = entry.prev;
+    entry.prev = entry.next = kNil;
+  }
+
+  void Free(int32_t index) {
+    Entry &entry = entries_[index];
+    entry.active = false;
+    entry.action = nullptr;
+    entry.generation++;
+    free_.push_back(index);
+  }
+
+  // take all entries of a slot out of the wheel
+  std::vector<int32_t> TakeSlot(int level, int64_t slot) {
+    std::vector<int32_t> indexes;
+    for (int32_t index = slots_[level][slot]; index != kNil; index = entries_[index].next) {
+      indexes.push_back(index);
+    }
+    slots_[level][slot] = kNil;
+    return indexes;
+  }
+
+  // advance one tick, entries of higher levels are cascaded down when the lower level wraps around
+  void TickOnce(std::vector<std::pair<TimerId, ExpiryAction>> *expired) {
+    current_tick_++;
+    int64_t tick = current_tick_;
+    for (int level = 1; level < kLevelNum; ++level) {
+      int shift = kFirstSlotBits + (level - 1) * kSlotBits;
+      if (tick & ((int64_t(1) << shift) - 1)) break;
+      for (int32_t index : TakeSlot(level, (tick >> shift) & (kSlotNum - 1))) Insert(index);
+    }
+    int64_t now_us = current_tick_ * tick_us_;
+    for (int32_t index : TakeSlot(0, tick & (kFirstSlotNum - 1))) {
+      Entry &entry = entries_[index];
+      if (entry.deadline_us > now_us) {
+        // rescheduled, moved to the slot of the new deadline
+        Insert(index);
+        continue;
+      }
+      expired->emplace_back(MakeId(index, entry.generation), std::move(entry.action));
+      Free(index);
+    }
+  }
+
+  // the first tick with an occupied slot of the first level, or the tick the first level wraps around and the
+  // higher levels are cascaded down
+  int64_t NextTick() const {
+    const int64_t wrap = (current_tick_ | (kFirstSlotNum - 1)) + 1;
+    for (int64_t tick = current_tick_ + 1; tick < wrap; ++tick) {
+      if (slots_[0][tick & (kFirstSlotNum - 1)] != kNil) return tick;
+    }
+    return wrap;
+  }
+
+  // advance to the tick of now, and call expiry actions without the lock
+  void ExpireUntilNow(std::unique_lock<std::mutex> *lk) {
+    std::vector<std::pair<TimerId, ExpiryAction>> expired;
+    int64_t target_tick = NowUs() / tick_us_;
+    while (current_tick_ < target_tick) {
+      if (entries_.size() == free_.size()) {
+        current_tick_ = target_tick;
+        break;
+      }
+      TickOnce(&expired);
+    }
+    for (auto &it : expired) {
+      running_id_ = it.first;
+      running_thread_ = std::this_thread::get_id();
+      lk->unlock();
+      it.second();
+      lk->lock();
+      running_id_ = 0;
+      action_cond_.notify_all();
+    }
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (!stop_) {
+      ExpireUntilNow(&lk);
+      if (stop_) break;
+      if (entries_.size() == free_.size()) {
+        wake_tick_ = kNoWake;
+        tick_cond_.wait(lk, [this] { return stop_ || entries_.size() != free_.size(); });
+      } else {
+        wake_tick_ = NextTick();
+        tick_cond_.wait_until(lk, start_ + std::chrono::microseconds(wake_tick_ * tick_us_));
+      }
+    }
+  }
+
+  int64_t tick_us_;
+  Clock::time_point start_;
+  int64_t current_tick_ = 0;
+  int64_t wake_tick_ = kNoWake;  // tick the thread sleeps until, Add wakes it up if a timer expires earlier
+  std::vector<int32_t> slots_[kLevelNum];
+  std::vector<Entry> entries_;
+  std::vector<int32_t> free_;
+  std::mutex mutex_;
+  std::condition_variable tick_cond_;
+  std::condition_variable action_cond_;
+  TimerId running_id_ = 0;
+  std::thread::id running_thread_;  // thread calling the running expiry action
+  bool stop_ = false;
+  bool manual_ = false;
+  std::atomic<int64_t> manual_now_us_{0};  // time of a wheel driven by Advance
+  std::thread thread_;
+};
+
+}  // namespace cnstream
+
+#endif  // MODULES_CORE_INCLUDE_CNSTREAM_TIMER_WHEEL_HPP_
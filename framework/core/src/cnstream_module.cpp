@@ -122,6 +122,8 @@ int Module::DoProcess(std::shared_ptr<CNFrameInfo> data) {
     if (!data->IsEos()) {
       ret = Process(data);
       RecordTime(data, true);
+    } else {
+      OnEos(data);
     }
     RwLockReadGuard guard(container_lock_);
     if (container_) {
@@ -0,0 +1,76 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "util/cnstream_timer.hpp"
+#include "util/cnstream_timer_wheel.hpp"
+
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace cnstream {
+
+/*
+ * 10k liveness timers of streams, each one is postponed at 30 fps, which is what RTSP clients do with each received
+ * frame. Timer removes and adds the timer again, TimerWheel only stores the new deadline.
+ */
+TEST(TimerWheelBenchmark, Reschedule10kTimersAt30Hz) {
+  constexpr int kTimerNum = 10000;
+  constexpr int kRounds = 30;
+  const auto kTimeout = std::chrono::seconds(10);
+  std::atomic<int> expired_num{0};
+
+  Timer timer;
+  std::vector<timer_id> timer_ids(kTimerNum);
+  for (auto &id : timer_ids) id = timer.add(kTimeout, [&](timer_id) { expired_num++; });
+  TimerWheel wheel(std::chrono::milliseconds(10));
+  std::vector<TimerWheel::TimerId> wheel_ids(kTimerNum);
+  for (auto &id : wheel_ids) id = wheel.Add(kTimeout, [&] { expired_num++; });
+
+  double timer_us = 0, wheel_us = 0;
+  auto next_round = steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    std::this_thread::sleep_until(next_round);
+    next_round += microseconds(1000000 / 30);
+    auto start = steady_clock::now();
+    for (auto &id : timer_ids) {
+      timer.remove(id);
+      id = timer.add(kTimeout, [&](timer_id) { expired_num++; });
+    }
+    auto mid = steady_clock::now();
+    for (auto id : wheel_ids) ASSERT_TRUE(wheel.Reschedule(id));
+    auto end = steady_clock::now();
+    timer_us += std::chrono::duration<double, std::micro>(mid - start).count();
+    wheel_us += std::chrono::duration<double, std::micro>(end - mid).count();
+  }
+  EXPECT_EQ(0, expired_num.load());
+  EXPECT_EQ(static_cast<size_t>(kTimerNum), wheel.Size());
+  std::cout << "[TimerWheel] " << kTimerNum << " timers rescheduled at 30 Hz, per round: Timer " << timer_us / kRounds
+            << " us, TimerWheel " << wheel_us / kRounds << " us" << std::endl;
+  for (auto id : wheel_ids) EXPECT_TRUE(wheel.Remove(id));
+  EXPECT_EQ(0u, wheel.Size());
+}
+
+}  // namespace cnstream
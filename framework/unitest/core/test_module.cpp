@@ -94,6 +94,35 @@ TEST(CoreModule, TransmitAttr) {
   EXPECT_TRUE(module_ex.HasTransmit());
 }
 
+class TestModuleEos : public Module {
+ public:
+  TestModuleEos() : Module("test-module-eos") {}
+  ~TestModuleEos() {}
+
+  bool Open(ModuleParamSet set) { return true; }
+  void Close() {}
+  int Process(std::shared_ptr<CNFrameInfo> data) {
+    process_cnt++;
+    return 0;
+  }
+  void OnEos(std::shared_ptr<CNFrameInfo> data) { eos_streams.push_back(data->stream_id); }
+
+  int process_cnt = 0;
+  std::vector<std::string> eos_streams;
+};
+
+TEST(CoreModule, OnEos) {
+  TestModuleEos module;
+  ModuleParamSet params;
+  ASSERT_TRUE(module.Open(params));
+  EXPECT_EQ(module.DoProcess(CNFrameInfo::Create("0")), 0);
+  EXPECT_EQ(module.DoProcess(CNFrameInfo::Create("0", true)), 0);
+  EXPECT_EQ(module.process_cnt, 1);
+  ASSERT_EQ(module.eos_streams.size(), 1u);
+  EXPECT_EQ(module.eos_streams[0], "0");
+  module.Close();
+}
+
 TEST(CoreModule, postevent) {
   Pipeline pipe("pipe");
   std::shared_ptr<TestModuleBase> ptr(new (TestModuleBase));
@@ -0,0 +1,150 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+#include "util/cnstream_timer_wheel.hpp"
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace cnstream {
+
+TEST(TimerWheelTest, Expire) {
+  TimerWheel wheel(milliseconds(1), TimerWheel::ManualTime());
+  int expired_num = 0;
+  EXPECT_NE(0u, wheel.Add(milliseconds(20), [&] { expired_num++; }));
+  EXPECT_EQ(1u, wheel.Size());
+  wheel.Advance(milliseconds(19));
+  EXPECT_EQ(0, expired_num);
+  wheel.Advance(milliseconds(1));
+  EXPECT_EQ(1, expired_num);
+  EXPECT_EQ(0u, wheel.Size());
+}
+
+TEST(TimerWheelTest, ExpireInThread) {
+  TimerWheel wheel(milliseconds(1));
+  std::promise<steady_clock::time_point> expired;
+  auto start = steady_clock::now();
+  EXPECT_NE(0u, wheel.Add(milliseconds(20), [&] { expired.set_value(steady_clock::now()); }));
+  auto future = expired.get_future();
+  ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(2)));
+  // never earlier than the timeout
+  EXPECT_GE(future.get() - start, milliseconds(20));
+  EXPECT_EQ(0u, wheel.Size());
+}
+
+TEST(TimerWheelTest, RescheduleAndRemove) {
+  TimerWheel wheel(milliseconds(1), TimerWheel::ManualTime());
+  int expired_num = 0;
+  TimerWheel::TimerId id = wheel.Add(milliseconds(30), [&] { expired_num++; });
+  // postponed for 100ms, longer than the timeout
+  for (int i = 0; i < 20; ++i) {
+    wheel.Advance(milliseconds(5));
+    EXPECT_TRUE(wheel.Reschedule(id));
+  }
+  wheel.Advance(milliseconds(29));
+  EXPECT_EQ(0, expired_num);
+  wheel.Advance(milliseconds(1));
+  EXPECT_EQ(1, expired_num);
+  EXPECT_FALSE(wheel.Reschedule(id));
+  EXPECT_FALSE(wheel.Remove(id));
+
+  TimerWheel::TimerId removed = wheel.Add(milliseconds(10), [&] { expired_num++; });
+  EXPECT_TRUE(wheel.Remove(removed));
+  // the slot is reused, the id of the removed timer is still invalid
+  TimerWheel::TimerId reused = wheel.Add(milliseconds(10), [&] { expired_num++; });
+  EXPECT_NE(removed, reused);
+  EXPECT_FALSE(wheel.Reschedule(removed));
+  wheel.Advance(milliseconds(10));
+  EXPECT_EQ(2, expired_num);
+  EXPECT_FALSE(wheel.Reschedule(0));
+}
+
+TEST(TimerWheelTest, CascadeLongTimeout) {
+  // timeouts of higher levels are cascaded to the first level before expiry, and expire at the tick of the deadline
+  TimerWheel wheel(microseconds(100), TimerWheel::ManualTime());
+  const int64_t timeouts_us[] = {50000, 300000, 700000, 30000000};
+  std::vector<int64_t> expired_us(4, 0);
+  int64_t now_us = 0;
+  for (int i = 0; i < 4; ++i) {
+    wheel.Add(microseconds(timeouts_us[i]), [&, i] { expired_us[i] = now_us; });
+  }
+  while (now_us < timeouts_us[3]) {
+    now_us += 100;
+    wheel.Advance(microseconds(100));
+  }
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(timeouts_us[i], expired_us[i]);
+  EXPECT_EQ(0u, wheel.Size());
+}
+
+TEST(TimerWheelTest, AddToSleepingWheel) {
+  // the thread sleeps until the far timer is cascaded down, the near timer added later wakes it up
+  TimerWheel wheel(milliseconds(10));
+  wheel.Add(std::chrono::seconds(10), [] {});
+  std::this_thread::sleep_for(milliseconds(50));
+  std::promise<steady_clock::time_point> expired;
+  auto start = steady_clock::now();
+  wheel.Add(milliseconds(20), [&] { expired.set_value(steady_clock::now()); });
+  auto future = expired.get_future();
+  ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(1)));
+  EXPECT_GE(future.get() - start, milliseconds(20));
+  EXPECT_EQ(1u, wheel.Size());
+
+  // ticks of an empty wheel are skipped, timers added after a long idle time expire on time
+  TimerWheel manual_wheel(milliseconds(1), TimerWheel::ManualTime());
+  manual_wheel.Advance(std::chrono::hours(1));
+  int expired_num = 0;
+  manual_wheel.Add(milliseconds(20), [&] { expired_num++; });
+  manual_wheel.Advance(milliseconds(19));
+  EXPECT_EQ(0, expired_num);
+  manual_wheel.Advance(milliseconds(1));
+  EXPECT_EQ(1, expired_num);
+}
+
+TEST(TimerWheelTest, RemoveInExpiryAction) {
+  TimerWheel wheel(milliseconds(1));
+  std::promise<void> done;
+  TimerWheel::TimerId other = wheel.Add(std::chrono::seconds(10), [] {});
+  wheel.Add(milliseconds(5), [&] {
+    EXPECT_TRUE(wheel.Remove(other));
+    done.set_value();
+  });
+  EXPECT_EQ(std::future_status::ready, done.get_future().wait_for(std::chrono::seconds(2)));
+  EXPECT_EQ(0u, wheel.Size());
+
+  // expiry actions of a manual wheel are called in the thread advancing it, removing itself does not wait
+  TimerWheel manual_wheel(milliseconds(1), TimerWheel::ManualTime());
+  TimerWheel::TimerId self = 0;
+  int expired_num = 0;
+  self = manual_wheel.Add(milliseconds(5), [&] {
+    EXPECT_FALSE(manual_wheel.Remove(self));
+    expired_num++;
+  });
+  manual_wheel.Advance(milliseconds(5));
+  EXPECT_EQ(1, expired_num);
+  EXPECT_EQ(0u, manual_wheel.Size());
+}
+
+}  // namespace cnstream
@@ -30,6 +30,8 @@
 #include <unistd.h>
 
 #include <glog/logging.h>
+#include <cerrno>
+#include <climits>
 #include <cstring>
 #include <map>
 #include <memory>
@@ -454,6 +456,33 @@ void CNDataFrame::ReleaseSharedMem(MemMapType type, std::string stream_id) {
   return;
 }
 
+static int StringToId(const std::string& str) {
+  if (str.empty()) return -1;
+  char* end = nullptr;
+  errno = 0;
+  long value = strtol(str.c_str(), &end, 10);  // NOLINT
+  if (*end != '\0' || errno == ERANGE || value < INT_MIN || value > INT_MAX) return -1;
+  return static_cast<int>(value);
+}
+
+void CNInferObject::SetClassId(const std::string& class_id) {
+  class_id_ = class_id.empty() ? kIdNotSet : StringToId(class_id);
+  id = class_id;
+}
+
+int CNInferObject::GetClassId() const {
+  return class_id_ != kIdNotSet ? class_id_ : StringToId(id);
+}
+
+void CNInferObject::SetTrackId(const std::string& track_id) {
+  track_id_ = track_id.empty() ? kIdNotSet : StringToId(track_id);
+  this->track_id = track_id;
+}
+
+int CNInferObject::GetTrackId() const {
+  return track_id_ != kIdNotSet ? track_id_ : StringToId(track_id);
+}
+
 bool CNInferObject::AddAttribute(const std::string& key, const CNInferAttr& value) {
   std::lock_guard<std::mutex> lk(attribute_mutex_);
   if (attributes_.find(key) != attributes_.end()) return false;
@@ -477,6 +506,11 @@ CNInferAttr CNInferObject::GetAttribute(const std::string& key) {
   return CNInferAttr();
 }
 
+std::vector<std::pair<std::string, CNInferAttr>> CNInferObject::GetAttributes() {
+  std::lock_guard<std::mutex> lk(attribute_mutex_);
+  return std::vector<std::pair<std::string, CNInferAttr>>(attributes_.begin(), attributes_.end());
+}
+
 bool CNInferObject::AddExtraAttribute(const std::string& key, const std::string& value) {
   std::lock_guard<std::mutex> lk(attribute_mutex_);
   if (extra_attributes_.find(key) != extra_attributes_.end()) return false;
@@ -247,6 +247,8 @@ struct CNDataFrame {
   void ReleaseSharedMem(MemMapType type, std::string stream_id);
 
   void* mlu_mem_handle = nullptr;  ///< The MLU memory handle for MLU data.
+  int shm_slot = -1;               ///< The slot of the shared memory frame ring holding the data, -1 if not in a ring.
+  uint32_t shm_generation = 0;     ///< The generation of the slot when the data is written to it.
 
  public:
   void* cpu_data = nullptr;  ///< CPU data pointer. You need to allocate it by calling CNStreamMallocHost().
@@ -323,12 +325,98 @@ using StringPairs = std::vector<std::pair<std::string, std::string>>;
  */
 struct CNInferObject {
  public:
-  std::string id;           ///< The ID of the classification (label value).
-  std::string track_id;     ///< The tracking result.
+  /**
+   * The ID of the classification (label value).
+   *
+   * @Note This field will deprecate, use SetClassId() and GetClassId() instead. It is kept in sync by SetClassId().
+   */
+  std::string id;
+  /**
+   * The tracking result.
+   *
+   * @Note This field will deprecate, use SetTrackId() and GetTrackId() instead. It is kept in sync by SetTrackId().
+   */
+  std::string track_id;
   float score;              ///< The label score.
   CNInferBoundingBox bbox;  ///< The object normalized coordinates.
   std::unordered_map<int, any> datas;  ///< user-defined structured information.
 
+  /**
+   * Sets the ID of the classification (label value). Both the integer ID and the string ``id`` are updated.
+   *
+   * @param class_id The ID of the classification.
+   *
+   * @return Void.
+   */
+  void SetClassId(int class_id) {
+    class_id_ = class_id;
+    id = std::to_string(class_id);
+  }
+
+  /**
+   * Sets the ID of the classification by a string, for labels which are not integers.
+   *
+   * @param class_id The ID of the classification.
+   *
+   * @return Void.
+   */
+  void SetClassId(const std::string& class_id);
+
+  /**
+   * Gets the ID of the classification.
+   *
+   * @return Returns the ID set by SetClassId(). If it is not set, the string ``id`` is parsed.
+   *         -1 is returned if the string is not an integer.
+   *
+   * @note Once SetClassId() is called, modifying ``id`` directly does not change the returned value.
+   */
+  int GetClassId() const;
+
+  /**
+   * Gets the ID of the classification as a string.
+   *
+   * @return Returns the string ``id``. An empty string is returned if it is not set.
+   */
+  std::string GetClassIdStr() const { return id; }
+
+  /**
+   * Sets the tracking result. Both the integer track ID and the string ``track_id`` are updated.
+   *
+   * @param track_id The track ID, -1 means the object is not tracked yet.
+   *
+   * @return Void.
+   */
+  void SetTrackId(int track_id) {
+    track_id_ = track_id;
+    this->track_id = std::to_string(track_id);
+  }
+
+  /**
+   * Sets the tracking result by a string, for trackers which do not use integer IDs.
+   *
+   * @param track_id The track ID.
+   *
+   * @return Void.
+   */
+  void SetTrackId(const std::string& track_id);
+
+  /**
+   * Gets the tracking result.
+   *
+   * @return Returns the track ID set by SetTrackId(). If it is not set, the string ``track_id`` is parsed.
+   *         -1 is returned if the string is not an integer.
+   *
+   * @note Once SetTrackId() is called, modifying ``track_id`` directly does not change the returned value.
+   */
+  int GetTrackId() const;
+
+  /**
+   * Gets the tracking result as a string.
+   *
+   * @return Returns the string ``track_id``. An empty string is returned if it is not set.
+   */
+  std::string GetTrackIdStr() const { return track_id; }
+
   /**
    * Adds the key of an attribute to a specified object.
    *
@@ -366,6 +454,15 @@ struct CNInferObject {
    */
   CNInferAttr GetAttribute(const std::string& key);
 
+  /**
+   * Gets all attributes of an object.
+   *
+   * @return Returns all attributes.
+   *
+   * @note This is a thread-safe function.
+   */
+  std::vector<std::pair<std::string, CNInferAttr>> GetAttributes();
+
   /**
    * Adds the key of the extended attribute to a specified object.
    *
@@ -459,6 +556,10 @@ struct CNInferObject {
   void* user_data_ = nullptr;  ///< User data. You can store your own data in this parameter.
 
  private:
+  // ids are kept as integers, so readers of the integers do not parse the strings
+  static constexpr int kIdNotSet = -2;
+  int class_id_ = kIdNotSet;
+  int track_id_ = kIdNotSet;
   std::unordered_map<std::string, CNInferAttr> attributes_;
   std::unordered_map<std::string, std::string> extra_attributes_;
   std::unordered_map<std::string, CNInferFeature> features_;
@@ -477,6 +578,32 @@ using CNDataFramePtr = std::shared_ptr<CNDataFrame>;
 static constexpr int CNObjsVecKey = 1;
 using CNObjsVec = std::vector<std::shared_ptr<CNInferObject>>;
 
+/**
+ * Codec of a compressed packet.
+ */
+enum class CNPacketCodec { H264 = 0, HEVC, MPEG4, MJPEG, UNKNOWN };
+
+/**
+ * A compressed packet read by the source, before decoding.
+ *
+ * H.264 and HEVC packets are Annex B byte streams (start code prefixed), so they could be written or sent
+ * without transcoding.
+ */
+struct CNPacket {
+  std::vector<uint8_t> data;                      ///< The bitstream of the packet.
+  int64_t pts = 0;                                ///< The presentation timestamp, 90kHz for file sources.
+  bool key = false;                               ///< Whether the packet is a key frame.
+  CNPacketCodec codec = CNPacketCodec::UNKNOWN;   ///< The codec of the packet.
+};
+
+/*
+ * Packets sent to the decoder since the previous frame was output, in decoding order. Packets of all frames of a
+ * stream make up the whole bitstream. With B-frames or decoder delay, the packet a frame is decoded from may be
+ * attached to an earlier frame. Only set when the source is configured to attach packets.
+ */
+static constexpr int CNPacketsKey = 2;
+using CNPacketsVec = std::vector<std::shared_ptr<CNPacket>>;
+
 }  // namespace cnstream
 
 #endif  // CNSTREAM_FRAME_VA_HPP_
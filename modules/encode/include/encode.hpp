@@ -43,6 +43,7 @@ using CNFrameInfoPtr = std::shared_ptr<cnstream::CNFrameInfo>;
 
 struct EncodeContext;
 struct EncodeParam;
+class SnapshotEncoder;
 /**
  * @brief Encode is a module for encoding the video or image on MLU.
  */
@@ -67,7 +68,11 @@ class Encode : public Module, public ModuleCreator<Encode> {
    *   encoder_type: Optional. Use cpu encoding or mlu encoding. The default encoder_type is cpu.
    *                 Supported values are ``mlu`` and ``cpu``.
    *   codec_type:   Optional. The codec type. The default codec_type is h264.
-   *                 Supported values are ``jpeg``, ``h264`` and ``hevc``.
+   *                 Supported values are ``jpeg``, ``h264``, ``hevc`` and ``mpeg4``(cpu only).
+   *                 Videos encoded on cpu are encoded by libavcodec on a worker thread of each stream,
+   *                 and muxed into {output_dir}/encode_stream_{stream_id}.mp4.
+   *                 Jpeg images encoded on cpu are encoded from yuv by a pool of workers shared by all streams,
+   *                 and written to {output_dir}/stream_{stream_id}_frame_{index}.jpg.
    *   preproc_type: Optional. Preprocessing data on cpu or mlu(mlu is not supported yet). The default preproc_type is cpu.
    *                 Supported value is ``cpu``.
    * 
@@ -83,6 +88,40 @@ class Encode : public Module, public ModuleCreator<Encode> {
    *                 Supported values are digital numbers.
    *   gop_size:     Optional.The gop size. The default gop size is 30.
    *                 Supported values are digital numbers.
+   *   preset:       Optional.The preset of cpu video encoder. The default preset is veryfast.
+   *                 Supported values are presets of libx264/libx265, e.g. ``ultrafast``, ``veryfast``, ``medium``.
+   *   encode_threads: Optional.Threads of cpu video encoder for each stream.
+   *                 The default value is 0, which means decided by the encoder.
+   *   input_queue_size: Optional.Frames waiting to be encoded by cpu video encoder at most for each stream,
+   *                 Process blocks when the queue is full. The default value is 4.
+   *   segment_duration: Optional.Seconds of each segment of cpu video. Segments start at key frames and are named
+   *                 {output_dir}/encode_stream_{stream_id}_{index}.mp4. The default value is 0,
+   *                 which means one file for a stream.
+   *   segment_num:  Optional.Segment files kept at most for each stream, the oldest are removed.
+   *                 The default value is 0, which means all segments are kept.
+   *   event_pre_seconds: Optional.Seconds before an event in event clips of cpu video, see SaveEventClip.
+   *                 The default value is 0, which means event clips are disabled.
+   *   event_post_seconds: Optional.Seconds after an event in event clips. The default value is 10.
+   *   event_buffer_size: Optional.Megabytes of packets kept in memory for event clips at most for each stream.
+   *                 The default value is 64.
+   *   jpeg_quality: Optional.Quality of jpeg encoded on cpu, from 1 to 100. The default value is 85.
+   *   snapshot_threads: Optional.Threads encoding jpeg on cpu, shared by all streams. The default value is 2.
+   *   snapshot_queue_size: Optional.Snapshots waiting to be encoded as jpeg on cpu at most.
+   *                 The default value is 32.
+   *   snapshot_drop_policy: Optional.What to do when the snapshot queue is full. The default value is none.
+   *                 Supported values are ``none`` (Process blocks), ``newest`` (the new snapshot is dropped)
+   *                 and ``oldest`` (the oldest waiting snapshot is dropped).
+   *   snapshot_objects: Optional.Encode crops of detected objects as jpeg on cpu instead of whole frames.
+   *                 Crops are named {output_dir}/stream_{stream_id}_frame_{frame_id}_obj_{index}.jpg.
+   *                 The default value is false. Supported values are ``true`` and ``false``.
+   *   passthrough:  Optional.Write compressed packets attached by the source (``output_packets`` of DataSource)
+   *                 to {output_dir}/passthrough_stream_{stream_id}.h264 (.h265, .m4v or .mjpeg) as they are,
+   *                 without decoding or encoding. Other encoding parameters are not used. A stream added again
+   *                 after eos is written to passthrough_stream_{stream_id}_{n}, earlier files are kept.
+   *                 The default value is false. Supported values are ``true`` and ``false``.
+   *   passthrough_metadata: Optional.Insert objects of each frame into H.264/HEVC passthrough streams as user data
+   *                 unregistered sei, see PassthroughWriter. The default value is false.
+   *                 Supported values are ``true`` and ``false``.
    *   output_dir:   Optional.The output directory. The default output directory is {CURRENT_DIR}/output.
    *                 Supported values are directories which could be accessed.
    *   device_id:    Required if encoder_type or preproc_type is set to ``mlu``. The device id.
@@ -121,6 +160,20 @@ class Encode : public Module, public ModuleCreator<Encode> {
    * @return Returns true if this API run successfully. Otherwise, returns false.
    */
   bool CheckParamSet(const ModuleParamSet& paramSet) const override;
+  /**
+   * @brief Save an event clip of a stream encoded on cpu, without re-encoding.
+   *
+   * Encoded packets of the last event_pre_seconds are kept in memory. The clip starts from the key frame at least
+   * event_pre_seconds before the latest encoded frame, and ends event_post_seconds after it.
+   * It returns at once, the clip is finished by frames encoded later, or by eos.
+   *
+   * @param stream_id The stream id.
+   * @param file_name The mp4 file name of the clip. If it is empty,
+   *                  {output_dir}/event_stream_{stream_id}_{index}.mp4 is used.
+   *
+   * @return Returns true if the clip is going to be saved.
+   */
+  bool SaveEventClip(const std::string& stream_id, const std::string& file_name = "");
   /**
    * @brief Records the start time and the end time of the module
    *
@@ -133,9 +186,14 @@ class Encode : public Module, public ModuleCreator<Encode> {
 
  private:
   EncodeContext* GetEncodeContext(CNFrameInfoPtr data);
+  void DestroyEncodeContext(const std::string& stream_id);
+  bool SaveObjectSnapshots(CNFrameInfoPtr data);
+  bool WritePassthrough(CNFrameInfoPtr data);
   EncodeParam* param_ = nullptr;
+  std::shared_ptr<SnapshotEncoder> snapshot_encoder_ = nullptr;
   uint32_t dst_stride_;
   std::unordered_map<std::string, EncodeContext*> ctxs_;
+  std::unordered_map<std::string, uint32_t> passthrough_sessions_;  // guarded by ctx_lock_
   RwLock ctx_lock_;
 };  // class Encode
 
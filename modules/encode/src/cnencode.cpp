@@ -43,10 +43,16 @@ bool CNEncode::Init() {
     LOG(ERROR) << "[CNEncode] Init function should be called only once.";
     return false;
   }
-  if (cnencode_param_.encoder_type == "cpu" &&
-      cnencode_param_.dst_pix_fmt != BGR24 &&
-      cnencode_param_.dst_pix_fmt != RGB24) {
-    LOG(ERROR) << "[CNEncode] cpu encoding only support bgr24/rgb24 format.";
+  if (cnencode_param_.encoder_type == "cpu" && cnencode_param_.codec_type == JPEG &&
+      cnencode_param_.dst_pix_fmt != BGR24 && cnencode_param_.dst_pix_fmt != NV12 &&
+      cnencode_param_.dst_pix_fmt != NV21) {
+    LOG(ERROR) << "[CNEncode] cpu jpeg encoding only support bgr24/nv12/nv21 format.";
+    return false;
+  }
+  if (cnencode_param_.encoder_type == "cpu" && cnencode_param_.codec_type != JPEG &&
+      cnencode_param_.dst_pix_fmt != NV12 &&
+      cnencode_param_.dst_pix_fmt != NV21) {
+    LOG(ERROR) << "[CNEncode] cpu video encoding only support nv12/nv21 format.";
     return false;
   }
   if (cnencode_param_.encoder_type == "mlu" &&
@@ -188,30 +194,49 @@ bool CNEncode::CreateCpuEncoder() {
     LOG(ERROR) << "[CNEncode]  Create cpu encoder failed, dst_width or dst_height is 0";
     return false;
   }
-  size_ = cv::Size(cnencode_param_.dst_width, cnencode_param_.dst_height);
-  std::string filename = cnencode_param_.output_dir + "/encode_stream_" + cnencode_param_.stream_id;
-  int fourcc = -1;
-#if ((CV_MAJOR_VERSION < 3) || CNS_MLU220_SOC)
-  LOG(WARNING) << "[CNEncode] H264 or HEVC encoder is not supported. MJPG encoder will be used instead.";
-  if (cnencode_param_.codec_type == H264 || cnencode_param_.codec_type == HEVC) {
-    fourcc = CV_FOURCC('M', 'J', 'P', 'G');
-    filename += ".avi";
+  if (cnencode_param_.codec_type == JPEG) {
+    if (!snapshot_encoder_) {
+      SnapshotEncoder::Param param;
+      param.thread_num = 1;
+      param.quality = cnencode_param_.jpeg_quality;
+      snapshot_encoder_ = std::make_shared<SnapshotEncoder>(param);
+      if (!snapshot_encoder_->Open()) {
+        LOG(ERROR) << "[CNEncode] Create snapshot encoder failed";
+        snapshot_encoder_.reset();
+        return false;
+      }
+    }
+    snapshot_prefix_ = cnencode_param_.output_dir + "/stream_" + cnencode_param_.stream_id + "_frame_";
+    return true;
   }
-#else
-  if (cnencode_param_.codec_type == H264) {
-    fourcc = CV_FOURCC('a', 'v', 'c', '1');
-    filename += ".mp4";
-  } else if (cnencode_param_.codec_type == HEVC) {
-    fourcc = CV_FOURCC('h', 'e', 'v', '1');
-    filename += ".mov";
+  FFmpegEncoder::Param param;
+  param.width = cnencode_param_.dst_width;
+  param.height = cnencode_param_.dst_height;
+  param.pix_fmt = cnencode_param_.dst_pix_fmt;
+  param.codec_type = cnencode_param_.codec_type;
+  param.frame_rate = cnencode_param_.frame_rate;
+  param.bit_rate = cnencode_param_.bit_rate;
+  param.gop = cnencode_param_.gop;
+  param.preset = cnencode_param_.preset;
+  param.thread_num = cnencode_param_.thread_num;
+  param.queue_size = cnencode_param_.queue_size;
+  std::string file_prefix = cnencode_param_.output_dir + "/encode_stream_" + cnencode_param_.stream_id;
+  if (cnencode_param_.segment_duration > 0) {
+    // segments take the place of the single file
+    param.record.file_prefix = file_prefix;
+    param.record.segment_duration = cnencode_param_.segment_duration;
+    param.record.segment_num = cnencode_param_.segment_num;
+  } else {
+    param.file_name = file_prefix + ".mp4";
   }
-#endif
-  if (fourcc >= 0) {
-    writer_ = std::move(cv::VideoWriter(filename, fourcc, cnencode_param_.frame_rate, size_));
-    if (!writer_.isOpened()) {
-      LOG(ERROR) << "[CNEncode] Create cpu encoder failed";
-      return false;
-    }
+  param.record.buffer_duration = cnencode_param_.event_pre_seconds;
+  param.record.buffer_bytes = cnencode_param_.event_buffer_bytes;
+  cpu_encoder_.reset(new FFmpegEncoder(param));
+  cpu_encoder_->SetPacketCallback([this](int64_t timestamp) { RecordEndTime(timestamp); });
+  if (!cpu_encoder_->Open()) {
+    LOG(ERROR) << "[CNEncode] Create cpu encoder failed";
+    cpu_encoder_.reset();
+    return false;
   }
   return true;
 }
@@ -249,27 +274,65 @@ CNEncode::~CNEncode() {
   if (p_file_) {
     fclose(p_file_);
   }
-  if (writer_.isOpened()) {
-    writer_.release();
+  if (cpu_encoder_) {
+    cpu_encoder_->Close();
+    cpu_encoder_.reset();
   }
+  // snapshots of this stream may still be waiting, they are written by the encoder shared with others
+  snapshot_encoder_.reset();
 }
 
 bool CNEncode::Update(const cv::Mat src, int64_t timestamp) {
-  if (cnencode_param_.codec_type == JPEG) {
-    cv::imwrite(cnencode_param_.output_dir + "/stream_" + cnencode_param_.stream_id + "_frame_" +
-                std::to_string(++frame_count_) + ".jpg", src);
-  } else {
-    if (!writer_.isOpened()) {
+  if (cnencode_param_.codec_type != JPEG) {
+    LOG(ERROR) << "[CNEncode] cpu video encoding takes nv12/nv21 frames.";
+    return false;
+  }
+  if (!snapshot_encoder_) {
+    LOG(ERROR) << "[CNEncode] snapshot encoder is not existed.";
+    return false;
+  }
+  return snapshot_encoder_->Submit(src, cv::Rect(), snapshot_prefix_ + std::to_string(++frame_count_) + ".jpg",
+                                   SnapshotDoneCallback(timestamp));
+}
+
+bool CNEncode::SaveEventClip(const std::string &file_name) {
+  if (!cpu_encoder_) {
+    LOG(ERROR) << "[CNEncode] Event clip is only supported by cpu video encoding.";
+    return false;
+  }
+  std::string clip_name = file_name;
+  if (clip_name.empty()) {
+    clip_name = cnencode_param_.output_dir + "/event_stream_" + cnencode_param_.stream_id + "_" +
+                std::to_string(++event_count_) + ".mp4";
+  }
+  return cpu_encoder_->SaveClip(clip_name, cnencode_param_.event_pre_seconds, cnencode_param_.event_post_seconds);
+}
+
+bool CNEncode::Update(const uint8_t* src_y, const uint8_t* src_uv, int64_t timestamp, bool eos, uint32_t stride) {
+  if (stride == 0) stride = cnencode_param_.dst_stride;
+  if (cnencode_param_.encoder_type == "cpu" && cnencode_param_.codec_type == JPEG) {
+    if (!snapshot_encoder_) {
+      LOG(ERROR) << "[CNEncode] snapshot encoder is not existed.";
+      return false;
+    }
+    if (eos) return true;
+    return snapshot_encoder_->Submit(src_y, src_uv, cnencode_param_.dst_width, cnencode_param_.dst_height, stride,
+                                     cnencode_param_.dst_pix_fmt == NV21, cv::Rect(),
+                                     snapshot_prefix_ + std::to_string(++frame_count_) + ".jpg",
+                                     SnapshotDoneCallback(timestamp));
+  }
+  if (cnencode_param_.encoder_type == "cpu") {
+    if (!cpu_encoder_) {
       LOG(ERROR) << "[CNEncode] cpu encoder is not existed.";
       return false;
     }
-    writer_.write(src);
+    if (eos) {
+      // flush encoder and finish the file
+      cpu_encoder_->Close();
+      return true;
+    }
+    return cpu_encoder_->SendFrame(src_y, src_uv, stride, timestamp);
   }
-  RecordEndTime(timestamp);
-  return true;
-}
-
-bool CNEncode::Update(uint8_t* src_y, uint8_t* src_uv, int64_t timestamp, bool eos) {
   if (!mlu_encoder_) {
     LOG(ERROR) << "[CNEncode] mlu encoder is not existed.";
     return false;
@@ -288,10 +351,10 @@ bool CNEncode::Update(uint8_t* src_y, uint8_t* src_uv, int64_t timestamp, bool e
     cnframe->pformat = picture_format_;
     cnframe->frame_size = output_frame_size_;
     cnframe->n_planes = 2;
-    cnframe->strides[0] = cnencode_param_.dst_stride;
-    cnframe->strides[1] = cnencode_param_.dst_stride;
-    cnframe->ptrs[0] = reinterpret_cast<void *>(src_y);
-    cnframe->ptrs[1] = reinterpret_cast<void *>(src_uv);
+    cnframe->strides[0] = stride;
+    cnframe->strides[1] = stride;
+    cnframe->ptrs[0] = const_cast<void *>(reinterpret_cast<const void *>(src_y));
+    cnframe->ptrs[1] = const_cast<void *>(reinterpret_cast<const void *>(src_uv));
   }
   try {
     if (!mlu_encoder_->SendDataCPU(*cnframe, eos)) {
@@ -374,6 +437,15 @@ void CNEncode::EosCallback() {
   LOG(INFO) << "[CNEncode] EosCallback ... ";
 }
 
+SnapshotEncoder::DoneCallback CNEncode::SnapshotDoneCallback(int64_t pts) const {
+  // the snapshot encoder may be shared by streams and outlive this object
+  std::shared_ptr<PerfManager> manager = perf_manager_;
+  std::string module_name = module_name_;
+  return [manager, module_name, pts]() {
+    if (manager) manager->Record(true, PerfManager::GetDefaultType(), module_name, pts);
+  };
+}
+
 void CNEncode::RecordEndTime(int64_t pts) {
   if (perf_manager_ != nullptr) {
     perf_manager_->Record(true, cnstream::PerfManager::GetDefaultType(), module_name_, pts);
@@ -39,6 +39,7 @@ extern "C" {
 #error OpenCV required
 #endif
 
+#include <atomic>
 #include <memory>
 #include <string>
 
@@ -46,7 +47,9 @@ extern "C" {
 #include "encode.hpp"
 #include "easycodec/easy_encode.h"
 #include "easycodec/vformat.h"
+#include "ffmpeg_encoder.hpp"
 #include "perf_manager.hpp"
+#include "snapshot_encoder.hpp"
 
 namespace cnstream {
 
@@ -62,6 +65,15 @@ class CNEncode {
     int frame_rate = 25;
     int bit_rate = 0x100000;
     int gop = 30;
+    std::string preset = "veryfast";  // only for cpu video encoding
+    int thread_num = 0;               // only for cpu video encoding
+    uint32_t queue_size = 4;          // only for cpu video encoding
+    double segment_duration = 0;      // seconds of each segment of cpu video, 0 means one file for a stream
+    uint32_t segment_num = 0;         // segment files kept at most, 0 keeps all
+    double event_pre_seconds = 0;     // seconds before event in event clips of cpu video, 0 disables event clips
+    double event_post_seconds = 0;    // seconds after event in event clips of cpu video
+    size_t event_buffer_bytes = 64 << 20;  // bytes of packets kept for event clips at most
+    int jpeg_quality = 85;            // only for cpu jpeg encoding, 1-100
     int device_id = -1;
     std::string stream_id = "";
     std::string output_dir = "";
@@ -72,8 +84,14 @@ class CNEncode {
   bool Init();
   bool CreateMluEncoder();
   bool CreateCpuEncoder();
-  bool Update(uint8_t* src_y, uint8_t* src_uv, int64_t timestamp, bool eos);
+  // stride is the stride of both planes, 0 means dst_stride
+  bool Update(const uint8_t* src_y, const uint8_t* src_uv, int64_t timestamp, bool eos, uint32_t stride = 0);
   bool Update(const cv::Mat src, int64_t timestamp);
+  // cpu jpeg encoding is done by snapshot encoder asynchronously, which could be shared by streams.
+  // Set before Init, otherwise one is created for this stream
+  void SetSnapshotEncoder(std::shared_ptr<SnapshotEncoder> encoder) { snapshot_encoder_ = encoder; }
+  // save an event clip of cpu video, file name is {output_dir}/event_stream_{stream_id}_{index}.mp4 if empty
+  bool SaveEventClip(const std::string &file_name = "");
 
   void EosCallback();
   void PacketCallback(const edk::CnPacket &packet);
@@ -81,9 +99,11 @@ class CNEncode {
   void SetPerfManager(std::shared_ptr<cnstream::PerfManager> manager) { perf_manager_ = manager; }
   void SetModuleName(std::string name) { module_name_ = name; }
 
+  static bool CreateDir(std::string dir);
+
  private:
   void RecordEndTime(int64_t pts);
-  bool CreateDir(std::string dir);
+  SnapshotEncoder::DoneCallback SnapshotDoneCallback(int64_t pts) const;
   // bool copy_frame_buffer_ = false;
 
   CNEncodeParam cnencode_param_;
@@ -92,6 +112,7 @@ class CNEncode {
   uint32_t output_frame_size_ = 0;
 
   uint32_t frame_count_ = 0;
+  std::atomic<uint32_t> event_count_{0};
 
   std::string output_file_name_ = "";
   size_t written_ = 0;
@@ -100,8 +121,9 @@ class CNEncode {
   edk::PixelFmt picture_format_;
   edk::EasyEncode *mlu_encoder_ = nullptr;
 
-  cv::VideoWriter writer_;
-  cv::Size size_;
+  std::unique_ptr<FFmpegEncoder> cpu_encoder_ = nullptr;
+  std::shared_ptr<SnapshotEncoder> snapshot_encoder_ = nullptr;
+  std::string snapshot_prefix_ = "";
 
   std::shared_ptr<cnstream::PerfManager> perf_manager_ = nullptr;
   std::string module_name_ = "";
@@ -28,6 +28,8 @@
 #include "cnstream_frame_va.hpp"
 #include "common.hpp"
 #include "image_preproc.hpp"
+#include "passthrough_writer.hpp"
+#include "snapshot_encoder.hpp"
 
 namespace cnstream {
 
@@ -37,6 +39,21 @@ struct EncodeParam {
   int dst_height = 0;                // Target height, prefered size same with input
   int gop = 30;                      // Target gop, default is 30
   int bit_rate = 0x100000;           // Target bit rate, default is 1Mbps
+  std::string preset = "veryfast";   // Preset of cpu video encoder
+  int encode_threads = 0;            // Threads of cpu video encoder, 0 means decided by encoder
+  int input_queue_size = 4;          // Frames waiting to be encoded by cpu video encoder at most
+  double segment_duration = 0;       // Seconds of each segment of cpu video, 0 means one file for a stream
+  int segment_num = 0;               // Segment files kept at most, 0 keeps all
+  double event_pre_seconds = 0;      // Seconds before event in event clips, 0 disables event clips
+  double event_post_seconds = 10;    // Seconds after event in event clips
+  int event_buffer_size = 64;        // Megabytes of packets kept for event clips at most
+  int jpeg_quality = 85;             // Quality of cpu jpeg encoding, 1-100
+  int snapshot_threads = 2;          // Threads encoding jpeg on cpu, shared by streams
+  int snapshot_queue_size = 32;      // Snapshots waiting to be encoded on cpu at most
+  SnapshotEncoder::DropPolicy snapshot_drop_policy = SnapshotEncoder::DropPolicy::NONE;
+  bool snapshot_objects = false;     // Encode crops of objects instead of whole frames on cpu
+  bool passthrough = false;          // Write packets attached by source instead of encoding
+  bool passthrough_metadata = false;  // Insert objects as sei into passthrough streams
   bool use_ffmpeg = false;           // Whether use ffmpeg to do image preprocessing, default is false
   CNCodecType codec_type = H264;     // Video codec type
   std::string encoder_type = "cpu";  // Encoding type, cpu or mlu encoding, default is cpu encoding
@@ -53,7 +70,7 @@ struct EncodeContext {
   std::unique_ptr<CNEncode> cnencode = nullptr;
   CNPixelFormat src_pix_fmt = NV21;
   uint8_t *data_yuv = nullptr;
-  cv::Mat dst_image;
+  std::unique_ptr<PassthroughWriter> passthrough = nullptr;
 };
 
 Encode::Encode(const std::string &name) : Module(name) {
@@ -68,11 +85,51 @@ Encode::Encode(const std::string &name) : Module(name) {
   param_register_.Register("dst_height", "The height of the output.");
   param_register_.Register("frame_rate", "Frame rate of the encoded video.");
   param_register_.Register("kbit_rate",
-                           "The amount data encoded for a unit of time. Only valid when encode on mlu."
+                           "The amount data encoded for a unit of time. Not valid when encode jpeg on cpu."
                            "A higher bitrate means a higher quality video, but lower encoding speed.");
   param_register_.Register("gop_size",
-                           "Group of pictures is known as GOP. Only valid when encode on mlu."
+                           "Group of pictures is known as GOP. Not valid when encode jpeg on cpu."
                            "gop_size is the number of frames between two I-frames.");
+  param_register_.Register("preset",
+                           "Preset of cpu video encoder, e.g. ultrafast, veryfast or medium. "
+                           "A slower preset means a higher quality video. Default is veryfast.");
+  param_register_.Register("encode_threads",
+                           "Threads used by cpu video encoder for each stream. Default is 0, decided by encoder.");
+  param_register_.Register("input_queue_size",
+                           "Frames waiting to be encoded by cpu video encoder at most for each stream. Process blocks "
+                           "when the queue is full. Default is 4.");
+  param_register_.Register("segment_duration",
+                           "Seconds of each segment of cpu video. Segments are split at key frames and named "
+                           "encode_stream_{stream_id}_{index}.mp4. Default is 0, one file for a stream.");
+  param_register_.Register("segment_num",
+                           "Segment files kept at most for each stream, the oldest ones are removed. "
+                           "Default is 0, all are kept.");
+  param_register_.Register("event_pre_seconds",
+                           "Seconds kept before an event in event clips of cpu video. Packets are buffered in memory "
+                           "and remuxed without re-encoding. Default is 0, event clips are disabled.");
+  param_register_.Register("event_post_seconds", "Seconds after an event in event clips. Default is 10.");
+  param_register_.Register("event_buffer_size",
+                           "Megabytes of packets kept for event clips at most for each stream. Default is 64.");
+  param_register_.Register("jpeg_quality", "Quality of jpeg encoded on cpu, from 1 to 100. Default is 85.");
+  param_register_.Register("snapshot_threads",
+                           "Threads encoding jpeg on cpu, shared by all streams. Default is 2.");
+  param_register_.Register("snapshot_queue_size",
+                           "Snapshots waiting to be encoded as jpeg on cpu at most. Default is 32.");
+  param_register_.Register("snapshot_drop_policy",
+                           "What to do when snapshot queue is full. It could be none (Process blocks), "
+                           "newest (the new snapshot is dropped) or oldest (the oldest waiting one is dropped). "
+                           "Default is none.");
+  param_register_.Register("snapshot_objects",
+                           "Encode crops of detected objects as jpeg on cpu instead of whole frames, "
+                           "named stream_{stream_id}_frame_{frame_id}_obj_{index}.jpg. It could be true or false. "
+                           "Default is false.");
+  param_register_.Register("passthrough",
+                           "Write compressed packets attached by the source (output_packets) to "
+                           "passthrough_stream_{stream_id}.h264/.h265 without decoding or encoding. "
+                           "It could be true or false. Default is false.");
+  param_register_.Register("passthrough_metadata",
+                           "Insert objects of each frame into passthrough streams as user data unregistered sei. "
+                           "It could be true or false. Default is false.");
   param_register_.Register("output_dir", "Where to store the encoded video. Default dir is {CURRENT_DIR}/output.");
   param_register_.Register("device_id", "Which device will be used. If there is only one device, it might be 0.");
 
@@ -100,6 +157,17 @@ EncodeContext *Encode::GetEncodeContext(CNFrameInfoPtr data) {
   // Create encode context
   RwLockWriteGuard lg(ctx_lock_);
 
+  if (param_->passthrough) {
+    std::string file_prefix = param_->output_dir + "/passthrough_stream_" + data->stream_id;
+    // a stream added again after eos is written to a new file, so that the earlier one is kept
+    uint32_t session = passthrough_sessions_[data->stream_id]++;
+    if (session > 0) file_prefix += "_" + std::to_string(session);
+    ctx = new EncodeContext();
+    ctx->passthrough.reset(new PassthroughWriter(file_prefix, param_->passthrough_metadata));
+    ctxs_[data->stream_id] = ctx;
+    return ctx;
+  }
+
   CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
   ctx = new EncodeContext();
   CNPixelFormat src_pix_fmt;
@@ -127,19 +195,16 @@ EncodeContext *Encode::GetEncodeContext(CNFrameInfoPtr data) {
       return nullptr;
   }
 
-  if (has_bgr_img || frame_pix_fmt == BGR24 || frame_pix_fmt == RGB24 || param_->encoder_type == "cpu") {
+  // all encoders take yuv frames, cpu jpeg encoder converts yuv to full range without going through bgr
+  if (has_bgr_img || frame_pix_fmt == BGR24 || frame_pix_fmt == RGB24) {
     src_pix_fmt = BGR24;
   } else {
     src_pix_fmt = frame_pix_fmt;
   }
-  if (param_->encoder_type == "mlu") {
-    if (frame_pix_fmt != NV12 && frame_pix_fmt != NV21) {
-      dst_pix_fmt = NV12;
-    } else {
-      dst_pix_fmt = frame_pix_fmt;
-    }
+  if (frame_pix_fmt != NV12 && frame_pix_fmt != NV21) {
+    dst_pix_fmt = NV12;
   } else {
-    dst_pix_fmt = BGR24;
+    dst_pix_fmt = frame_pix_fmt;
   }
   ctx->src_pix_fmt = src_pix_fmt;
   if (param_->dst_height <= 0) param_->dst_height = frame->height / 2 * 2;
@@ -187,6 +252,15 @@ EncodeContext *Encode::GetEncodeContext(CNFrameInfoPtr data) {
   cnencode_param.frame_rate = param_->frame_rate;
   cnencode_param.bit_rate = param_->bit_rate;
   cnencode_param.gop = param_->gop;
+  cnencode_param.preset = param_->preset;
+  cnencode_param.thread_num = param_->encode_threads;
+  cnencode_param.queue_size = param_->input_queue_size;
+  cnencode_param.segment_duration = param_->segment_duration;
+  cnencode_param.segment_num = param_->segment_num;
+  cnencode_param.event_pre_seconds = param_->event_pre_seconds;
+  cnencode_param.event_post_seconds = param_->event_post_seconds;
+  cnencode_param.event_buffer_bytes = static_cast<size_t>(param_->event_buffer_size) << 20;
+  cnencode_param.jpeg_quality = param_->jpeg_quality;
   cnencode_param.stream_id = data->stream_id;
   cnencode_param.output_dir = param_->output_dir;
   if (param_->encoder_type == "mlu") {
@@ -194,6 +268,7 @@ EncodeContext *Encode::GetEncodeContext(CNFrameInfoPtr data) {
   }
 
   ctx->cnencode.reset(new CNEncode(cnencode_param));
+  ctx->cnencode->SetSnapshotEncoder(snapshot_encoder_);
   if (!ctx->cnencode->Init()) {
     LOG(ERROR) << "[Encode] CNEncode type object initialized failed.";
     if (ctx) {
@@ -201,13 +276,10 @@ EncodeContext *Encode::GetEncodeContext(CNFrameInfoPtr data) {
     }
     return nullptr;
   }
-  if (param_->encoder_type == "mlu" && (param_->preproc_type == "cpu" || ctx->src_pix_fmt == BGR24)) {
+  if (param_->preproc_type == "cpu" || ctx->src_pix_fmt == BGR24) {
     ctx->data_yuv = new uint8_t[dst_stride_ * param_->dst_height * 3 / 2];
     memset(ctx->data_yuv, 0, sizeof(uint8_t) * dst_stride_ * param_->dst_height * 3 / 2);
   }
-  if (param_->encoder_type == "cpu") {
-    ctx->dst_image = cv::Mat(param_->dst_height, param_->dst_width, CV_8UC3);
-  }
   std::shared_ptr<PerfManager> manager = GetPerfManager(data->stream_id);
   ctx->cnencode->SetPerfManager(manager);
   ctx->cnencode->SetModuleName(GetName());
@@ -254,6 +326,60 @@ bool Encode::Open(ModuleParamSet paramSet) {
   if (paramSet.find("gop_size") != paramSet.end()) {
     param_->gop = std::stoi(paramSet["gop_size"]);
   }
+  if (paramSet.find("preset") != paramSet.end()) {
+    param_->preset = paramSet["preset"];
+  }
+  if (paramSet.find("encode_threads") != paramSet.end()) {
+    param_->encode_threads = std::stoi(paramSet["encode_threads"]);
+  }
+  if (paramSet.find("input_queue_size") != paramSet.end()) {
+    param_->input_queue_size = std::stoi(paramSet["input_queue_size"]);
+  }
+  if (paramSet.find("segment_duration") != paramSet.end()) {
+    param_->segment_duration = std::stod(paramSet["segment_duration"]);
+  }
+  if (paramSet.find("segment_num") != paramSet.end()) {
+    param_->segment_num = std::stoi(paramSet["segment_num"]);
+  }
+  if (paramSet.find("event_pre_seconds") != paramSet.end()) {
+    param_->event_pre_seconds = std::stod(paramSet["event_pre_seconds"]);
+  }
+  if (paramSet.find("event_post_seconds") != paramSet.end()) {
+    param_->event_post_seconds = std::stod(paramSet["event_post_seconds"]);
+  }
+  if (paramSet.find("event_buffer_size") != paramSet.end()) {
+    param_->event_buffer_size = std::stoi(paramSet["event_buffer_size"]);
+  }
+  if (paramSet.find("jpeg_quality") != paramSet.end()) {
+    param_->jpeg_quality = std::stoi(paramSet["jpeg_quality"]);
+  }
+  if (paramSet.find("snapshot_threads") != paramSet.end()) {
+    param_->snapshot_threads = std::stoi(paramSet["snapshot_threads"]);
+  }
+  if (paramSet.find("snapshot_queue_size") != paramSet.end()) {
+    param_->snapshot_queue_size = std::stoi(paramSet["snapshot_queue_size"]);
+  }
+  if (paramSet.find("snapshot_drop_policy") != paramSet.end()) {
+    if (paramSet["snapshot_drop_policy"] == "none") {
+      param_->snapshot_drop_policy = SnapshotEncoder::DropPolicy::NONE;
+    } else if (paramSet["snapshot_drop_policy"] == "newest") {
+      param_->snapshot_drop_policy = SnapshotEncoder::DropPolicy::NEWEST;
+    } else if (paramSet["snapshot_drop_policy"] == "oldest") {
+      param_->snapshot_drop_policy = SnapshotEncoder::DropPolicy::OLDEST;
+    } else {
+      LOG(ERROR) << "[Encode] snapshot_drop_policy should be choosen from none, newest and oldest.";
+      return false;
+    }
+  }
+  if (paramSet.find("snapshot_objects") != paramSet.end() && paramSet["snapshot_objects"] == "true") {
+    param_->snapshot_objects = true;
+  }
+  if (paramSet.find("passthrough") != paramSet.end() && paramSet["passthrough"] == "true") {
+    param_->passthrough = true;
+  }
+  if (paramSet.find("passthrough_metadata") != paramSet.end() && paramSet["passthrough_metadata"] == "true") {
+    param_->passthrough_metadata = true;
+  }
   if (paramSet.find("dst_width") != paramSet.end()) {
     param_->dst_width = std::stoi(paramSet["dst_width"]);
   }
@@ -307,14 +433,28 @@ bool Encode::Open(ModuleParamSet paramSet) {
       param_->codec_type = HEVC;
     } else if ("jpeg" == codec_type) {
       param_->codec_type = JPEG;
+    } else if ("mpeg4" == codec_type) {
+      param_->codec_type = MPEG4;
     } else {
-      LOG(WARNING) << "[Encode] codec type should be choosen from h264, h265 and jpeg. "
+      LOG(WARNING) << "[Encode] codec type should be choosen from h264, h265, mpeg4 and jpeg. "
                    << "It is invalid, h264 will be selected as default.";
     }
   }
   if (paramSet.find("device_id") != paramSet.end()) {
     param_->device_id = std::stoi(paramSet["device_id"]);
   }
+  if (param_->passthrough) {
+    // packets are written as they are, encoding parameters are not used
+    if (param_->snapshot_objects || param_->segment_duration > 0 || param_->event_pre_seconds > 0) {
+      LOG(ERROR) << "[Encode] Object snapshots, segment recording and event clip are not supported by passthrough.";
+      return false;
+    }
+    if (!CNEncode::CreateDir(param_->output_dir + "/")) {
+      LOG(ERROR) << "[Encode] Create output directory " << param_->output_dir << " failed.";
+      return false;
+    }
+    return true;
+  }
   if ((param_->preproc_type == "mlu" || param_->encoder_type == "mlu") && param_->device_id < 0) {
     LOG(ERROR) << "[Encode] Please set device id if use mlu to encode or preprococess.";
     return false;
@@ -327,17 +467,70 @@ bool Encode::Open(ModuleParamSet paramSet) {
     LOG(ERROR) << "[Encode] Not supported mlu encoding image the height or the width of which is odd.";
     return false;
   }
+  if (param_->encoder_type == "mlu" && param_->codec_type == MPEG4) {
+    LOG(ERROR) << "[Encode] mpeg4 is only supported by cpu encoding.";
+    return false;
+  }
+  if (param_->encoder_type == "cpu" && (param_->dst_height % 2 || param_->dst_width % 2)) {
+    LOG(ERROR) << "[Encode] Not supported cpu encoding image the height or the width of which is odd.";
+    return false;
+  }
+  if (param_->encoder_type == "cpu" && param_->codec_type != JPEG) {
+    if (param_->encode_threads < 0 || param_->input_queue_size <= 0) {
+      LOG(ERROR) << "[Encode] encode_threads should not be negative and input_queue_size should be positive.";
+      return false;
+    }
+    if (param_->segment_duration < 0 || param_->segment_num < 0 || param_->event_pre_seconds < 0 ||
+        param_->event_post_seconds < 0 || param_->event_buffer_size <= 0) {
+      LOG(ERROR) << "[Encode] Segment and event clip parameters should not be negative, "
+                 << "and event_buffer_size should be positive.";
+      return false;
+    }
+  } else if (param_->segment_duration > 0 || param_->event_pre_seconds > 0) {
+    LOG(ERROR) << "[Encode] Segment recording and event clip are only supported by cpu video encoding.";
+    return false;
+  }
+  if (param_->encoder_type == "cpu" && param_->codec_type == JPEG) {
+    if (param_->jpeg_quality < 1 || param_->jpeg_quality > 100 || param_->snapshot_threads <= 0 ||
+        param_->snapshot_queue_size <= 0) {
+      LOG(ERROR) << "[Encode] jpeg_quality should be in range [1, 100], "
+                 << "snapshot_threads and snapshot_queue_size should be positive.";
+      return false;
+    }
+    SnapshotEncoder::Param snapshot_param;
+    snapshot_param.thread_num = param_->snapshot_threads;
+    snapshot_param.queue_size = param_->snapshot_queue_size;
+    snapshot_param.drop_policy = param_->snapshot_drop_policy;
+    snapshot_param.quality = param_->jpeg_quality;
+    snapshot_encoder_ = std::make_shared<SnapshotEncoder>(snapshot_param);
+    if (!snapshot_encoder_->Open()) {
+      LOG(ERROR) << "[Encode] Open snapshot encoder failed.";
+      snapshot_encoder_.reset();
+      return false;
+    }
+  } else if (param_->snapshot_objects) {
+    LOG(ERROR) << "[Encode] Object snapshots are only supported by cpu jpeg encoding.";
+    return false;
+  }
   return true;
 }
 
+void Encode::DestroyEncodeContext(const std::string &stream_id) {
+  RwLockWriteGuard lg(ctx_lock_);
+  auto iter = ctxs_.find(stream_id);
+  if (iter == ctxs_.end()) return;
+  if (iter->second->data_yuv) {
+    delete[] iter->second->data_yuv;
+  }
+  delete iter->second;
+  ctxs_.erase(iter);
+}
+
 void Encode::Close() {
   if (param_) {
     delete param_;
     param_ = nullptr;
   }
-  if (ctxs_.empty()) {
-    return;
-  }
   for (auto &pair : ctxs_) {
     if (pair.second->data_yuv) {
       delete[] pair.second->data_yuv;
@@ -349,6 +542,12 @@ void Encode::Close() {
     }
   }
   ctxs_.clear();
+  passthrough_sessions_.clear();
+  // write snapshots still waiting
+  if (snapshot_encoder_) {
+    snapshot_encoder_->Close();
+    snapshot_encoder_.reset();
+  }
 }
 
 int Encode::Process(CNFrameInfoPtr data) {
@@ -356,24 +555,32 @@ int Encode::Process(CNFrameInfoPtr data) {
     return -1;
   }
   bool eos = data->IsEos();
+  if (param_->snapshot_objects) {
+    if (!eos && !SaveObjectSnapshots(data)) return -1;
+    TransmitData(data);
+    return 1;
+  }
+  if (param_->passthrough) {
+    if (!WritePassthrough(data)) return -1;
+    TransmitData(data);
+    return 1;
+  }
   EncodeContext *ctx = GetEncodeContext(data);
   if (!ctx) {
     LOG(ERROR) << "[Encode] Get encode context failed.";
     return -1;
   }
-  if (ctx->data_yuv) {
-    memset(ctx->data_yuv, 0, sizeof(uint8_t) * dst_stride_ * param_->dst_height * 3 / 2);
-  }
   cv::Mat *image = nullptr;
-  uint8_t *dst_y = nullptr, *dst_uv = nullptr;
+  const uint8_t *dst_y = nullptr, *dst_uv = nullptr;
+  uint32_t dst_stride = dst_stride_;
 
   if (eos) {
-    if (param_->encoder_type == "mlu") {
-      if (!ctx->cnencode->Update(dst_y, dst_uv, data->timestamp, eos)) {
-        LOG(ERROR) << "[Encode] Encode frame on Mlu failed.";
-        return -1;
-      }
+    if (!ctx->cnencode->Update(dst_y, dst_uv, data->timestamp, eos)) {
+      LOG(ERROR) << "[Encode] Send eos to encoder failed.";
+      return -1;
     }
+    // cpu encoders are closed by eos, a stream added later with the same stream id gets a new one
+    if (param_->encoder_type == "cpu") DestroyEncodeContext(data->stream_id);
     TransmitData(data);
     return 1;
   }
@@ -384,74 +591,67 @@ int Encode::Process(CNFrameInfoPtr data) {
     return -1;
   }
 
-  if (param_->encoder_type == "mlu") {
-    if (frame->HasBGRImage()) {
-      ctx->preproc->SetSrcWidthHeight(frame->width, frame->height);
-    } else {
-      ctx->preproc->SetSrcWidthHeight(frame->width, frame->height, frame->stride[0]);
-    }
-    if (ctx->src_pix_fmt == BGR24) {
-      image = frame->ImageBGR();
-    }
-    if (param_->preproc_type == "mlu") {
-      // Mlu Preproc
-      // if (!image) {
-      //   const uint8_t *src_y = reinterpret_cast<const uint8_t*>(frame->data[0]->GetMluData());
-      //   const uint8_t *src_uv = reinterpret_cast<const uint8_t*>(frame->data[1]->GetMluData());
-      //   // TODO: Get encoder mlu address
-      //   if (!ctx->preproc->Yuv2Yuv(src_y, src_uv, dst_y, dst_uv)) {
-      //     LOG(ERROR) << "[Encode] mlu yuv2yuv reisze failed.";
-      //     return -1;
-      //   }
-      // } else {
-      //   // bgr 2 yuv (mlu is not supported, use cpu instead opencv/ffmpeg)
-      //   if (!ctx->preproc->Bgr2Yuv(*image, ctx->data_yuv)) {
-      //     LOG(ERROR) << "[Encode] cpu bgr2yuv reisze failed. (mlu is not supported yet)";
-      //     return -1;
-      //   }
-      // }
-      LOG(ERROR) << "[Encode] mlu preproc is not supported yet.";
-      return -1;
-    } else {
-      // Cpu Preproc
-      if (!image) {
-        const uint8_t *src_y = reinterpret_cast<const uint8_t *>(frame->data[0]->GetCpuData());
-        const uint8_t *src_uv = reinterpret_cast<const uint8_t *>(frame->data[1]->GetCpuData());
-        if (!ctx->preproc->Yuv2Yuv(src_y, src_uv, ctx->data_yuv)) {
-          LOG(ERROR) << "[Encode] cpu yuv reisze failed.";
-          return -1;
-        }
-      } else {
-        if (!ctx->preproc->Bgr2Yuv(*image, ctx->data_yuv)) {
-          LOG(ERROR) << "[Encode] cpu bgr2yuv and reisze failed.";
-          return -1;
-        }
-      }
-      if (ctx->data_yuv) {
-        dst_y = ctx->data_yuv;
-        dst_uv = ctx->data_yuv + param_->dst_height * dst_stride_;
-      }
-    }
-
-    // Mlu Encode
-    if (!ctx->cnencode->Update(dst_y, dst_uv, data->timestamp, eos)) {
-      LOG(ERROR) << "[Encode] Encode frame on Mlu failed.";
-      return -1;
-    }
-  } else if (param_->encoder_type == "cpu") {
+  if (frame->HasBGRImage()) {
     ctx->preproc->SetSrcWidthHeight(frame->width, frame->height);
+  } else {
+    ctx->preproc->SetSrcWidthHeight(frame->width, frame->height, frame->stride[0]);
+  }
+  if (ctx->src_pix_fmt == BGR24) {
     image = frame->ImageBGR();
+  }
+  if (param_->preproc_type == "mlu") {
+    // Mlu Preproc
+    // if (!image) {
+    //   const uint8_t *src_y = reinterpret_cast<const uint8_t*>(frame->data[0]->GetMluData());
+    //   const uint8_t *src_uv = reinterpret_cast<const uint8_t*>(frame->data[1]->GetMluData());
+    //   // TODO: Get encoder mlu address
+    //   if (!ctx->preproc->Yuv2Yuv(src_y, src_uv, dst_y, dst_uv)) {
+    //     LOG(ERROR) << "[Encode] mlu yuv2yuv reisze failed.";
+    //     return -1;
+    //   }
+    // } else {
+    //   // bgr 2 yuv (mlu is not supported, use cpu instead opencv/ffmpeg)
+    //   if (!ctx->preproc->Bgr2Yuv(*image, ctx->data_yuv)) {
+    //     LOG(ERROR) << "[Encode] cpu bgr2yuv reisze failed. (mlu is not supported yet)";
+    //     return -1;
+    //   }
+    // }
+    LOG(ERROR) << "[Encode] mlu preproc is not supported yet.";
+    return -1;
+  } else {
     // Cpu Preproc
-    if (!ctx->preproc->Bgr2Bgr(*image, ctx->dst_image)) {
-      LOG(ERROR) << "[Encode] cpu bgr reisze failed.";
-      return -1;
+    if (!image) {
+      const uint8_t *src_y = reinterpret_cast<const uint8_t *>(frame->data[0]->GetCpuData());
+      const uint8_t *src_uv = reinterpret_cast<const uint8_t *>(frame->data[1]->GetCpuData());
+      // encoders copy the frame anyway, planes are sent directly if no resizing is needed.
+      // mlu encoder takes frames of the stride it is created with
+      if (frame->width == param_->dst_width && frame->height == param_->dst_height &&
+          frame->stride[0] == frame->stride[1] &&
+          (param_->encoder_type == "cpu" || static_cast<uint32_t>(frame->stride[0]) == dst_stride_)) {
+        dst_y = src_y;
+        dst_uv = src_uv;
+        dst_stride = frame->stride[0];
+      } else if (!ctx->preproc->Yuv2Yuv(src_y, src_uv, ctx->data_yuv)) {
+        LOG(ERROR) << "[Encode] cpu yuv reisze failed.";
+        return -1;
+      }
+    } else {
+      if (!ctx->preproc->Bgr2Yuv(*image, ctx->data_yuv)) {
+        LOG(ERROR) << "[Encode] cpu bgr2yuv and reisze failed.";
+        return -1;
+      }
     }
-    // Cpu Encode
-    if (!ctx->cnencode->Update(ctx->dst_image, data->timestamp)) {
-      LOG(ERROR) << "[Encode] Encode frame on Cpu failed.";
-      return -1;
+    if (!dst_y && ctx->data_yuv) {
+      dst_y = ctx->data_yuv;
+      dst_uv = ctx->data_yuv + param_->dst_height * dst_stride_;
     }
   }
+
+  // Mlu Encode, or send to cpu video or jpeg encoder
+  if (!ctx->cnencode->Update(dst_y, dst_uv, data->timestamp, eos, dst_stride)) {
+    LOG(ERROR) << "[Encode] Encode frame on " << param_->encoder_type << " failed.";
+    return -1;
+  }
   TransmitData(data);
   return 1;
 }
@@ -511,16 +711,48 @@ bool Encode::CheckParamSet(const ModuleParamSet &paramSet) const {
     }
   }
 
-  if (paramSet.find("codec_type") != paramSet.end() && paramSet.at("codec_type") != "jpeg" &&
-      paramSet.at("codec_type") != "h264" && paramSet.at("codec_type") != "hevc") {
-    LOG(ERROR) << "[Encode] codec_type is invalid, ``" << paramSet.at("codec_type")
-               << "``. Choose from ``jpeg``, ``h264`` and ``hevc``.";
+  std::string codec_type = "h264";
+  if (paramSet.find("codec_type") != paramSet.end()) {
+    codec_type = paramSet.at("codec_type");
+    if (codec_type != "jpeg" && codec_type != "h264" && codec_type != "hevc" && codec_type != "mpeg4") {
+      LOG(ERROR) << "[Encode] codec_type is invalid, ``" << paramSet.at("codec_type")
+                 << "``. Choose from ``jpeg``, ``h264``, ``hevc`` and ``mpeg4``.";
+      ret = false;
+    }
+  }
+  if (codec_type == "mpeg4" && encoder_type == "mlu") {
+    LOG(ERROR) << "[Encode] mpeg4 is only supported by cpu encoding.";
+    ret = false;
+  }
+  if (paramSet.find("snapshot_drop_policy") != paramSet.end() && paramSet.at("snapshot_drop_policy") != "none" &&
+      paramSet.at("snapshot_drop_policy") != "newest" && paramSet.at("snapshot_drop_policy") != "oldest") {
+    LOG(ERROR) << "[Encode] snapshot_drop_policy is invalid, ``" << paramSet.at("snapshot_drop_policy")
+               << "``. Choose from ``none``, ``newest`` and ``oldest``.";
     ret = false;
   }
+  for (const std::string key : {"passthrough", "passthrough_metadata"}) {
+    if (paramSet.find(key) != paramSet.end() && paramSet.at(key) != "true" && paramSet.at(key) != "false") {
+      LOG(ERROR) << "[Encode] " << key << " is invalid, ``" << paramSet.at(key)
+                 << "``. Choose from ``true`` and ``false``.";
+      ret = false;
+    }
+  }
+  if (paramSet.find("snapshot_objects") != paramSet.end()) {
+    if (paramSet.at("snapshot_objects") != "true" && paramSet.at("snapshot_objects") != "false") {
+      LOG(ERROR) << "[Encode] snapshot_objects is invalid, ``" << paramSet.at("snapshot_objects")
+                 << "``. Choose from ``true`` and ``false``.";
+      ret = false;
+    } else if (paramSet.at("snapshot_objects") == "true" && (codec_type != "jpeg" || encoder_type != "cpu")) {
+      LOG(ERROR) << "[Encode] Object snapshots are only supported by cpu jpeg encoding.";
+      ret = false;
+    }
+  }
 
   std::string err_msg;
-  if (!checker.IsNum({"dst_width", "dst_height", "frame_rate", "kbit_rate", "gop_size", "device_id"}, paramSet, err_msg,
-                     true)) {
+  if (!checker.IsNum({"dst_width", "dst_height", "frame_rate", "kbit_rate", "gop_size", "device_id",
+                      "encode_threads", "input_queue_size", "segment_duration", "segment_num", "event_pre_seconds",
+                      "event_post_seconds", "event_buffer_size", "jpeg_quality", "snapshot_threads",
+                      "snapshot_queue_size"}, paramSet, err_msg, true)) {
     LOG(ERROR) << "[Encode] " << err_msg;
     return false;
   }
@@ -543,6 +775,101 @@ bool Encode::CheckParamSet(const ModuleParamSet &paramSet) const {
   return ret;
 }
 
+bool Encode::SaveObjectSnapshots(CNFrameInfoPtr data) {
+  CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+  if (frame->width * frame->height == 0) {
+    LOG(ERROR) << "[Encode] The height or the width of the data frame is invalid.";
+    return false;
+  }
+  CNObjsVec objs;
+  if (data->datas.find(CNObjsVecKey) != data->datas.end()) {
+    objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+  }
+  // crops are copied from yuv planes directly, bgr image is used only if yuv planes are not available
+  bool yuv = !frame->HasBGRImage() && frame->stride[0] == frame->stride[1] &&
+             (frame->fmt == CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV12 ||
+              frame->fmt == CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV21);
+  cv::Mat *image = nullptr;
+  const uint8_t *src_y = nullptr, *src_uv = nullptr;
+  if (!objs.empty()) {
+    if (yuv) {
+      src_y = reinterpret_cast<const uint8_t *>(frame->data[0]->GetCpuData());
+      src_uv = reinterpret_cast<const uint8_t *>(frame->data[1]->GetCpuData());
+    } else {
+      image = frame->ImageBGR();
+    }
+  }
+  std::string prefix = param_->output_dir + "/stream_" + data->stream_id + "_frame_" +
+                       std::to_string(frame->frame_id) + "_obj_";
+  for (size_t i = 0; i < objs.size(); ++i) {
+    const CNInferBoundingBox &bbox = objs[i]->bbox;
+    cv::Rect roi(bbox.x * frame->width, bbox.y * frame->height, bbox.w * frame->width, bbox.h * frame->height);
+    std::string file_name = prefix + std::to_string(i) + ".jpg";
+    bool ret;
+    if (yuv) {
+      ret = snapshot_encoder_->Submit(src_y, src_uv, frame->width, frame->height, frame->stride[0],
+                                      frame->fmt == CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV21, roi, file_name);
+    } else {
+      ret = snapshot_encoder_->Submit(*image, roi, file_name);
+    }
+    if (!ret) {
+      LOG(WARNING) << "[Encode] Encode snapshot of object " << i << " in frame " << frame->frame_id
+                   << " of stream " << data->stream_id << " failed.";
+    }
+  }
+  // crops are copied when submitted, the frame is not used any more
+  std::shared_ptr<PerfManager> manager = GetPerfManager(data->stream_id);
+  if (manager) {
+    manager->Record(true, PerfManager::GetDefaultType(), GetName(), data->timestamp);
+  }
+  return true;
+}
+
+bool Encode::WritePassthrough(CNFrameInfoPtr data) {
+  if (data->IsEos()) {
+    // the file is finished by the writer
+    DestroyEncodeContext(data->stream_id);
+    return true;
+  }
+  EncodeContext *ctx = GetEncodeContext(data);
+  if (!ctx) {
+    LOG(ERROR) << "[Encode] Get encode context failed.";
+    return false;
+  }
+  if (data->datas.find(CNPacketsKey) == data->datas.end()) {
+    LOG(ERROR) << "[Encode] No packets attached to frames of stream " << data->stream_id
+               << ". Set output_packets of the source to true for passthrough.";
+    return false;
+  }
+  CNPacketsVec packets = cnstream::any_cast<CNPacketsVec>(data->datas[CNPacketsKey]);
+  CNObjsVec objs;
+  if (data->datas.find(CNObjsVecKey) != data->datas.end()) {
+    objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+  }
+  if (!ctx->passthrough->Write(packets, data->timestamp, &objs)) {
+    return false;
+  }
+  std::shared_ptr<PerfManager> manager = GetPerfManager(data->stream_id);
+  if (manager) {
+    manager->Record(true, PerfManager::GetDefaultType(), GetName(), data->timestamp);
+  }
+  return true;
+}
+
+bool Encode::SaveEventClip(const std::string &stream_id, const std::string &file_name) {
+  RwLockReadGuard lg(ctx_lock_);
+  auto iter = ctxs_.find(stream_id);
+  if (iter == ctxs_.end()) {
+    LOG(ERROR) << "[Encode] No frame of stream " << stream_id << " is encoded yet.";
+    return false;
+  }
+  if (!iter->second->cnencode) {
+    LOG(ERROR) << "[Encode] Event clip is not supported by passthrough. stream id: " << stream_id;
+    return false;
+  }
+  return iter->second->cnencode->SaveEventClip(file_name);
+}
+
 void Encode::RecordTime(std::shared_ptr<CNFrameInfo> data, bool is_finished) {
   std::shared_ptr<PerfManager> manager = GetPerfManager(data->stream_id);
   if (!data->IsEos() && manager && !is_finished) {
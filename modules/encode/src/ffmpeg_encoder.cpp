@@ -0,0 +1,428 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "ffmpeg_encoder.hpp"
+
+#include <glog/logging.h>
+
+#include <cstring>
+#include <string>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+// FFMPEG use AVCodecParameters instead of AVCodecContext
+// since from version 3.1(libavformat/version:57.40.100)
+#define FFMPEG_VERSION_3_1 AV_VERSION_INT(57, 40, 100)
+
+namespace cnstream {
+
+FFmpegEncoder::FFmpegEncoder(const Param &param) : param_(param) {
+  av_init_packet(&packet_);
+  packet_.data = nullptr;
+  packet_.size = 0;
+}
+
+FFmpegEncoder::~FFmpegEncoder() { Close(); }
+
+bool FFmpegEncoder::Open() {
+  if (is_open_) {
+    LOG(ERROR) << "[FFmpegEncoder] Open function should be called only once.";
+    return false;
+  }
+  if (param_.width == 0 || param_.height == 0 || param_.width % 2 || param_.height % 2) {
+    LOG(ERROR) << "[FFmpegEncoder] Invalid width or height: " << param_.width << " " << param_.height;
+    return false;
+  }
+  if (param_.pix_fmt != NV12 && param_.pix_fmt != NV21) {
+    LOG(ERROR) << "[FFmpegEncoder] Only support nv12/nv21 input.";
+    return false;
+  }
+  bool record = param_.record.segment_duration > 0 || param_.record.buffer_duration > 0;
+  if (param_.file_name.empty() && !record) {
+    LOG(ERROR) << "[FFmpegEncoder] Neither output file nor recorder is set.";
+    return false;
+  }
+  if (param_.queue_size == 0) param_.queue_size = 1;
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+  av_register_all();
+#endif
+
+  AVCodec *codec = nullptr;
+  switch (param_.codec_type) {
+    case H264:
+      codec = avcodec_find_encoder_by_name("libx264");
+      if (!codec) codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+      break;
+    case HEVC:
+      codec = avcodec_find_encoder_by_name("libx265");
+      if (!codec) codec = avcodec_find_encoder(AV_CODEC_ID_HEVC);
+      break;
+    case MPEG4:
+      codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+      break;
+    default:
+      break;
+  }
+  if (!codec) {
+    LOG(ERROR) << "[FFmpegEncoder] Can not find encoder, codec type: " << param_.codec_type;
+    return false;
+  }
+
+  if (!param_.file_name.empty()) {
+    if (avformat_alloc_output_context2(&format_ctx_, nullptr, nullptr, param_.file_name.c_str()) < 0 ||
+        !format_ctx_) {
+      LOG(ERROR) << "[FFmpegEncoder] Can not guess output format from file name: " << param_.file_name;
+      Destroy();
+      return false;
+    }
+    stream_ = avformat_new_stream(format_ctx_, nullptr);
+    if (!stream_) {
+      LOG(ERROR) << "[FFmpegEncoder] Create stream failed.";
+      Destroy();
+      return false;
+    }
+  }
+  codec_ctx_ = avcodec_alloc_context3(codec);
+  if (!codec_ctx_) {
+    LOG(ERROR) << "[FFmpegEncoder] Create codec context failed.";
+    Destroy();
+    return false;
+  }
+
+  AVPixelFormat input_fmt = param_.pix_fmt == NV12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_NV21;
+  // encode input format directly if the encoder takes it, otherwise convert to the first one it takes
+  AVPixelFormat encode_fmt = AV_PIX_FMT_YUV420P;
+  if (codec->pix_fmts) {
+    encode_fmt = codec->pix_fmts[0];
+    for (const AVPixelFormat *fmt = codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; ++fmt) {
+      if (*fmt == input_fmt) {
+        encode_fmt = input_fmt;
+        break;
+      }
+    }
+  }
+  AVRational frame_rate = av_d2q(param_.frame_rate > 0 ? param_.frame_rate : 25, 60000);
+  codec_ctx_->codec_id = codec->id;
+  codec_ctx_->width = param_.width;
+  codec_ctx_->height = param_.height;
+  codec_ctx_->pix_fmt = encode_fmt;
+  codec_ctx_->bit_rate = param_.bit_rate;
+  codec_ctx_->gop_size = param_.gop;
+  codec_ctx_->time_base = av_inv_q(frame_rate);
+  codec_ctx_->framerate = frame_rate;
+  codec_ctx_->thread_count = param_.thread_num;
+  // mp4 files written by recorder take global header as well
+  if (record || (format_ctx_->oformat->flags & AVFMT_GLOBALHEADER)) {
+    codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  AVDictionary *opts = nullptr;
+  if (!param_.preset.empty()) av_dict_set(&opts, "preset", param_.preset.c_str(), 0);
+  int ret = avcodec_open2(codec_ctx_, codec, &opts);
+  av_dict_free(&opts);
+  if (ret < 0) {
+    LOG(ERROR) << "[FFmpegEncoder] avcodec_open2() failed, ret=" << ret;
+    Destroy();
+    return false;
+  }
+
+  if (format_ctx_) {
+    stream_->time_base = codec_ctx_->time_base;
+#if LIBAVFORMAT_VERSION_INT >= FFMPEG_VERSION_3_1
+    ret = avcodec_parameters_from_context(stream_->codecpar, codec_ctx_);
+#else
+    ret = avcodec_copy_context(stream_->codec, codec_ctx_);
+#endif
+    if (ret < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] Copy codec parameters to stream failed, ret=" << ret;
+      Destroy();
+      return false;
+    }
+    if (!(format_ctx_->oformat->flags & AVFMT_NOFILE) &&
+        avio_open(&format_ctx_->pb, param_.file_name.c_str(), AVIO_FLAG_WRITE) < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] Open output file failed: " << param_.file_name;
+      Destroy();
+      return false;
+    }
+    if (avformat_write_header(format_ctx_, nullptr) < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] Write header failed: " << param_.file_name;
+      Destroy();
+      return false;
+    }
+  }
+  if (record) {
+    SegmentRecorder::StreamInfo info;
+    info.codec_id = codec->id;
+    info.width = param_.width;
+    info.height = param_.height;
+    info.time_base = codec_ctx_->time_base;
+    if (codec_ctx_->extradata && codec_ctx_->extradata_size > 0) {
+      info.extradata.assign(codec_ctx_->extradata, codec_ctx_->extradata + codec_ctx_->extradata_size);
+    }
+    recorder_.reset(new SegmentRecorder(param_.record));
+    if (!recorder_->Open(info)) {
+      LOG(ERROR) << "[FFmpegEncoder] Open segment recorder failed.";
+      Destroy();
+      return false;
+    }
+  }
+
+  if (encode_fmt != input_fmt) {
+    sws_ctx_ = sws_getContext(param_.width, param_.height, input_fmt, param_.width, param_.height, encode_fmt,
+                              SWS_POINT, nullptr, nullptr, nullptr);
+    convert_frame_ = av_frame_alloc();
+    if (!sws_ctx_ || !convert_frame_) {
+      LOG(ERROR) << "[FFmpegEncoder] Create pixel format converter failed.";
+      Destroy();
+      return false;
+    }
+    convert_frame_->format = encode_fmt;
+    convert_frame_->width = param_.width;
+    convert_frame_->height = param_.height;
+    if (av_frame_get_buffer(convert_frame_, 32) < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] Alloc frame buffer failed.";
+      Destroy();
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < param_.queue_size; ++i) {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+      LOG(ERROR) << "[FFmpegEncoder] Alloc frame failed.";
+      Destroy();
+      return false;
+    }
+    frames_.push_back(frame);
+    frame->format = input_fmt;
+    frame->width = param_.width;
+    frame->height = param_.height;
+    if (av_frame_get_buffer(frame, 32) < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] Alloc frame buffer failed.";
+      Destroy();
+      return false;
+    }
+    free_frames_.push(frame);
+  }
+
+  VLOG(2) << "[FFmpegEncoder] Open " << codec->name << " encoder, " << param_.width << "x" << param_.height
+          << ", output: " << (param_.file_name.empty() ? param_.record.file_prefix : param_.file_name);
+  eos_ = false;
+  worker_ = std::thread(&FFmpegEncoder::Loop, this);
+  is_open_ = true;
+  return true;
+}
+
+bool FFmpegEncoder::SendFrame(const uint8_t *y, const uint8_t *uv, uint32_t stride, int64_t timestamp) {
+  if (!is_open_) {
+    LOG(ERROR) << "[FFmpegEncoder] Encoder is not opened.";
+    return false;
+  }
+  if (!y || !uv) {
+    LOG(ERROR) << "[FFmpegEncoder] src y or src uv pointer is nullptr.";
+    return false;
+  }
+  AVFrame *frame = nullptr;
+  {
+    std::unique_lock<std::mutex> lk(mtx_);
+    free_cond_.wait(lk, [this]() { return !free_frames_.empty() || eos_; });
+    if (eos_) {
+      LOG(ERROR) << "[FFmpegEncoder] Encoder is closed.";
+      return false;
+    }
+    frame = free_frames_.front();
+    free_frames_.pop();
+  }
+  // the encoder may still hold a reference to the buffer of the last frame
+  if (av_frame_make_writable(frame) < 0) {
+    LOG(ERROR) << "[FFmpegEncoder] Make frame writable failed.";
+    std::lock_guard<std::mutex> lk(mtx_);
+    free_frames_.push(frame);
+    return false;
+  }
+  for (uint32_t i = 0; i < param_.height; ++i) {
+    memcpy(frame->data[0] + i * frame->linesize[0], y + i * stride, param_.width);
+  }
+  for (uint32_t i = 0; i < param_.height / 2; ++i) {
+    memcpy(frame->data[1] + i * frame->linesize[1], uv + i * stride, param_.width);
+  }
+  frame->pts = timestamp;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    busy_frames_.push(frame);
+  }
+  busy_cond_.notify_one();
+  return true;
+}
+
+void FFmpegEncoder::Loop() {
+  while (true) {
+    AVFrame *frame = nullptr;
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      busy_cond_.wait(lk, [this]() { return !busy_frames_.empty() || eos_; });
+      if (busy_frames_.empty()) break;
+      frame = busy_frames_.front();
+      busy_frames_.pop();
+    }
+    timestamps_[frame_index_] = frame->pts;
+    frame->pts = frame_index_++;
+    AVFrame *input = frame;
+    if (sws_ctx_) {
+      // the encoder may still hold a reference to the buffer of the last converted frame
+      if (av_frame_make_writable(convert_frame_) < 0) {
+        LOG(ERROR) << "[FFmpegEncoder] Make converted frame writable failed, frame is dropped.";
+        {
+          std::lock_guard<std::mutex> lk(mtx_);
+          free_frames_.push(frame);
+        }
+        free_cond_.notify_one();
+        continue;
+      }
+      sws_scale(sws_ctx_, frame->data, frame->linesize, 0, param_.height, convert_frame_->data,
+                convert_frame_->linesize);
+      convert_frame_->pts = frame->pts;
+      input = convert_frame_;
+    }
+    EncodeFrame(input);
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      free_frames_.push(frame);
+    }
+    free_cond_.notify_one();
+  }
+  // flush delayed packets
+  EncodeFrame(nullptr);
+  if (format_ctx_) av_write_trailer(format_ctx_);
+}
+
+bool FFmpegEncoder::EncodeFrame(AVFrame *frame) {
+#if LIBAVCODEC_VERSION_INT >= FFMPEG_VERSION_3_1
+  int ret = avcodec_send_frame(codec_ctx_, frame);
+  if (ret < 0) {
+    LOG(ERROR) << "[FFmpegEncoder] avcodec_send_frame() failed, ret=" << ret;
+    return false;
+  }
+  while ((ret = avcodec_receive_packet(codec_ctx_, &packet_)) == 0) {
+    if (!WritePacket()) return false;
+  }
+  if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+    LOG(ERROR) << "[FFmpegEncoder] avcodec_receive_packet() failed, ret=" << ret;
+    return false;
+  }
+#else
+  int got_packet = 0;
+  do {
+    int ret = avcodec_encode_video2(codec_ctx_, &packet_, frame, &got_packet);
+    if (ret < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] avcodec_encode_video2() failed, ret=" << ret;
+      return false;
+    }
+    if (got_packet && !WritePacket()) return false;
+  } while (!frame && got_packet);
+#endif
+  return true;
+}
+
+bool FFmpegEncoder::WritePacket() {
+  auto iter = timestamps_.find(packet_.pts);
+  int64_t timestamp = 0;
+  if (iter != timestamps_.end()) {
+    timestamp = iter->second;
+    timestamps_.erase(iter);
+  }
+  // recorder copies the packet and writes files on its own thread
+  if (recorder_) recorder_->Write(packet_);
+  if (format_ctx_) {
+    av_packet_rescale_ts(&packet_, codec_ctx_->time_base, stream_->time_base);
+    packet_.stream_index = stream_->index;
+    // packet is unreferenced by muxer
+    int ret = av_interleaved_write_frame(format_ctx_, &packet_);
+    if (ret < 0) {
+      LOG(ERROR) << "[FFmpegEncoder] Write packet failed, ret=" << ret;
+      return false;
+    }
+  } else {
+    av_packet_unref(&packet_);
+  }
+  if (packet_callback_) packet_callback_(timestamp);
+  return true;
+}
+
+bool FFmpegEncoder::SaveClip(const std::string &file_name, double pre_seconds, double post_seconds) {
+  if (!recorder_) {
+    LOG(ERROR) << "[FFmpegEncoder] Recorder is not enabled.";
+    return false;
+  }
+  return recorder_->SaveClip(file_name, pre_seconds, post_seconds);
+}
+
+void FFmpegEncoder::Close() {
+  if (is_open_) {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      eos_ = true;
+    }
+    busy_cond_.notify_all();
+    free_cond_.notify_all();
+    if (worker_.joinable()) worker_.join();
+    is_open_ = false;
+  }
+  Destroy();
+}
+
+void FFmpegEncoder::Destroy() {
+  // recorder is kept until destruction, so that SaveClip is safe to call after Close
+  if (recorder_) recorder_->Close();
+  for (auto &frame : frames_) {
+    av_frame_free(&frame);
+  }
+  frames_.clear();
+  free_frames_ = std::queue<AVFrame *>();
+  busy_frames_ = std::queue<AVFrame *>();
+  if (convert_frame_) {
+    av_frame_free(&convert_frame_);
+  }
+  if (sws_ctx_) {
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+  }
+  if (codec_ctx_) {
+    avcodec_free_context(&codec_ctx_);
+  }
+  if (format_ctx_) {
+    if (format_ctx_->pb && !(format_ctx_->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&format_ctx_->pb);
+    }
+    avformat_free_context(format_ctx_);
+    format_ctx_ = nullptr;
+    stream_ = nullptr;
+  }
+  timestamps_.clear();
+}
+
+}  // namespace cnstream
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,139 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_ENCODE_FFMPEG_ENCODER_HPP_
+#define MODULES_ENCODE_FFMPEG_ENCODER_HPP_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "segment_recorder.hpp"
+
+namespace cnstream {
+
+/**
+ * @brief Video encoder on cpu based on libavcodec, encoded packets are muxed into a file by libavformat.
+ *
+ * Frames are copied into a bounded pool of input frames and encoded on a worker thread, so the caller
+ * only waits for the copy. SendFrame blocks when all input frames are waiting to be encoded.
+ *
+ * Encoded packets are also passed to a SegmentRecorder if segment recording or event clip is enabled.
+ */
+class FFmpegEncoder {
+ public:
+  struct Param {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    CNPixelFormat pix_fmt = NV12;    // NV12 or NV21
+    CNCodecType codec_type = H264;   // H264, HEVC or MPEG4
+    int frame_rate = 25;
+    int bit_rate = 0x100000;
+    int gop = 30;
+    std::string preset = "veryfast";  // libx264/libx265 preset, ignored by other encoders
+    int thread_num = 0;               // encoder threads, 0 means decided by libavcodec
+    uint32_t queue_size = 4;          // input frames waiting to be encoded at most
+    std::string file_name = "";       // container is guessed from the suffix, empty if only recorder is used
+    SegmentRecorder::Param record;    // enabled if segment_duration or buffer_duration is positive
+  };
+
+  /// Called on the worker thread for each encoded packet with the timestamp of its frame
+  using PacketCallback = std::function<void(int64_t timestamp)>;
+
+  explicit FFmpegEncoder(const Param &param);
+  ~FFmpegEncoder();
+
+  /**
+   * @brief Create encoder and output file, and start worker thread.
+   */
+  bool Open();
+  /**
+   * @brief Copy a YUV420sp frame to input queue.
+   *
+   * @param y Y plane
+   * @param uv UV plane
+   * @param stride stride of both planes in bytes
+   * @param timestamp timestamp passed back by PacketCallback
+   */
+  bool SendFrame(const uint8_t *y, const uint8_t *uv, uint32_t stride, int64_t timestamp);
+  /**
+   * @brief Encode queued frames, flush encoder and finish the output file. Called by destructor if not called.
+   */
+  void Close();
+
+  void SetPacketCallback(PacketCallback callback) { packet_callback_ = callback; }
+
+  /**
+   * @brief Save an event clip from recorded packets without re-encoding, see SegmentRecorder::SaveClip.
+   *
+   * @return false if event clip is not enabled
+   */
+  bool SaveClip(const std::string &file_name, double pre_seconds, double post_seconds);
+
+ private:
+  void Loop();
+  bool EncodeFrame(AVFrame *frame);
+  bool WritePacket();
+  void Destroy();
+
+  Param param_;
+  bool is_open_ = false;
+
+  AVCodecContext *codec_ctx_ = nullptr;
+  AVFormatContext *format_ctx_ = nullptr;
+  AVStream *stream_ = nullptr;
+  AVPacket packet_;
+  // used when encoder does not take the input pixel format
+  SwsContext *sws_ctx_ = nullptr;
+  AVFrame *convert_frame_ = nullptr;
+  std::unique_ptr<SegmentRecorder> recorder_ = nullptr;
+
+  std::vector<AVFrame *> frames_;
+  std::queue<AVFrame *> free_frames_;
+  std::queue<AVFrame *> busy_frames_;
+  std::mutex mtx_;
+  std::condition_variable free_cond_;
+  std::condition_variable busy_cond_;
+  bool eos_ = false;
+  std::thread worker_;
+
+  // encoder pts (frame index) -> timestamp of the frame, only accessed on worker thread
+  std::unordered_map<int64_t, int64_t> timestamps_;
+  int64_t frame_index_ = 0;
+  PacketCallback packet_callback_ = nullptr;
+};  // class FFmpegEncoder
+
+}  // namespace cnstream
+
+#endif  // MODULES_ENCODE_FFMPEG_ENCODER_HPP_
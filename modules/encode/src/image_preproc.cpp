@@ -254,115 +254,88 @@ bool ImagePreproc::Yuv2Yuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t
     LOG(ERROR) << "[ImagePreproc][Yuv2Yuv] data pointer is nullptr";
     return false;
   }
-  if (preproc_param_.preproc_type == "cpu") {
-    uint8_t *dst_data = nullptr;
-    uint32_t dst_frame_size = preproc_param_.dst_stride * preproc_param_.dst_height;
-    uint32_t output_buf_size = dst_frame_size * 3 / 2;
-    dst_data = new uint8_t[output_buf_size];
-    if (!Yuv2Yuv(src_y, src_uv, dst_data)) {
-      delete[] dst_data;
-      return false;
-    }
-    memcpy(dst_y, dst_data, dst_frame_size * sizeof(uint8_t));
-    memcpy(dst_uv, dst_data + dst_frame_size, dst_frame_size / 2 * sizeof(uint8_t));
-    delete[] dst_data;
-  } else {
-    // do mlu resize
-    return false;
-  }
-  return true;
-}
-
-// yuv to yuv cpu/ffmpeg/mlu
-bool ImagePreproc::Yuv2Yuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst) {
-  bool ret = true;
-  if (src_y == nullptr || src_uv == nullptr || dst == nullptr) {
-    LOG(ERROR) << "[ImagePreproc][Yuv2Yuv] data pointer is nullptr";
-    return false;
-  }
   if (preproc_param_.preproc_type != "cpu") {
+    // do mlu resize
     return false;
   }
-  uint32_t dst_frame_size = preproc_param_.dst_stride * preproc_param_.dst_height;
   if (preproc_param_.src_width == preproc_param_.dst_width &&
       preproc_param_.src_height == preproc_param_.dst_height) {
     if (preproc_param_.dst_stride == preproc_param_.src_stride) {
-      memcpy(dst, src_y, dst_frame_size * sizeof(uint8_t));
-      memcpy(dst + dst_frame_size, src_uv, dst_frame_size * sizeof(uint8_t) / 2);
+      uint32_t dst_frame_size = preproc_param_.dst_stride * preproc_param_.dst_height;
+      memcpy(dst_y, src_y, dst_frame_size * sizeof(uint8_t));
+      memcpy(dst_uv, src_uv, dst_frame_size * sizeof(uint8_t) / 2);
     } else {
       for (uint32_t y = 0; y < preproc_param_.dst_height; ++y) {
-        memcpy(dst, src_y + preproc_param_.src_stride * y, preproc_param_.src_width * sizeof(uint8_t));
-        dst += preproc_param_.dst_stride;
+        memcpy(dst_y + preproc_param_.dst_stride * y, src_y + preproc_param_.src_stride * y,
+               preproc_param_.src_width * sizeof(uint8_t));
       }
       for (uint32_t uv = 0; uv < preproc_param_.dst_height / 2; ++uv) {
-        memcpy(dst, src_uv + preproc_param_.src_stride * uv, preproc_param_.src_width * sizeof(uint8_t));
-        dst += preproc_param_.dst_stride;
+        memcpy(dst_uv + preproc_param_.dst_stride * uv, src_uv + preproc_param_.src_stride * uv,
+               preproc_param_.src_width * sizeof(uint8_t));
       }
     }
     return true;
   }
-  uint8_t *src_data = nullptr;
-  uint32_t src_frame_size = preproc_param_.src_stride * preproc_param_.src_height;
-  uint32_t input_buf_size = src_frame_size * 3 / 2;
-  uint32_t output_buf_size = preproc_param_.dst_stride * preproc_param_.dst_height * 3 / 2;
-  src_data = new uint8_t[input_buf_size];
-  memcpy(src_data, src_y, src_frame_size * sizeof(uint8_t));
-  memcpy(src_data + src_frame_size, src_uv, src_frame_size / 2 * sizeof(uint8_t));
-
   if (preproc_param_.use_ffmpeg) {
-    ret = ConvertWithFFmpeg(src_data, input_buf_size, dst, output_buf_size);
-  } else {
-    ret = ResizeYuvNearest(src_data, dst);
+    return ResizeYuvWithFFmpeg(src_y, src_uv, dst_y, dst_uv);
   }
+  return ResizeYuv(src_y, src_uv, dst_y, dst_uv);
+}
 
-  delete[] src_data;
-
-  return ret;
+// yuv to yuv cpu/ffmpeg/mlu
+bool ImagePreproc::Yuv2Yuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst) {
+  if (src_y == nullptr || src_uv == nullptr || dst == nullptr) {
+    LOG(ERROR) << "[ImagePreproc][Yuv2Yuv] data pointer is nullptr";
+    return false;
+  }
+  return Yuv2Yuv(src_y, src_uv, dst, dst + preproc_param_.dst_stride * preproc_param_.dst_height);
 }
 
-// cpu yuv 2 yuv
-bool ImagePreproc::ResizeYuvNearest(const uint8_t *src, uint8_t *dst) {
-  if (!src || !dst) {
-    LOG(ERROR) << "[ImagePreproc][ResizeYuvNearest] src or dst pointer is nullptr";
+// cpu yuv 2 yuv, planes are resized by opencv without copying
+bool ImagePreproc::ResizeYuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst_y, uint8_t *dst_uv) {
+  const uint32_t src_w = preproc_param_.src_width, src_h = preproc_param_.src_height;
+  const uint32_t dst_w = preproc_param_.dst_width, dst_h = preproc_param_.dst_height;
+  if (src_w < 2 || src_h < 2 || dst_w < 2 || dst_h < 2) {
+    LOG(ERROR) << "[ImagePreproc][ResizeYuv] width or height is less than 2.";
     return false;
   }
+  // bilinear skips source pixels when shrinking to less than half, area interpolation is used instead.
+  // area is much slower than bilinear for other ratios (e.g. 1080p to 720p) and gives almost the same result
+  int interpolation = (dst_w * 2 <= src_w && dst_h * 2 <= src_h) ? cv::INTER_AREA : cv::INTER_LINEAR;
+  cv::Mat src_y_mat(src_h, src_w, CV_8UC1, const_cast<uint8_t *>(src_y), preproc_param_.src_stride);
+  cv::Mat dst_y_mat(dst_h, dst_w, CV_8UC1, dst_y, preproc_param_.dst_stride);
+  cv::resize(src_y_mat, dst_y_mat, dst_y_mat.size(), 0, 0, interpolation);
+  // interleaved uv is resized as a 2 channel image
+  cv::Mat src_uv_mat(src_h / 2, src_w / 2, CV_8UC2, const_cast<uint8_t *>(src_uv), preproc_param_.src_stride);
+  cv::Mat dst_uv_mat(dst_h / 2, dst_w / 2, CV_8UC2, dst_uv, preproc_param_.dst_stride);
+  cv::resize(src_uv_mat, dst_uv_mat, dst_uv_mat.size(), 0, 0, interpolation);
+  return true;
+}
 
-  uint32_t srcy, srcx, src_index;
-  uint32_t xrIntFloat_16 = (preproc_param_.src_width << 16) / preproc_param_.dst_width + 1;
-  uint32_t yrIntFloat_16 = (preproc_param_.src_height << 16) / preproc_param_.dst_height + 1;
-
-  uint8_t *dst_uv = dst + preproc_param_.dst_height * preproc_param_.dst_stride;
-  const uint8_t *src_uv = src + preproc_param_.src_height * preproc_param_.src_stride;
-  uint8_t *dst_uv_yScanline = nullptr;
-  const uint8_t *src_uv_yScanline = nullptr;
-  uint8_t *dst_y_slice = dst;
-  const uint8_t *src_y_slice = nullptr;
-  uint8_t *sp = nullptr;
-  const uint8_t *dp = nullptr;
-
-  for (uint32_t y = 0; y < preproc_param_.dst_height; ++y) {
-    srcy = (y * yrIntFloat_16) >> 16;
-    src_y_slice = src + srcy * preproc_param_.src_stride;
-    if (0 == (y & 1)) {
-      dst_uv_yScanline = dst_uv + (y / 2) * preproc_param_.dst_stride;
-      src_uv_yScanline = src_uv + (srcy / 2) * preproc_param_.src_stride;
-    }
-    for (uint32_t x = 0; x < preproc_param_.dst_width; ++x) {
-      srcx = (x * xrIntFloat_16) >> 16;
-      dst_y_slice[x] = src_y_slice[srcx];
-      if ((y & 1) == 0) {    // y is even
-        if ((x & 1) == 0) {  // x is even
-          src_index = (srcx / 2) * 2;
-          sp = dst_uv_yScanline + x;
-          dp = src_uv_yScanline + src_index;
-          *sp = *dp;
-          ++sp;
-          ++dp;
-          *sp = *dp;
-        }
-      }
-    }
-    dst_y_slice += preproc_param_.dst_stride;
+// ffmpeg yuv 2 yuv, sws_scale reads and writes planes directly
+bool ImagePreproc::ResizeYuvWithFFmpeg(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst_y,
+                                       uint8_t *dst_uv) {
+  if (!swsctx_) {
+    LOG(ERROR) << "[ImagePreproc] Please init first.";
+    return false;
+  }
+  if (preproc_param_.dst_stride % 2 || preproc_param_.dst_height % 2) {
+    LOG(ERROR) << "[ImagePreproc][ResizeYuvWithFFmpeg] dst stride or dst height is odd number.";
+    return false;
+  }
+  if (preproc_param_.src_stride % 2 || preproc_param_.src_height % 2) {
+    LOG(ERROR) << "[ImagePreproc][ResizeYuvWithFFmpeg] src stride or src height is odd number.";
+    return false;
+  }
+  const uint8_t *src_data[4] = {src_y, src_uv, nullptr, nullptr};
+  int src_linesize[4] = {static_cast<int>(preproc_param_.src_stride), static_cast<int>(preproc_param_.src_stride), 0,
+                         0};
+  uint8_t *dst_data[4] = {dst_y, dst_uv, nullptr, nullptr};
+  int dst_linesize[4] = {static_cast<int>(preproc_param_.dst_stride), static_cast<int>(preproc_param_.dst_stride), 0,
+                         0};
+  if (sws_scale(swsctx_, src_data, src_linesize, 0, preproc_param_.src_height, dst_data, dst_linesize) < 0) {
+    LOG(ERROR) << "[ImagePreproc][ResizeYuvWithFFmpeg] resize failed.";
+    return false;
   }
   return true;
 }
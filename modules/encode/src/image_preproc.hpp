@@ -72,13 +72,14 @@ class ImagePreproc {
   bool Yuv2Yuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst);
   bool Yuv2Yuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst_y, uint8_t *dst_uv);
 
-  bool ResizeYuvNearest(const uint8_t *src, uint8_t *dst);
+  bool ResizeYuv(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst_y, uint8_t *dst_uv);
   bool Bgr2YUV420NV(const cv::Mat &bgr, uint8_t *nv_data);
   bool ConvertWithFFmpeg(const uint8_t *src_buffer, const size_t src_buffer_size, uint8_t *dst_buffer,
                          const size_t dst_buffer_size);
 
  private:
   bool InitForFFmpeg();
+  bool ResizeYuvWithFFmpeg(const uint8_t *src_y, const uint8_t *src_uv, uint8_t *dst_y, uint8_t *dst_uv);
 
   ImagePreprocParam preproc_param_;
   bool is_init_ = false;
@@ -0,0 +1,155 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "passthrough_writer.hpp"
+
+#include <glog/logging.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace cnstream {
+
+// no zero bytes, so the uuid never needs emulation prevention
+const uint8_t PassthroughWriter::kPassthroughSeiUuid[16] = {0x63, 0x6e, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d,
+                                                             0x2d, 0x6f, 0x62, 0x6a, 0x65, 0x63, 0x74, 0x73};
+
+// offset of the start code of the first slice, 0 if there is no slice
+static size_t FirstSliceOffset(const std::vector<uint8_t> &data, CNPacketCodec codec) {
+  for (size_t i = 0; i + 3 < data.size(); ++i) {
+    if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) continue;
+    uint8_t header = data[i + 3];
+    bool slice = codec == CNPacketCodec::H264 ? ((header & 0x1f) >= 1 && (header & 0x1f) <= 5)
+                                              : ((header >> 1) & 0x3f) < 32;
+    if (slice) return (i > 0 && data[i - 1] == 0) ? i - 1 : i;
+    i += 2;
+  }
+  return 0;
+}
+
+std::string PassthroughWriter::FormatMetadata(int64_t pts, const CNObjsVec &objs) {
+  std::ostringstream ss;
+  ss << "pts=" << pts;
+  for (const auto &obj : objs) {
+    ss << ';' << obj->GetClassIdStr() << ',' << obj->GetTrackIdStr() << ',' << obj->score << ',' << obj->bbox.x
+       << ',' << obj->bbox.y << ',' << obj->bbox.w << ',' << obj->bbox.h;
+  }
+  return ss.str();
+}
+
+std::vector<uint8_t> PassthroughWriter::MakeSei(CNPacketCodec codec, const std::string &payload) {
+  std::vector<uint8_t> nal = {0, 0, 0, 1};
+  if (codec == CNPacketCodec::H264) {
+    nal.push_back(6);  // sei
+  } else if (codec == CNPacketCodec::HEVC) {
+    nal.push_back(39 << 1);  // prefix sei
+    nal.push_back(1);
+  } else {
+    return {};
+  }
+  std::vector<uint8_t> rbsp = {5};  // user data unregistered
+  size_t size = sizeof(kPassthroughSeiUuid) + payload.size();
+  for (; size >= 255; size -= 255) rbsp.push_back(0xff);
+  rbsp.push_back(static_cast<uint8_t>(size));
+  rbsp.insert(rbsp.end(), kPassthroughSeiUuid, kPassthroughSeiUuid + sizeof(kPassthroughSeiUuid));
+  rbsp.insert(rbsp.end(), payload.begin(), payload.end());
+  rbsp.push_back(0x80);  // rbsp trailing bits
+
+  int zeros = 0;
+  for (uint8_t byte : rbsp) {
+    if (zeros == 2 && byte <= 3) {
+      nal.push_back(3);
+      zeros = 0;
+    }
+    nal.push_back(byte);
+    zeros = byte == 0 ? zeros + 1 : 0;
+  }
+  return nal;
+}
+
+bool PassthroughWriter::Open(CNPacketCodec codec) {
+  std::string ext;
+  switch (codec) {
+    case CNPacketCodec::H264:
+      ext = ".h264";
+      break;
+    case CNPacketCodec::HEVC:
+      ext = ".h265";
+      break;
+    case CNPacketCodec::MPEG4:
+      ext = ".m4v";
+      break;
+    case CNPacketCodec::MJPEG:
+      ext = ".mjpeg";
+      break;
+    default:
+      LOG(ERROR) << "[PassthroughWriter] Unknown codec of packets.";
+      return false;
+  }
+  codec_ = codec;
+  file_name_ = file_prefix_ + ext;
+  file_.open(file_name_, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    LOG(ERROR) << "[PassthroughWriter] Open " << file_name_ << " failed.";
+    return false;
+  }
+  LOG_IF(WARNING, metadata_ && codec != CNPacketCodec::H264 && codec != CNPacketCodec::HEVC)
+      << "[PassthroughWriter] Metadata is only written to H.264 and HEVC, it is ignored for " << file_name_;
+  return true;
+}
+
+bool PassthroughWriter::Write(const CNPacketsVec &packets, int64_t pts, const CNObjsVec *objs) {
+  if (packets.empty()) return true;
+  if (closed_) {
+    // reopening would truncate the finished file
+    LOG(ERROR) << "[PassthroughWriter] Write after " << file_name_ << " is closed.";
+    return false;
+  }
+  if (!file_.is_open() && !Open(packets.front()->codec)) return false;
+  for (size_t i = 0; i < packets.size(); ++i) {
+    const std::vector<uint8_t> &data = packets[i]->data;
+    std::vector<uint8_t> sei;
+    if (metadata_ && objs && i + 1 == packets.size()) sei = MakeSei(codec_, FormatMetadata(pts, *objs));
+    if (sei.empty()) {
+      file_.write(reinterpret_cast<const char *>(data.data()), data.size());
+    } else {
+      size_t offset = FirstSliceOffset(data, codec_);
+      file_.write(reinterpret_cast<const char *>(data.data()), offset);
+      file_.write(reinterpret_cast<const char *>(sei.data()), sei.size());
+      file_.write(reinterpret_cast<const char *>(data.data() + offset), data.size() - offset);
+    }
+    written_bytes_ += data.size() + sei.size();
+  }
+  if (!file_.good()) {
+    LOG(ERROR) << "[PassthroughWriter] Write " << file_name_ << " failed.";
+    return false;
+  }
+  return true;
+}
+
+void PassthroughWriter::Close() {
+  if (file_.is_open()) {
+    file_.close();
+    closed_ = true;
+  }
+}
+
+}  // namespace cnstream
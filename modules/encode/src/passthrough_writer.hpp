@@ -0,0 +1,91 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_ENCODE_PASSTHROUGH_WRITER_HPP_
+#define MODULES_ENCODE_PASSTHROUGH_WRITER_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cnstream_frame_va.hpp"
+
+namespace cnstream {
+
+/**
+ * @brief Write compressed packets attached by the source (CNPacketsKey) to an elementary stream file,
+ *        without decoding or encoding.
+ *
+ * The file is {file_prefix}.h264, .h265, .m4v or .mjpeg by the codec of the first packet. Packets are written
+ * as they are, so the file is the same as the bitstream read by the source.
+ *
+ * If metadata is enabled, objects of each frame are inserted before the first slice of the last packet of the frame
+ * as a user data unregistered SEI (H.264 and HEVC only). The payload is kPassthroughSeiUuid followed by the text
+ * made by FormatMetadata, which carries pts of the frame, as packets are in decoding order.
+ */
+class PassthroughWriter {
+ public:
+  static const uint8_t kPassthroughSeiUuid[16];
+
+  PassthroughWriter(const std::string &file_prefix, bool metadata) : file_prefix_(file_prefix), metadata_(metadata) {}
+  ~PassthroughWriter() { Close(); }
+
+  /**
+   * @brief Write packets of a frame, the file is opened by the first packet. It fails after the file is closed.
+   *
+   * @param packets packets attached to the frame
+   * @param pts timestamp of the frame
+   * @param objs objects of the frame, only used if metadata is enabled, could be nullptr
+   *
+   * @return false if the file could not be opened or written
+   */
+  bool Write(const CNPacketsVec &packets, int64_t pts, const CNObjsVec *objs);
+  void Close();
+
+  const std::string &FileName() const { return file_name_; }
+  uint64_t WrittenBytes() const { return written_bytes_; }
+
+  /**
+   * @brief Text of objects: "pts=<pts>" followed by ";<class_id>,<track_id>,<score>,<x>,<y>,<w>,<h>" of each object.
+   */
+  static std::string FormatMetadata(int64_t pts, const CNObjsVec &objs);
+  /**
+   * @brief Make a user data unregistered SEI NAL unit with start code, emulation prevention bytes are inserted.
+   *
+   * @return empty if the codec is not H.264 or HEVC
+   */
+  static std::vector<uint8_t> MakeSei(CNPacketCodec codec, const std::string &payload);
+
+ private:
+  bool Open(CNPacketCodec codec);
+
+  std::string file_prefix_;
+  bool metadata_;
+  std::ofstream file_;
+  bool closed_ = false;
+  std::string file_name_;
+  CNPacketCodec codec_ = CNPacketCodec::UNKNOWN;
+  uint64_t written_bytes_ = 0;
+};  // class PassthroughWriter
+
+}  // namespace cnstream
+
+#endif  // MODULES_ENCODE_PASSTHROUGH_WRITER_HPP_
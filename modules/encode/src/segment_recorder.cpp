@@ -0,0 +1,386 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "segment_recorder.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+// FFMPEG use AVCodecParameters instead of AVCodecContext
+// since from version 3.1(libavformat/version:57.40.100)
+#define FFMPEG_VERSION_3_1 AV_VERSION_INT(57, 40, 100)
+
+namespace cnstream {
+
+void PacketRing::Push(EncodedPacketPtr packet) {
+  if (packet->key) {
+    gops_.emplace_back();
+  } else if (gops_.empty()) {
+    return;
+  }
+  gops_.back().packets.push_back(packet);
+  gops_.back().bytes += packet->data.size();
+  bytes_ += packet->data.size();
+  Evict();
+}
+
+void PacketRing::Evict() {
+  while (gops_.size() > 1) {
+    int64_t last_dts = gops_.back().packets.back()->dts;
+    bool covered = last_dts - gops_[1].packets.front()->dts >= max_duration_;
+    bool overflow = max_bytes_ > 0 && bytes_ > max_bytes_;
+    if (!covered && !overflow) break;
+    bytes_ -= gops_.front().bytes;
+    gops_.pop_front();
+  }
+}
+
+std::vector<EncodedPacketPtr> PacketRing::Since(int64_t pts) const {
+  std::vector<EncodedPacketPtr> packets;
+  size_t start = 0;
+  for (size_t i = 1; i < gops_.size() && gops_[i].packets.front()->pts <= pts; ++i) {
+    start = i;
+  }
+  for (size_t i = start; i < gops_.size(); ++i) {
+    packets.insert(packets.end(), gops_[i].packets.begin(), gops_[i].packets.end());
+  }
+  return packets;
+}
+
+void PacketRing::Clear() {
+  gops_.clear();
+  bytes_ = 0;
+}
+
+int64_t PacketRing::Duration() const {
+  if (gops_.empty()) return 0;
+  return gops_.back().packets.back()->dts - gops_.front().packets.front()->dts;
+}
+
+/**
+ * @brief Mux packets into a mp4 file, the file is created on the first packet.
+ *        Timestamps are shifted to start from 0. Only used on writer thread.
+ */
+class SegmentRecorder::Muxer {
+ public:
+  Muxer(const std::string &file_name, const StreamInfo &info, bool is_segment)
+      : file_name_(file_name), info_(info), is_segment_(is_segment) {}
+  ~Muxer() { Close(); }
+
+  bool Write(const EncodedPacket &packet);
+  void Close();
+
+  const std::string &FileName() const { return file_name_; }
+  bool IsSegment() const { return is_segment_; }
+  bool HasWritten() const { return packet_num_ > 0; }
+
+ private:
+  bool Open();
+  void Destroy();
+
+  std::string file_name_;
+  const StreamInfo &info_;
+  bool is_segment_;
+  AVFormatContext *format_ctx_ = nullptr;
+  AVStream *stream_ = nullptr;
+  bool failed_ = false;
+  int64_t offset_ = 0;
+  uint64_t packet_num_ = 0;
+};  // class SegmentRecorder::Muxer
+
+bool SegmentRecorder::Muxer::Open() {
+  if (avformat_alloc_output_context2(&format_ctx_, nullptr, "mp4", file_name_.c_str()) < 0 || !format_ctx_) {
+    LOG(ERROR) << "[SegmentRecorder] Create mp4 muxer failed: " << file_name_;
+    return false;
+  }
+  stream_ = avformat_new_stream(format_ctx_, nullptr);
+  if (!stream_) {
+    LOG(ERROR) << "[SegmentRecorder] Create stream failed: " << file_name_;
+    return false;
+  }
+  stream_->time_base = info_.time_base;
+#if LIBAVFORMAT_VERSION_INT >= FFMPEG_VERSION_3_1
+  AVCodecParameters *codecpar = stream_->codecpar;
+#else
+  AVCodecContext *codecpar = stream_->codec;
+  codecpar->time_base = info_.time_base;
+#endif
+  codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+  codecpar->codec_id = info_.codec_id;
+  codecpar->width = info_.width;
+  codecpar->height = info_.height;
+  if (!info_.extradata.empty()) {
+    codecpar->extradata =
+        reinterpret_cast<uint8_t *>(av_mallocz(info_.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+    if (!codecpar->extradata) {
+      LOG(ERROR) << "[SegmentRecorder] Alloc extradata failed.";
+      return false;
+    }
+    memcpy(codecpar->extradata, info_.extradata.data(), info_.extradata.size());
+    codecpar->extradata_size = info_.extradata.size();
+  }
+  if (avio_open(&format_ctx_->pb, file_name_.c_str(), AVIO_FLAG_WRITE) < 0) {
+    LOG(ERROR) << "[SegmentRecorder] Open output file failed: " << file_name_;
+    return false;
+  }
+  if (avformat_write_header(format_ctx_, nullptr) < 0) {
+    LOG(ERROR) << "[SegmentRecorder] Write header failed: " << file_name_;
+    return false;
+  }
+  return true;
+}
+
+bool SegmentRecorder::Muxer::Write(const EncodedPacket &packet) {
+  if (failed_) return false;
+  if (!format_ctx_) {
+    if (!Open()) {
+      failed_ = true;
+      Destroy();
+      return false;
+    }
+    offset_ = packet.dts;
+  }
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = const_cast<uint8_t *>(packet.data.data());
+  pkt.size = packet.data.size();
+  pkt.pts = packet.pts - offset_;
+  pkt.dts = packet.dts - offset_;
+  pkt.duration = packet.duration;
+  pkt.flags = packet.key ? AV_PKT_FLAG_KEY : 0;
+  pkt.stream_index = stream_->index;
+  av_packet_rescale_ts(&pkt, info_.time_base, stream_->time_base);
+  // only one stream, packets are written in decoding order without interleaving
+  int ret = av_write_frame(format_ctx_, &pkt);
+  if (ret < 0) {
+    LOG(ERROR) << "[SegmentRecorder] Write packet to " << file_name_ << " failed, ret=" << ret;
+    return false;
+  }
+  ++packet_num_;
+  return true;
+}
+
+void SegmentRecorder::Muxer::Close() {
+  if (format_ctx_ && !failed_) {
+    av_write_trailer(format_ctx_);
+    VLOG(2) << "[SegmentRecorder] Finish " << file_name_ << ", " << packet_num_ << " packets";
+  }
+  Destroy();
+}
+
+void SegmentRecorder::Muxer::Destroy() {
+  if (format_ctx_) {
+    if (format_ctx_->pb) avio_closep(&format_ctx_->pb);
+    avformat_free_context(format_ctx_);
+    format_ctx_ = nullptr;
+    stream_ = nullptr;
+  }
+}
+
+SegmentRecorder::SegmentRecorder(const Param &param) : param_(param), ring_(0, param.buffer_bytes) {}
+
+SegmentRecorder::~SegmentRecorder() { Close(); }
+
+int64_t SegmentRecorder::SecondsToTicks(double seconds) const {
+  return std::llround(seconds * info_.time_base.den / info_.time_base.num);
+}
+
+bool SegmentRecorder::Open(const StreamInfo &info) {
+  if (is_open_) {
+    LOG(ERROR) << "[SegmentRecorder] Open function should be called only once.";
+    return false;
+  }
+  if (param_.segment_duration <= 0 && param_.buffer_duration <= 0) {
+    LOG(ERROR) << "[SegmentRecorder] Neither segment recording nor event clip is enabled.";
+    return false;
+  }
+  if (info.time_base.num <= 0 || info.time_base.den <= 0) {
+    LOG(ERROR) << "[SegmentRecorder] Invalid time base: " << info.time_base.num << "/" << info.time_base.den;
+    return false;
+  }
+  info_ = info;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    ring_ = PacketRing(SecondsToTicks(param_.buffer_duration), param_.buffer_bytes);
+    segment_index_ = 0;
+    last_pts_ = INT64_MIN;
+    stop_ = false;
+  }
+  writer_ = std::thread(&SegmentRecorder::Loop, this);
+  is_open_ = true;
+  return true;
+}
+
+void SegmentRecorder::Write(const AVPacket &packet) {
+  if (!packet.data || packet.size <= 0) return;
+  std::shared_ptr<EncodedPacket> encoded = std::make_shared<EncodedPacket>();
+  encoded->data.assign(packet.data, packet.data + packet.size);
+  encoded->pts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+  encoded->dts = packet.dts != AV_NOPTS_VALUE ? packet.dts : encoded->pts;
+  encoded->duration = packet.duration;
+  encoded->key = packet.flags & AV_PKT_FLAG_KEY;
+  Write(encoded);
+}
+
+void SegmentRecorder::Enqueue(const std::shared_ptr<Muxer> &muxer, const EncodedPacketPtr &packet, bool live) {
+  size_t bytes = live && packet ? packet->data.size() : 0;
+  tasks_.push({muxer, packet, bytes});
+  pending_bytes_ += bytes;
+}
+
+void SegmentRecorder::Write(EncodedPacketPtr packet) {
+  if (!packet) return;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (stop_) return;
+    if (param_.buffer_duration > 0) ring_.Push(packet);
+    last_pts_ = std::max(last_pts_, packet->pts);
+
+    // drop packets until the next key frame when writer falls behind, so that files are still decodable
+    bool writer_busy = pending_bytes_ + packet->data.size() > param_.max_pending_bytes;
+    if (!drop_until_key_ && writer_busy) {
+      LOG(WARNING) << "[SegmentRecorder] Writer falls behind, drop packets until next key frame. "
+                   << param_.file_prefix;
+      drop_until_key_ = true;
+    } else if (drop_until_key_ && packet->key && !writer_busy) {
+      drop_until_key_ = false;
+    }
+
+    if (!drop_until_key_ && param_.segment_duration > 0 && packet->key &&
+        (!segment_ || packet->pts - segment_start_ >= SecondsToTicks(param_.segment_duration))) {
+      if (segment_) Enqueue(segment_, nullptr, true);
+      std::string file_name = param_.file_prefix + "_" + std::to_string(segment_index_++) + ".mp4";
+      segment_ = std::make_shared<Muxer>(file_name, info_, true);
+      segment_start_ = packet->pts;
+    }
+    if (!drop_until_key_ && segment_) Enqueue(segment_, packet, true);
+
+    // a clip contains every packet displayed before its end
+    for (auto it = clips_.begin(); it != clips_.end();) {
+      if (packet->dts > it->end_dts) {
+        Enqueue(it->muxer, nullptr, true);
+        it = clips_.erase(it);
+        continue;
+      }
+      if (!drop_until_key_) Enqueue(it->muxer, packet, true);
+      ++it;
+    }
+    if (drop_until_key_) ++dropped_packets_;
+  }
+  cond_.notify_one();
+}
+
+bool SegmentRecorder::SaveClip(const std::string &file_name, double pre_seconds, double post_seconds) {
+  if (param_.buffer_duration <= 0) {
+    LOG(ERROR) << "[SegmentRecorder] Event clip is disabled, buffer_duration should be positive.";
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (stop_) {
+      LOG(ERROR) << "[SegmentRecorder] Recorder is not opened or closed.";
+      return false;
+    }
+    if (ring_.Empty()) {
+      LOG(WARNING) << "[SegmentRecorder] No key frame is recorded yet, clip " << file_name << " is not saved.";
+      return false;
+    }
+    std::shared_ptr<Muxer> muxer = std::make_shared<Muxer>(file_name, info_, false);
+    // packets in the ring are not counted as pending, they are bounded by the ring
+    for (const auto &packet : ring_.Since(last_pts_ - SecondsToTicks(pre_seconds))) {
+      Enqueue(muxer, packet, false);
+    }
+    if (post_seconds > 0) {
+      clips_.push_back({muxer, last_pts_ + SecondsToTicks(post_seconds)});
+    } else {
+      Enqueue(muxer, nullptr, false);
+    }
+  }
+  cond_.notify_one();
+  return true;
+}
+
+void SegmentRecorder::Loop() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      cond_.wait(lk, [this]() { return !tasks_.empty() || stop_; });
+      if (tasks_.empty()) break;
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    if (task.packet) {
+      task.muxer->Write(*task.packet);
+    } else {
+      task.muxer->Close();
+      if (task.muxer->IsSegment() && task.muxer->HasWritten()) {
+        segment_files_.push_back(task.muxer->FileName());
+        while (param_.segment_num > 0 && segment_files_.size() > param_.segment_num) {
+          if (std::remove(segment_files_.front().c_str()) != 0) {
+            LOG(WARNING) << "[SegmentRecorder] Remove old segment failed: " << segment_files_.front();
+          }
+          segment_files_.pop_front();
+        }
+      }
+    }
+    // release the muxer outside of the lock if this is the last task of it
+    task.muxer.reset();
+    std::lock_guard<std::mutex> lk(mtx_);
+    pending_bytes_ -= task.bytes;
+  }
+}
+
+void SegmentRecorder::Close() {
+  if (!is_open_) return;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (segment_) Enqueue(segment_, nullptr, false);
+    segment_.reset();
+    for (auto &clip : clips_) {
+      Enqueue(clip.muxer, nullptr, false);
+    }
+    clips_.clear();
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (writer_.joinable()) writer_.join();
+  ring_.Clear();
+  is_open_ = false;
+}
+
+}  // namespace cnstream
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
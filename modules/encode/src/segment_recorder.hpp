@@ -0,0 +1,204 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_ENCODE_SEGMENT_RECORDER_HPP_
+#define MODULES_ENCODE_SEGMENT_RECORDER_HPP_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * @brief Encoded packet shared by the packet ring and output files. Timestamps are in time base of the stream.
+ */
+struct EncodedPacket {
+  std::vector<uint8_t> data;
+  int64_t pts = 0;
+  int64_t dts = 0;
+  int64_t duration = 0;
+  bool key = false;
+};
+using EncodedPacketPtr = std::shared_ptr<const EncodedPacket>;
+
+/**
+ * @brief Ring of the latest encoded packets, bounded by duration and bytes.
+ *
+ * Packets are dropped from the front by whole GOPs, so the ring always starts with a key frame.
+ * GOPs are dropped once the rest of the ring still covers max_duration, or while there are more than
+ * max_bytes. The latest GOP is never dropped.
+ */
+class PacketRing {
+ public:
+  /**
+   * @param max_duration duration kept at least in time base of the stream
+   * @param max_bytes bytes kept at most, 0 means unlimited
+   */
+  PacketRing(int64_t max_duration, size_t max_bytes) : max_duration_(max_duration), max_bytes_(max_bytes) {}
+
+  /**
+   * @brief Append a packet. Packets before the first key frame are dropped.
+   */
+  void Push(EncodedPacketPtr packet);
+  /**
+   * @brief Get packets from the last GOP starting at or before pts to the end.
+   *        Starts from the first GOP if all of them start after pts.
+   */
+  std::vector<EncodedPacketPtr> Since(int64_t pts) const;
+  void Clear();
+
+  bool Empty() const { return gops_.empty(); }
+  size_t Bytes() const { return bytes_; }
+  size_t GopNum() const { return gops_.size(); }
+  /// dts of the last packet minus dts of the first packet
+  int64_t Duration() const;
+  /// pts of the first packet, the ring should not be empty
+  int64_t StartPts() const { return gops_.front().packets.front()->pts; }
+
+ private:
+  struct Gop {
+    std::vector<EncodedPacketPtr> packets;
+    size_t bytes = 0;
+  };
+  void Evict();
+
+  int64_t max_duration_;
+  size_t max_bytes_;
+  std::deque<Gop> gops_;
+  size_t bytes_ = 0;
+};  // class PacketRing
+
+/**
+ * @brief Record encoded packets of one stream to mp4 files without re-encoding.
+ *
+ * Continuous recording is split into segments of about segment_duration, each segment starts with a key frame.
+ * Latest packets are kept in a PacketRing, so that SaveClip is able to remux an event clip of several seconds
+ * before and after the event.
+ *
+ * Write only copies the packet and queues it, files are opened, written and closed on a writer thread,
+ * so that the encoding thread is never blocked by file io. If the writer falls behind by more than
+ * max_pending_bytes, packets are dropped until the next key frame.
+ */
+class SegmentRecorder {
+ public:
+  struct Param {
+    std::string file_prefix = "";         // segments are named {file_prefix}_{index}.mp4
+    double segment_duration = 0;          // seconds of each segment, 0 disables continuous recording
+    uint32_t segment_num = 0;             // segment files kept at most, the oldest are removed. 0 keeps all
+    double buffer_duration = 0;           // seconds of packets kept for event clips, 0 disables event clips
+    size_t buffer_bytes = 64 << 20;       // bytes of packets kept for event clips at most
+    size_t max_pending_bytes = 64 << 20;  // bytes of packets waiting to be written at most
+  };
+
+  /// Parameters of the encoded stream
+  struct StreamInfo {
+    AVCodecID codec_id = AV_CODEC_ID_NONE;
+    int width = 0;
+    int height = 0;
+    AVRational time_base = {1, 25};
+    std::vector<uint8_t> extradata;  // global header (e.g. avcC/hvcC), required by mp4
+  };
+
+  explicit SegmentRecorder(const Param &param);
+  ~SegmentRecorder();
+
+  /**
+   * @brief Start writer thread.
+   */
+  bool Open(const StreamInfo &info);
+  /**
+   * @brief Record a packet, called in decoding order. Timestamps are in time base of the stream.
+   */
+  void Write(const AVPacket &packet);
+  void Write(EncodedPacketPtr packet);
+  /**
+   * @brief Save an event clip, which starts from the key frame at least pre_seconds before the latest packet,
+   *        and ends post_seconds after it. Returns at once, the clip is finished by later packets.
+   *
+   * @param file_name mp4 file name of the clip
+   * @param pre_seconds seconds before the event, limited by buffer_duration and buffer_bytes
+   * @param post_seconds seconds after the event
+   *
+   * @return false if event clips are disabled or no packet is recorded yet
+   */
+  bool SaveClip(const std::string &file_name, double pre_seconds, double post_seconds);
+  /**
+   * @brief Finish all files and stop writer thread. Called by destructor if not called.
+   */
+  void Close();
+
+  /// Number of packets dropped because the writer falls behind
+  uint64_t DroppedPackets() const { return dropped_packets_; }
+
+ private:
+  class Muxer;
+  struct Clip {
+    std::shared_ptr<Muxer> muxer;
+    int64_t end_dts;
+  };
+  struct Task {
+    std::shared_ptr<Muxer> muxer;
+    EncodedPacketPtr packet;  // nullptr closes the muxer
+    size_t bytes;             // counted in pending_bytes_
+  };
+
+  void Enqueue(const std::shared_ptr<Muxer> &muxer, const EncodedPacketPtr &packet, bool live);
+  void Loop();
+  int64_t SecondsToTicks(double seconds) const;
+
+  Param param_;
+  StreamInfo info_;
+  bool is_open_ = false;
+
+  // guards all members below
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  PacketRing ring_;
+  std::shared_ptr<Muxer> segment_ = nullptr;
+  int64_t segment_start_ = 0;
+  uint64_t segment_index_ = 0;
+  int64_t last_pts_ = 0;
+  std::vector<Clip> clips_;
+  std::queue<Task> tasks_;
+  size_t pending_bytes_ = 0;
+  bool drop_until_key_ = false;
+  std::atomic<uint64_t> dropped_packets_{0};
+  bool stop_ = true;
+
+  std::thread writer_;
+  // finished segment files, only accessed on writer thread
+  std::deque<std::string> segment_files_;
+};  // class SegmentRecorder
+
+}  // namespace cnstream
+
+#endif  // MODULES_ENCODE_SEGMENT_RECORDER_HPP_
@@ -0,0 +1,405 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "snapshot_encoder.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+#define FFMPEG_VERSION_3_1 AV_VERSION_INT(57, 40, 100)
+
+namespace cnstream {
+
+namespace {
+
+// lookup tables expanding BT.601 video range (Y 16-235, UV 16-240) to full range which jpeg takes
+struct RangeTable {
+  uint8_t y[256];
+  uint8_t uv[256];
+  RangeTable() {
+    for (int i = 0; i < 256; ++i) {
+      int y_value = ((i - 16) * 255 * 2 + 219) / (219 * 2);
+      int uv_value = 128 + ((i - 128) * 255 * 2 + (i >= 128 ? 224 : -224)) / (224 * 2);
+      y[i] = static_cast<uint8_t>(std::min(std::max(y_value, 0), 255));
+      uv[i] = static_cast<uint8_t>(std::min(std::max(uv_value, 0), 255));
+    }
+  }
+};
+
+const RangeTable &GetRangeTable() {
+  static const RangeTable table;
+  return table;
+}
+
+// encoders cached by each worker, creating a mjpeg encoder costs about as much as encoding a small crop
+constexpr size_t kMaxCachedCodecs = 8;
+
+}  // namespace
+
+/**
+ * @brief State of a worker thread, holding mjpeg encoders of the latest image sizes.
+ */
+class SnapshotEncoder::Worker {
+ public:
+  explicit Worker(int quality) {
+    // map jpeg quality 1-100 to mjpeg qscale 31-1
+    qscale_ = 1 + (100 - std::min(std::max(quality, 1), 100)) * 30 / 99;
+    av_init_packet(&packet_);
+    packet_.data = nullptr;
+    packet_.size = 0;
+  }
+  ~Worker() {
+    for (auto &codec : codecs_) {
+      av_frame_free(&codec.frame);
+      avcodec_free_context(&codec.ctx);
+    }
+  }
+
+  bool Encode(const Task &task);
+
+ private:
+  struct Codec {
+    int width;
+    int height;
+    AVCodecContext *ctx;
+    AVFrame *frame;
+  };
+  Codec *GetCodec(int width, int height);
+  void FillFrame(const Task &task, AVFrame *frame);
+  bool WriteFile(const std::string &file_name);
+
+  int qscale_;
+  std::list<Codec> codecs_;  // the most recently used first
+  AVPacket packet_;
+  cv::Mat i420_;
+  int64_t pts_ = 0;
+};  // class SnapshotEncoder::Worker
+
+SnapshotEncoder::Worker::Codec *SnapshotEncoder::Worker::GetCodec(int width, int height) {
+  for (auto iter = codecs_.begin(); iter != codecs_.end(); ++iter) {
+    if (iter->width == width && iter->height == height) {
+      codecs_.splice(codecs_.begin(), codecs_, iter);
+      return &codecs_.front();
+    }
+  }
+  AVCodec *mjpeg = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+  if (!mjpeg) {
+    LOG(ERROR) << "[SnapshotEncoder] Can not find mjpeg encoder.";
+    return nullptr;
+  }
+  Codec codec = {width, height, avcodec_alloc_context3(mjpeg), av_frame_alloc()};
+  if (!codec.ctx || !codec.frame) {
+    LOG(ERROR) << "[SnapshotEncoder] Alloc codec context or frame failed.";
+    av_frame_free(&codec.frame);
+    avcodec_free_context(&codec.ctx);
+    return nullptr;
+  }
+  codec.ctx->width = width;
+  codec.ctx->height = height;
+  codec.ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+  codec.ctx->color_range = AVCOL_RANGE_JPEG;
+  codec.ctx->time_base = {1, 25};
+  codec.ctx->flags |= AV_CODEC_FLAG_QSCALE;
+  codec.ctx->global_quality = FF_QP2LAMBDA * qscale_;
+  codec.frame->format = AV_PIX_FMT_YUVJ420P;
+  codec.frame->width = width;
+  codec.frame->height = height;
+  if (avcodec_open2(codec.ctx, mjpeg, nullptr) < 0 || av_frame_get_buffer(codec.frame, 32) < 0) {
+    LOG(ERROR) << "[SnapshotEncoder] Open mjpeg encoder failed, size: " << width << "x" << height;
+    av_frame_free(&codec.frame);
+    avcodec_free_context(&codec.ctx);
+    return nullptr;
+  }
+  if (codecs_.size() >= kMaxCachedCodecs) {
+    av_frame_free(&codecs_.back().frame);
+    avcodec_free_context(&codecs_.back().ctx);
+    codecs_.pop_back();
+  }
+  codecs_.push_front(codec);
+  return &codecs_.front();
+}
+
+void SnapshotEncoder::Worker::FillFrame(const Task &task, AVFrame *frame) {
+  const RangeTable &table = GetRangeTable();
+  const int width = task.width, height = task.height;
+  const uint8_t *y = task.data.data();
+  const uint8_t *uv = y + width * height;
+  bool swap_uv = task.format == Format::NV21;
+  if (task.format == Format::BGR24) {
+    // opencv converts to video range I420, the same as decoded frames
+    cv::Mat bgr(height, width, CV_8UC3, const_cast<uint8_t *>(task.data.data()));
+    cv::cvtColor(bgr, i420_, cv::COLOR_BGR2YUV_I420);
+    y = i420_.data;
+  }
+  for (int r = 0; r < height; ++r) {
+    const uint8_t *src = y + r * width;
+    uint8_t *dst = frame->data[0] + r * frame->linesize[0];
+    for (int c = 0; c < width; ++c) dst[c] = table.y[src[c]];
+  }
+  for (int r = 0; r < height / 2; ++r) {
+    uint8_t *dst_u = frame->data[1] + r * frame->linesize[1];
+    uint8_t *dst_v = frame->data[2] + r * frame->linesize[2];
+    if (task.format == Format::BGR24) {
+      const uint8_t *src_u = i420_.data + width * height + r * width / 2;
+      const uint8_t *src_v = src_u + width * height / 4;
+      for (int c = 0; c < width / 2; ++c) {
+        dst_u[c] = table.uv[src_u[c]];
+        dst_v[c] = table.uv[src_v[c]];
+      }
+      continue;
+    }
+    if (swap_uv) std::swap(dst_u, dst_v);
+    const uint8_t *src = uv + r * width;
+    for (int c = 0; c < width / 2; ++c) {
+      dst_u[c] = table.uv[src[2 * c]];
+      dst_v[c] = table.uv[src[2 * c + 1]];
+    }
+  }
+}
+
+bool SnapshotEncoder::Worker::WriteFile(const std::string &file_name) {
+  FILE *file = fopen(file_name.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "[SnapshotEncoder] Open file failed: " << file_name;
+    return false;
+  }
+  size_t written = fwrite(packet_.data, 1, packet_.size, file);
+  fclose(file);
+  if (written != static_cast<size_t>(packet_.size)) {
+    LOG(ERROR) << "[SnapshotEncoder] Write file failed: " << file_name;
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotEncoder::Worker::Encode(const Task &task) {
+  Codec *codec = GetCodec(task.width, task.height);
+  if (!codec) return false;
+  if (av_frame_make_writable(codec->frame) < 0) {
+    LOG(ERROR) << "[SnapshotEncoder] Make frame writable failed.";
+    return false;
+  }
+  FillFrame(task, codec->frame);
+  codec->frame->pts = pts_++;
+  codec->frame->quality = codec->ctx->global_quality;
+
+  bool ret = false;
+#if LIBAVCODEC_VERSION_INT >= FFMPEG_VERSION_3_1
+  if (avcodec_send_frame(codec->ctx, codec->frame) < 0) {
+    LOG(ERROR) << "[SnapshotEncoder] avcodec_send_frame() failed.";
+    return false;
+  }
+  // mjpeg has no delay, one packet for each frame
+  if (avcodec_receive_packet(codec->ctx, &packet_) == 0) {
+    ret = WriteFile(task.file_name);
+    av_packet_unref(&packet_);
+  }
+#else
+  int got_packet = 0;
+  if (avcodec_encode_video2(codec->ctx, &packet_, codec->frame, &got_packet) == 0 && got_packet) {
+    ret = WriteFile(task.file_name);
+    av_packet_unref(&packet_);
+  }
+#endif
+  if (!ret) LOG(ERROR) << "[SnapshotEncoder] Encode snapshot failed: " << task.file_name;
+  return ret;
+}
+
+SnapshotEncoder::SnapshotEncoder(const Param &param) : param_(param) {}
+
+SnapshotEncoder::~SnapshotEncoder() { Close(); }
+
+bool SnapshotEncoder::Open() {
+  if (running_) {
+    LOG(ERROR) << "[SnapshotEncoder] Open function should be called only once.";
+    return false;
+  }
+  if (param_.thread_num == 0 || param_.queue_size == 0) {
+    LOG(ERROR) << "[SnapshotEncoder] thread_num and queue_size should be positive.";
+    return false;
+  }
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+  avcodec_register_all();
+#endif
+  if (!avcodec_find_encoder(AV_CODEC_ID_MJPEG)) {
+    LOG(ERROR) << "[SnapshotEncoder] Can not find mjpeg encoder.";
+    return false;
+  }
+  GetRangeTable();
+  running_ = true;
+  for (uint32_t i = 0; i < param_.thread_num; ++i) {
+    threads_.emplace_back(&SnapshotEncoder::Loop, this);
+  }
+  return true;
+}
+
+std::unique_ptr<SnapshotEncoder::Task> SnapshotEncoder::AcquireTask() {
+  std::unique_ptr<Task> task;
+  std::unique_lock<std::mutex> lk(mtx_);
+  if (!running_) {
+    LOG(ERROR) << "[SnapshotEncoder] Encoder is not opened.";
+    return nullptr;
+  }
+  if (tasks_.size() + filling_ >= param_.queue_size) {
+    if (param_.drop_policy == DropPolicy::OLDEST && !tasks_.empty()) {
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      ++dropped_num_;
+    } else if (param_.drop_policy == DropPolicy::NONE) {
+      not_full_.wait(lk, [this]() { return tasks_.size() + filling_ < param_.queue_size || !running_; });
+      if (!running_) return nullptr;
+    } else {
+      ++dropped_num_;
+      return nullptr;
+    }
+  }
+  if (!task && !free_tasks_.empty()) {
+    task = std::move(free_tasks_.back());
+    free_tasks_.pop_back();
+  }
+  if (!task) task.reset(new Task);
+  ++filling_;
+  return task;
+}
+
+void SnapshotEncoder::Push(std::unique_ptr<Task> task) {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    --filling_;
+    tasks_.push_back(std::move(task));
+  }
+  not_empty_.notify_one();
+}
+
+static bool ClipRoi(int width, int height, cv::Rect *roi) {
+  if (roi->area() <= 0) *roi = cv::Rect(0, 0, width, height);
+  *roi &= cv::Rect(0, 0, width, height);
+  // YUV420 needs even position and size
+  int x0 = roi->x / 2 * 2, y0 = roi->y / 2 * 2;
+  int x1 = (roi->x + roi->width) / 2 * 2, y1 = (roi->y + roi->height) / 2 * 2;
+  *roi = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+  return roi->width > 0 && roi->height > 0;
+}
+
+bool SnapshotEncoder::Submit(const uint8_t *y, const uint8_t *uv, int width, int height, int stride, bool nv21,
+                             cv::Rect roi, const std::string &file_name, DoneCallback done) {
+  if (!y || !uv || stride < width || !ClipRoi(width, height, &roi)) {
+    LOG(ERROR) << "[SnapshotEncoder] Invalid image or roi, size: " << width << "x" << height << ", stride: " << stride
+               << ", roi: " << roi;
+    return false;
+  }
+  std::unique_ptr<Task> task = AcquireTask();
+  if (!task) return running_;
+  task->format = nv21 ? Format::NV21 : Format::NV12;
+  task->width = roi.width;
+  task->height = roi.height;
+  task->data.resize(roi.width * roi.height * 3 / 2);
+  uint8_t *dst = task->data.data();
+  for (int r = roi.y; r < roi.y + roi.height; ++r, dst += roi.width) {
+    memcpy(dst, y + r * stride + roi.x, roi.width);
+  }
+  for (int r = roi.y / 2; r < (roi.y + roi.height) / 2; ++r, dst += roi.width) {
+    memcpy(dst, uv + r * stride + roi.x, roi.width);
+  }
+  task->file_name = file_name;
+  task->done = std::move(done);
+  Push(std::move(task));
+  return true;
+}
+
+bool SnapshotEncoder::Submit(const cv::Mat &bgr, cv::Rect roi, const std::string &file_name, DoneCallback done) {
+  if (bgr.empty() || bgr.type() != CV_8UC3 || !ClipRoi(bgr.cols, bgr.rows, &roi)) {
+    LOG(ERROR) << "[SnapshotEncoder] Invalid bgr image or roi, roi: " << roi;
+    return false;
+  }
+  std::unique_ptr<Task> task = AcquireTask();
+  if (!task) return running_;
+  task->format = Format::BGR24;
+  task->width = roi.width;
+  task->height = roi.height;
+  task->data.resize(roi.width * roi.height * 3);
+  cv::Mat dst(roi.height, roi.width, CV_8UC3, task->data.data());
+  bgr(roi).copyTo(dst);
+  task->file_name = file_name;
+  task->done = std::move(done);
+  Push(std::move(task));
+  return true;
+}
+
+void SnapshotEncoder::Loop() {
+  Worker worker(param_.quality);
+  while (true) {
+    std::unique_ptr<Task> task;
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      not_empty_.wait(lk, [this]() { return !tasks_.empty() || !running_; });
+      if (tasks_.empty()) break;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    not_full_.notify_one();
+    if (worker.Encode(*task)) {
+      ++encoded_num_;
+      if (task->done) task->done();
+    }
+    task->done = nullptr;
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (free_tasks_.size() < param_.queue_size) free_tasks_.push_back(std::move(task));
+  }
+}
+
+void SnapshotEncoder::Close() {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!running_) return;
+    running_ = false;
+  }
+  not_empty_.notify_all();
+  not_full_.notify_all();
+  for (auto &thread : threads_) {
+    if (thread.joinable()) thread.join();
+  }
+  threads_.clear();
+  tasks_.clear();
+  free_tasks_.clear();
+}
+
+}  // namespace cnstream
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
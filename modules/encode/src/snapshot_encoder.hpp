@@ -0,0 +1,133 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_ENCODE_SNAPSHOT_ENCODER_HPP_
+#define MODULES_ENCODE_SNAPSHOT_ENCODER_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * @brief Encode snapshots (whole images or crops of them) to jpeg files on a bounded pool of worker threads.
+ *
+ * Submit only copies the pixels of the crop, color conversion, encoding and writing the file are done by workers.
+ * YUV420sp images are encoded without converting to BGR, chroma is deinterleaved and expanded from video range
+ * to the full range jpeg takes. Encoders are created by libavcodec (mjpeg) and cached by image size in each worker.
+ *
+ * When all queue_size snapshots are waiting to be encoded, Submit blocks or drops a snapshot by policy.
+ */
+class SnapshotEncoder {
+ public:
+  enum class DropPolicy {
+    NONE = 0,  ///< Submit blocks until a snapshot is taken by a worker
+    NEWEST,    ///< the submitted snapshot is dropped
+    OLDEST,    ///< the oldest waiting snapshot is dropped
+  };
+  struct Param {
+    uint32_t thread_num = 2;
+    uint32_t queue_size = 32;                 // snapshots waiting to be encoded at most
+    DropPolicy drop_policy = DropPolicy::NONE;
+    int quality = 85;                         // jpeg quality, 1-100
+  };
+
+  /// Called on a worker thread when the snapshot file is written
+  using DoneCallback = std::function<void()>;
+
+  explicit SnapshotEncoder(const Param &param);
+  ~SnapshotEncoder();
+
+  /**
+   * @brief Start worker threads.
+   */
+  bool Open();
+  /**
+   * @brief Submit a crop of a YUV420sp (NV12/NV21, video range) image.
+   *
+   * @param y Y plane
+   * @param uv UV plane
+   * @param width width of the image
+   * @param height height of the image
+   * @param stride stride of both planes in bytes
+   * @param nv21 whether the image is NV21
+   * @param roi region to encode, clipped to the image and aligned to even. Empty means the whole image
+   * @param file_name jpeg file name
+   * @param done called when the file is written, could be nullptr
+   *
+   * @return false if parameters are invalid or encoder is not opened. Dropped snapshots are not failures
+   */
+  bool Submit(const uint8_t *y, const uint8_t *uv, int width, int height, int stride, bool nv21, cv::Rect roi,
+              const std::string &file_name, DoneCallback done = nullptr);
+  /**
+   * @brief Submit a crop of a BGR24 image, see the other Submit.
+   */
+  bool Submit(const cv::Mat &bgr, cv::Rect roi, const std::string &file_name, DoneCallback done = nullptr);
+  /**
+   * @brief Encode waiting snapshots and stop workers. Called by destructor if not called.
+   */
+  void Close();
+
+  uint64_t EncodedNum() const { return encoded_num_; }
+  uint64_t DroppedNum() const { return dropped_num_; }
+
+ private:
+  enum class Format { NV12, NV21, BGR24 };
+  struct Task {
+    Format format;
+    int width;
+    int height;
+    std::vector<uint8_t> data;  // packed pixels of the crop, reused by later tasks
+    std::string file_name;
+    DoneCallback done;
+  };
+  class Worker;
+
+  // take a recycled task and copy into it, nullptr if dropped
+  std::unique_ptr<Task> AcquireTask();
+  void Push(std::unique_ptr<Task> task);
+  void Loop();
+
+  Param param_;
+  std::vector<std::thread> threads_;
+  std::mutex mtx_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<std::unique_ptr<Task>> tasks_;
+  std::vector<std::unique_ptr<Task>> free_tasks_;
+  // tasks being filled by Submit, counted as queued
+  uint32_t filling_ = 0;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> encoded_num_{0};
+  std::atomic<uint64_t> dropped_num_{0};
+};  // class SnapshotEncoder
+
+}  // namespace cnstream
+
+#endif  // MODULES_ENCODE_SNAPSHOT_ENCODER_HPP_
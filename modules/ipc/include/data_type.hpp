@@ -32,6 +32,16 @@ enum IPCType {
   IPC_SERVER = 1     ///< the module ipc acts as server.
 };
 
+/**
+ * An enumerated type that is used to identify how the client sends frames to a server which has max cached frames
+ * not released.
+ */
+enum IPCBackpressure {
+  IPC_BACKPRESSURE_BLOCK = 0,       ///< the client waits for the server to release frames.
+  IPC_BACKPRESSURE_DROP_OLDEST = 1  ///< the client keeps the latest frame of each stream for the server, and drops
+                                    ///< the older one.
+};
+
 }  // namespace cnstream
 
 #endif
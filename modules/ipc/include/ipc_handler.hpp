@@ -27,6 +27,7 @@
 
 #include <semaphore.h>
 #include <cmath>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <thread>
@@ -39,7 +40,7 @@
 
 namespace cnstream {
 
-#define SOCK_BUFSIZE 512  // buffer size
+#define SOCK_BUFSIZE 512  // buffer size of legacy json package
 
 /**
  * An enumerated type that is used to identify the frame info package type transmitting between processores.
@@ -49,30 +50,54 @@ enum PkgType {
   PKG_DATA = 0,         ///< data package
   PKG_RELEASE_MEM = 1,  ///< package with release shared memory info
   PKG_EXIT = 2,         ///< package with exit info
-  PKG_ERROR = 3         ///< package with error info
+  PKG_ERROR = 3,        ///< package with error info
+  PKG_HELLO = 4,        ///< package with protocol version, to negotiate on connecting
+  PKG_RELEASE_BATCH = 5  ///< package with release shared memory info of frames in ranges
 };
 
+/**
+ * The frames released together, frame_num frames of the stream from first_frame_id.
+ */
+typedef struct {
+  uint32_t stream_idx;      ///< The index of the stream.
+  uint32_t frame_num;       ///< The number of frames in the range.
+  uint64_t first_frame_id;  ///< The frame index of the first frame in the range.
+} ReleaseRange;
+
 /**
  * The structure holding process info and frame info transmitting between processores.
  */
 typedef struct {
-  PkgType pkg_type;                          ///< package type
+  PkgType pkg_type = PKG_INVALID;            ///< package type
   uint32_t stream_idx = INVALID_STREAM_IDX;  ///< The index of the channel, stream_index
   std::string stream_id;                     ///< The data stream aliases where this frame is located to.
   size_t flags = 0;                          ///< The mask for this frame, ``CNFrameFlag``.
   uint64_t frame_id;                          ///< The frame index that incremented from 0.
   int64_t timestamp;                         ///< The time stamp of this frame.
-  CNDataFormat fmt;                          ///< The format of the frame.
+  CNDataFormat fmt = CN_INVALID;             ///< The format of the frame.
   int width;                                 ///< The width of the frame.
   int height;                                ///< The height of the frame.
   int stride[CN_MAX_PLANES];                 ///< The strides of the frame.
   void* ptr_mlu[CN_MAX_PLANES];              ///< The MLU data addresses for planes.
   DevContext ctx;                            ///< The device context of this frame.
-  MemMapType mem_map_type;                   ///< memory map/shared type.
+  MemMapType mem_map_type = MEMMAP_INVALID;  ///< memory map/shared type.
   void* mlu_mem_handle;                      ///< The MLU memory handle for mlu data.
+  int shm_slot = -1;                         ///< The slot of the shared memory frame ring, -1 if not in the ring.
+  uint32_t shm_generation = 0;               ///< The generation of the slot.
+  uint16_t protocol_version = 0;             ///< The highest protocol version of the sender, for hello package.
+  bool has_pixels = true;                    ///< false if only metadata of the frame is sent.
+  std::string objects;                       ///< The objects encoded by EncodeIPCObjects, empty if in the slot.
+  uint32_t slot_objects_size = 0;            ///< The size of encoded objects in the slot of frame ring.
+  uint64_t slot_objects_offset = 0;          ///< The offset of encoded objects in the slot of frame ring.
+  std::vector<ReleaseRange> release_ranges;  ///< The frames released, for release batch package.
+  std::string ring_name;                     ///< The frame ring of client, for hello package.
+  std::vector<std::string> stream_ids;       ///< The streams server receives, all if empty, for hello package.
+  IPCBackpressure backpressure = IPC_BACKPRESSURE_BLOCK;  ///< The backpressure of server, for hello package.
 } FrameInfoPackage;
 
 class ModuleIPC;
+class ShmFrameRing;
+class CNSocket;
 
 /**
  * @brief for IPCHandler, base class definition
@@ -90,7 +115,7 @@ class IPCHandler {
    *  @brief  Destructor function.
    *  @return None
    */
-  virtual ~IPCHandler() {}
+  virtual ~IPCHandler();
 
   /**
    *  @brief  Open resources.
@@ -158,12 +183,42 @@ class IPCHandler {
    */
   inline void SetMaxCachedFrameSize(const uint32_t size) { max_cachedframe_size_ = size; }
 
+  /**
+   *  @brief  Set slot size of the shared memory frame ring, 0 means the size of the first frame.
+   *  @return Void.
+   */
+  inline void SetShmSlotSize(const size_t size) { shm_slot_size_ = size; }
+
+  /**
+   *  @brief  Set whether only metadata of frames is sent, without pixels.
+   *  @return Void.
+   */
+  inline void SetMetadataOnly(const bool metadata_only) { metadata_only_ = metadata_only; }
+
+  /**
+   *  @brief  Get whether only metadata of frames is sent, without pixels.
+   *  @return Return true if pixels are not sent.
+   */
+  inline bool IsMetadataOnly() { return metadata_only_; }
+
   /**
    *  @brief  Set communication socket address.
    *  @return Void.
    */
   inline void SetSocketAddress(const std::string& socket_address) { socket_address_ = socket_address; }
 
+  /**
+   *  @brief  Set ids of streams the server receives, empty means all streams.
+   *  @return Void.
+   */
+  inline void SetStreamIds(const std::vector<std::string>& stream_ids) { stream_ids_ = stream_ids; }
+
+  /**
+   *  @brief  Set how the client sends frames to the server when max cached frames are not released by the server.
+   *  @return Void.
+   */
+  inline void SetBackpressure(const IPCBackpressure backpressure) { backpressure_ = backpressure; }
+
   /**
    *  @brief  Set memory map type.
    *  @return Void.
@@ -204,6 +259,43 @@ class IPCHandler {
    */
   bool WaitSemphore();
 
+  /**
+   *  @brief  Encode package to message, binary if binary protocol is negotiated, otherwise, legacy json package.
+   *  @return Return true if encode package successfully, otherwise, return false.
+   */
+  bool EncodePackage(const FrameInfoPackage& pkg, std::vector<char>* msg);
+
+  /**
+   *  @brief  Send package with socket.
+   *  @return Return true if send package successfully, otherwise, return false.
+   */
+  bool SendPackage(CNSocket* socket, const FrameInfoPackage& pkg);
+
+  /**
+   *  @brief  Receive a binary message or a legacy json package with socket, and decode it to package. pkg_type is
+   *          PKG_INVALID if the message could not be decoded.
+   *  @return Return false if connection is broken, otherwise, return true.
+   */
+  bool RecvPackage(CNSocket* socket, FrameInfoPackage* pkg);
+
+  /**
+   *  @brief Set planes of frame to the slot of shared memory frame ring in package, the ring is mapped at first.
+   *  @return Void.
+   */
+  void MapFrameRingSlot(const FrameInfoPackage& recv_pkg, CNDataFrame* dataframe);
+
+  /**
+   *  @brief Encode objects of frame to package, in the slot of frame ring after the pixels if there is room.
+   *  @return Void.
+   */
+  void PackObjects(std::shared_ptr<CNFrameInfo> data, const CNDataFrame* frame, FrameInfoPackage* send_pkg);
+
+  /**
+   *  @brief Decode objects in package, or in the slot of frame ring, to CNObjsVecKey of frame.
+   *  @return Void.
+   */
+  void UnpackObjects(const FrameInfoPackage& recv_pkg, std::shared_ptr<CNFrameInfo> data);
+
  protected:
 #ifdef UNIT_TEST
  public:  // NOLINT
@@ -225,11 +317,18 @@ class IPCHandler {
   ModuleIPC* ipc_module_ = nullptr;              // ipc module
   std::string socket_address_;                   // communication socket adress
   MemMapType memmap_type_ = MEMMAP_CPU;          // memory map type, with cpu by default
-  char recv_buf_[SOCK_BUFSIZE];                  // receive buffer
-  char send_buf_[SOCK_BUFSIZE];                  // send buffer
+  std::vector<char> recv_buf_;                   // receive buffer
+  std::vector<char> send_buf_;                   // send buffer
+  std::atomic<uint16_t> protocol_version_{0};    // negotiated protocol version, 0 means legacy json package
   ThreadSafeQueue<FrameInfoPackage> send_pkgq_;  // queue for package to send
   uint32_t max_cachedframe_size_ = 40;           // max size for cached processed frame map
   DevContext dev_ctx_;                           // device context info for server.
+  size_t shm_slot_size_ = 0;                     // slot size of frame ring, 0 means the size of the first frame
+  std::shared_ptr<ShmFrameRing> frame_ring_;     // frame ring shared by processes, created by client, mapped by server
+  bool metadata_only_ = false;                   // send objects of frames without pixels
+  std::string ring_name_;                        // name of frame ring, ShmFrameRing::NameOf(socket_address_) if empty
+  std::vector<std::string> stream_ids_;          // streams the server receives, all streams if empty
+  IPCBackpressure backpressure_ = IPC_BACKPRESSURE_BLOCK;  // how the client sends frames to a slow server
 
  private:
   sem_t* sem_id_ = nullptr;   // semaphore id
@@ -119,11 +119,20 @@ class ModuleIPC : public Module, public ModuleCreator<ModuleIPC> {
    * @return IPCHandler pointer.
    */
   std::shared_ptr<IPCHandler> GetIPCHandler() { return ipc_handler_; }
+
+  /**
+   * @brief Get ipc_handlers_, for unit test.
+   * @param void.
+   * @return IPCHandler pointers, one for each server when ModuleIPC act as client.
+   */
+  std::vector<std::shared_ptr<IPCHandler>> GetIPCHandlers() { return ipc_handlers_; }
 #else
  private:  // NOLINT
 #endif
   std::shared_ptr<IPCHandler> ipc_handler_ =
       nullptr;  // ipc handler, may act as client or server, which depends on the parameter configuration
+  std::vector<std::shared_ptr<IPCHandler>>
+      ipc_handlers_;  // ipc handlers of all servers when act as client, ipc_handler_ is the first one
 
   /**
    * @brief When ModuleIPC act as server, post frame info to communicate process to release shared memory,.
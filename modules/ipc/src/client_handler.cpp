@@ -18,17 +18,138 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <poll.h>
+
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "client_handler.hpp"
 #include "cnstream_frame.hpp"
 #include "device/mlu_context.h"
+#include "ipc_protocol.hpp"
 #include "module_ipc.hpp"
+#include "shm_frame_ring.hpp"
 
 namespace cnstream {
 
+static IPCFrameKey FrameKeyOf(const std::shared_ptr<CNFrameInfo>& data) {
+  CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+  return IPCFrameKey(data->GetStreamIndex(), frame->frame_id);
+}
+
+IPCFrameCache::IPCFrameCache(const std::string& ring_name, MemMapType memmap_type, uint32_t slot_num,
+                             size_t slot_size)
+    : ring_name_(ring_name), memmap_type_(memmap_type), slot_num_(slot_num), slot_size_(slot_size) {}
+
+IPCFrameCache::~IPCFrameCache() {
+  // clear all cached frames, and free all shared memory, the ring is removed then
+  for (auto& it : frames_) {
+    ReleaseFrameMemory(it.second.data);
+  }
+  LOG_IF(WARNING, fallback_frame_num_.load()) << fallback_frame_num_.load() << " frames are not in the frame ring "
+                                              << ring_name_ << ", shared memory is created for each of them.";
+}
+
+std::shared_ptr<ShmFrameRing> IPCFrameCache::Ring() {
+  std::lock_guard<std::mutex> lock(ring_mutex_);
+  return frame_ring_;
+}
+
+void IPCFrameCache::CopyToSharedMem(std::shared_ptr<CNFrameInfo> data) {
+  CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+  if (MEMMAP_CPU == memmap_type_ && CopyToFrameRing(frame.get())) return;
+  frame->CopyToSharedMem(memmap_type_, data->stream_id);
+}
+
+void IPCFrameCache::Add(std::shared_ptr<CNFrameInfo> data, uint32_t ref_num) {
+  if (!ref_num) {
+    ReleaseFrameMemory(data);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_[FrameKeyOf(data)] = {data, ref_num};
+}
+
+void IPCFrameCache::Release(const IPCFrameKey& key) {
+  std::shared_ptr<CNFrameInfo> data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = frames_.find(key);
+    if (iter == frames_.end()) {
+      LOG(WARNING) << "frame to release is not cached, stream index: " << key.first << ", frame id: " << key.second;
+      return;
+    }
+    if (--iter->second.ref_num) return;
+    data = iter->second.data;
+    frames_.erase(iter);
+  }
+  ReleaseFrameMemory(data);
+}
+
+size_t IPCFrameCache::Size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frames_.size();
+}
+
+bool IPCFrameCache::CopyToFrameRing(CNDataFrame* frame) {
+  size_t bytes = frame->GetBytes();
+  if (!bytes) return false;
+  std::shared_ptr<ShmFrameRing> ring;
+  {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    if (!frame_ring_) {
+      if (ring_failed_) return false;
+      // slots are enough for all frames not released by servers
+      std::shared_ptr<ShmFrameRing> new_ring = std::make_shared<ShmFrameRing>();
+      if (!new_ring->Create(ring_name_, slot_num_, std::max(slot_size_, bytes))) {
+        LOG(WARNING) << "create shared memory frame ring failed, create shared memory for each frame instead.";
+        ring_failed_ = true;
+        return false;
+      }
+      LOG(INFO) << "shared memory frame ring created, slot num: " << new_ring->SlotNum()
+                << ", slot size: " << new_ring->SlotSize();
+      frame_ring_ = new_ring;
+    }
+    ring = frame_ring_;
+  }
+
+  uint32_t generation = 0;
+  int slot = bytes > ring->SlotSize() ? -1 : ring->Acquire(&generation);
+  if (slot < 0) {
+    // warn once, the number of frames is reported when the cache is destroyed
+    LOG_IF(WARNING, 0 == fallback_frame_num_++)
+        << "frame of " << bytes << " bytes is not copied to the frame ring, slot num: " << ring->SlotNum()
+        << ", slot size: " << ring->SlotSize() << ", create shared memory for the frame instead.";
+    return false;
+  }
+
+  uint8_t* dst = ring->Slot(slot, generation);
+  for (int i = 0; i < frame->GetPlanes(); i++) {
+    size_t plane_size = frame->GetPlaneBytes(i);
+    memcpy(dst, frame->data[i]->GetCpuData(), plane_size);
+    dst += plane_size;
+  }
+  frame->shm_slot = slot;
+  frame->shm_generation = generation;
+  return true;
+}
+
+void IPCFrameCache::ReleaseFrameMemory(std::shared_ptr<CNFrameInfo> data) {
+  CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+  if (frame->shm_slot >= 0) {
+    std::shared_ptr<ShmFrameRing> ring = Ring();
+    if (ring && !ring->Release(frame->shm_slot)) {
+      LOG(WARNING) << "frame ring slot " << frame->shm_slot << " is not in use, frame id: " << frame->frame_id;
+    }
+    frame->shm_slot = -1;
+  } else {
+    frame->ReleaseSharedMem(memmap_type_, data->stream_id);
+  }
+}
+
 IPCClientHandler::IPCClientHandler(const IPCType& type, ModuleIPC* ipc_module) : IPCHandler(type, ipc_module) {}
 
 IPCClientHandler::~IPCClientHandler() { CloseSemphore(); }
@@ -50,12 +171,30 @@ bool IPCClientHandler::Open() {
     return false;
   }
 
+  if (!NegotiateProtocol()) {
+    LOG(ERROR) << "client negotiate protocol with server failed, unix address: " << socket_address_;
+    return false;
+  }
+
+  if (metadata_only_ && protocol_version_.load() < kIPCObjectsVersion) {
+    LOG(ERROR) << "server does not support frames of metadata only, ipc protocol version "
+               << protocol_version_.load() << ", unix address: " << socket_address_;
+    return false;
+  }
+
+  // server maps the ring by its own socket address before fan out is supported
+  if (!metadata_only_ && protocol_version_.load() < kIPCFanOutVersion &&
+      GetFrameCache()->RingName() != ShmFrameRing::NameOf(socket_address_)) {
+    LOG(ERROR) << "server does not support frames sent to several servers, ipc protocol version "
+               << protocol_version_.load() << ", unix address: " << socket_address_;
+    return false;
+  }
+
   LOG(INFO) << "client connect to server succeed, unix address: " << socket_address_;
   server_closed_.store(false);
   is_running_.store(true);
   is_connected_.store(true);
   recv_thread_ = std::thread(&IPCClientHandler::RecvPackageLoop, this);
-  process_thread_ = std::thread(&IPCClientHandler::FreeSharedMemory, this);
   CloseSemphore();
   return true;
 }
@@ -67,42 +206,56 @@ void IPCClientHandler::Close() {
   }
 
   is_running_.store(false);
+  WakeSenders();
   if (recv_thread_.joinable()) {
     recv_thread_.join();
   }
-  if (process_thread_.joinable()) {
-    process_thread_.join();
-  }
+  LOG(INFO) << "client received " << release_pkg_num_.load() << " release packages for "
+            << released_frame_num_.load() << " frames.";
 
   client_handle_.Close();
 
-  // clear all cached processed data, and free all shared memory
-  if (processed_frames_map_.size() > 0) {
-    for (auto& it : processed_frames_map_) {
-      auto data = it.second;
-      CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
-      frame->ReleaseSharedMem(memmap_type_, data->stream_id);
-    }
+  // frames not released by server, and frames kept for server, are released from the frame cache
+  std::vector<IPCFrameKey> keys;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& it : processed_frames_map_) keys.push_back(it.first);
+    for (auto& it : pending_frames_) keys.push_back(FrameKeyOf(it.second));
+    processed_frames_map_.clear();
+    pending_frames_.clear();
+  }
+  if (frame_cache_) {
+    for (auto& key : keys) frame_cache_->Release(key);
   }
+  LOG_IF(INFO, dropped_frame_num_.load()) << "client dropped " << dropped_frame_num_.load()
+                                          << " frames for slow server, unix address: " << socket_address_;
+  // the ring is removed with the frame cache, server has been closed or disconnected
+  frame_ring_.reset();
+  frame_cache_.reset();
 }
 
 void IPCClientHandler::Shutdown() { client_handle_.Shutdown(); }
 
+void IPCClientHandler::WakeSenders() {
+  // lock mutex_, so the state is not changed between the check and the wait of senders
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  framesmap_full_cond_.notify_all();
+}
+
 void IPCClientHandler::RecvPackageLoop() {
   std::string recv_err_msg;
   while (is_running_.load()) {
-    if (client_handle_.RecvData(recv_buf_, sizeof(recv_buf_)) != sizeof(recv_buf_)) {
+    FrameInfoPackage recv_pkg;
+    if (!RecvPackage(&client_handle_, &recv_pkg)) {
       recv_err_msg = "client receive message error";
       LOG(ERROR) << recv_err_msg;
       client_handle_.Close();
       is_connected_.store(false);
+      WakeSenders();
       ipc_module_->PostEvent(EventType::EVENT_ERROR, recv_err_msg);
       break;
     }
-    FrameInfoPackage recv_pkg;
-    std::string recv_str(recv_buf_);
-    memset(recv_buf_, 0, sizeof(recv_buf_));
-    if (!ParseStringToPackage(recv_str, &recv_pkg)) {
+    if (PKG_INVALID == recv_pkg.pkg_type) {
       LOG(WARNING) << "client parse error.";
     }
 
@@ -122,7 +275,16 @@ void IPCClientHandler::RecvPackageLoop() {
 
       case PkgType::PKG_RELEASE_MEM:
         if (recv_pkg.stream_id.empty()) break;
-        recv_releaseq_.Push(recv_pkg);
+        FreeSharedMemory(recv_pkg);
+        break;
+
+      case PkgType::PKG_RELEASE_BATCH:
+        FreeSharedMemory(recv_pkg);
+        break;
+
+      case PkgType::PKG_HELLO:
+        // server replies later than negotiation timeout, use binary protocol from now on
+        protocol_version_.store(std::min(kIPCProtocolVersion, recv_pkg.protocol_version));
         break;
 
       default:
@@ -133,7 +295,8 @@ void IPCClientHandler::RecvPackageLoop() {
 
 bool IPCClientHandler::Send() {
   if (is_connected_.load()) {
-    if (client_handle_.SendData(send_buf_, sizeof(send_buf_)) != sizeof(send_buf_)) {
+    if (send_buf_.empty() ||
+        client_handle_.SendData(send_buf_.data(), send_buf_.size()) != static_cast<int>(send_buf_.size())) {
       LOG(WARNING) << " client send message to server failed.";
       return false;
     }
@@ -141,41 +304,168 @@ bool IPCClientHandler::Send() {
   return true;
 }
 
-void IPCClientHandler::FreeSharedMemory() {
-  // get data from received data queue, find CNFrameInfo data in processed map, and release shared memory in CNDataFrame
-  while (is_running_.load()) {
-    FrameInfoPackage recv_pkg;
-    if (!recv_releaseq_.WaitAndTryPop(recv_pkg, std::chrono::milliseconds(20))) continue;
+bool IPCClientHandler::NegotiateProtocol() {
+  FrameInfoPackage hello;
+  hello.pkg_type = PKG_HELLO;
+  hello.protocol_version = kIPCProtocolVersion;
+  hello.ring_name = GetFrameCache()->RingName();
+  std::vector<char> msg;
+  // legacy server reads json packages of SOCK_BUFSIZE bytes, and drops hello as it is not json
+  if (!EncodeIPCMessage(hello, &msg, SOCK_BUFSIZE) ||
+      client_handle_.SendData(msg.data(), msg.size()) != static_cast<int>(msg.size())) {
+    return false;
+  }
+
+  pollfd fds = {client_handle_.socket_fd_, POLLIN, 0};
+  if (poll(&fds, 1, kHelloTimeoutMs) <= 0) {
+    LOG(INFO) << "server does not reply hello, use legacy json package.";
+    return true;
+  }
+  FrameInfoPackage reply;
+  if (!RecvPackage(&client_handle_, &reply)) return false;
+  if (PKG_HELLO != reply.pkg_type) {
+    LOG(WARNING) << "server replies package of type " << reply.pkg_type << " to hello, use legacy json package.";
+    return true;
+  }
+  protocol_version_.store(std::min(kIPCProtocolVersion, reply.protocol_version));
+  // streams and backpressure of server, all streams and block for servers before fan out is supported
+  stream_ids_ = reply.stream_ids;
+  backpressure_ = reply.backpressure;
+  LOG(INFO) << "client use ipc protocol version " << protocol_version_.load() << ", server receives "
+            << (stream_ids_.empty() ? std::string("all") : std::to_string(stream_ids_.size())) << " streams with "
+            << (IPC_BACKPRESSURE_BLOCK == backpressure_ ? "block" : "drop oldest") << " backpressure.";
+  return true;
+}
 
-    if (recv_pkg.stream_id.empty()) continue;
-    std::unique_lock<std::mutex> lock(mutex_);
-    // get data from processed map, release it's shared memory, and pop data from processed map
-    std::string key = "stream_id_" + recv_pkg.stream_id + "_frame_id_" + std::to_string(recv_pkg.frame_id);
-    auto iter = processed_frames_map_.find(key);
+void IPCClientHandler::FreeSharedMemory(const FrameInfoPackage& release_pkg) {
+  // release is handled on receiving, find CNFrameInfo data in processed map, and release it from the frame cache
+  std::vector<IPCFrameKey> keys;
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto release = [&](uint32_t stream_idx, uint64_t frame_id) {
+    auto iter = processed_frames_map_.find(IPCFrameKey(stream_idx, frame_id));
     if (iter != processed_frames_map_.end()) {
-      CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(iter->second->datas[CNDataFramePtrKey]);
-      frame->ReleaseSharedMem(memmap_type_, iter->second->stream_id);
+      keys.push_back(iter->first);
       processed_frames_map_.erase(iter);
-      framesmap_full_cond_.notify_one();
     } else {
-      LOG(FATAL) << "frame need to release can not find by key: " << key;
+      LOG(FATAL) << "frame need to release can not find, stream index: " << stream_idx << ", frame id: " << frame_id;
+    }
+  };
+  if (PKG_RELEASE_BATCH == release_pkg.pkg_type) {
+    for (const auto& range : release_pkg.release_ranges) {
+      for (uint32_t i = 0; i < range.frame_num; ++i) release(range.stream_idx, range.first_frame_id + i);
     }
+  } else {
+    release(release_pkg.stream_idx, release_pkg.frame_id);
   }
+  release_pkg_num_++;
+  released_frame_num_ += keys.size();
+  if (keys.empty()) return;
+
+  framesmap_full_cond_.notify_all();
+  SendPendingFrames(&lock);
+  std::shared_ptr<IPCFrameCache> frame_cache = GetFrameCache();
+  for (auto& key : keys) frame_cache->Release(key);
+}
+
+std::shared_ptr<IPCFrameCache> IPCClientHandler::GetFrameCache() {
+  if (!frame_cache_) frame_cache_ = CreateFrameCache(1);
+  return frame_cache_;
 }
 
-bool IPCClientHandler::CacheProcessedData(std::shared_ptr<CNFrameInfo> data) {
-  while (is_running_.load() && is_connected_.load()) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (framesmap_full_cond_.wait_for(lock, std::chrono::milliseconds(10),
-                                      [&] { return (processed_frames_map_.size() < max_cachedframe_size_); })) {
-      CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
-      std::string key = "stream_id_" + data->stream_id + "_frame_id_" + std::to_string(frame->frame_id);
-      processed_frames_map_.insert(make_pair(key, data));
+std::shared_ptr<IPCFrameCache> IPCClientHandler::CreateFrameCache(uint32_t server_num) {
+  // one more slot than max cached frames of each server, for the frame waiting to be sent
+  return std::make_shared<IPCFrameCache>(ShmFrameRing::NameOf(socket_address_), memmap_type_,
+                                         (max_cachedframe_size_ + 1) * server_num, shm_slot_size_);
+}
+
+bool IPCClientHandler::IsSubscribed(const std::string& stream_id) const {
+  return stream_ids_.empty() || std::find(stream_ids_.begin(), stream_ids_.end(), stream_id) != stream_ids_.end();
+}
+
+void IPCClientHandler::CopyToSharedMem(std::shared_ptr<CNFrameInfo> data) {
+  std::shared_ptr<IPCFrameCache> frame_cache = GetFrameCache();
+  frame_cache->CopyToSharedMem(data);
+  // objects of frame are encoded in the slot after the pixels
+  std::lock_guard<std::mutex> send_lock(send_mutex_);
+  if (!frame_ring_) frame_ring_ = frame_cache->Ring();
+}
+
+bool IPCClientHandler::SendFrame(std::shared_ptr<CNFrameInfo> data) {
+  if (data->IsEos() || metadata_only_) {
+    std::shared_ptr<CNFrameInfo> dropped;
+    if (data->IsEos()) {
+      // the frame kept for server is dropped, server receives no frame of the stream after eos
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto iter = pending_frames_.find(data->GetStreamIndex());
+      if (iter != pending_frames_.end()) {
+        dropped = iter->second;
+        pending_frames_.erase(iter);
+      }
+    }
+    if (dropped) {
+      GetFrameCache()->Release(FrameKeyOf(dropped));
+      dropped_frame_num_++;
+    }
+    std::lock_guard<std::mutex> send_lock(send_mutex_);
+    return SendFramePackage(data);
+  }
+
+  IPCFrameKey key = FrameKeyOf(data);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (IPC_BACKPRESSURE_DROP_OLDEST == backpressure_) {
+    if (is_connected_.load() && processed_frames_map_.size() >= max_cachedframe_size_) {
+      // server is busy, the frame is sent when server releases a frame, the older one of the stream is dropped
+      std::shared_ptr<CNFrameInfo>& pending = pending_frames_[data->GetStreamIndex()];
+      std::shared_ptr<CNFrameInfo> dropped = pending;
+      pending = data;
+      lock.unlock();
+      if (dropped) {
+        GetFrameCache()->Release(FrameKeyOf(dropped));
+        dropped_frame_num_++;
+      }
       return true;
     }
+  } else {
+    // woken by releases of server, by disconnection and by close
+    framesmap_full_cond_.wait(lock, [this] {
+      return !is_running_.load() || !is_connected_.load() || processed_frames_map_.size() < max_cachedframe_size_;
+    });
+  }
+
+  if (!is_running_.load() || !is_connected_.load()) {
+    lock.unlock();
+    GetFrameCache()->Release(key);
+    return false;
   }
+  processed_frames_map_.insert(std::make_pair(key, data));
+  // lock send_mutex_ before mutex_ is unlocked, so frames are sent in the order they are taken
+  std::lock_guard<std::mutex> send_lock(send_mutex_);
+  lock.unlock();
+  return SendFramePackage(data);
+}
+
+void IPCClientHandler::SendPendingFrames(std::unique_lock<std::mutex>* lock) {
+  std::vector<std::shared_ptr<CNFrameInfo>> frames;
+  while (!pending_frames_.empty() && processed_frames_map_.size() < max_cachedframe_size_) {
+    auto iter = pending_frames_.begin();
+    processed_frames_map_.insert(std::make_pair(FrameKeyOf(iter->second), iter->second));
+    frames.push_back(iter->second);
+    pending_frames_.erase(iter);
+  }
+  if (frames.empty()) {
+    lock->unlock();
+    return;
+  }
+  std::lock_guard<std::mutex> send_lock(send_mutex_);
+  lock->unlock();
+  for (auto& data : frames) SendFramePackage(data);
+}
 
-  return false;
+bool IPCClientHandler::SendFramePackage(std::shared_ptr<CNFrameInfo> data) {
+  // the frame ring may be created by the frame cache for another server
+  if (!frame_ring_ && frame_cache_) frame_ring_ = frame_cache_->Ring();
+  PreparePackageToSend(PkgType::PKG_DATA, data);
+  return Send();
 }
 
 }  //  namespace cnstream
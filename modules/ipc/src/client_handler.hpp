@@ -21,21 +21,116 @@
 #ifndef MODULES_IPC_CLIENT_HANDLER_HPP_
 #define MODULES_IPC_CLIENT_HANDLER_HPP_
 
+#include <atomic>
 #include <cmath>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "cnsocket.hpp"
 #include "ipc_handler.hpp"
 
 namespace cnstream {
 
+using IPCFrameKey = std::pair<uint32_t, uint64_t>;  // stream index and frame id of a processed frame
+
+/**
+ * @brief Processed frames in shared memory, shared by client handlers of all servers the frames are sent to. Shared
+ * memory of a frame is released after all the servers it is sent to release it.
+ */
+class IPCFrameCache {
+ public:
+  /**
+   *  @brief  Constructed function.
+   *  @param  ring_name : name of the shared memory frame ring, servers map the ring by it
+   *  @param  slot_num : slot number of the ring, the max number of frames in the ring
+   *  @param  slot_size : slot size of the ring, 0 means the size of the first frame
+   *  @return None
+   */
+  IPCFrameCache(const std::string& ring_name, MemMapType memmap_type, uint32_t slot_num, size_t slot_size);
+
+  /**
+   *  @brief  Destructor function, release shared memory of all cached frames and remove the ring.
+   *  @return None
+   */
+  ~IPCFrameCache();
+
+  /**
+   *  @brief  Get name of the shared memory frame ring.
+   *  @return Return name of the ring.
+   */
+  const std::string& RingName() const { return ring_name_; }
+
+  /**
+   *  @brief  Get the shared memory frame ring.
+   *  @return Return the ring, nullptr if the ring is not created.
+   */
+  std::shared_ptr<ShmFrameRing> Ring();
+
+  /**
+   *  @brief  Copy frame data to a slot of the shared memory frame ring, or to shared memory of the frame if the ring
+   *          is not available, e.g. mlu memory map, the frame is larger than the slot or all slots are in use.
+   *  @return Void.
+   */
+  void CopyToSharedMem(std::shared_ptr<CNFrameInfo> data);
+
+  /**
+   *  @brief  Cache a frame in shared memory, which is sent to ref_num servers.
+   *  @return Void.
+   */
+  void Add(std::shared_ptr<CNFrameInfo> data, uint32_t ref_num);
+
+  /**
+   *  @brief  A server releases the frame, or the frame is not sent to the server. Shared memory of the frame is
+   *          released if no server holds it.
+   *  @return Void.
+   */
+  void Release(const IPCFrameKey& key);
+
+  /**
+   *  @brief  Get number of cached frames.
+   *  @return Return number of cached frames.
+   */
+  size_t Size();
+
+  /**
+   *  @brief  Get number of frames copied to shared memory of their own, as the ring is full or the frame is larger
+   *          than the slot. With drop oldest backpressure, a frame kept for each stream of each server is in the ring
+   *          besides max cached frames, so the ring may be full when there are many streams.
+   *  @return Return number of frames not in the ring.
+   */
+  uint64_t GetFallbackFrameNum() const { return fallback_frame_num_.load(); }
+
+ private:
+  bool CopyToFrameRing(CNDataFrame* frame);
+  void ReleaseFrameMemory(std::shared_ptr<CNFrameInfo> data);
+
+  struct CachedFrame {
+    std::shared_ptr<CNFrameInfo> data;
+    uint32_t ref_num;
+  };
+
+  std::string ring_name_;                          // name of frame ring
+  MemMapType memmap_type_;                         // memory map type
+  uint32_t slot_num_;                              // slot number of frame ring
+  size_t slot_size_;                               // slot size of frame ring, 0 means the size of the first frame
+  std::mutex mutex_;                               // mutex for cached frames
+  std::map<IPCFrameKey, CachedFrame> frames_;      // cached frames with number of servers holding them
+  std::mutex ring_mutex_;                          // mutex for creating frame ring
+  std::shared_ptr<ShmFrameRing> frame_ring_;       // frame ring created at the first frame
+  bool ring_failed_ = false;                       // frame ring is failed to create, not to try again
+  std::atomic<uint64_t> fallback_frame_num_{0};    // frames not in the ring, though the ring is created
+};
+
 /**
  * @brief for IPCClientHandler, inherited from IPCHandler.
  */
 class IPCClientHandler : public IPCHandler {
  public:
+  static constexpr int kHelloTimeoutMs = 1000;  // time to wait for hello reply of server
+
   /**
    *  @brief  Constructed function.
    *  @param  Name : type - define client or server handler
@@ -86,10 +181,43 @@ class IPCClientHandler : public IPCHandler {
   void SendPackageLoop() override{};
 
   /**
-   *  @brief  Cache processed data.
-   *  @return Return true if cache processed data successfully, otherwise, return false.
+   *  @brief  Set frame cache shared with client handlers of other servers. A client handler creates its own cache
+   *          with the frame ring named by its socket address if it is not set.
+   *  @return Void.
+   */
+  void SetFrameCache(std::shared_ptr<IPCFrameCache> frame_cache) { frame_cache_ = frame_cache; }
+
+  /**
+   *  @brief  Get frame cache of the client handler.
+   *  @return Return the frame cache.
+   */
+  std::shared_ptr<IPCFrameCache> GetFrameCache();
+
+  /**
+   *  @brief  Create frame cache with the frame ring named by socket address, for frames sent to server_num servers.
+   *  @return Return the frame cache.
+   */
+  std::shared_ptr<IPCFrameCache> CreateFrameCache(uint32_t server_num);
+
+  /**
+   *  @brief  Check whether the server receives the stream.
+   *  @return Return true if the server receives all streams or the stream is one of them.
    */
-  bool CacheProcessedData(std::shared_ptr<CNFrameInfo> data);
+  bool IsSubscribed(const std::string& stream_id) const;
+
+  /**
+   *  @brief  Copy frame data to shared memory of the frame cache.
+   *  @return Void.
+   */
+  void CopyToSharedMem(std::shared_ptr<CNFrameInfo> data);
+
+  /**
+   *  @brief  Send frame to server. The frame cached in shared memory waits until the server has less than max cached
+   *          frames not released, or it is kept for the server as the latest frame of the stream with drop oldest
+   *          backpressure. Frames not sent are released from the frame cache.
+   *  @return Return true if the frame is sent or kept for the server, otherwise, return false.
+   */
+  bool SendFrame(std::shared_ptr<CNFrameInfo> data);
 
 #ifdef UNIT_TEST
   /**
@@ -97,27 +225,79 @@ class IPCClientHandler : public IPCHandler {
    *  @return Return true if communicate server is closed, otherwise, return false.
    */
   bool GetServerState() { return server_closed_.load(); }
+
+  /**
+   *  @brief  Get number of processed frames waiting for release.
+   *  @return Return number of cached processed frames.
+   */
+  size_t GetCachedFrameNum() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return processed_frames_map_.size();
+  }
+
+  /**
+   *  @brief  Get number of release packages received, a release batch counts one.
+   *  @return Return number of release packages received.
+   */
+  uint64_t GetReleasePackageNum() { return release_pkg_num_.load(); }
+
+  /**
+   *  @brief  Get number of frames dropped for the server with drop oldest backpressure.
+   *  @return Return number of dropped frames.
+   */
+  uint64_t GetDroppedFrameNum() { return dropped_frame_num_.load(); }
 #endif
 
  private:
   /**
-   *  @brief  Free shared memory for each frame in cached processed frame.
+   *  @brief  Free shared memory of the frames released by server, and remove them from cached processed frames.
+   *  @return Void.
+   */
+  void FreeSharedMemory(const FrameInfoPackage& release_pkg);
+
+  /**
+   *  @brief  Wake senders waiting for releases of server, after client is closed or disconnected.
    *  @return Void.
    */
-  void FreeSharedMemory();
+  void WakeSenders();
+
+  /**
+   *  @brief  Send hello package to server, use binary protocol if server replies in kHelloTimeoutMs, otherwise,
+   *          use legacy json package.
+   *  @return Return false if connection is broken, otherwise, return true.
+   */
+  bool NegotiateProtocol();
+
+  /**
+   *  @brief  Send frames kept for the server while it has less than max cached frames, send_mutex_ is locked before
+   *          frames are taken, so they are sent in order.
+   *  @return Void.
+   */
+  void SendPendingFrames(std::unique_lock<std::mutex>* lock);
+
+  /**
+   *  @brief  Encode frame to send buffer, and send it. send_mutex_ must be locked.
+   *  @return Return true if frame is sent successfully, otherwise, return false.
+   */
+  bool SendFramePackage(std::shared_ptr<CNFrameInfo> data);
 
  private:
   CNClient client_handle_;                           // client socket handle
-  std::thread recv_thread_;                          // thread for receving message to process
-  std::thread process_thread_;                       // thread for releasing shared memory used in frame
+  std::thread recv_thread_;                          // thread for receving message and releasing shared memory
   std::atomic<bool> server_closed_{true};            // flag to identify if server is closed
   std::atomic<bool> is_running_{false};              // flag to identify if thread is running
   std::atomic<bool> is_connected_{false};            // flag to identify connection state
+  std::atomic<uint64_t> release_pkg_num_{0};         // number of release packages received
+  std::atomic<uint64_t> released_frame_num_{0};      // number of frames released by server
+  std::atomic<uint64_t> dropped_frame_num_{0};       // number of frames dropped with drop oldest backpressure
   std::mutex mutex_;                                 // mutex for processd frames map read/write
-  ThreadSafeQueue<FrameInfoPackage> recv_releaseq_;  // message queue with frameinfo to release
-  std::map<std::string, std::shared_ptr<CNFrameInfo>>
-      processed_frames_map_;                     // frames which is processed, and wait to release memory
+  std::map<IPCFrameKey, std::shared_ptr<CNFrameInfo>>
+      processed_frames_map_;                     // frames which is sent to server, and wait to release memory
+  std::map<uint32_t, std::shared_ptr<CNFrameInfo>>
+      pending_frames_;                           // the latest frame of each stream waiting to be sent, drop oldest
   std::condition_variable framesmap_full_cond_;  // condition variable for processed frames map size
+  std::mutex send_mutex_;                        // mutex for send buffer, frames are sent by process and recv thread
+  std::shared_ptr<IPCFrameCache> frame_cache_;   // frames in shared memory, may be shared with other handlers
 };
 
 }  //  namespace cnstream
@@ -39,7 +39,14 @@ void CNSocket::Shutdown() { shutdown(socket_fd_, SHUT_RDWR); }
 
 int CNSocket::RecvData(char* read_buf, int buf_size) {
   if (nullptr != read_buf) {
-    return recv(socket_fd_, read_buf, buf_size, 0);
+    int received = 0;
+    while (received < buf_size) {
+      int ret = recv(socket_fd_, read_buf + received, buf_size - received, 0);
+      if (ret < 0 && errno == EINTR) continue;
+      if (ret <= 0) return received ? received : ret;
+      received += ret;
+    }
+    return received;
   }
 
   return -1;
@@ -47,7 +54,14 @@ int CNSocket::RecvData(char* read_buf, int buf_size) {
 
 int CNSocket::SendData(char* send_buf, int buf_size) {
   if (nullptr != send_buf) {
-    return send(socket_fd_, send_buf, buf_size, 0);
+    int sent = 0;
+    while (sent < buf_size) {
+      int ret = send(socket_fd_, send_buf + sent, buf_size - sent, MSG_NOSIGNAL);
+      if (ret < 0 && errno == EINTR) continue;
+      if (ret <= 0) return sent ? sent : ret;
+      sent += ret;
+    }
+    return sent;
   }
 
   return -1;
@@ -54,13 +54,13 @@ class CNSocket {
   void Shutdown();
 
   /**
-   *  @brief  Receive data from socket fd.
+   *  @brief  Receive buf_size bytes from socket fd, wait until all of them are received or connection is broken.
    *  @return received data bytes.
    */
   int RecvData(char* buf, int buf_size);
 
   /**
-   *  @brief  Send data to socket fd.
+   *  @brief  Send buf_size bytes to socket fd, wait until all of them are sent or connection is broken.
    *  @return send data bytes.
    */
   int SendData(char* buf, int buf_size);
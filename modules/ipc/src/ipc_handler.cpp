@@ -26,13 +26,20 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "cnsocket.hpp"
 #include "ipc_handler.hpp"
+#include "ipc_protocol.hpp"
+#include "shm_frame_ring.hpp"
 
 namespace cnstream {
 
+IPCHandler::~IPCHandler() {}
+
 bool IPCHandler::OpenSemphore() {
   std::string sem_name = "sem_" + socket_address_;
   // if semaphore exists, open and use directly
@@ -56,7 +63,7 @@ bool IPCHandler::OpenSemphore() {
 
 void IPCHandler::CloseSemphore() {
   std::string sem_name = "sem_" + socket_address_;
-  sem_close(sem_id_);
+  if (sem_id_) sem_close(sem_id_);
   if (sem_created_) sem_unlink(sem_name.c_str());
 }
 
@@ -213,6 +220,16 @@ bool IPCHandler::ParseStringToPackage(const std::string& str, FrameInfoPackage*
         return false;
       }
     }
+
+    // optional, frame is in its own shared memory if it is not in the frame ring
+    if (end != doc.FindMember("shm_slot")) {
+      if (!doc["shm_slot"].IsInt() || end == doc.FindMember("shm_generation") || !doc["shm_generation"].IsUint()) {
+        LOG(WARNING) << "parse shm_slot error.";
+        return false;
+      }
+      pkg->shm_slot = doc["shm_slot"].GetInt();
+      pkg->shm_generation = doc["shm_generation"].GetUint();
+    }
   }
   return true;
 }
@@ -275,6 +292,14 @@ bool IPCHandler::SerializeToString(const FrameInfoPackage& pkg, std::string* str
     writer.Key("mlu_mem_handle");
     intptr_t ptmp = reinterpret_cast<intptr_t>(pkg.mlu_mem_handle);
     writer.String(std::to_string(ptmp).c_str());
+
+    if (pkg.shm_slot >= 0) {
+      writer.Key("shm_slot");
+      writer.Int(pkg.shm_slot);
+
+      writer.Key("shm_generation");
+      writer.Uint(pkg.shm_generation);
+    }
   }
   writer.EndObject();
 
@@ -308,9 +333,13 @@ void IPCHandler::PreparePackageToSend(const PkgType& type, const std::shared_ptr
           send_pkg.stride[i] = frame->stride[i];
         }
         send_pkg.mlu_mem_handle = frame->mlu_mem_handle;
+        send_pkg.shm_slot = frame->shm_slot;
+        send_pkg.shm_generation = frame->shm_generation;
         send_pkg.ctx.dev_type = frame->ctx.dev_type;
         send_pkg.ctx.dev_id = frame->ctx.dev_id;
         send_pkg.ctx.ddr_channel = frame->ctx.ddr_channel;
+        send_pkg.has_pixels = !metadata_only_;
+        if (protocol_version_.load() >= kIPCObjectsVersion) PackObjects(data, frame.get(), &send_pkg);
       }
     } break;
     case PkgType::PKG_RELEASE_MEM: {
@@ -339,10 +368,7 @@ void IPCHandler::PreparePackageToSend(const PkgType& type, const std::shared_ptr
   }
 
   if (IPC_CLIENT == ipc_type_) {
-    std::string send_str;
-    SerializeToString(send_pkg, &send_str);
-    memset(send_buf_, 0, sizeof(send_buf_));
-    memcpy(send_buf_, send_str.c_str(), send_str.length());
+    EncodePackage(send_pkg, &send_buf_);
   } else if (IPC_SERVER == ipc_type_) {
     send_pkgq_.Push(send_pkg);
   }
@@ -389,14 +415,149 @@ void IPCHandler::PackageToCNData(const FrameInfoPackage& recv_pkg, std::shared_p
     dataframe->ctx.ddr_channel = data->GetStreamIndex() % 4;
   }
 
-  // sync shared memory for frame data
-  if (!data->IsEos()) {
+  // sync shared memory for frame data, the frame has no planes if only metadata is sent
+  if (!data->IsEos() && recv_pkg.has_pixels) {
     std::lock_guard<std::mutex> lock(mem_map_mutex_);
-    dataframe->MmapSharedMem(memmap_type_, data->stream_id);
+    if (recv_pkg.shm_slot >= 0) {
+      MapFrameRingSlot(recv_pkg, dataframe.get());
+    } else {
+      dataframe->MmapSharedMem(memmap_type_, data->stream_id);
+    }
   }
 
   data->datas[CNDataFramePtrKey] = dataframe;
+  if (!recv_pkg.objects.empty() || recv_pkg.slot_objects_size) UnpackObjects(recv_pkg, data);
   return;
 }
 
+bool IPCHandler::EncodePackage(const FrameInfoPackage& pkg, std::vector<char>* msg) {
+  if (!msg) return false;
+  msg->clear();
+  const uint16_t version = protocol_version_.load();
+  if (version > 0) return EncodeIPCMessage(pkg, msg, 0, version);
+
+  std::string str;
+  if (!SerializeToString(pkg, &str)) return false;
+  if (str.size() >= SOCK_BUFSIZE) {
+    LOG(ERROR) << "package is larger than " << SOCK_BUFSIZE << " bytes, which is the limit of legacy json package.";
+    return false;
+  }
+  msg->assign(SOCK_BUFSIZE, 0);
+  memcpy(msg->data(), str.c_str(), str.size());
+  return true;
+}
+
+bool IPCHandler::SendPackage(CNSocket* socket, const FrameInfoPackage& pkg) {
+  if (!socket || !EncodePackage(pkg, &send_buf_)) return false;
+  return socket->SendData(send_buf_.data(), send_buf_.size()) == static_cast<int>(send_buf_.size());
+}
+
+bool IPCHandler::RecvPackage(CNSocket* socket, FrameInfoPackage* pkg) {
+  if (!socket || !pkg) return false;
+  pkg->pkg_type = PKG_INVALID;
+  // legacy json package is longer than the header, so the header is always read at first
+  IPCMsgHeader header;
+  char* head = reinterpret_cast<char*>(&header);
+  if (socket->RecvData(head, sizeof(header)) != static_cast<int>(sizeof(header))) return false;
+
+  if (head[0] == kIPCMsgMagic[0]) {
+    // the stream is out of sync if header is invalid, nothing could be read after it
+    if (!CheckIPCMsgHeader(header)) return false;
+    recv_buf_.resize(header.payload_size);
+    if (header.payload_size &&
+        socket->RecvData(recv_buf_.data(), header.payload_size) != static_cast<int>(header.payload_size)) {
+      return false;
+    }
+    if (!DecodeIPCMessage(header, recv_buf_.data(), pkg)) pkg->pkg_type = PKG_INVALID;
+    return true;
+  }
+
+  // legacy json package of SOCK_BUFSIZE bytes, padded with zeros
+  static_assert(SOCK_BUFSIZE > sizeof(IPCMsgHeader), "legacy package must be longer than header");
+  const int rest = SOCK_BUFSIZE - sizeof(header);
+  recv_buf_.assign(SOCK_BUFSIZE + 1, 0);
+  memcpy(recv_buf_.data(), head, sizeof(header));
+  if (socket->RecvData(recv_buf_.data() + sizeof(header), rest) != rest) return false;
+  if (!ParseStringToPackage(std::string(recv_buf_.data()), pkg)) pkg->pkg_type = PKG_INVALID;
+  return true;
+}
+
+void IPCHandler::MapFrameRingSlot(const FrameInfoPackage& recv_pkg, CNDataFrame* dataframe) {
+  // the ring is mapped once, at the first frame in it
+  if (!frame_ring_) {
+    std::shared_ptr<ShmFrameRing> ring = std::make_shared<ShmFrameRing>();
+    if (!ring->Map(ring_name_.empty() ? ShmFrameRing::NameOf(socket_address_) : ring_name_)) {
+      LOG(FATAL) << "map shared memory frame ring failed, socket address: " << socket_address_;
+    }
+    frame_ring_ = ring;
+  }
+
+  uint8_t* ptr = frame_ring_->Slot(recv_pkg.shm_slot, recv_pkg.shm_generation);
+  if (!ptr || dataframe->GetBytes() > frame_ring_->SlotSize()) {
+    LOG(FATAL) << "frame ring slot " << recv_pkg.shm_slot << " of generation " << recv_pkg.shm_generation
+               << " is invalid, stream id: " << recv_pkg.stream_id << ", frame id: " << recv_pkg.frame_id;
+  }
+  dataframe->shm_slot = recv_pkg.shm_slot;
+  dataframe->shm_generation = recv_pkg.shm_generation;
+
+  // planes point to the slot, synced to mlu only if mlu data is used
+  for (int i = 0; i < dataframe->GetPlanes(); i++) {
+    size_t plane_size = dataframe->GetPlaneBytes(i);
+    CNSyncedMemory* sync_ptr = nullptr;
+    if (dataframe->ctx.dev_type == DevContext::MLU) {
+      sync_ptr = new (std::nothrow) CNSyncedMemory(plane_size, dataframe->ctx.dev_id, dataframe->ctx.ddr_channel);
+    } else {
+      sync_ptr = new (std::nothrow) CNSyncedMemory(plane_size);
+    }
+    dataframe->data[i].reset(sync_ptr);
+    dataframe->data[i]->SetCpuData(ptr);
+    ptr += plane_size;
+  }
+}
+
+void IPCHandler::PackObjects(std::shared_ptr<CNFrameInfo> data, const CNDataFrame* frame, FrameInfoPackage* send_pkg) {
+  auto iter = data->datas.find(CNObjsVecKey);
+  if (iter == data->datas.end()) return;
+  EncodeIPCObjects(cnstream::any_cast<CNObjsVec>(iter->second), &send_pkg->objects);
+
+  // objects follow the pixels in the slot, so the message is not larger with more objects or features
+  if (frame->shm_slot < 0 || !frame_ring_) return;
+  size_t offset = frame->GetBytes();
+  if (offset + send_pkg->objects.size() > frame_ring_->SlotSize()) return;
+  uint8_t* ptr = frame_ring_->Slot(frame->shm_slot, frame->shm_generation);
+  if (!ptr) return;
+  memcpy(ptr + offset, send_pkg->objects.data(), send_pkg->objects.size());
+  send_pkg->slot_objects_size = static_cast<uint32_t>(send_pkg->objects.size());
+  send_pkg->slot_objects_offset = offset;
+  send_pkg->objects.clear();
+}
+
+void IPCHandler::UnpackObjects(const FrameInfoPackage& recv_pkg, std::shared_ptr<CNFrameInfo> data) {
+  const char* buf = recv_pkg.objects.data();
+  size_t size = recv_pkg.objects.size();
+  if (recv_pkg.slot_objects_size) {
+    std::shared_ptr<ShmFrameRing> ring;
+    {
+      std::lock_guard<std::mutex> lock(mem_map_mutex_);
+      ring = frame_ring_;
+    }
+    // the slot is mapped with the pixels of the frame, and is valid until the frame is released
+    const uint8_t* ptr = ring ? ring->Slot(recv_pkg.shm_slot, recv_pkg.shm_generation) : nullptr;
+    if (!ptr || recv_pkg.slot_objects_offset + recv_pkg.slot_objects_size > ring->SlotSize()) {
+      LOG(ERROR) << "objects are out of frame ring slot " << recv_pkg.shm_slot << ", stream id: "
+                 << recv_pkg.stream_id << ", frame id: " << recv_pkg.frame_id;
+      return;
+    }
+    buf = reinterpret_cast<const char*>(ptr) + recv_pkg.slot_objects_offset;
+    size = recv_pkg.slot_objects_size;
+  }
+
+  CNObjsVec objs;
+  if (!DecodeIPCObjects(buf, size, &objs)) {
+    LOG(ERROR) << "decode objects failed, stream id: " << recv_pkg.stream_id << ", frame id: " << recv_pkg.frame_id;
+    return;
+  }
+  data->datas[CNObjsVecKey] = objs;
+}
+
 }  //  namespace cnstream
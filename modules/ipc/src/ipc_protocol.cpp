@@ -0,0 +1,475 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "ipc_protocol.hpp"
+
+#include <glog/logging.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cnstream {
+
+static_assert(sizeof(IPCMsgHeader) == 12, "IPCMsgHeader must be packed");
+static_assert(sizeof(IPCFramePayload) % 8 == 0, "IPCFramePayload must be packed");
+static_assert(sizeof(IPCFrameExtPayload) == 16, "IPCFrameExtPayload must be packed");
+static_assert(sizeof(IPCObjectRecord) == 48, "IPCObjectRecord must be packed");
+static_assert(sizeof(ReleaseRange) == 16, "ReleaseRange must be packed");
+static_assert(sizeof(IPCHelloExtPayload) == 16, "IPCHelloExtPayload must be packed");
+
+bool EncodeIPCMessage(const FrameInfoPackage& pkg, std::vector<char>* msg, size_t min_size, uint16_t version) {
+  if (!msg) return false;
+  const bool has_ext = PKG_DATA == pkg.pkg_type && version >= kIPCObjectsVersion;
+  // objects in the slot of frame ring are not copied to the message
+  const size_t objects_size = pkg.slot_objects_size ? 0 : pkg.objects.size();
+  size_t payload_size = 0;
+  switch (pkg.pkg_type) {
+    case PKG_DATA:
+    case PKG_RELEASE_MEM:
+      payload_size = sizeof(IPCFramePayload) + pkg.stream_id.size();
+      if (has_ext) payload_size += sizeof(IPCFrameExtPayload) + objects_size;
+      break;
+    case PKG_HELLO:
+      payload_size = sizeof(IPCHelloPayload);
+      if (version >= kIPCFanOutVersion) {
+        payload_size += sizeof(IPCHelloExtPayload) + pkg.ring_name.size();
+        for (const auto& stream_id : pkg.stream_ids) payload_size += sizeof(uint32_t) + stream_id.size();
+      }
+      break;
+    case PKG_RELEASE_BATCH:
+      payload_size = sizeof(IPCReleaseBatchPayload) + sizeof(ReleaseRange) * pkg.release_ranges.size();
+      break;
+    case PKG_EXIT:
+    case PKG_ERROR:
+      break;
+    default:
+      msg->clear();
+      return false;
+  }
+  size_t size = sizeof(IPCMsgHeader) + payload_size;
+  if (size < min_size) {
+    payload_size += min_size - size;
+    size = min_size;
+  }
+  msg->assign(size, 0);
+
+  IPCMsgHeader header;
+  memcpy(header.magic, kIPCMsgMagic, sizeof(header.magic));
+  header.version = version;
+  header.pkg_type = static_cast<int16_t>(pkg.pkg_type);
+  header.payload_size = static_cast<uint32_t>(payload_size);
+  char* dst = msg->data();
+  memcpy(dst, &header, sizeof(header));
+  dst += sizeof(header);
+
+  if (PKG_DATA == pkg.pkg_type || PKG_RELEASE_MEM == pkg.pkg_type) {
+    IPCFramePayload payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.frame_id = pkg.frame_id;
+    payload.stream_idx = pkg.stream_idx;
+    payload.stream_id_size = static_cast<uint32_t>(pkg.stream_id.size());
+    if (PKG_DATA == pkg.pkg_type) {
+      payload.timestamp = pkg.timestamp;
+      payload.flags = pkg.flags;
+      payload.mlu_mem_handle = reinterpret_cast<uintptr_t>(pkg.mlu_mem_handle);
+      payload.fmt = static_cast<int32_t>(pkg.fmt);
+      payload.width = pkg.width;
+      payload.height = pkg.height;
+      for (int i = 0; i < CN_MAX_PLANES; i++) payload.stride[i] = pkg.stride[i];
+      payload.dev_type = static_cast<int32_t>(pkg.ctx.dev_type);
+      payload.dev_id = pkg.ctx.dev_id;
+      payload.ddr_channel = pkg.ctx.ddr_channel;
+      payload.mem_map_type = static_cast<int32_t>(pkg.mem_map_type);
+      payload.shm_slot = pkg.shm_slot;
+      payload.shm_generation = pkg.shm_generation;
+    }
+    memcpy(dst, &payload, sizeof(payload));
+    dst += sizeof(payload);
+    memcpy(dst, pkg.stream_id.data(), pkg.stream_id.size());
+    dst += pkg.stream_id.size();
+    if (has_ext) {
+      IPCFrameExtPayload ext;
+      memset(&ext, 0, sizeof(ext));
+      if (!pkg.has_pixels) ext.ext_flags |= IPC_FRAME_NO_PIXELS;
+      if (pkg.slot_objects_size) {
+        ext.ext_flags |= IPC_FRAME_OBJECTS_IN_SLOT;
+        ext.objects_size = pkg.slot_objects_size;
+        ext.objects_offset = pkg.slot_objects_offset;
+      } else {
+        ext.objects_size = static_cast<uint32_t>(objects_size);
+      }
+      memcpy(dst, &ext, sizeof(ext));
+      memcpy(dst + sizeof(ext), pkg.objects.data(), objects_size);
+    }
+  } else if (PKG_HELLO == pkg.pkg_type) {
+    IPCHelloPayload payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.version = pkg.protocol_version;
+    memcpy(dst, &payload, sizeof(payload));
+    if (version >= kIPCFanOutVersion) {
+      dst += sizeof(payload);
+      IPCHelloExtPayload ext;
+      memset(&ext, 0, sizeof(ext));
+      ext.backpressure = static_cast<uint32_t>(pkg.backpressure);
+      ext.ring_name_size = static_cast<uint32_t>(pkg.ring_name.size());
+      ext.stream_id_num = static_cast<uint32_t>(pkg.stream_ids.size());
+      memcpy(dst, &ext, sizeof(ext));
+      dst += sizeof(ext);
+      memcpy(dst, pkg.ring_name.data(), pkg.ring_name.size());
+      dst += pkg.ring_name.size();
+      for (const auto& stream_id : pkg.stream_ids) {
+        uint32_t size = static_cast<uint32_t>(stream_id.size());
+        memcpy(dst, &size, sizeof(size));
+        memcpy(dst + sizeof(size), stream_id.data(), size);
+        dst += sizeof(size) + size;
+      }
+    }
+  } else if (PKG_RELEASE_BATCH == pkg.pkg_type) {
+    IPCReleaseBatchPayload payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.range_num = static_cast<uint32_t>(pkg.release_ranges.size());
+    memcpy(dst, &payload, sizeof(payload));
+    memcpy(dst + sizeof(payload), pkg.release_ranges.data(), sizeof(ReleaseRange) * pkg.release_ranges.size());
+  }
+  return true;
+}
+
+bool CheckIPCMsgHeader(const IPCMsgHeader& header) {
+  if (memcmp(header.magic, kIPCMsgMagic, sizeof(header.magic))) {
+    LOG(WARNING) << "ipc message magic is invalid.";
+    return false;
+  }
+  if (header.payload_size > kIPCMaxPayloadSize) {
+    LOG(WARNING) << "ipc message payload size " << header.payload_size << " is too large.";
+    return false;
+  }
+  return true;
+}
+
+static bool DecodeFrameExt(const IPCMsgHeader& header, const char* payload, const IPCFramePayload& frame,
+                           FrameInfoPackage* pkg) {
+  size_t offset = sizeof(frame) + frame.stream_id_size;
+  IPCFrameExtPayload ext;
+  if (header.payload_size - offset < sizeof(ext)) {
+    LOG(WARNING) << "ipc frame message extension is out of payload.";
+    return false;
+  }
+  memcpy(&ext, payload + offset, sizeof(ext));
+  offset += sizeof(ext);
+  pkg->has_pixels = !(ext.ext_flags & IPC_FRAME_NO_PIXELS);
+  if (ext.ext_flags & IPC_FRAME_OBJECTS_IN_SLOT) {
+    pkg->slot_objects_size = ext.objects_size;
+    pkg->slot_objects_offset = ext.objects_offset;
+  } else if (ext.objects_size) {
+    if (ext.objects_size > header.payload_size - offset) {
+      LOG(WARNING) << "ipc frame message objects are out of payload.";
+      return false;
+    }
+    pkg->objects.assign(payload + offset, ext.objects_size);
+  }
+  return true;
+}
+
+static bool DecodeHelloExt(const IPCMsgHeader& header, const char* payload, FrameInfoPackage* pkg) {
+  const char* end = payload + header.payload_size;
+  const char* ptr = payload + sizeof(IPCHelloPayload);
+  IPCHelloExtPayload ext;
+  if (static_cast<size_t>(end - ptr) < sizeof(ext)) {
+    LOG(WARNING) << "ipc hello message extension is out of payload.";
+    return false;
+  }
+  memcpy(&ext, ptr, sizeof(ext));
+  ptr += sizeof(ext);
+  if (ext.backpressure > IPC_BACKPRESSURE_DROP_OLDEST || static_cast<size_t>(end - ptr) < ext.ring_name_size) {
+    LOG(WARNING) << "ipc hello message backpressure or ring name is invalid.";
+    return false;
+  }
+  pkg->backpressure = static_cast<IPCBackpressure>(ext.backpressure);
+  pkg->ring_name.assign(ptr, ext.ring_name_size);
+  ptr += ext.ring_name_size;
+  pkg->stream_ids.clear();
+  for (uint32_t i = 0; i < ext.stream_id_num; ++i) {
+    uint32_t size = 0;
+    if (static_cast<size_t>(end - ptr) < sizeof(size)) break;
+    memcpy(&size, ptr, sizeof(size));
+    ptr += sizeof(size);
+    if (static_cast<size_t>(end - ptr) < size) break;
+    pkg->stream_ids.emplace_back(ptr, size);
+    ptr += size;
+  }
+  if (pkg->stream_ids.size() != ext.stream_id_num) {
+    LOG(WARNING) << "ipc hello message stream ids are out of payload.";
+    return false;
+  }
+  return true;
+}
+
+bool DecodeIPCMessage(const IPCMsgHeader& header, const char* payload, FrameInfoPackage* pkg) {
+  if (!pkg || (header.payload_size && !payload)) return false;
+  if (header.pkg_type < PKG_DATA || header.pkg_type > PKG_RELEASE_BATCH) {
+    LOG(WARNING) << "ipc message type " << header.pkg_type << " is unknown.";
+    return false;
+  }
+  pkg->pkg_type = PkgType(header.pkg_type);
+  switch (pkg->pkg_type) {
+    case PKG_DATA:
+    case PKG_RELEASE_MEM: {
+      IPCFramePayload frame;
+      if (header.payload_size < sizeof(frame)) {
+        LOG(WARNING) << "ipc frame message payload is too short.";
+        return false;
+      }
+      memcpy(&frame, payload, sizeof(frame));
+      if (frame.stream_id_size > header.payload_size - sizeof(frame)) {
+        LOG(WARNING) << "ipc frame message stream id is out of payload.";
+        return false;
+      }
+      pkg->stream_id.assign(payload + sizeof(frame), frame.stream_id_size);
+      pkg->stream_idx = frame.stream_idx;
+      pkg->frame_id = frame.frame_id;
+      if (PKG_DATA == pkg->pkg_type) {
+        pkg->timestamp = frame.timestamp;
+        pkg->flags = frame.flags;
+        pkg->mlu_mem_handle = reinterpret_cast<void*>(static_cast<uintptr_t>(frame.mlu_mem_handle));
+        pkg->fmt = CNDataFormat(frame.fmt);
+        pkg->width = frame.width;
+        pkg->height = frame.height;
+        for (int i = 0; i < CN_MAX_PLANES; i++) pkg->stride[i] = frame.stride[i];
+        pkg->ctx.dev_type = DevContext::DevType(frame.dev_type);
+        pkg->ctx.dev_id = frame.dev_id;
+        pkg->ctx.ddr_channel = frame.ddr_channel;
+        pkg->mem_map_type = MemMapType(frame.mem_map_type);
+        pkg->shm_slot = frame.shm_slot;
+        pkg->shm_generation = frame.shm_generation;
+        pkg->has_pixels = true;
+        pkg->objects.clear();
+        pkg->slot_objects_size = 0;
+        pkg->slot_objects_offset = 0;
+        if (header.version >= kIPCObjectsVersion && !DecodeFrameExt(header, payload, frame, pkg)) return false;
+      }
+    } break;
+    case PKG_HELLO: {
+      IPCHelloPayload hello;
+      if (header.payload_size < sizeof(hello)) {
+        LOG(WARNING) << "ipc hello message payload is too short.";
+        return false;
+      }
+      memcpy(&hello, payload, sizeof(hello));
+      pkg->protocol_version = hello.version;
+      if (header.version >= kIPCFanOutVersion && !DecodeHelloExt(header, payload, pkg)) return false;
+    } break;
+    case PKG_RELEASE_BATCH: {
+      IPCReleaseBatchPayload batch;
+      if (header.payload_size < sizeof(batch)) {
+        LOG(WARNING) << "ipc release batch message payload is too short.";
+        return false;
+      }
+      memcpy(&batch, payload, sizeof(batch));
+      if (batch.range_num > (header.payload_size - sizeof(batch)) / sizeof(ReleaseRange)) {
+        LOG(WARNING) << "ipc release batch message ranges are out of payload.";
+        return false;
+      }
+      pkg->release_ranges.resize(batch.range_num);
+      memcpy(pkg->release_ranges.data(), payload + sizeof(batch), sizeof(ReleaseRange) * batch.range_num);
+    } break;
+    default:
+      break;
+  }
+  return true;
+}
+
+void AddReleasedFrame(std::vector<ReleaseRange>* ranges, uint32_t stream_idx, uint64_t frame_id) {
+  if (!ranges) return;
+  // ranges are few, the latest ones are most likely to be extended
+  for (auto iter = ranges->rbegin(); iter != ranges->rend(); ++iter) {
+    if (iter->stream_idx != stream_idx) continue;
+    if (iter->first_frame_id + iter->frame_num == frame_id) {
+      iter->frame_num++;
+      return;
+    }
+    if (iter->first_frame_id == frame_id + 1) {
+      iter->first_frame_id = frame_id;
+      iter->frame_num++;
+      return;
+    }
+  }
+  ranges->push_back({stream_idx, 1, frame_id});
+}
+
+namespace {
+
+class ObjectsWriter {
+ public:
+  explicit ObjectsWriter(std::string* buf) : buf_(buf) {}
+  void Write(const void* data, size_t size) { buf_->append(reinterpret_cast<const char*>(data), size); }
+  template <typename T>
+  void Write(const T& value) { Write(&value, sizeof(value)); }
+  void WriteString(const std::string& str) { Write(str.data(), str.size()); }
+
+ private:
+  std::string* buf_;
+};
+
+class ObjectsReader {
+ public:
+  ObjectsReader(const char* buf, size_t size) : cur_(buf), end_(buf + size) {}
+  bool Read(void* data, size_t size) {
+    if (static_cast<size_t>(end_ - cur_) < size) return false;
+    memcpy(data, cur_, size);
+    cur_ += size;
+    return true;
+  }
+  template <typename T>
+  bool Read(T* value) { return Read(value, sizeof(*value)); }
+  bool ReadString(uint32_t size, std::string* str) {
+    if (static_cast<size_t>(end_ - cur_) < size) return false;
+    str->assign(cur_, size);
+    cur_ += size;
+    return true;
+  }
+
+ private:
+  const char* cur_;
+  const char* end_;
+};
+
+}  // namespace
+
+void EncodeIPCObjects(const CNObjsVec& objs, std::string* buf) {
+  if (!buf) return;
+  buf->clear();
+  ObjectsWriter writer(buf);
+  IPCObjectsHeader header = {static_cast<uint32_t>(objs.size()), 0};
+  writer.Write(header);
+  for (const auto& obj : objs) {
+    auto attributes = obj->GetAttributes();
+    auto extra_attributes = obj->GetExtraAttributes();
+    auto features = obj->GetFeatures();
+    const std::string class_id = obj->GetClassIdStr();
+    const std::string track_id = obj->GetTrackIdStr();
+    IPCObjectRecord record;
+    record.class_id = obj->GetClassId();
+    record.track_id = obj->GetTrackId();
+    record.score = obj->score;
+    record.bbox[0] = obj->bbox.x;
+    record.bbox[1] = obj->bbox.y;
+    record.bbox[2] = obj->bbox.w;
+    record.bbox[3] = obj->bbox.h;
+    record.id_size = static_cast<uint32_t>(class_id.size());
+    record.track_id_size = static_cast<uint32_t>(track_id.size());
+    record.attr_num = static_cast<uint32_t>(attributes.size());
+    record.extra_attr_num = static_cast<uint32_t>(extra_attributes.size());
+    record.feature_num = static_cast<uint32_t>(features.size());
+    writer.Write(record);
+    writer.WriteString(class_id);
+    writer.WriteString(track_id);
+    for (const auto& attr : attributes) {
+      IPCObjectAttr value = {static_cast<uint32_t>(attr.first.size()), attr.second.id, attr.second.value,
+                             attr.second.score};
+      writer.Write(value);
+      writer.WriteString(attr.first);
+    }
+    for (const auto& attr : extra_attributes) {
+      writer.Write(static_cast<uint32_t>(attr.first.size()));
+      writer.Write(static_cast<uint32_t>(attr.second.size()));
+      writer.WriteString(attr.first);
+      writer.WriteString(attr.second);
+    }
+    for (const auto& feature : features) {
+      writer.Write(static_cast<uint32_t>(feature.first.size()));
+      writer.Write(static_cast<uint32_t>(feature.second.size()));
+      writer.WriteString(feature.first);
+      writer.Write(feature.second.data(), feature.second.size() * sizeof(float));
+    }
+  }
+}
+
+bool DecodeIPCObjects(const char* buf, size_t size, CNObjsVec* objs) {
+  if (!buf || !objs) return false;
+  objs->clear();
+  ObjectsReader reader(buf, size);
+  IPCObjectsHeader header;
+  if (!reader.Read(&header)) return false;
+  // each object takes a record at least, a corrupted number never allocates much
+  if (header.object_num > size / sizeof(IPCObjectRecord)) return false;
+  objs->reserve(header.object_num);
+  for (uint32_t i = 0; i < header.object_num; ++i) {
+    IPCObjectRecord record;
+    if (!reader.Read(&record)) return false;
+    std::shared_ptr<CNInferObject> obj = std::make_shared<CNInferObject>();
+    obj->score = record.score;
+    obj->bbox.x = record.bbox[0];
+    obj->bbox.y = record.bbox[1];
+    obj->bbox.w = record.bbox[2];
+    obj->bbox.h = record.bbox[3];
+    std::string class_id, track_id;
+    if (!reader.ReadString(record.id_size, &class_id) || !reader.ReadString(record.track_id_size, &track_id)) {
+      return false;
+    }
+    // the strings are sent as they are, ids like "007" or "12abc" do not survive formatting the integers
+    if (record.id_size > 0) {
+      obj->SetClassId(class_id);
+    } else if (record.class_id != -1) {
+      obj->SetClassId(record.class_id);
+    }
+    if (record.track_id_size > 0) {
+      obj->SetTrackId(track_id);
+    } else if (record.track_id != -1) {
+      obj->SetTrackId(record.track_id);
+    }
+    for (uint32_t j = 0; j < record.attr_num; ++j) {
+      IPCObjectAttr value;
+      std::string key;
+      if (!reader.Read(&value) || !reader.ReadString(value.key_size, &key)) return false;
+      CNInferAttr attr;
+      attr.id = value.id;
+      attr.value = value.value;
+      attr.score = value.score;
+      obj->AddAttribute(key, attr);
+    }
+    for (uint32_t j = 0; j < record.extra_attr_num; ++j) {
+      uint32_t key_size, value_size;
+      std::string key, value;
+      if (!reader.Read(&key_size) || !reader.Read(&value_size) || !reader.ReadString(key_size, &key) ||
+          !reader.ReadString(value_size, &value)) {
+        return false;
+      }
+      obj->AddExtraAttribute(key, value);
+    }
+    for (uint32_t j = 0; j < record.feature_num; ++j) {
+      uint32_t key_size, dim;
+      std::string key;
+      if (!reader.Read(&key_size) || !reader.Read(&dim) || !reader.ReadString(key_size, &key) ||
+          dim > size / sizeof(float)) {
+        return false;
+      }
+      CNInferFeature feature(dim);
+      if (!reader.Read(feature.data(), dim * sizeof(float))) return false;
+      obj->AddFeature(key, feature);
+    }
+    objs->push_back(obj);
+  }
+  return true;
+}
+
+}  //  namespace cnstream
@@ -0,0 +1,192 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_IPC_PROTOCOL_HPP_
+#define MODULES_IPC_PROTOCOL_HPP_
+
+/**
+ *  Binary messages between ModuleIPC processes.
+ *
+ *  A message is an IPCMsgHeader followed by payload_size bytes of payload, in the byte order of the host, as both
+ *  processes are on the same host. Payload of data and release packages is IPCFramePayload followed by the stream
+ *  id, payload of hello package is IPCHelloPayload, exit and error packages have no payload.
+ *
+ *  Since version 4, hello payload is followed by IPCHelloExtPayload, the ring name of client, and the stream ids
+ *  server receives, each one is its size (uint32_t) and the id. A client sends frames to several servers, and the
+ *  servers map the frame ring of the client by the ring name.
+ *
+ *  Since version 3, releases of frames queued together are sent as one release batch package, its payload is
+ *  IPCReleaseBatchPayload followed by range_num ReleaseRange.
+ *
+ *  Since version 2, the stream id of data package is followed by IPCFrameExtPayload and the objects of the frame
+ *  encoded by EncodeIPCObjects, unless the objects are in the slot of frame ring after the pixels. The objects are:
+ *    IPCObjectsHeader
+ *    for each object: IPCObjectRecord, id, track_id,
+ *                     for each attribute: IPCObjectAttr, key,
+ *                     for each extra attribute: key size, value size (both uint32_t), key, value,
+ *                     for each feature: key size, dimension (both uint32_t), key, values (float).
+ *
+ *  The first bytes of a message are kIPCMsgMagic, which is never '{' that legacy json packages of SOCK_BUFSIZE bytes
+ *  start with, so a receiver tells both apart by the first byte. Binary messages are only sent after the peer replies
+ *  the hello package, see IPCHandler.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cnstream_frame_va.hpp"
+#include "ipc_handler.hpp"
+
+namespace cnstream {
+
+static constexpr char kIPCMsgMagic[4] = {'C', 'N', 'I', 'P'};
+static constexpr uint16_t kIPCProtocolVersion = 4;      ///< version of binary messages, 0 is legacy json
+static constexpr uint16_t kIPCObjectsVersion = 2;       ///< the first version with objects and frames without pixels
+static constexpr uint16_t kIPCReleaseBatchVersion = 3;  ///< the first version with release batch package
+static constexpr uint16_t kIPCFanOutVersion = 4;        ///< the first version with ring name, streams and backpressure
+static constexpr uint32_t kIPCMaxPayloadSize = 1 << 24;  ///< a larger payload means a broken connection
+
+struct IPCMsgHeader {
+  char magic[4];
+  uint16_t version;  ///< protocol version of the sender when the message is sent
+  int16_t pkg_type;  ///< PkgType
+  uint32_t payload_size;
+};
+
+struct IPCFramePayload {
+  uint64_t frame_id;
+  int64_t timestamp;
+  uint64_t flags;
+  uint64_t mlu_mem_handle;
+  uint32_t stream_idx;
+  int32_t fmt;
+  int32_t width;
+  int32_t height;
+  int32_t stride[CN_MAX_PLANES];
+  int32_t dev_type;
+  int32_t dev_id;
+  int32_t ddr_channel;
+  int32_t mem_map_type;
+  int32_t shm_slot;
+  uint32_t shm_generation;
+  uint32_t stream_id_size;
+  uint32_t reserved;
+};
+
+enum IPCFrameExtFlag {
+  IPC_FRAME_NO_PIXELS = 1 << 0,        ///< only metadata is sent, pixels are not in shared memory
+  IPC_FRAME_OBJECTS_IN_SLOT = 1 << 1,  ///< objects are in the slot of frame ring, at objects_offset
+};
+
+struct IPCFrameExtPayload {
+  uint32_t ext_flags;     ///< IPCFrameExtFlag
+  uint32_t objects_size;  ///< size of encoded objects, 0 if the frame has no objects
+  uint64_t objects_offset;
+};
+
+struct IPCObjectsHeader {
+  uint32_t object_num;
+  uint32_t reserved;
+};
+
+struct IPCObjectRecord {
+  int32_t class_id;
+  int32_t track_id;
+  float score;
+  float bbox[4];
+  uint32_t id_size;
+  uint32_t track_id_size;
+  uint32_t attr_num;
+  uint32_t extra_attr_num;
+  uint32_t feature_num;
+};
+
+struct IPCObjectAttr {
+  uint32_t key_size;
+  int32_t id;
+  int32_t value;
+  float score;
+};
+
+struct IPCReleaseBatchPayload {
+  uint32_t range_num;
+  uint32_t reserved;
+};
+
+struct IPCHelloPayload {
+  uint16_t version;  ///< the highest version supported by the sender
+  uint16_t reserved[3];
+};
+
+struct IPCHelloExtPayload {
+  uint32_t backpressure;  ///< IPCBackpressure of server
+  uint32_t ring_name_size;
+  uint32_t stream_id_num;  ///< 0 if server receives all streams
+  uint32_t reserved;
+};
+
+/**
+ *  @brief  Encode package to a binary message.
+ *  @param  min_size Pad the message with zeros to min_size bytes, e.g. SOCK_BUFSIZE for a hello package read by
+ *          a legacy peer.
+ *  @param  version Protocol version negotiated with the peer, objects and metadata only frames need
+ *          kIPCObjectsVersion.
+ *  @return Return false if package type is invalid.
+ */
+bool EncodeIPCMessage(const FrameInfoPackage& pkg, std::vector<char>* msg, size_t min_size = 0,
+                      uint16_t version = kIPCProtocolVersion);
+
+/**
+ *  @brief  Check the header of binary message.
+ *  @return Return false if magic or payload size is invalid.
+ */
+bool CheckIPCMsgHeader(const IPCMsgHeader& header);
+
+/**
+ *  @brief  Decode payload of binary message to package, fields are read from payload directly.
+ *          Payload longer than known by this version is accepted, trailing bytes are ignored.
+ *  @return Return false if payload is too short for the package type.
+ */
+bool DecodeIPCMessage(const IPCMsgHeader& header, const char* payload, FrameInfoPackage* pkg);
+
+/**
+ *  @brief  Add a released frame to ranges, the range of the stream next to the frame is extended if there is one,
+ *          so frames released in order, or nearly in order, take a range for each stream.
+ *  @return Void.
+ */
+void AddReleasedFrame(std::vector<ReleaseRange>* ranges, uint32_t stream_idx, uint64_t frame_id);
+
+/**
+ *  @brief  Encode objects to compact binary, fixed-size fields are copied as they are.
+ *  @return Void.
+ */
+void EncodeIPCObjects(const CNObjsVec& objs, std::string* buf);
+
+/**
+ *  @brief  Decode objects encoded by EncodeIPCObjects, from a message or a slot of frame ring.
+ *  @return Return false if the objects are truncated.
+ */
+bool DecodeIPCObjects(const char* buf, size_t size, CNObjsVec* objs);
+
+}  //  namespace cnstream
+
+#endif
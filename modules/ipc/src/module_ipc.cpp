@@ -21,7 +21,9 @@
 
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "client_handler.hpp"
 #include "device/mlu_context.h"
@@ -42,17 +44,42 @@ std::shared_ptr<IPCHandler> CreateIPCHandler(const IPCType& type, ModuleIPC* ipc
 
   return nullptr;
 }
+
+static std::vector<std::string> StringSplit(const std::string& s, char c) {
+  std::stringstream ss(s);
+  std::string piece;
+  std::vector<std::string> result;
+  while (std::getline(ss, piece, c)) {
+    result.push_back(piece);
+  }
+  return result;
+}
+
 class ModuleIpcPrivate {};
 
 ModuleIPC::ModuleIPC(const std::string& name) : Module(name) {
   param_register_.SetModuleDesc("ModuleIPC is a module for ipc support with socket.");
   param_register_.Register("ipc_type", "Identify ModuleIPC actor as client or server.");
   param_register_.Register("memmap_type", "Identify memory map type inter process communication.");
-  param_register_.Register("socket_address", "Identify socket communicate path.");
+  param_register_.Register("socket_address",
+                           "Identify socket communicate path. Client sends frames to several servers with paths "
+                           "separated by comma.");
   // only support the same device with client when use mlu mem map
   param_register_.Register("device_id", "Identify device id for server processor.");
   param_register_.Register("max_cachedframe_size",
                            "Identify max size of cached processed frame with shared memory for client.");
+  param_register_.Register("shm_slot_size",
+                           "Identify slot size in bytes of shared memory frame ring for client, frames larger than it "
+                           "are passed with shared memory of each frame. The size of the first frame by default.");
+  param_register_.Register("metadata_only",
+                           "Identify whether client sends only metadata of frames, e.g. objects, without pixels. "
+                           "false by default.");
+  param_register_.Register("stream_ids",
+                           "Identify ids of streams server receives, separated by comma. All streams by default.");
+  param_register_.Register("backpressure",
+                           "Identify how client sends frames when server has max cached frames not released, "
+                           "block or drop_oldest. block by default, client waits for server. drop_oldest, client "
+                           "keeps the latest frame of each stream for server and drops the older one.");
 }
 
 bool ModuleIPC::Open(ModuleParamSet paramSet) {
@@ -70,32 +97,66 @@ bool ModuleIPC::Open(ModuleParamSet paramSet) {
     return false;
   }
 
-  ipc_handler_ = CreateIPCHandler(type, this);
-  if (nullptr == ipc_handler_) {
-    LOG(ERROR) << "[ModuleIPC], create ipc handler failed\n";
-    return false;
-  }
+  // client sends frames to each server, servers receiving the same stream share the frame in shared memory
+  std::vector<std::string> socket_addresses = StringSplit(paramSet["socket_address"], ',');
+  ipc_handlers_.clear();
+  for (const auto& socket_address : socket_addresses) {
+    std::shared_ptr<IPCHandler> handler = CreateIPCHandler(type, this);
+    if (nullptr == handler) {
+      LOG(ERROR) << "[ModuleIPC], create ipc handler failed\n";
+      return false;
+    }
 
-  ipc_handler_->SetSocketAddress(paramSet["socket_address"]);
-  if (type == IPC_CLIENT && paramSet.find("max_cachedframe_size") != paramSet.end()) {
-    ipc_handler_->SetMaxCachedFrameSize(std::stoi(paramSet["max_cachedframe_size"]));
+    handler->SetSocketAddress(socket_address);
+    if (type == IPC_CLIENT && paramSet.find("max_cachedframe_size") != paramSet.end()) {
+      handler->SetMaxCachedFrameSize(std::stoi(paramSet["max_cachedframe_size"]));
+    }
+    if (type == IPC_CLIENT && paramSet.find("shm_slot_size") != paramSet.end()) {
+      handler->SetShmSlotSize(std::stoul(paramSet["shm_slot_size"]));
+    }
+    if (type == IPC_CLIENT && paramSet.find("metadata_only") != paramSet.end()) {
+      handler->SetMetadataOnly(paramSet["metadata_only"] == "true");
+    }
+    if (type == IPC_SERVER && paramSet.find("stream_ids") != paramSet.end()) {
+      handler->SetStreamIds(StringSplit(paramSet["stream_ids"], ','));
+    }
+    if (type == IPC_SERVER && paramSet.find("backpressure") != paramSet.end()) {
+      handler->SetBackpressure(paramSet["backpressure"] == "drop_oldest" ? IPC_BACKPRESSURE_DROP_OLDEST
+                                                                         : IPC_BACKPRESSURE_BLOCK);
+    }
+    if (paramSet.find("device_id") != paramSet.end()) {
+      handler->SetDeviceId(std::stoi(paramSet["device_id"]));
+    }
+
+    if (paramSet["memmap_type"] == "cpu") {
+      handler->SetMemmapType(MEMMAP_CPU);
+    } else if (paramSet["memmap_type"] == "mlu") {
+      handler->SetMemmapType(MEMMAP_MLU);
+    } else {
+      LOG(ERROR) << "[ModuleIPC], memmap_type is invalid.";
+      return false;
+    }
+    ipc_handlers_.push_back(handler);
   }
-  if (paramSet.find("device_id") != paramSet.end()) {
-    ipc_handler_->SetDeviceId(std::stoi(paramSet["device_id"]));
+  if (ipc_handlers_.empty()) {
+    LOG(ERROR) << "[ModuleIPC], socket_address is empty.";
+    return false;
   }
+  ipc_handler_ = ipc_handlers_.front();
 
-  if (paramSet["memmap_type"] == "cpu") {
-    ipc_handler_->SetMemmapType(MEMMAP_CPU);
-  } else if (paramSet["memmap_type"] == "mlu") {
-    ipc_handler_->SetMemmapType(MEMMAP_MLU);
-  } else {
-    LOG(ERROR) << "[ModuleIPC], memmap_type is invalid.";
-    return false;
+  if (IPC_CLIENT == type) {
+    auto first_handler = std::dynamic_pointer_cast<IPCClientHandler>(ipc_handler_);
+    std::shared_ptr<IPCFrameCache> frame_cache = first_handler->CreateFrameCache(ipc_handlers_.size());
+    for (auto& handler : ipc_handlers_) {
+      std::dynamic_pointer_cast<IPCClientHandler>(handler)->SetFrameCache(frame_cache);
+    }
   }
 
-  if (!ipc_handler_->Open()) {
-    LOG(ERROR) << "[ModuleIPC], open ipc handler failed\n";
-    return false;
+  for (auto& handler : ipc_handlers_) {
+    if (!handler->Open()) {
+      LOG(ERROR) << "[ModuleIPC], open ipc handler failed\n";
+      return false;
+    }
   }
 
   if (container_ && IPC_SERVER == type) {
@@ -106,13 +167,13 @@ bool ModuleIPC::Open(ModuleParamSet paramSet) {
 }
 
 void ModuleIPC::Close() {
-  if (ipc_handler_) {
+  for (auto& handler : ipc_handlers_) {
     // send package with exit info to client
-    if (IPC_SERVER == ipc_handler_->GetType()) {
-      ipc_handler_->PreparePackageToSend(PkgType::PKG_EXIT, nullptr);
+    if (IPC_SERVER == handler->GetType()) {
+      handler->PreparePackageToSend(PkgType::PKG_EXIT, nullptr);
     }
 
-    ipc_handler_->Close();
+    handler->Close();
   }
 }
 
@@ -120,15 +181,20 @@ int ModuleIPC::Process(std::shared_ptr<CNFrameInfo> data) {
   if (!data) return -1;
   if (ipc_handler_->GetType() != IPC_CLIENT) return -1;
 
-  auto handler = std::dynamic_pointer_cast<IPCClientHandler>(ipc_handler_);
-  if (!data->IsEos()) {
-    CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
-    frame->CopyToSharedMem(handler->GetMemMapType(), data->stream_id);
-    handler->CacheProcessedData(data);
+  std::vector<std::shared_ptr<IPCClientHandler>> handlers;
+  for (auto& it : ipc_handlers_) {
+    auto handler = std::dynamic_pointer_cast<IPCClientHandler>(it);
+    if (handler->IsSubscribed(data->stream_id)) handlers.push_back(handler);
+  }
+  if (!handlers.empty() && !data->IsEos() && !ipc_handler_->IsMetadataOnly()) {
+    // frame is copied to shared memory once, and released after all servers receiving it release it
+    handlers.front()->CopyToSharedMem(data);
+    handlers.front()->GetFrameCache()->Add(data, handlers.size());
   }
 
-  handler->PreparePackageToSend(PkgType::PKG_DATA, data);
-  handler->Send();
+  for (auto& handler : handlers) {
+    handler->SendFrame(data);
+  }
   this->TransmitData(data);
   return 0;
 }
@@ -163,8 +229,36 @@ bool ModuleIPC::CheckParamSet(const ModuleParamSet& paramSet) const {
     LOG(WARNING) << "[ModuleIPC], device id is not set, will use device info in CNFrameInfo.";
   }
 
+  if (paramSet.find("metadata_only") != paramSet.end() && paramSet.at("metadata_only") != "true" &&
+      paramSet.at("metadata_only") != "false") {
+    LOG(ERROR) << "[ModuleIPC], metadata_only must be true or false.";
+    ret = false;
+  }
+
+  if (paramSet.find("backpressure") != paramSet.end() && paramSet.at("backpressure") != "block" &&
+      paramSet.at("backpressure") != "drop_oldest") {
+    LOG(ERROR) << "[ModuleIPC], backpressure must be block or drop_oldest.";
+    ret = false;
+  }
+
+  if (paramSet.find("socket_address") != paramSet.end()) {
+    const std::string& socket_address = paramSet.at("socket_address");
+    if (paramSet.find("ipc_type") != paramSet.end() && paramSet.at("ipc_type") == "server" &&
+        socket_address.find(',') != std::string::npos) {
+      LOG(ERROR) << "[ModuleIPC], server listens on one socket_address.";
+      ret = false;
+    }
+    for (const auto& address : StringSplit(socket_address, ',')) {
+      if (address.empty()) {
+        LOG(ERROR) << "[ModuleIPC], socket_address is empty.";
+        ret = false;
+        break;
+      }
+    }
+  }
+
   std::string err_msg;
-  if (!checker.IsNum({"device_id", "max_cachedframe_size"}, paramSet, err_msg)) {
+  if (!checker.IsNum({"device_id", "max_cachedframe_size", "shm_slot_size"}, paramSet, err_msg)) {
     LOG(ERROR) << err_msg;
     ret = false;
   }
@@ -187,6 +281,8 @@ void ModuleIPC::PostFrameToReleaseMem(std::shared_ptr<CNFrameInfo> data) {
   // post frame info to communicate process(client), to release shared memory
   if (IPC_SERVER == ipc_handler_->GetType() && !data->IsEos()) {
     CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+    // frames of metadata only have no planes, and are not cached by client
+    if (!frame->data[0]) return;
     frame->UnMapSharedMem(ipc_handler_->GetMemMapType());
     ipc_handler_->PreparePackageToSend(PkgType::PKG_RELEASE_MEM, data);
   }
@@ -18,11 +18,14 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "cnstream_frame.hpp"
 #include "device/mlu_context.h"
+#include "ipc_protocol.hpp"
 #include "module_ipc.hpp"
 #include "perf_manager.hpp"
 #include "server_handler.hpp"
@@ -65,6 +68,7 @@ void IPCServerHandler::Close() {
   if (listen_thread_.joinable()) {
     listen_thread_.join();
   }
+  WakeThreads();
 
   if (recv_thread_.joinable()) {
     recv_thread_.join();
@@ -87,18 +91,17 @@ void IPCServerHandler::RecvPackageLoop() {
   std::string recv_err_msg;
   size_t eos_chn_cnt = 0;
   while (is_running_.load()) {
-    if (server_handle_.RecvData(recv_buf_, sizeof(recv_buf_)) != sizeof(recv_buf_)) {
+    FrameInfoPackage recv_pkg;
+    if (!RecvPackage(&server_handle_, &recv_pkg)) {
       recv_err_msg = "server receive message error";
       LOG(ERROR) << recv_err_msg;
       server_handle_.Close();
       is_connected_.store(false);
+      WakeThreads();
       ipc_module_->PostEvent(EventType::EVENT_ERROR, recv_err_msg);
       break;
     }
-    FrameInfoPackage recv_pkg;
-    std::string recv_str(recv_buf_);
-    memset(recv_buf_, 0, sizeof(recv_buf_));
-    if (!ParseStringToPackage(recv_str, &recv_pkg)) {
+    if (PKG_INVALID == recv_pkg.pkg_type) {
       LOG(WARNING) << "server receive parse error";
       continue;
     }
@@ -125,6 +128,20 @@ void IPCServerHandler::RecvPackageLoop() {
         }
         break;
 
+      case PKG_HELLO: {
+        // reply with the highest version of server, and both use the lower one of client and server
+        protocol_version_.store(std::min(kIPCProtocolVersion, recv_pkg.protocol_version));
+        LOG(INFO) << "server use ipc protocol version " << protocol_version_.load();
+        // frame ring of client is mapped at the first frame in it, after hello
+        if (!recv_pkg.ring_name.empty()) ring_name_ = recv_pkg.ring_name;
+        FrameInfoPackage reply;
+        reply.pkg_type = PKG_HELLO;
+        reply.protocol_version = kIPCProtocolVersion;
+        reply.stream_ids = stream_ids_;
+        reply.backpressure = backpressure_;
+        send_pkgq_.Push(reply);
+      } break;
+
       case PKG_ERROR:
         recv_err_msg = "Server receive error info from communicate process, process id: " + std::to_string(getpid());
         ipc_module_->PostEvent(EventType::EVENT_ERROR, recv_err_msg);
@@ -140,15 +157,31 @@ void IPCServerHandler::RecvPackageLoop() {
 void IPCServerHandler::SendPackageLoop() {
   while (is_running_.load() && is_connected_.load()) {
     FrameInfoPackage send_pkg;
-    if (!send_pkgq_.WaitAndTryPop(send_pkg, std::chrono::milliseconds(10))) {
-      continue;
+    send_pkgq_.WaitAndPop(send_pkg);
+    if (PKG_INVALID == send_pkg.pkg_type) continue;
+
+    // releases queued while the last message is being sent go to the client in one release batch, without waiting
+    // for more, so a release is never delayed and messages are fewer as frame rate rises.
+    FrameInfoPackage next_pkg;
+    bool has_next = false;
+    if (PKG_RELEASE_MEM == send_pkg.pkg_type && protocol_version_.load() >= kIPCReleaseBatchVersion) {
+      FrameInfoPackage batch_pkg;
+      batch_pkg.pkg_type = PKG_RELEASE_BATCH;
+      AddReleasedFrame(&batch_pkg.release_ranges, send_pkg.stream_idx, send_pkg.frame_id);
+      while (batch_pkg.release_ranges.size() < kMaxReleaseRanges && send_pkgq_.TryPop(next_pkg)) {
+        if (PKG_RELEASE_MEM != next_pkg.pkg_type) {
+          has_next = PKG_INVALID != next_pkg.pkg_type;
+          break;
+        }
+        AddReleasedFrame(&batch_pkg.release_ranges, next_pkg.stream_idx, next_pkg.frame_id);
+      }
+      send_pkg = std::move(batch_pkg);
     }
 
-    std::string send_str;
-    SerializeToString(send_pkg, &send_str);
-    memset(send_buf_, 0, sizeof(send_buf_));
-    memcpy(send_buf_, send_str.c_str(), send_str.length());
-    if (server_handle_.SendData(send_buf_, sizeof(send_buf_)) != sizeof(send_buf_)) {
+    if (!SendPackage(&server_handle_, send_pkg)) {
+      LOG(WARNING) << " server send message to client failed.";
+    }
+    if (has_next && !SendPackage(&server_handle_, next_pkg)) {
       LOG(WARNING) << " server send message to client failed.";
     }
   }
@@ -162,13 +195,16 @@ void IPCServerHandler::ListenConnections() {
     } else {
       LOG(INFO) << "server listening, client connect succeed.";
       is_connected_.store(true);
-      send_thread_ = std::thread(&IPCServerHandler::SendPackageLoop, this);
-      recv_thread_ = std::thread(&IPCServerHandler::RecvPackageLoop, this);
-      // start send data thread for each stream_idx
+      // queues are created before the receive thread, which pushes data to them and wakes them on error
       for (size_t thr_idx = 0; thr_idx < SEND_THREAD_NUM; thr_idx++) {
         vec_recv_dataq_.emplace_back(new ThreadSafeQueue<FrameInfoPackage>);
+      }
+      // start send data thread for each stream_idx
+      for (size_t thr_idx = 0; thr_idx < SEND_THREAD_NUM; thr_idx++) {
         vec_process_thread_.push_back(std::thread(&IPCServerHandler::ProcessFrameInfoPackage, this, thr_idx));
       }
+      send_thread_ = std::thread(&IPCServerHandler::SendPackageLoop, this);
+      recv_thread_ = std::thread(&IPCServerHandler::RecvPackageLoop, this);
 
       server_handle_.CloseListen();
       CloseSemphore();
@@ -184,15 +220,16 @@ void IPCServerHandler::ProcessFrameInfoPackage(size_t thread_idx) {
     if (unit_test) continue;
 #endif
     FrameInfoPackage recv_pkg;
-    if (!vec_recv_dataq_[thread_idx]->WaitAndTryPop(recv_pkg, std::chrono::milliseconds(10))) {
-      continue;
-    }
+    vec_recv_dataq_[thread_idx]->WaitAndPop(recv_pkg);
 
+    // packages without stream id wake the thread to exit
     if (recv_pkg.stream_id.empty()) continue;
     std::shared_ptr<CNFrameInfo> data;
     while (true) {
       data = CNFrameInfo::Create(recv_pkg.stream_id);
       if (data.get() != nullptr) break;
+      // the stream reaches the flow depth of pipeline, wait for frames to be released, the same as sources
+      if (!is_running_.load() || !is_connected_.load()) return;
       std::this_thread::sleep_for(std::chrono::milliseconds(5));
     }
 
@@ -211,15 +248,18 @@ void IPCServerHandler::ProcessFrameInfoPackage(size_t thread_idx) {
   }
 }
 
+void IPCServerHandler::WakeThreads() {
+  FrameInfoPackage wake_pkg;
+  wake_pkg.pkg_type = PKG_INVALID;
+  send_pkgq_.Push(wake_pkg);
+  for (auto& it : vec_recv_dataq_) it->Push(wake_pkg);
+}
+
 #ifdef UNIT_TEST
 FrameInfoPackage IPCServerHandler::ReadReceivedData() {
   FrameInfoPackage pkg;
-  while (true) {
-    if (!recv_pkg_.WaitAndTryPop(pkg, std::chrono::milliseconds(10))) {
-      continue;
-    }
-    return pkg;
-  }
+  recv_pkg_.WaitAndPop(pkg);
+  return pkg;
 }
 
 #endif
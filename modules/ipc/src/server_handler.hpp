@@ -40,6 +40,7 @@ using CNPackageQueue = std::unique_ptr<ThreadSafeQueue<FrameInfoPackage>>;
  */
 class IPCServerHandler : public IPCHandler {
  public:
+  static constexpr size_t kMaxReleaseRanges = 256;  // ranges in a release batch, 4KB at most
   /**
    *  @brief  Constructed function.
    *  @param  Name : type - define client or server handler
@@ -107,6 +108,12 @@ class IPCServerHandler : public IPCHandler {
    */
   void ProcessFrameInfoPackage(size_t thread_idx);
 
+  /**
+   *  @brief  Wake send and process threads waiting for packages, after they are stopped or disconnected.
+   *  @return Void.
+   */
+  void WakeThreads();
+
  private:
   CNServer server_handle_;                       // server socket handle
   std::thread listen_thread_;                    // thread for listening connection
@@ -0,0 +1,192 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "shm_frame_ring.hpp"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <new>
+#include <string>
+
+namespace cnstream {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "generations in shared memory must be lock free");
+
+constexpr uint32_t ShmFrameRing::kMagic;
+constexpr uint32_t ShmFrameRing::kVersion;
+
+static constexpr size_t kSlotAlign = 64 * 1024;
+
+static size_t AlignUp(size_t value, size_t align) { return (value + align - 1) / align * align; }
+
+std::string ShmFrameRing::NameOf(const std::string& socket_address) {
+  std::string name = "/cnstream_ipc_ring_" + socket_address;
+  for (size_t i = 1; i < name.size(); ++i) {
+    if (name[i] == '/') name[i] = '_';
+  }
+  return name;
+}
+
+std::atomic<uint32_t>* ShmFrameRing::Generations() const {
+  return reinterpret_cast<std::atomic<uint32_t>*>(base_ + sizeof(Header));
+}
+
+bool ShmFrameRing::Create(const std::string& name, uint32_t slot_num, size_t slot_size) {
+  Close();
+  if (!slot_num || !slot_size) {
+    LOG(ERROR) << "[ShmFrameRing] slot num and slot size must be greater than 0.";
+    return false;
+  }
+  slot_size = AlignUp(slot_size, kSlotAlign);
+  size_t data_offset = AlignUp(sizeof(Header) + sizeof(std::atomic<uint32_t>) * slot_num, kSlotAlign);
+  size_t bytes = data_offset + slot_size * slot_num;
+
+  shm_unlink(name.c_str());
+  fd_ = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd_ < 0) {
+    LOG(ERROR) << "[ShmFrameRing] create " << name << " failed, error code: " << errno;
+    return false;
+  }
+  owner_ = true;
+  name_ = name;
+  if (ftruncate(fd_, bytes) == -1) {
+    LOG(ERROR) << "[ShmFrameRing] truncate " << name << " to " << bytes << " bytes failed, error code: " << errno;
+    Close();
+    return false;
+  }
+  void* ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (ptr == MAP_FAILED) {
+    LOG(ERROR) << "[ShmFrameRing] mmap " << name << " failed, error code: " << errno;
+    Close();
+    return false;
+  }
+  base_ = reinterpret_cast<uint8_t*>(ptr);
+  bytes_ = bytes;
+  slot_num_ = slot_num;
+  slot_size_ = slot_size;
+  data_ = base_ + data_offset;
+
+  std::atomic<uint32_t>* generations = Generations();
+  for (uint32_t i = 0; i < slot_num; ++i) new (&generations[i]) std::atomic<uint32_t>(0);
+  Header* header = reinterpret_cast<Header*>(base_);
+  header->version = kVersion;
+  header->slot_num = slot_num;
+  header->reserved = 0;
+  header->slot_size = slot_size;
+  header->data_offset = data_offset;
+  header->magic = kMagic;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_slots_.clear();
+  for (int i = static_cast<int>(slot_num) - 1; i >= 0; --i) free_slots_.push_back(i);
+  in_use_.assign(slot_num, false);
+  return true;
+}
+
+bool ShmFrameRing::Map(const std::string& name) {
+  Close();
+  fd_ = shm_open(name.c_str(), O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd_ < 0) {
+    LOG(ERROR) << "[ShmFrameRing] open " << name << " failed, error code: " << errno;
+    return false;
+  }
+  name_ = name;
+  struct stat st;
+  if (fstat(fd_, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    LOG(ERROR) << "[ShmFrameRing] " << name << " is not a frame ring.";
+    Close();
+    return false;
+  }
+  void* ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (ptr == MAP_FAILED) {
+    LOG(ERROR) << "[ShmFrameRing] mmap " << name << " failed, error code: " << errno;
+    Close();
+    return false;
+  }
+  base_ = reinterpret_cast<uint8_t*>(ptr);
+  bytes_ = st.st_size;
+
+  const Header* header = reinterpret_cast<const Header*>(base_);
+  if (header->magic != kMagic || header->version != kVersion || !header->slot_num ||
+      header->data_offset < sizeof(Header) + sizeof(std::atomic<uint32_t>) * header->slot_num ||
+      header->data_offset + header->slot_size * header->slot_num > bytes_) {
+    LOG(ERROR) << "[ShmFrameRing] " << name << " has invalid header, version " << header->version;
+    Close();
+    return false;
+  }
+  slot_num_ = header->slot_num;
+  slot_size_ = header->slot_size;
+  data_ = base_ + header->data_offset;
+  return true;
+}
+
+void ShmFrameRing::Close() {
+  if (base_) munmap(base_, bytes_);
+  if (fd_ >= 0) close(fd_);
+  if (owner_) shm_unlink(name_.c_str());
+  base_ = data_ = nullptr;
+  fd_ = -1;
+  owner_ = false;
+  bytes_ = slot_size_ = 0;
+  slot_num_ = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_slots_.clear();
+  in_use_.clear();
+}
+
+int ShmFrameRing::Acquire(uint32_t* generation) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!owner_ || free_slots_.empty()) return -1;
+  int slot = free_slots_.back();
+  free_slots_.pop_back();
+  in_use_[slot] = true;
+  // 0 is never a valid generation, so a zeroed packet never matches
+  uint32_t gen = Generations()[slot].load(std::memory_order_relaxed) + 1;
+  if (gen == 0) gen = 1;
+  Generations()[slot].store(gen, std::memory_order_release);
+  if (generation) *generation = gen;
+  return slot;
+}
+
+bool ShmFrameRing::Release(int slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!owner_ || slot < 0 || slot >= static_cast<int>(slot_num_) || !in_use_[slot]) return false;
+  in_use_[slot] = false;
+  free_slots_.push_back(slot);
+  return true;
+}
+
+uint8_t* ShmFrameRing::Slot(int slot, uint32_t generation) const {
+  if (!base_ || slot < 0 || slot >= static_cast<int>(slot_num_) || generation == 0) return nullptr;
+  if (Generations()[slot].load(std::memory_order_acquire) != generation) return nullptr;
+  return data_ + slot_size_ * slot;
+}
+
+uint32_t ShmFrameRing::FreeSlotNum() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_slots_.size();
+}
+
+}  // namespace cnstream
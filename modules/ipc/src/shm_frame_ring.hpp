@@ -0,0 +1,124 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_IPC_SHM_FRAME_RING_HPP_
+#define MODULES_IPC_SHM_FRAME_RING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * @brief A shared memory region of fixed size slots to pass frames between processes, created once per connection.
+ *
+ * The producer creates the region and owns the free slots. Acquire bumps the generation of a free slot, the producer
+ * writes the frame into it and sends the slot index with the generation to the consumer. The consumer maps the
+ * region once, and gets the slot by Slot, which returns nullptr if the generation does not match, e.g. the slot is
+ * reused or the region is recreated. When the consumer is done with the frame, the producer gets it back by Release.
+ *
+ * Generations are the only state shared by both processes, they are lock free atomics in the header of the region.
+ */
+class ShmFrameRing {
+ public:
+  static constexpr uint32_t kMagic = 0x434e5352;  // "CNSR"
+  static constexpr uint32_t kVersion = 1;
+
+  /**
+   * @brief Name of the ring of the connection with the socket address, it is a valid shm_open name.
+   */
+  static std::string NameOf(const std::string& socket_address);
+
+  ShmFrameRing() = default;
+  ~ShmFrameRing() { Close(); }
+  ShmFrameRing(const ShmFrameRing&) = delete;
+  ShmFrameRing& operator=(const ShmFrameRing&) = delete;
+
+  /**
+   * @brief Create the region as producer, an existing region of the same name is replaced.
+   *
+   * @param slot_size bytes of each slot, rounded up to 64KB
+   */
+  bool Create(const std::string& name, uint32_t slot_num, size_t slot_size);
+  /**
+   * @brief Map the region created by the producer as consumer.
+   */
+  bool Map(const std::string& name);
+  /**
+   * @brief Unmap the region, it is removed if it is created by this instance.
+   */
+  void Close();
+
+  /**
+   * @brief Take a free slot, only called by the producer.
+   *
+   * @return the slot index, or -1 if all slots are in use
+   */
+  int Acquire(uint32_t* generation);
+  /**
+   * @brief Give the slot back, only called by the producer.
+   *
+   * @return false if the slot is not in use
+   */
+  bool Release(int slot);
+
+  /**
+   * @brief Address of the slot, nullptr if the slot is out of range or the generation does not match.
+   */
+  uint8_t* Slot(int slot, uint32_t generation) const;
+
+  bool IsOpened() const { return base_ != nullptr; }
+  uint32_t SlotNum() const { return slot_num_; }
+  size_t SlotSize() const { return slot_size_; }
+  uint32_t FreeSlotNum() const;
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_num;
+    uint32_t reserved;
+    uint64_t slot_size;
+    uint64_t data_offset;
+  };
+
+  std::atomic<uint32_t>* Generations() const;
+
+  std::string name_;
+  bool owner_ = false;
+  int fd_ = -1;
+  uint8_t* base_ = nullptr;
+  size_t bytes_ = 0;
+  uint32_t slot_num_ = 0;
+  size_t slot_size_ = 0;
+  uint8_t* data_ = nullptr;
+
+  mutable std::mutex mutex_;
+  std::vector<int> free_slots_;  // producer only
+  std::vector<bool> in_use_;     // producer only
+};  // class ShmFrameRing
+
+}  // namespace cnstream
+
+#endif  // MODULES_IPC_SHM_FRAME_RING_HPP_
@@ -46,7 +46,7 @@ namespace cnstream {
 class CnOsd;
 
 /**
- * @brief Draw objects on image,output is bgr24 images
+ * @brief Draw objects on image, output is bgr24 images, or yuv420sp images when color_mode is nv
  */
 class Osd : public Module, public ModuleCreator<Osd> {
  public:
@@ -72,6 +72,7 @@ class Osd : public Module, public ModuleCreator<Osd> {
    * @param paramSet :
    * @verbatim
    *   label_path: label path
+   *   color_mode: bgr or nv, nv draws on NV12/NV21 frames directly without converting them to BGR24
    * @endverbatim
    *
    * @return if module open succeed
@@ -117,6 +118,7 @@ class Osd : public Module, public ModuleCreator<Osd> {
   std::vector<std::string> attr_keys_;
   std::string font_path_ = "";
   std::string logo_ = "";
+  std::string color_mode_ = "bgr";
   float text_scale_ = 1;
   float text_thickness_ = 1;
   float box_thickness_ = 1;
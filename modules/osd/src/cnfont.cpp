@@ -30,7 +30,12 @@
 #error OpenCV required
 #endif
 
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "glog/logging.h"
 
@@ -38,14 +43,94 @@ namespace cnstream {
 
 #ifdef HAVE_FREETYPE
 
-bool CnFont::Init(const std::string &font_path, float font_pixel, float space, float step) {
-if (FT_Init_FreeType(&m_library)) {
+std::shared_ptr<GlyphAtlas> GlyphAtlas::Get(const std::string &font_path, uint32_t font_pixel) {
+  static std::mutex atlases_mutex;
+  static std::map<std::pair<std::string, uint32_t>, std::weak_ptr<GlyphAtlas>> atlases;
+  std::lock_guard<std::mutex> lk(atlases_mutex);
+  auto key = std::make_pair(font_path, font_pixel);
+  std::shared_ptr<GlyphAtlas> atlas = atlases[key].lock();
+  if (!atlas) {
+    atlas.reset(new GlyphAtlas);
+    if (!atlas->Init(font_path, font_pixel)) {
+      atlases.erase(key);
+      return nullptr;
+    }
+    atlases[key] = atlas;
+  }
+  return atlas;
+}
+
+bool GlyphAtlas::Init(const std::string &font_path, uint32_t font_pixel) {
+  if (FT_Init_FreeType(&library_)) {
     LOG(ERROR) << "FreeType init errors";
+    library_ = nullptr;
     return false;
   }
-  if (FT_New_Face(m_library, font_path.c_str(), 0, &m_face)) {
-    FT_Done_FreeType(m_library);
-    LOG(ERROR) << "Can not create a font, please checkout the font path: " << m_library;
+  if (FT_New_Face(library_, font_path.c_str(), 0, &face_)) {
+    LOG(ERROR) << "Can not create a font, please checkout the font path: " << font_path;
+    face_ = nullptr;
+    return false;
+  }
+  // Set character size
+  FT_Set_Pixel_Sizes(face_, font_pixel, 0);
+  for (wchar_t wc = 0; wc < 128; ++wc) {
+    Rasterize(wc, &ascii_[wc]);
+  }
+  return true;
+}
+
+GlyphAtlas::~GlyphAtlas() {
+  if (face_) FT_Done_Face(face_);
+  if (library_) FT_Done_FreeType(library_);
+}
+
+void GlyphAtlas::Rasterize(wchar_t wc, Glyph* glyph) {
+  // Generate an anti-aliased bitmap of a font based on unicode
+  FT_UInt glyph_index = FT_Get_Char_Index(face_, wc);
+  if (FT_Load_Glyph(face_, glyph_index, FT_LOAD_DEFAULT) || FT_Render_Glyph(face_->glyph, FT_RENDER_MODE_NORMAL)) {
+    return;
+  }
+  const FT_Bitmap &bitmap = face_->glyph->bitmap;
+  glyph->rows = bitmap.rows;
+  glyph->width = bitmap.width;
+  glyph->alpha.resize(glyph->rows * glyph->width * 3);
+  uint8_t* dst = glyph->alpha.data();
+  for (int i = 0; i < glyph->rows; ++i) {
+    const uint8_t* src = bitmap.buffer + i * bitmap.pitch;
+    for (int j = 0; j < glyph->width; ++j) {
+      *dst++ = src[j];
+      *dst++ = src[j];
+      *dst++ = src[j];
+    }
+  }
+}
+
+const GlyphAtlas::Glyph* GlyphAtlas::GetGlyph(wchar_t wc) {
+  if (wc >= 0 && wc < 128) return &ascii_[wc];
+  std::lock_guard<std::mutex> lk(mutex_);
+  std::unique_ptr<Glyph> &glyph = glyphs_[wc];
+  if (!glyph) {
+    glyph.reset(new Glyph);
+    Rasterize(wc, glyph.get());
+  }
+  return glyph.get();
+}
+
+/* Blend one row of pixels: dst = dst * (1 - a) + color * a, a = alpha * opacity / 256.
+   All channels are laid out continuously, so the loop is vectorized by the compiler. */
+static void BlendRow(uint8_t* dst, const uint8_t* alpha, const uint8_t* color, int n, uint32_t opacity) {
+  for (int k = 0; k < n; ++k) {
+    uint32_t a = (alpha[k] * opacity) >> 8;
+    uint32_t t = dst[k] * (255 - a) + color[k] * a + 128;
+    dst[k] = static_cast<uint8_t>((t + (t >> 8)) >> 8);
+  }
+}
+
+bool CnFont::Init(const std::string &font_path, float font_pixel, float space, float step) {
+  font_path_ = font_path;
+  atlas_ = GlyphAtlas::Get(font_path_, static_cast<uint32_t>(font_pixel));
+  if (!atlas_) {
+    LOG(ERROR) << "Can not create a font, please checkout the font path: " << font_path;
     return false;
   }
   is_initialized_ = true;
@@ -59,12 +144,7 @@ if (FT_Init_FreeType(&m_library)) {
   return true;
 }
 
-CnFont::~CnFont() {
-  if (is_initialized_) {
-    FT_Done_Face(m_face);
-    FT_Done_FreeType(m_library);
-  }
-}
+CnFont::~CnFont() {}
 
 // Restore the original font Settings
 void CnFont::restoreFont(float font_pixel, float space, float step) {
@@ -83,8 +163,9 @@ void CnFont::restoreFont(float font_pixel, float space, float step) {
 
   m_fontDiaphaneity = 1.0;
 
-  // Set character size
-  FT_Set_Pixel_Sizes(m_face, static_cast<int>(m_fontSize.val[0]), 0);
+  // Switch to glyphs of the character size
+  std::shared_ptr<GlyphAtlas> atlas = GlyphAtlas::Get(font_path_, static_cast<uint32_t>(font_pixel));
+  if (atlas) atlas_ = atlas;
 }
 
 uint32_t CnFont::GetFontPixel() {
@@ -133,8 +214,9 @@ bool CnFont::GetTextSize(char* text, uint32_t* width, uint32_t* height) {
     LOG(ERROR) << " [CnFont] [GetTextSize] Please init CnFont first.";
     return false;
   }
-  wchar_t* w_str;
+  wchar_t* w_str = nullptr;
   ToWchar(text, w_str);
+  if (!w_str) return false;
 
   uint32_t w_char_width = 0, w_char_height = 0;
   double space = m_fontSize.val[0] * m_fontSize.val[1];
@@ -152,6 +234,7 @@ bool CnFont::GetTextSize(char* text, uint32_t* width, uint32_t* height) {
     }
     *width += sep;
   }
+  delete[] w_str;
   return true;
 }
 
@@ -161,15 +244,10 @@ void CnFont::GetWCharSize(wchar_t wc, uint32_t* width, uint32_t* height) {
     return;
   }
 
-  FT_UInt glyph_index = FT_Get_Char_Index(m_face, wc);
-  FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-  FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_MONO);
-
-  FT_GlyphSlot slot = m_face->glyph;
-
-  // height and width
-  *height = slot->bitmap.rows;
-  *width = slot->bitmap.width;
+  // height and width are cached with the glyph
+  const GlyphAtlas::Glyph* glyph = atlas_->GetGlyph(wc);
+  *height = glyph->rows;
+  *width = glyph->width;
 }
 
 int CnFont::putText(cv::Mat& img, char* text, cv::Point pos, cv::Scalar color) {
@@ -179,53 +257,53 @@ int CnFont::putText(cv::Mat& img, char* text, cv::Point pos, cv::Scalar color) {
     LOG(ERROR) << " [Osd] Please init CnFont first.";
     return -1;
   }
+  if (img.type() != CV_8UC3) {
+    LOG(ERROR) << " [Osd] Only BGR24 image is supported by CnFont.";
+    return -1;
+  }
 
-  wchar_t* w_str;
+  wchar_t* w_str = nullptr;
   ToWchar(text, w_str);
+  if (!w_str) return -1;
 
+  std::vector<uint8_t> color_row;
   for (int i = 0; w_str[i] != '\0'; ++i) {
-    putWChar(img, w_str[i], pos, color);
+    putWChar(img, w_str[i], pos, color, &color_row);
   }
+  delete[] w_str;
 
   return 0;
 }
 
 // Output the current character and update the m pos position
-void CnFont::putWChar(cv::Mat& img, wchar_t wc, cv::Point& pos, cv::Scalar color) {
-  // Generate a binary bitmap of a font based on unicode
-  FT_UInt glyph_index = FT_Get_Char_Index(m_face, wc);
-  FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-  FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_MONO);
-
-  FT_GlyphSlot slot = m_face->glyph;
+void CnFont::putWChar(cv::Mat& img, wchar_t wc, cv::Point& pos, const cv::Scalar& color,
+                      std::vector<uint8_t>* color_row) {
+  const GlyphAtlas::Glyph* glyph = atlas_->GetGlyph(wc);
 
   // Cols and rows
-  int rows = slot->bitmap.rows;
-  int cols = slot->bitmap.width;
-
-  for (int i = 0; i < rows; ++i) {
-    for (int j = 0; j < cols; ++j) {
-      int off = i * slot->bitmap.pitch + j / 8;
-      if (slot->bitmap.buffer[off] & (0xC0 >> (j % 8))) {
-        int r = pos.y - (rows - 1 - i);
-        int c = pos.x + j;
-
-        if (r >= 0 && r < img.rows && c >= 0 && c < img.cols) {
-          cv::Vec3b pixel = img.at<cv::Vec3b>(cv::Point(c, r));
-          cv::Scalar scalar = cv::Scalar(pixel.val[0], pixel.val[1], pixel.val[2]);
-
-          // Color fusion
-          float p = m_fontDiaphaneity;
-          for (int k = 0; k < 4; ++k) {
-            scalar.val[k] = scalar.val[k] * (1 - p) + color.val[k] * p;
-          }
-          img.at<cv::Vec3b>(cv::Point(c, r))[0] = (unsigned char)(scalar.val[0]);
-          img.at<cv::Vec3b>(cv::Point(c, r))[1] = (unsigned char)(scalar.val[1]);
-          img.at<cv::Vec3b>(cv::Point(c, r))[2] = (unsigned char)(scalar.val[2]);
-        }
-      }
+  int rows = glyph->rows;
+  int cols = glyph->width;
+
+  if (color_row->size() < static_cast<size_t>(cols * 3)) {
+    for (size_t k = color_row->size(); k < static_cast<size_t>(cols * 3); ++k) {
+      color_row->push_back(cv::saturate_cast<uint8_t>(color.val[k % 3]));
     }
   }
+
+  // Clip the glyph to the image
+  int c_begin = std::max(0, -pos.x);
+  int c_end = std::min(cols, img.cols - pos.x);
+  if (c_begin < c_end) {
+    uint32_t opacity = static_cast<uint32_t>(m_fontDiaphaneity * 256);
+    for (int i = 0; i < rows; ++i) {
+      int r = pos.y - (rows - 1 - i);
+      if (r < 0 || r >= img.rows) continue;
+      uint8_t* dst = img.ptr<uint8_t>(r) + (pos.x + c_begin) * 3;
+      const uint8_t* alpha = glyph->alpha.data() + (i * cols + c_begin) * 3;
+      BlendRow(dst, alpha, color_row->data(), (c_end - c_begin) * 3, opacity);
+    }
+  }
+
   // Modify the output position of the next word
   double space = m_fontSize.val[0] * m_fontSize.val[1];
   double sep = m_fontSize.val[0] * m_fontSize.val[2];
@@ -27,7 +27,13 @@
 #include <locale.h>
 #include <wchar.h>
 #include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include FT_FREETYPE_H
 #endif
 
@@ -40,6 +46,45 @@
 
 namespace cnstream {
 
+#ifdef HAVE_FREETYPE
+/**
+ * @brief Glyphs of one font in one pixel size. Each glyph is rasterized only once and shared by all CnFont
+ *        objects using the same font and size, so it is safe to use it in several threads.
+ */
+class GlyphAtlas {
+ public:
+  struct Glyph {
+    int width = 0;
+    int rows = 0;
+    /// anti-aliased coverage of each pixel, repeated for the 3 channels, rows * width * 3 bytes
+    std::vector<uint8_t> alpha;
+  };
+  /**
+   * @brief Get the atlas of the font in the size, it is created when it does not exist
+   * @return nullptr if the font could not be loaded
+   */
+  static std::shared_ptr<GlyphAtlas> Get(const std::string &font_path, uint32_t font_pixel);
+  ~GlyphAtlas();
+  /**
+   * @brief Get the glyph of a wide character, the returned glyph lives as long as the atlas
+   */
+  const Glyph* GetGlyph(wchar_t wc);
+
+ private:
+  GlyphAtlas() = default;
+  bool Init(const std::string &font_path, uint32_t font_pixel);
+  void Rasterize(wchar_t wc, Glyph* glyph);
+
+  FT_Library library_ = nullptr;
+  FT_Face face_ = nullptr;
+  // guards face_ and glyphs_
+  std::mutex mutex_;
+  // ascii glyphs are rasterized in Init and read without lock
+  Glyph ascii_[128];
+  std::unordered_map<wchar_t, std::unique_ptr<Glyph>> glyphs_;
+};  // class GlyphAtlas
+#endif
+
 /**
  * @brief Show chinese label in the image
  */
@@ -100,12 +145,14 @@ class CnFont {
    *   wc: single wide character
    *   pos: the show of position
    *   color: the color of font
+   *   color_row: color of font repeated for each pixel of a glyph row, extended when the glyph is wider
    */
-  void putWChar(cv::Mat& img, wchar_t wc, cv::Point& pos, cv::Scalar color);  // NOLINT
+  void putWChar(cv::Mat& img, wchar_t wc, cv::Point& pos, const cv::Scalar& color,  // NOLINT
+                std::vector<uint8_t>* color_row);
   CnFont& operator=(const CnFont&);
 
-  FT_Library m_library;
-  FT_Face m_face;
+  std::string font_path_;
+  std::shared_ptr<GlyphAtlas> atlas_;
   bool is_initialized_ = false;
 
   // Default font output parameters
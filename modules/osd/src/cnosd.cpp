@@ -21,23 +21,21 @@
 #include "cnosd.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "cnfont.hpp"
+#include "osd_canvas.hpp"
 
 #define CLIP(x) x < 0 ? 0 : (x > 1 ? 1 : x)
 
 namespace cnstream {
 
-// Keep 2 digits after decimal
-static std::string FloatToString(float number) {
-  char buffer[10];
-  snprintf(buffer, sizeof(buffer), "%.2f", number);
-  return std::string(buffer);
-}
+// layout of a track is released if the track is not drawn in so many frames
+static constexpr uint64_t kLayoutMaxIdle = 256;
 
 // http://martin.ankerl.com/2009/12/09/how-to-create-random-colors-programmatically
 static cv::Scalar HSV2RGB(const float h, const float s, const float v) {
@@ -76,53 +74,71 @@ CnOsd::CnOsd(const std::vector<std::string>& labels) : labels_(labels) {
   colors_ = GenerateColorsForCategories(labels_.size());
 }
 
-void CnOsd::DrawLogo(cv::Mat* image, std::string logo) const {
-  cv::Point logo_pos(5, image->rows - 5);
+void CnOsd::DrawLogo(OsdCanvas* image, std::string logo) const {
+  cv::Point logo_pos(5, image->Height() - 5);
   uint32_t scale = 1;
   uint32_t thickness = 2;
   cv::Scalar color(200, 200, 200);
-  cv::putText(*image, logo, logo_pos, font_, scale, color, thickness);
+  image->PutText(logo, logo_pos, font_, scale, color, thickness);
 }
 
-void CnOsd::DrawLabel(cv::Mat* image, const cnstream::CNObjsVec& objects,
-                      std::vector<std::string> attr_keys) const {
+void CnOsd::DrawLabel(OsdCanvas* image, const cnstream::CNObjsVec& objects,
+                      std::vector<std::string> attr_keys, uint32_t stream_index) {
   // check input data
-  if (image->cols * image->rows == 0) {
+  if (image->Width() * image->Height() == 0) {
     LOG(ERROR) << "Osd: the image is empty.";
     return;
   }
 
+  ++draw_count_;
+  command_num_ = 0;
+  int image_width = image->Width();
+  int image_height = image->Height();
+  cv::Size text_size;
+  int baseline = 0;
   for (uint32_t i = 0; i < objects.size(); ++i) {
     std::shared_ptr<cnstream::CNInferObject> object = objects[i];
     if (!object) continue;
-    std::pair<cv::Point, cv::Point> corner = GetBboxCorner(*object.get(), image->cols, image->rows);
+    std::pair<cv::Point, cv::Point> corner = GetBboxCorner(*object.get(), image_width, image_height);
     cv::Point top_left = corner.first;
     cv::Point bottom_right = corner.second;
     cv::Point bottom_left(top_left.x, bottom_right.y);
 
     cv::Scalar color(0, 0, 0);
 
-    int label_id = GetLabelId(object->id);
+    int label_id = object->GetClassId();
 
     if (LabelIsFound(label_id)) {
       color = colors_[label_id];
     }
 
     // Draw Detection window
-    DrawBox(image, top_left, bottom_right, color);
+    AddBox(image_width, top_left, bottom_right, color);
 
     // Draw Text label + score + track id
-    std::string text;
-    if (LabelIsFound(label_id)) {
-      text = labels_[label_id];
+    int track_id = object->GetTrackId();
+    int score_bucket = static_cast<int>(std::lround(object->score * 100));
+    const std::string *text = &text_;
+    if (track_id >= 0) {
+      // format and measure text only when the label or the shown score of the track changes
+      LabelLayout &layout = layouts_[(static_cast<uint64_t>(stream_index) << 32) | static_cast<uint32_t>(track_id)];
+      if (layout.text.empty() || layout.label_id != label_id || layout.score_bucket != score_bucket ||
+          layout.image_width != image_width) {
+        FormatLabel(label_id, score_bucket, track_id, &layout.text);
+        MeasureText(image_width, layout.text, 1, &layout.text_size, &layout.baseline);
+        layout.label_id = label_id;
+        layout.score_bucket = score_bucket;
+        layout.image_width = image_width;
+      }
+      layout.last_used = draw_count_;
+      text = &layout.text;
+      text_size = layout.text_size;
+      baseline = layout.baseline;
     } else {
-      text = "Label not found, id = " + std::to_string(label_id);
+      FormatLabel(label_id, score_bucket, track_id, &text_);
+      MeasureText(image_width, text_, 1, &text_size, &baseline);
     }
-    text += " " + FloatToString(object->score);
-    if (!object->track_id.empty() && object->track_id != "-1") {
-      text += " track_id: " + object->track_id;
-    }
-    DrawText(image, bottom_left, text, color);
+    AddText(image_width, image_height, bottom_left, *text, text_size, baseline, color);
 
     // draw secondary inference infomation
     int label_bottom_y = 0;
@@ -133,10 +149,64 @@ void CnOsd::DrawLabel(cv::Mat* image, const cnstream::CNObjsVec& objects,
       std::string secondary_lable = secondary_labels_[infer_attr.value];
       std::string secondary_score = std::to_string(infer_attr.score);
       std::string secondary_text = secondary_lable + " : " + secondary_score;
-      DrawText(image, top_left + cv::Point(0, label_bottom_y), secondary_text, color, 0.5, &text_height);
+      MeasureText(image_width, secondary_text, 0.5, &text_size, &baseline);
+      AddText(image_width, image_height, top_left + cv::Point(0, label_bottom_y), secondary_text, text_size, baseline,
+              color, 0.5, &text_height);
       label_bottom_y += text_height;
     }
   }
+
+  Rasterize(image);
+
+  // forget layouts of tracks disappeared for a while
+  if (draw_count_ % kLayoutMaxIdle == 0) {
+    for (auto iter = layouts_.begin(); iter != layouts_.end();) {
+      if (draw_count_ - iter->second.last_used > kLayoutMaxIdle) {
+        iter = layouts_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+}
+
+void CnOsd::Rasterize(OsdCanvas* image) {
+  int image_height = image->Height();
+  int band_rows = (band_rows_ > 0 && band_rows_ < image_height) ? band_rows_ : image_height;
+  for (int band_y = 0; band_y < image_height; band_y += band_rows) {
+    int rows = std::min(band_rows, image_height - band_y);
+    std::unique_ptr<OsdCanvas> band;
+    OsdCanvas* canvas = image;
+    if (rows != image_height) {
+      band = image->Band(band_y, rows);
+      canvas = band.get();
+    }
+    cv::Point offset(0, band_y);
+    for (size_t i = 0; i < command_num_; ++i) {
+      OsdCommand &cmd = commands_[i];
+      if (cmd.y_end <= band_y || cmd.y_begin >= band_y + rows) continue;
+      switch (cmd.type) {
+        case OsdCommand::Type::RECT:
+          canvas->DrawRect(cmd.p0 - offset, cmd.p1 - offset, cmd.color, cmd.thickness);
+          break;
+        case OsdCommand::Type::TEXT:
+        case OsdCommand::Type::FONT_TEXT:
+          // texts spanning several bands are rendered only once
+          if (!cmd.rendered) {
+            if (cmd.type == OsdCommand::Type::TEXT) {
+              OsdCanvas::RenderText(cmd.text, font_, cmd.scale, cmd.thickness, &cmd.text_mask);
+            } else {
+              OsdCanvas::RenderText(cn_font_.get(), cmd.text, &cmd.text_mask);
+            }
+            cmd.rendered = true;
+          }
+          if (!cmd.text_mask.mask.empty()) {
+            canvas->BlendMask(cmd.text_mask.mask, cmd.p0 + cmd.text_mask.offset - offset, cmd.color);
+          }
+          break;
+      }
+    }
+  }
 }
 
 std::pair<cv::Point, cv::Point> CnOsd::GetBboxCorner(const cnstream::CNInferObject &object,
@@ -159,64 +229,100 @@ bool CnOsd::LabelIsFound(const int &label_id) const {
   return true;
 }
 
-int CnOsd::GetLabelId(const std::string &label_id_str) const {
-  return label_id_str.empty() ? -1 : std::stoi(label_id_str);
+void CnOsd::FormatLabel(int label_id, int score_bucket, int track_id, std::string *text) const {
+  char buffer[64];
+  if (LabelIsFound(label_id)) {
+    text->assign(labels_[label_id]);
+  } else {
+    snprintf(buffer, sizeof(buffer), "Label not found, id = %d", label_id);
+    text->assign(buffer);
+  }
+  if (track_id >= 0) {
+    snprintf(buffer, sizeof(buffer), " %.2f track_id: %d", score_bucket / 100.0, track_id);
+  } else {
+    snprintf(buffer, sizeof(buffer), " %.2f", score_bucket / 100.0);
+  }
+  text->append(buffer);
 }
 
-void CnOsd::DrawBox(cv::Mat* image, const cv::Point &top_left, const cv::Point &bottom_right,
-                    const cv::Scalar &color) const {
-  cv::rectangle(*image, top_left, bottom_right, color, CalcThickness(image->cols, box_thickness_));
+OsdCommand* CnOsd::AddCommand(OsdCommand::Type type, const cv::Scalar &color) {
+  if (command_num_ == commands_.size()) commands_.emplace_back();
+  OsdCommand* cmd = &commands_[command_num_++];
+  cmd->type = type;
+  cmd->color = color;
+  cmd->rendered = false;
+  return cmd;
 }
 
-void CnOsd::DrawText(cv::Mat* image, const cv::Point &bottom_left, const std::string &text,
-                     const cv::Scalar &color, float scale, int* text_height) const {
-  double txt_scale = CalcScale(image->cols, text_scale_) * scale;
-  int txt_thickness = CalcThickness(image->cols, text_thickness_) * scale;
-  int box_thickness = CalcThickness(image->cols, box_thickness_) * scale;
+void CnOsd::AddBox(int image_width, const cv::Point &top_left, const cv::Point &bottom_right,
+                   const cv::Scalar &color) {
+  OsdCommand* cmd = AddCommand(OsdCommand::Type::RECT, color);
+  cmd->p0 = top_left;
+  cmd->p1 = bottom_right;
+  cmd->thickness = CalcThickness(image_width, box_thickness_);
+  cmd->y_begin = std::min(top_left.y, bottom_right.y) - cmd->thickness;
+  cmd->y_end = std::max(top_left.y, bottom_right.y) + cmd->thickness + 1;
+}
 
-  int baseline = 0;
-  int space_before = 0;
-  cv::Size text_size;
-  int label_height;
+void CnOsd::MeasureText(int image_width, const std::string &text, float scale, cv::Size *text_size,
+                        int *baseline) const {
+  double txt_scale = CalcScale(image_width, text_scale_) * scale;
+  int txt_thickness = CalcThickness(image_width, text_thickness_) * scale;
   if (cn_font_ == nullptr) {
-    text_size = cv::getTextSize(text, font_, txt_scale, txt_thickness, &baseline);
-    space_before = 3 * txt_scale;
-    text_size.width += space_before * 2;
+    *baseline = 0;
+    *text_size = cv::getTextSize(text, font_, txt_scale, txt_thickness, baseline);
   } else {
     uint32_t text_h = 0, text_w = 0;
     char* str = const_cast<char*>(text.data());
     cn_font_->GetTextSize(str, &text_w, &text_h);
-    baseline = cn_font_->GetFontPixel() / 4;
-    space_before = baseline / 2;
-    text_size.height = text_h;
-    text_size.width = text_w + space_before * 2;
+    *baseline = cn_font_->GetFontPixel() / 4;
+    text_size->height = text_h;
+    text_size->width = text_w;
   }
-  label_height = baseline + txt_thickness + text_size.height;
+}
+
+void CnOsd::AddText(int image_width, int image_height, const cv::Point &bottom_left, const std::string &text,
+                    const cv::Size &text_size, int baseline, const cv::Scalar &color, float scale,
+                    int* text_height) {
+  double txt_scale = CalcScale(image_width, text_scale_) * scale;
+  int txt_thickness = CalcThickness(image_width, text_thickness_) * scale;
+  int box_thickness = CalcThickness(image_width, box_thickness_) * scale;
+
+  int space_before = cn_font_ == nullptr ? static_cast<int>(3 * txt_scale) : baseline / 2;
+  int label_width = text_size.width + space_before * 2;
+  int label_height = baseline + txt_thickness + text_size.height;
   int offset = (box_thickness == 1 ? 0 : -(box_thickness + 1) / 2);
   cv::Point label_top_left = bottom_left + cv::Point(offset, offset);
-  cv::Point label_bottom_right = label_top_left + cv::Point(text_size.width + offset, label_height);
+  cv::Point label_bottom_right = label_top_left + cv::Point(label_width + offset, label_height);
   // move up if the label is beyond the bottom of the image
-  if (label_bottom_right.y > image->rows) {
+  if (label_bottom_right.y > image_height) {
     label_bottom_right.y -= label_height;
     label_top_left.y -= label_height;
   }
   // move left if the label is beyond the right side of the image
-  if (label_bottom_right.x > image->cols) {
-    label_bottom_right.x = image->cols;
-    label_top_left.x = image->cols - text_size.width;
+  if (label_bottom_right.x > image_width) {
+    label_bottom_right.x = image_width;
+    label_top_left.x = image_width - label_width;
   }
   // draw text background
-  cv::rectangle(*image, label_top_left, label_bottom_right, color, CV_FILLED);
+  OsdCommand* cmd = AddCommand(OsdCommand::Type::RECT, color);
+  cmd->p0 = label_top_left;
+  cmd->p1 = label_bottom_right;
+  cmd->thickness = CV_FILLED;
+  cmd->y_begin = std::min(label_top_left.y, label_bottom_right.y);
+  cmd->y_end = std::max(label_top_left.y, label_bottom_right.y) + 1;
   // draw text
   cv::Point text_left_bottom =
       label_top_left + cv::Point(space_before, label_height - baseline / 2 - txt_thickness / 2);
   cv::Scalar text_color = cv::Scalar(255, 255, 255) - color;
-  if (cn_font_ == nullptr) {
-    cv::putText(*image, text, text_left_bottom, font_, txt_scale, text_color, txt_thickness);
-  } else {
-    char* str = const_cast<char*>(text.data());
-    cn_font_->putText(*image, str, text_left_bottom, text_color);
-  }
+  cmd = AddCommand(cn_font_ == nullptr ? OsdCommand::Type::TEXT : OsdCommand::Type::FONT_TEXT, text_color);
+  cmd->p0 = text_left_bottom;
+  cmd->text.assign(text);
+  cmd->scale = txt_scale;
+  cmd->thickness = txt_thickness;
+  // glyphs may go beyond the label a little
+  cmd->y_begin = text_left_bottom.y - text_size.height - 2 * txt_thickness - 2;
+  cmd->y_end = text_left_bottom.y + baseline + 2 * txt_thickness + 2;
   if (text_height) *text_height = text_size.height + baseline;
 }
 
@@ -28,16 +28,35 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "osd.hpp"
+#include "osd_canvas.hpp"
 #include "cnstream_frame_va.hpp"
 
 namespace cnstream {
 
 class CnFont;
 
+/**
+ * @brief A drawing operation of osd, coordinates are in the whole image
+ */
+struct OsdCommand {
+  enum class Type { RECT, TEXT, FONT_TEXT } type;
+  cv::Point p0;      ///< top left of rectangle, or bottom left of text
+  cv::Point p1;      ///< bottom right of rectangle
+  cv::Scalar color;
+  int thickness;     ///< thickness of rectangle (negative to fill) or text
+  double scale;      ///< scale of opencv font
+  std::string text;
+  int y_begin;       ///< first row touched
+  int y_end;         ///< one past the last row touched
+  bool rendered;     ///< whether text is rendered to text_mask in this frame
+  TextMask text_mask;  ///< text is rendered once and blended to all bands it touches
+};
+
 class CnOsd {
  public:
   CnOsd() = delete;
@@ -48,19 +67,42 @@ class CnOsd {
   inline void SetBoxThickness(float thickness)  { box_thickness_ = thickness; }
   inline void SetSecondaryLabels(std::vector<std::string> labels) { secondary_labels_ = labels; }
   inline void SetCnFont(std::shared_ptr<CnFont> cn_font) { cn_font_ = cn_font; }
+  /**
+   * @brief Set rows of the bands, commands are drawn band by band so each band of the image is touched once.
+   *        0 means drawing the whole image at once
+   */
+  inline void SetBandRows(int rows) { band_rows_ = rows > 0 ? (rows + 1) / 2 * 2 : 0; }
 
-  void DrawLabel(cv::Mat *image, const CNObjsVec& objects, std::vector<std::string> attr_keys = {}) const;
-  void DrawLogo(cv::Mat *image, std::string logo) const;
+  /**
+   * @brief Draw objects, layout of labels is cached by stream_index and track id of objects
+   */
+  void DrawLabel(OsdCanvas *image, const CNObjsVec& objects, std::vector<std::string> attr_keys = {},
+                 uint32_t stream_index = 0);
+  void DrawLogo(OsdCanvas *image, std::string logo) const;
 
  private:
+  struct LabelLayout {
+    int label_id;
+    int score_bucket;
+    int image_width;
+    std::string text;
+    cv::Size text_size;
+    int baseline;
+    uint64_t last_used;
+  };
+
   std::pair<cv::Point, cv::Point> GetBboxCorner(const cnstream::CNInferObject &object,
                                                 int img_width, int img_height) const;
   bool LabelIsFound(const int &label_id) const;
-  int GetLabelId(const std::string &label_id_str) const;
-  void DrawBox(cv::Mat* image, const cv::Point &top_left, const cv::Point &bottom_right,
-               const cv::Scalar &color) const;
-  void DrawText(cv::Mat* image, const cv::Point &bottom_left, const std::string &text, const cv::Scalar &color,
-                float scale = 1, int* text_height = nullptr) const;
+  // score_bucket is score in hundredths, the same precision as the label shows
+  void FormatLabel(int label_id, int score_bucket, int track_id, std::string *text) const;
+  OsdCommand* AddCommand(OsdCommand::Type type, const cv::Scalar &color);
+  void AddBox(int image_width, const cv::Point &top_left, const cv::Point &bottom_right, const cv::Scalar &color);
+  void MeasureText(int image_width, const std::string &text, float scale, cv::Size *text_size, int *baseline) const;
+  void AddText(int image_width, int image_height, const cv::Point &bottom_left, const std::string &text,
+               const cv::Size &text_size, int baseline, const cv::Scalar &color, float scale = 1,
+               int* text_height = nullptr);
+  void Rasterize(OsdCanvas *image);
   int CalcThickness(int image_width, float thickness) const;
   double CalcScale(int image_width, float scale) const;
 
@@ -72,6 +114,14 @@ class CnOsd {
   std::vector<cv::Scalar> colors_;
   int font_ = cv::FONT_HERSHEY_SIMPLEX;
   std::shared_ptr<CnFont> cn_font_;
+  int band_rows_ = 128;
+  // commands of current frame, elements are reused among frames to keep capacity of strings
+  std::vector<OsdCommand> commands_;
+  size_t command_num_ = 0;
+  // key is stream index and track id, layout is kept while label and score bucket of the track are the same
+  std::unordered_map<uint64_t, LabelLayout> layouts_;
+  uint64_t draw_count_ = 0;
+  std::string text_;
 };  // class CnOsd
 
 }  // namespace cnstream
@@ -39,6 +39,7 @@
 #include "cnfont.hpp"
 #include "cnosd.hpp"
 #include "cnstream_frame_va.hpp"
+#include "osd_canvas.hpp"
 
 namespace cnstream {
 
@@ -68,7 +69,8 @@ static std::vector<std::string> LoadLabels(const std::string& label_path) {
 }
 
 Osd::Osd(const std::string& name) : Module(name) {
-  param_register_.SetModuleDesc("Osd is a module for drawing objects on image. Output image is BGR24 format.");
+  param_register_.SetModuleDesc("Osd is a module for drawing objects on image. Output image is BGR24 format,"
+                                " or the source YUV420sp format when color_mode is nv.");
   param_register_.Register("label_path", "The path of the label file.");
   param_register_.Register("font_path", "The path of font.");
   param_register_.Register("label_size", " The size of the label, support value: "
@@ -81,6 +83,9 @@ Osd::Osd(const std::string& name) : Module(name) {
   param_register_.Register("secondary_label_path", "The path of the secondary inference file");
   param_register_.Register("attr_keys", "The keys of attribute which you want to draw on image");
   param_register_.Register("logo", "draw 'logo' on each frame");
+  param_register_.Register("color_mode", "Which image to draw on, bgr or nv. bgr draws on the BGR24 image converted"
+                           " from the frame. nv draws on the Y and UV planes of NV12/NV21 frames directly, so the frame"
+                           " is not converted to BGR24. The default value is bgr.");
 }
 
 Osd::~Osd() { Close(); }
@@ -186,6 +191,10 @@ bool Osd::Open(cnstream::ModuleParamSet paramSet) {
   if (paramSet.find("logo") != paramSet.end()) {
     logo_ = paramSet["logo"];
   }
+
+  if (paramSet.find("color_mode") != paramSet.end()) {
+    color_mode_ = paramSet["color_mode"];
+  }
   return true;
 }
 
@@ -216,10 +225,22 @@ int Osd::Process(std::shared_ptr<CNFrameInfo> data) {
     input_objs = (cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]));
   }
 
+  std::unique_ptr<OsdCanvas> canvas;
+  // frames already converted to BGR24 are drawn on the BGR24 image, which is used by downstream modules
+  if (color_mode_ == "nv" && !frame->HasBGRImage() &&
+      (frame->fmt == CN_PIXEL_FORMAT_YUV420_NV12 || frame->fmt == CN_PIXEL_FORMAT_YUV420_NV21)) {
+    uint8_t* y_plane = static_cast<uint8_t*>(frame->data[0]->GetMutableCpuData());
+    uint8_t* uv_plane = static_cast<uint8_t*>(frame->data[1]->GetMutableCpuData());
+    canvas.reset(new YuvCanvas(y_plane, uv_plane, frame->width, frame->height, frame->stride[0], frame->stride[1],
+                               frame->fmt == CN_PIXEL_FORMAT_YUV420_NV21));
+  } else {
+    canvas.reset(new BgrCanvas(frame->ImageBGR()));
+  }
+
   if (!logo_.empty()) {
-    ctx->DrawLogo(frame->ImageBGR(), logo_);
+    ctx->DrawLogo(canvas.get(), logo_);
   }
-  ctx->DrawLabel(frame->ImageBGR(), input_objs, attr_keys_);
+  ctx->DrawLabel(canvas.get(), input_objs, attr_keys_, data->GetStreamIndex());
   return 0;
 }
 
@@ -249,6 +270,13 @@ bool Osd::CheckParamSet(const ModuleParamSet& paramSet) const {
       ret = false;
     }
   }
+  if (paramSet.find("color_mode") != paramSet.end()) {
+    std::string color_mode = paramSet.at("color_mode");
+    if (color_mode != "bgr" && color_mode != "nv") {
+      LOG(ERROR) << "[Osd] [color_mode] : " << color_mode << " is not supported. Please choose from 'bgr' and 'nv'.";
+      ret = false;
+    }
+  }
   std::string err_msg;
   if (!checker.IsNum({"text_scale", "text_thickness", "box_thickness"}, paramSet, err_msg)) {
     LOG(ERROR) << "[Osd] " << err_msg;
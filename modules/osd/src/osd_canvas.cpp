@@ -0,0 +1,227 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "osd_canvas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "cnfont.hpp"
+
+namespace cnstream {
+
+static inline uint8_t ClipToByte(float value) {
+  return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value + 0.5f));
+}
+
+// BT.601, limited range
+static void BgrToYuv(const cv::Scalar& bgr, uint8_t* y, uint8_t* u, uint8_t* v) {
+  float b = bgr.val[0], g = bgr.val[1], r = bgr.val[2];
+  *y = ClipToByte(0.257f * r + 0.504f * g + 0.098f * b + 16);
+  *u = ClipToByte(-0.148f * r - 0.291f * g + 0.439f * b + 128);
+  *v = ClipToByte(0.439f * r - 0.368f * g - 0.071f * b + 128);
+}
+
+static inline uint8_t Blend(uint8_t dst, uint8_t src, uint32_t alpha) {
+  uint32_t t = dst * (255 - alpha) + src * alpha + 128;
+  return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+std::unique_ptr<OsdCanvas> BgrCanvas::Band(int y, int rows) {
+  cv::Mat band = image_.rowRange(y, y + rows);
+  return std::unique_ptr<OsdCanvas>(new BgrCanvas(&band));
+}
+
+void BgrCanvas::DrawRect(const cv::Point& top_left, const cv::Point& bottom_right, const cv::Scalar& color,
+                         int thickness) {
+  cv::rectangle(image_, top_left, bottom_right, color, thickness);
+}
+
+void BgrCanvas::PutText(const std::string& text, const cv::Point& bottom_left, int font_face, double scale,
+                        const cv::Scalar& color, int thickness) {
+  cv::putText(image_, text, bottom_left, font_face, scale, color, thickness);
+}
+
+void BgrCanvas::PutText(CnFont* font, const std::string& text, const cv::Point& bottom_left,
+                        const cv::Scalar& color) {
+  font->putText(image_, const_cast<char*>(text.c_str()), bottom_left, color);
+}
+
+void BgrCanvas::BlendMask(const cv::Mat& mask, const cv::Point& pos, const cv::Scalar& color) {
+  int x0 = std::max(pos.x, 0), y0 = std::max(pos.y, 0);
+  int x1 = std::min(pos.x + mask.cols, image_.cols), y1 = std::min(pos.y + mask.rows, image_.rows);
+  if (x0 >= x1 || y0 >= y1) return;
+  uint8_t bgr[3] = {ClipToByte(color.val[0]), ClipToByte(color.val[1]), ClipToByte(color.val[2])};
+  for (int r = y0; r < y1; ++r) {
+    const uint8_t* alpha = mask.ptr<uint8_t>(r - pos.y) + (x0 - pos.x);
+    uint8_t* dst = image_.ptr<uint8_t>(r) + x0 * 3;
+    for (int c = x0; c < x1; ++c, ++alpha) {
+      if (*alpha) {
+        dst[0] = Blend(dst[0], bgr[0], *alpha);
+        dst[1] = Blend(dst[1], bgr[1], *alpha);
+        dst[2] = Blend(dst[2], bgr[2], *alpha);
+      }
+      dst += 3;
+    }
+  }
+}
+
+// zeroed rows x cols part of buffer, the buffer only grows so following texts reuse it
+static cv::Mat ZeroMask(cv::Mat* buffer, int rows, int cols, int type) {
+  if (buffer->rows < rows || buffer->cols < cols || buffer->type() != type) {
+    buffer->create(std::max(buffer->rows, rows), std::max(buffer->cols, cols), type);
+  }
+  cv::Mat mask = (*buffer)(cv::Rect(0, 0, cols, rows));
+  mask.setTo(cv::Scalar::all(0));
+  return mask;
+}
+
+void OsdCanvas::RenderText(const std::string& text, int font_face, double scale, int thickness, TextMask* mask) {
+  int baseline = 0;
+  cv::Size size = cv::getTextSize(text, font_face, scale, thickness, &baseline);
+  int margin = std::max(thickness, 1);
+  mask->mask = ZeroMask(&mask->buffer, size.height + baseline + 2 * margin, size.width + 2 * margin, CV_8UC1);
+  cv::putText(mask->mask, text, cv::Point(margin, size.height + margin), font_face, scale, cv::Scalar(255), thickness);
+  mask->offset = cv::Point(-margin, -size.height - margin);
+}
+
+void OsdCanvas::RenderText(CnFont* font, const std::string& text, TextMask* mask) {
+  char* str = const_cast<char*>(text.c_str());
+  uint32_t text_w = 0, text_h = 0;
+  if (!font->GetTextSize(str, &text_w, &text_h) || text_w == 0 || text_h == 0) {
+    mask->mask = cv::Mat();
+    return;
+  }
+  // CnFont draws on BGR image, glyphs are the same in all channels
+  cv::Mat mask_bgr = ZeroMask(&mask->buffer_bgr, text_h, text_w, CV_8UC3);
+  font->putText(mask_bgr, str, cv::Point(0, text_h - 1), cv::Scalar(255, 255, 255));
+  // extractChannel writes into the buffer as the size and type match
+  mask->mask = ZeroMask(&mask->buffer, text_h, text_w, CV_8UC1);
+  cv::extractChannel(mask_bgr, mask->mask, 0);
+  mask->offset = cv::Point(0, 1 - static_cast<int>(text_h));
+}
+
+YuvCanvas::YuvCanvas(uint8_t* y_plane, uint8_t* uv_plane, int width, int height, int y_stride, int uv_stride,
+                     bool nv21)
+    : y_plane_(y_plane), uv_plane_(uv_plane), width_(width), height_(height), y_stride_(y_stride),
+      uv_stride_(uv_stride), nv21_(nv21), text_mask_(std::make_shared<TextMask>()) {}
+
+std::unique_ptr<OsdCanvas> YuvCanvas::Band(int y, int rows) {
+  YuvCanvas* band = new YuvCanvas(y_plane_ + y * y_stride_, uv_plane_ + y / 2 * uv_stride_, width_, rows, y_stride_,
+                                  uv_stride_, nv21_);
+  band->text_mask_ = text_mask_;
+  return std::unique_ptr<OsdCanvas>(band);
+}
+
+void YuvCanvas::FillRect(int x0, int y0, int x1, int y1, const cv::Scalar& color) {
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, width_);
+  y1 = std::min(y1, height_);
+  if (x0 >= x1 || y0 >= y1) return;
+  uint8_t y, u, v;
+  BgrToYuv(color, &y, &u, &v);
+  if (nv21_) std::swap(u, v);
+
+  for (int r = y0; r < y1; ++r) {
+    memset(y_plane_ + r * y_stride_ + x0, y, x1 - x0);
+  }
+  // every chroma sample touched by the rectangle takes the color
+  int uv_rows = height_ / 2;
+  int cy1 = std::min((y1 + 1) / 2, uv_rows);
+  int cx0 = x0 / 2, cx1 = (x1 + 1) / 2;
+  for (int r = y0 / 2; r < cy1; ++r) {
+    uint8_t* dst = uv_plane_ + r * uv_stride_ + cx0 * 2;
+    for (int c = cx0; c < cx1; ++c) {
+      *dst++ = u;
+      *dst++ = v;
+    }
+  }
+}
+
+void YuvCanvas::DrawRect(const cv::Point& top_left, const cv::Point& bottom_right, const cv::Scalar& color,
+                         int thickness) {
+  int x0 = std::min(top_left.x, bottom_right.x), x1 = std::max(top_left.x, bottom_right.x);
+  int y0 = std::min(top_left.y, bottom_right.y), y1 = std::max(top_left.y, bottom_right.y);
+  if (thickness < 0) {
+    FillRect(x0, y0, x1 + 1, y1 + 1, color);
+    return;
+  }
+  // lines are centered on the edges, the same as cv::rectangle
+  int half = thickness / 2;
+  FillRect(x0 - half, y0 - half, x1 - half + thickness, y0 - half + thickness, color);  // top
+  FillRect(x0 - half, y1 - half, x1 - half + thickness, y1 - half + thickness, color);  // bottom
+  FillRect(x0 - half, y0 - half, x0 - half + thickness, y1 - half + thickness, color);  // left
+  FillRect(x1 - half, y0 - half, x1 - half + thickness, y1 - half + thickness, color);  // right
+}
+
+void YuvCanvas::BlendMask(const cv::Mat& mask, const cv::Point& pos, const cv::Scalar& color) {
+  int x0 = std::max(pos.x, 0), y0 = std::max(pos.y, 0);
+  int x1 = std::min(pos.x + mask.cols, width_), y1 = std::min(pos.y + mask.rows, height_);
+  if (x0 >= x1 || y0 >= y1) return;
+  uint8_t y, u, v;
+  BgrToYuv(color, &y, &u, &v);
+  if (nv21_) std::swap(u, v);
+
+  for (int r = y0; r < y1; ++r) {
+    const uint8_t* alpha = mask.ptr<uint8_t>(r - pos.y) + (x0 - pos.x);
+    uint8_t* dst = y_plane_ + r * y_stride_;
+    for (int c = x0; c < x1; ++c) {
+      dst[c] = Blend(dst[c], y, *alpha++);
+    }
+  }
+  // chroma of 2x2 block is blended with average coverage
+  int uv_rows = height_ / 2;
+  int cy1 = std::min((y1 + 1) / 2, uv_rows);
+  int cx0 = x0 / 2, cx1 = (x1 + 1) / 2;
+  for (int cr = y0 / 2; cr < cy1; ++cr) {
+    uint8_t* dst = uv_plane_ + cr * uv_stride_;
+    for (int cc = cx0; cc < cx1; ++cc) {
+      uint32_t sum = 0;
+      for (int r = cr * 2; r < cr * 2 + 2; ++r) {
+        if (r < y0 || r >= y1) continue;
+        for (int c = cc * 2; c < cc * 2 + 2; ++c) {
+          if (c < x0 || c >= x1) continue;
+          sum += mask.at<uint8_t>(r - pos.y, c - pos.x);
+        }
+      }
+      if (sum == 0) continue;
+      uint32_t alpha = (sum + 2) / 4;
+      dst[cc * 2] = Blend(dst[cc * 2], u, alpha);
+      dst[cc * 2 + 1] = Blend(dst[cc * 2 + 1], v, alpha);
+    }
+  }
+}
+
+void YuvCanvas::PutText(const std::string& text, const cv::Point& bottom_left, int font_face, double scale,
+                        const cv::Scalar& color, int thickness) {
+  RenderText(text, font_face, scale, thickness, text_mask_.get());
+  BlendMask(text_mask_->mask, bottom_left + text_mask_->offset, color);
+}
+
+void YuvCanvas::PutText(CnFont* font, const std::string& text, const cv::Point& bottom_left,
+                        const cv::Scalar& color) {
+  RenderText(font, text, text_mask_.get());
+  if (text_mask_->mask.empty()) return;
+  BlendMask(text_mask_->mask, bottom_left + text_mask_->offset, color);
+}
+
+}  // namespace cnstream
@@ -0,0 +1,147 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_OSD_CANVAS_HPP_
+#define MODULES_OSD_CANVAS_HPP_
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace cnstream {
+
+class CnFont;
+
+/**
+ * @brief Coverage mask of a text. The buffers only grow, so masks of following texts reuse them
+ */
+struct TextMask {
+  cv::Mat mask;        ///< CV_8UC1 coverage, a part of buffer. Empty if there is nothing to draw
+  cv::Point offset;    ///< top left of the mask relative to bottom left of the text
+  cv::Mat buffer;
+  cv::Mat buffer_bgr;  ///< CnFont draws on BGR image
+};
+
+/**
+ * @brief Image which osd draws on. Colors are always given in BGR.
+ */
+class OsdCanvas {
+ public:
+  virtual ~OsdCanvas() {}
+  virtual int Width() const = 0;
+  virtual int Height() const = 0;
+  /**
+   * @brief Get canvas of rows [y, y + rows) sharing the image data, coordinates of it start from row y.
+   *        y should be even for YUV420sp image
+   */
+  virtual std::unique_ptr<OsdCanvas> Band(int y, int rows) = 0;
+  /**
+   * @brief Draw a rectangle, it is filled when thickness is negative, the same as cv::rectangle
+   */
+  virtual void DrawRect(const cv::Point& top_left, const cv::Point& bottom_right, const cv::Scalar& color,
+                        int thickness) = 0;
+  /**
+   * @brief Put text with opencv font, the same as cv::putText
+   */
+  virtual void PutText(const std::string& text, const cv::Point& bottom_left, int font_face, double scale,
+                       const cv::Scalar& color, int thickness) = 0;
+  /**
+   * @brief Put text with CnFont, bottom of the glyphs is aligned to bottom_left
+   */
+  virtual void PutText(CnFont* font, const std::string& text, const cv::Point& bottom_left,
+                       const cv::Scalar& color) = 0;
+  /**
+   * @brief Blend color with coverage mask (CV_8UC1), top left of the mask is put on pos
+   */
+  virtual void BlendMask(const cv::Mat& mask, const cv::Point& pos, const cv::Scalar& color) = 0;
+
+  /**
+   * @brief Render text with opencv font to mask, so the text could be blended to several bands
+   */
+  static void RenderText(const std::string& text, int font_face, double scale, int thickness, TextMask* mask);
+  /**
+   * @brief Render text with CnFont to mask, bottom of the glyphs is aligned to bottom left of the text
+   */
+  static void RenderText(CnFont* font, const std::string& text, TextMask* mask);
+};  // class OsdCanvas
+
+/**
+ * @brief Draw on BGR24 image
+ */
+class BgrCanvas : public OsdCanvas {
+ public:
+  explicit BgrCanvas(cv::Mat* image) : image_(*image) {}
+  int Width() const override { return image_.cols; }
+  int Height() const override { return image_.rows; }
+  std::unique_ptr<OsdCanvas> Band(int y, int rows) override;
+  void DrawRect(const cv::Point& top_left, const cv::Point& bottom_right, const cv::Scalar& color,
+                int thickness) override;
+  void PutText(const std::string& text, const cv::Point& bottom_left, int font_face, double scale,
+               const cv::Scalar& color, int thickness) override;
+  void PutText(CnFont* font, const std::string& text, const cv::Point& bottom_left,
+               const cv::Scalar& color) override;
+  void BlendMask(const cv::Mat& mask, const cv::Point& pos, const cv::Scalar& color) override;
+
+ private:
+  // header of the image, data is shared
+  cv::Mat image_;
+};  // class BgrCanvas
+
+/**
+ * @brief Draw on Y plane and interleaved UV plane of YUV420sp (NV12 or NV21) image directly.
+ *
+ * Colors are converted to BT.601 YUV, the same as opencv uses to convert YUV420sp to BGR.
+ * Chroma of each 2x2 block is blended with the average coverage of the 4 pixels.
+ */
+class YuvCanvas : public OsdCanvas {
+ public:
+  YuvCanvas(uint8_t* y_plane, uint8_t* uv_plane, int width, int height, int y_stride, int uv_stride, bool nv21);
+  int Width() const override { return width_; }
+  int Height() const override { return height_; }
+  std::unique_ptr<OsdCanvas> Band(int y, int rows) override;
+  void DrawRect(const cv::Point& top_left, const cv::Point& bottom_right, const cv::Scalar& color,
+                int thickness) override;
+  void PutText(const std::string& text, const cv::Point& bottom_left, int font_face, double scale,
+               const cv::Scalar& color, int thickness) override;
+  void PutText(CnFont* font, const std::string& text, const cv::Point& bottom_left,
+               const cv::Scalar& color) override;
+  void BlendMask(const cv::Mat& mask, const cv::Point& pos, const cv::Scalar& color) override;
+
+ private:
+  // fill [x0, x1) x [y0, y1)
+  void FillRect(int x0, int y0, int x1, int y1, const cv::Scalar& color);
+
+  uint8_t* y_plane_;
+  uint8_t* uv_plane_;
+  int width_;
+  int height_;
+  int y_stride_;
+  int uv_stride_;
+  bool nv21_;
+  // text masks are reused by all texts of the canvas and its bands
+  std::shared_ptr<TextMask> text_mask_;
+};  // class YuvCanvas
+
+}  // namespace cnstream
+
+#endif  // MODULES_OSD_CANVAS_HPP_
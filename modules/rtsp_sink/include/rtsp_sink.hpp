@@ -61,6 +61,7 @@ enum VideoCodecType {
 enum EncoderType {
   FFMPEG = 0,  /// encoder with ffmpeg
   MLU,         /// encoder with mlu
+  PASSTHROUGH,  /// send packets attached by the source (CNPacketsKey) without encoding, H.264 only
 };
 
 /**
@@ -79,6 +80,9 @@ struct RtspParam {
   ColorFormat color_format = NV21;   // Color format
   VideoCodecType codec_type = H264;  // Video codec type
   EncoderType enc_type = FFMPEG;     // Encoder type
+  std::string preset = "veryfast";   // Preset of ffmpeg encoder
+  std::string tune = "zerolatency";  // Tune of ffmpeg encoder
+  int encode_threads = 0;            // Threads of ffmpeg encoder, 0 means decided by ffmpeg
 
   int device_id;             // Device id
   int view_rows;             // Row of the display grid. Only used in mosaic mode.
@@ -108,7 +112,13 @@ class RtspSink : public Module, public ModuleCreator<RtspSink> {
   /**
    * @brief Called by pipeline when pipeline start.
    *
-   * @param paramSet : parameter set
+   * @param paramSet : parameter set. ``encoder_type`` could be ``mlu``, ``ffmpeg`` or ``passthrough``.
+   *                   ``passthrough`` sends H.264 packets attached by DataSource (``output_packets``) as they are,
+   *                   with timestamps of 90kHz, it is not supported in mosaic mode.
+   *                   ``preset``, ``tune`` and ``encode_threads`` are options of ``ffmpeg`` encoder,
+   *                   ``veryfast``, ``zerolatency`` and 0 (decided by ffmpeg) by default.
+   *                   In mosaic mode with ``nv`` color mode, frames are scaled from nv planes into their tiles.
+   *                   Other color modes fall back to ``bgr``.
    *
    * @return ture if module open succeed, otherwise false.
    */
@@ -143,6 +153,7 @@ class RtspSink : public Module, public ModuleCreator<RtspSink> {
   RtspSinkContext* GetRtspSinkContext(CNFrameInfoPtr data);
   RtspParam GetRtspParam(CNFrameInfoPtr data);
   RtspSinkContext* CreateRtspSinkContext(CNFrameInfoPtr data);
+  int SendPackets(RtspSinkContext* ctx, CNFrameInfoPtr data);
   void SetParam(const ModuleParamSet& paramSet, std::string name, int* variable, int default_value);
   void SetParam(const ModuleParamSet& paramSet, std::string name, std::string* variable, std::string default_value);
 
@@ -23,6 +23,9 @@
 #include <glog/logging.h>
 #include <string.h>
 
+#include <algorithm>
+#include <string>
+
 #define OUTPUT_BUFFER_SIZE 0x200000
 
 namespace cnstream {
@@ -32,52 +35,22 @@ FFmpegVideoEncoder::FFmpegVideoFrame::FFmpegVideoFrame(FFmpegVideoEncoder *encod
   frame_->width = encoder_->avcodec_ctx_->width;
   frame_->height = encoder_->avcodec_ctx_->height;
   frame_->format = encoder_->picture_format_;
-  int align = (encoder_->picture_format_ == AV_PIX_FMT_RGB24 || encoder_->picture_format_ == AV_PIX_FMT_BGR24) ? 24 : 8;
-  av_image_alloc(frame_->data, frame_->linesize, frame_->width, frame_->height, (AVPixelFormat)frame_->format, align);
 }
 
 FFmpegVideoEncoder::FFmpegVideoFrame::~FFmpegVideoFrame() {
-  if (frame_) {
-    av_freep(&(frame_->data[0]));
-    av_frame_unref(frame_);
-    av_free(frame_);
-  }
+  if (frame_) av_frame_free(&frame_);
 }
 
+// The frame references the data instead of copying it. The data is encoded before SendFrame returns,
+// and encoders copy or reference count the frames they keep.
 void FFmpegVideoEncoder::FFmpegVideoFrame::Fill(uint8_t *data, int64_t timestamp) {
   if (frame_ == nullptr) return;
 
   frame_->pts = timestamp;
-
-  int line_size;
-  if (frame_->format == AV_PIX_FMT_RGB24 || frame_->format == AV_PIX_FMT_BGR24) {
-    line_size = frame_->width * 3;
-    for (int i = 0; i < frame_->height; i++) {
-      memcpy(frame_->data[0] + frame_->linesize[0] * i, data + line_size * i, line_size);
-    }
-  } else if (frame_->format == AV_PIX_FMT_YUV420P) {
-    line_size = frame_->width;
-    int size = frame_->height * frame_->width;
-    for (int i = 0; i < frame_->height; i++) {
-      memcpy(frame_->data[0] + frame_->linesize[0] * i, data + line_size * i, line_size);
-    }
-    for (int i = 0; i < frame_->height / 2; i++) {
-      memcpy(frame_->data[1] + frame_->linesize[1] * i, data + size + line_size / 2 * i, line_size / 2);
-    }
-    for (int i = 0; i < frame_->height / 2; i++) {
-      memcpy(frame_->data[2] + frame_->linesize[2] * i, data + size * 5 / 4 + line_size / 2 * i, line_size / 2);
-    }
-  } else if (frame_->format == AV_PIX_FMT_NV21 || frame_->format == AV_PIX_FMT_NV12) {
-    line_size = frame_->width;
-    int size = frame_->height * frame_->width;
-    for (int i = 0; i < frame_->height; i++) {
-      memcpy(frame_->data[0] + frame_->linesize[0] * i, data + line_size * i, line_size);
-    }
-    for (int i = 0; i < frame_->height / 2; i++) {
-      memcpy(frame_->data[1] + frame_->linesize[1] * i, data + size + line_size * i, line_size);
-    }
-  } else {
+  if (av_image_fill_arrays(frame_->data, frame_->linesize, data, static_cast<AVPixelFormat>(frame_->format),
+                           frame_->width, frame_->height, 1) < 0) {
     LOG(ERROR) << "unsupport pixel format: " << frame_->format;
+    frame_->data[0] = nullptr;
   }
 }
 
@@ -147,12 +120,20 @@ FFmpegVideoEncoder::FFmpegVideoEncoder(const RtspParam &rtsp_param) : VideoEncod
   avcodec_ctx_->framerate.num = frame_rate_.num;
   avcodec_ctx_->framerate.den = frame_rate_.den;
   avcodec_ctx_->gop_size = rtsp_param.gop;
+  // frames of formats taken by the encoder (e.g. nv12 by libx264) are encoded without converting
   avcodec_ctx_->pix_fmt = AV_PIX_FMT_YUV420P;
+  for (const AVPixelFormat *fmt = avcodec_->pix_fmts; fmt && *fmt != AV_PIX_FMT_NONE; ++fmt) {
+    if (*fmt == picture_format_) {
+      avcodec_ctx_->pix_fmt = picture_format_;
+      break;
+    }
+  }
   avcodec_ctx_->max_b_frames = 1;
-  // avcodec_ctx_->thread_count = 1;
+  // 0 means decided by libavcodec
+  avcodec_ctx_->thread_count = rtsp_param.encode_threads;
 
-  av_dict_set(&avcodec_opts_, "preset", "veryfast", 0);
-  av_dict_set(&avcodec_opts_, "tune", "zerolatency", 0);
+  if (!rtsp_param.preset.empty()) av_dict_set(&avcodec_opts_, "preset", rtsp_param.preset.c_str(), 0);
+  if (!rtsp_param.tune.empty()) av_dict_set(&avcodec_opts_, "tune", rtsp_param.tune.c_str(), 0);
   av_dict_set(&avcodec_opts_, "level", "4.2", 0);
   av_dict_set(&avcodec_opts_, "profile", "high", 0);
   int ret = avcodec_open2(avcodec_ctx_, avcodec_, &avcodec_opts_);
@@ -162,7 +143,7 @@ FFmpegVideoEncoder::FFmpegVideoEncoder(const RtspParam &rtsp_param) : VideoEncod
     return;
   }
 
-  if (picture_format_ != AV_PIX_FMT_YUV420P) {
+  if (picture_format_ != avcodec_ctx_->pix_fmt) {
     avframe_ = av_frame_alloc();
     avframe_->format = AV_PIX_FMT_YUV420P;
     avframe_->data[0] = nullptr;
@@ -198,6 +179,10 @@ FFmpegVideoEncoder::FFmpegVideoEncoder(const RtspParam &rtsp_param) : VideoEncod
 FFmpegVideoEncoder::~FFmpegVideoEncoder() {
   Stop();
   Destroy();
+  if (latency_count_) {
+    LOG(INFO) << "[FFmpegVideoEncoder] " << latency_count_ << " frames encoded, latency average: "
+              << latency_sum_ms_ / latency_count_ << "ms, max: " << latency_max_ms_ << "ms";
+  }
 }
 
 void FFmpegVideoEncoder::Destroy() {
@@ -244,6 +229,11 @@ uint32_t FFmpegVideoEncoder::GetOffset(const uint8_t *data) {
 void FFmpegVideoEncoder::EncodeFrame(VideoFrame *frame) {
   FFmpegVideoFrame *ffpic = dynamic_cast<FFmpegVideoFrame *>(frame);
   AVFrame *picture = ffpic->Get();
+  if (!avcodec_ctx_ || !picture->data[0]) return;
+  // frames are sent by one thread at a time, pts are unique
+  if (start_times_.size() < kMaxPendingFrames) {
+    start_times_[picture->pts] = std::chrono::steady_clock::now();
+  }
 
   if (sws_ctx_) {
     sws_scale(sws_ctx_, picture->data, picture->linesize, 0, picture->height, avframe_->data, avframe_->linesize);
@@ -269,6 +259,18 @@ void FFmpegVideoEncoder::EncodeFrame(VideoFrame *frame) {
     PushOutputBuffer(data, length, frame_count_, avpacket_->pts);
     frame_count_++;
     Callback(NEW_FRAME);
+    auto iter = start_times_.find(avpacket_->pts);
+    if (iter != start_times_.end()) {
+      double latency_ms =
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - iter->second).count();
+      start_times_.erase(iter);
+      latency_sum_ms_ += latency_ms;
+      latency_max_ms_ = std::max(latency_max_ms_, latency_ms);
+      ++latency_count_;
+      ReportLatency(avpacket_->pts, latency_ms);
+    }
+    // frames before dts are all encoded, those left are dropped by encoder
+    start_times_.erase(start_times_.begin(), start_times_.lower_bound(avpacket_->dts));
   }
   av_packet_unref(avpacket_);
 }
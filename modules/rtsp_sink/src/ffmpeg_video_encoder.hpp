@@ -31,6 +31,9 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
+#include <chrono>
+#include <map>
+
 #include "rtsp_sink.hpp"
 #include "video_encoder.hpp"
 
@@ -50,6 +53,9 @@ class FFmpegVideoEncoder : public VideoEncoder {
     }
   }
 
+  // whether frames are converted (by swscale) to a format taken by the encoder
+  bool ConvertsFrame() const { return sws_ctx_ != nullptr; }
+
   friend class FFmpegVideoFrame;
 
  private:
@@ -83,6 +89,13 @@ class FFmpegVideoEncoder : public VideoEncoder {
   AVFrame *avframe_ = nullptr;
   AVPacket *avpacket_ = nullptr;
   SwsContext *sws_ctx_ = nullptr;
+
+  // encoding start time by pts, entries of frames dropped by encoder are bounded
+  static constexpr size_t kMaxPendingFrames = 64;
+  std::map<int64_t, std::chrono::steady_clock::time_point> start_times_;
+  double latency_sum_ms_ = 0;
+  double latency_max_ms_ = 0;
+  uint64_t latency_count_ = 0;
 };  // FFmpegVideoEncoder
 
 }  // namespace cnstream
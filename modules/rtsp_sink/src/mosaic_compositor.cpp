@@ -0,0 +1,112 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "mosaic_compositor.hpp"
+
+#ifdef HAVE_OPENCV
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#else
+#error OpenCV required
+#endif
+
+#include <glog/logging.h>
+
+#include <cstring>
+#include <vector>
+
+namespace cnstream {
+
+std::vector<MosaicCompositor::Tile> MosaicCompositor::Layout(int width, int height, int cols, int rows) {
+  std::vector<Tile> tiles;
+  if (cols < 1 || rows < 1) return tiles;
+  if (3 == cols && 2 == rows) {
+    const int w = (width / 3) & ~1, h = (height / 3) & ~1;
+    tiles.push_back({0, 0, w * 2, h * 2});
+    tiles.push_back({w * 2, 0, w, h});
+    tiles.push_back({w * 2, h, w, h});
+    for (int i = 0; i < 3; ++i) tiles.push_back({w * i, h * 2, w, h});
+    return tiles;
+  }
+  const int w = (width / cols) & ~1, h = (height / rows) & ~1;
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) tiles.push_back({w * c, h * r, w, h});
+  }
+  return tiles;
+}
+
+MosaicCompositor::MosaicCompositor(int width, int height, int cols, int rows)
+    : width_(width & ~1), height_(height & ~1), tiles_(Layout(width_, height_, cols, rows)) {
+  // black of video range
+  canvas_.resize(width_ * height_ * 3 / 2, 128);
+  memset(canvas_.data(), 16, width_ * height_);
+  for (const Tile &tile : tiles_) {
+    buffers_.emplace_back(new TileBuffer);
+    buffers_.back()->data.resize(tile.w * tile.h * 3 / 2);
+  }
+}
+
+bool MosaicCompositor::Update(int channel, const uint8_t *y, const uint8_t *uv, int width, int height,
+                              int y_stride, int uv_stride) {
+  if (channel < 0 || static_cast<size_t>(channel) >= tiles_.size()) {
+    LOG(ERROR) << "[MosaicCompositor] Channel " << channel << " is out of " << tiles_.size() << " tiles.";
+    return false;
+  }
+  if (!y || !uv || width < 4 || height < 4 || y_stride < width || uv_stride < width / 2 * 2) {
+    LOG(ERROR) << "[MosaicCompositor] Invalid frame of channel " << channel << ", " << width << "x" << height
+               << " stride " << y_stride << " " << uv_stride;
+    return false;
+  }
+  const Tile &tile = tiles_[channel];
+  // the same interpolation as ImagePreproc::ResizeYuv, area when shrinking to half or less, bilinear otherwise
+  int interpolation = (tile.w * 2 <= width && tile.h * 2 <= height) ? cv::INTER_AREA : cv::INTER_LINEAR;
+  cv::Mat src_y(height, width, CV_8UC1, const_cast<uint8_t *>(y), y_stride);
+  // interleaved uv is resized as a 2 channel image
+  cv::Mat src_uv(height / 2, width / 2, CV_8UC2, const_cast<uint8_t *>(uv), uv_stride);
+  TileBuffer *buffer = buffers_[channel].get();
+  std::lock_guard<std::mutex> lk(buffer->mutex);
+  cv::Mat dst_y(tile.h, tile.w, CV_8UC1, buffer->data.data());
+  cv::Mat dst_uv(tile.h / 2, tile.w / 2, CV_8UC2, buffer->data.data() + tile.w * tile.h);
+  cv::resize(src_y, dst_y, dst_y.size(), 0, 0, interpolation);
+  cv::resize(src_uv, dst_uv, dst_uv.size(), 0, 0, interpolation);
+  buffer->dirty = true;
+  return true;
+}
+
+int MosaicCompositor::Compose() {
+  int composed = 0;
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    TileBuffer *buffer = buffers_[i].get();
+    std::unique_lock<std::mutex> lk(buffer->mutex, std::try_to_lock);
+    if (!lk.owns_lock() || !buffer->dirty) continue;
+    const Tile &tile = tiles_[i];
+    const uint8_t *src_y = buffer->data.data();
+    const uint8_t *src_uv = src_y + tile.w * tile.h;
+    uint8_t *dst_y = canvas_.data() + tile.y * width_ + tile.x;
+    uint8_t *dst_uv = canvas_.data() + width_ * height_ + tile.y / 2 * width_ + tile.x;
+    for (int r = 0; r < tile.h; ++r) memcpy(dst_y + r * width_, src_y + r * tile.w, tile.w);
+    for (int r = 0; r < tile.h / 2; ++r) memcpy(dst_uv + r * width_, src_uv + r * tile.w, tile.w);
+    buffer->dirty = false;
+    ++composed;
+  }
+  return composed;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,88 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_RTSP_SINK_SRC_MOSAIC_COMPOSITOR_HPP_
+#define MODULES_RTSP_SINK_SRC_MOSAIC_COMPOSITOR_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * @brief Compose NV12 (or NV21) frames of channels into tiles of an NV12 canvas for mosaic view.
+ *
+ * Each channel is scaled from its Y and UV planes straight into its tile by cv::resize, the same as
+ * ImagePreproc::ResizeYuv of the encode module, there is no color conversion.
+ * Tiles are double buffered: Update scales a new frame into the buffer of its tile and only holds the lock of the
+ * tile. Compose copies tiles updated since the last call to the canvas, a tile being scaled is skipped and copied
+ * next time, so the encoder is never blocked by scaling.
+ */
+class MosaicCompositor {
+ public:
+  struct Tile {
+    int x, y, w, h;
+  };
+
+  /**
+   * @brief Tiles of a cols x rows grid, all aligned to even. 3 x 2 is the special layout of 3 x 3 cells,
+   *        with the first channel in the top left 2 x 2 cells.
+   */
+  static std::vector<Tile> Layout(int width, int height, int cols, int rows);
+
+  MosaicCompositor(int width, int height, int cols, int rows);
+
+  /**
+   * @brief Scale a frame of the channel into its tile, channels could be updated concurrently.
+   *
+   * @return false if the channel is out of the layout, the frame is smaller than 4 x 4 or a stride is too small
+   */
+  bool Update(int channel, const uint8_t *y, const uint8_t *uv, int width, int height, int y_stride, int uv_stride);
+  /**
+   * @brief Copy updated tiles to the canvas, only called by the thread reading the canvas.
+   *
+   * @return number of tiles copied
+   */
+  int Compose();
+
+  /// NV12 canvas of width x height, black at first, only read by the thread calling Compose
+  uint8_t *Canvas() { return canvas_.data(); }
+  int Width() const { return width_; }
+  int Height() const { return height_; }
+  size_t TileNum() const { return tiles_.size(); }
+
+ private:
+  struct TileBuffer {
+    std::mutex mutex;
+    std::vector<uint8_t> data;  // nv12 of the tile
+    bool dirty = false;
+  };
+
+  int width_, height_;
+  std::vector<uint8_t> canvas_;
+  std::vector<Tile> tiles_;
+  std::vector<std::unique_ptr<TileBuffer>> buffers_;
+};  // class MosaicCompositor
+
+}  // namespace cnstream
+
+#endif  // MODULES_RTSP_SINK_SRC_MOSAIC_COMPOSITOR_HPP_
@@ -0,0 +1,48 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_RTSP_SINK_SRC_PASSTHROUGH_VIDEO_ENCODER_HPP_
+#define MODULES_RTSP_SINK_SRC_PASSTHROUGH_VIDEO_ENCODER_HPP_
+
+#include "rtsp_sink.hpp"
+#include "video_encoder.hpp"
+
+namespace cnstream {
+
+/**
+ * @brief Deliver encoded packets sent by SendPacket, nothing is encoded.
+ */
+class PassthroughVideoEncoder : public VideoEncoder {
+ public:
+  explicit PassthroughVideoEncoder(const RtspParam &rtsp_param)
+      : VideoEncoder(0x200000), bit_rate_(rtsp_param.kbps * 1000) {}
+  // bit rate of the source is unknown, kbit_rate is used to size the buffers of the server
+  uint32_t GetBitRate() override { return bit_rate_; }
+
+ private:
+  VideoFrame *NewFrame() override { return nullptr; }
+  void EncodeFrame(VideoFrame *frame) override {}
+
+  uint32_t bit_rate_;
+};  // class PassthroughVideoEncoder
+
+}  // namespace cnstream
+
+#endif  // MODULES_RTSP_SINK_SRC_PASSTHROUGH_VIDEO_ENCODER_HPP_
@@ -159,18 +159,29 @@ bool RtspSink::Open(ModuleParamSet paramSet) {
 
   SetParam(paramSet, "preproc_type", &params_.preproc_type, "cpu");
   SetParam(paramSet, "encoder_type", &params_.encoder_type, "mlu");
-  params_.enc_type = params_.encoder_type == "mlu" ? MLU : FFMPEG;
+  if (params_.encoder_type == "passthrough") {
+    params_.enc_type = PASSTHROUGH;
+  } else {
+    params_.enc_type = params_.encoder_type == "mlu" ? MLU : FFMPEG;
+  }
   SetParam(paramSet, "device_id", &params_.device_id, 0);
+  SetParam(paramSet, "preset", &params_.preset, "veryfast");
+  SetParam(paramSet, "tune", &params_.tune, "zerolatency");
+  SetParam(paramSet, "encode_threads", &params_.encode_threads, 0);
 
   SetParam(paramSet, "color_mode", &params_.color_mode, "nv");
   SetParam(paramSet, "view_mode", &params_.view_mode, "single");
 
   if ("mosaic" == params_.view_mode) {
     params_.preproc_type = "cpu";
-    params_.color_mode = "bgr";
+    if (params_.color_mode != "nv") params_.color_mode = "bgr";
     is_mosaic_style_ = true;
     SetParam(paramSet, "view_cols", &params_.view_cols, 4);
     SetParam(paramSet, "view_rows", &params_.view_rows, 4);
+    if (params_.enc_type == PASSTHROUGH) {
+      LOG(ERROR) << "[RtspSink] passthrough is not supported in mosaic mode.";
+      return false;
+    }
   }
   return true;
 }
@@ -185,22 +196,29 @@ void RtspSink::Close() {
 int RtspSink::Process(CNFrameInfoPtr data) {
   RtspSinkContext* ctx = GetRtspSinkContext(data);
   if (!ctx) return -1;
+  if (params_.enc_type == PASSTHROUGH) {
+    return SendPackets(ctx, data);
+  }
   CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
   if ("cpu" == params_.preproc_type) {
     if ("bgr" == params_.color_mode || params_.color_format == BGR24) {
       cv::Mat image = *frame->ImageBGR();
       ctx->rtsp_stream_->UpdateBGR(image, data->timestamp, data->GetStreamIndex());
+    } else if ("nv" == params_.color_mode && is_mosaic_style_) {
+      // planes are scaled into the tile of the stream directly
+      const uint8_t *plane_0 = reinterpret_cast<const uint8_t *>(frame->data[0]->GetCpuData());
+      const uint8_t *plane_1 = reinterpret_cast<const uint8_t *>(frame->data[1]->GetCpuData());
+      if (!ctx->rtsp_stream_->UpdateMosaicYUV(plane_0, plane_1, frame->width, frame->height, frame->stride[0],
+                                              frame->stride[1], data->GetStreamIndex())) {
+        return -1;
+      }
+      frame->deAllocator_.reset();
     } else if ("nv" == params_.color_mode) {
-      uint8_t *image_data = nullptr;
-      image_data = new uint8_t[frame->GetBytes()];
-      uint8_t *plane_0 = reinterpret_cast<uint8_t *>(frame->data[0]->GetMutableCpuData());
-      uint8_t *plane_1 = reinterpret_cast<uint8_t *>(frame->data[1]->GetMutableCpuData());
-      memcpy(image_data, plane_0, frame->GetPlaneBytes(0) * sizeof(uint8_t));
-      memcpy(image_data + frame->GetPlaneBytes(0), plane_1, frame->GetPlaneBytes(1) * sizeof(uint8_t));
+      // planes are copied (and resized) to the canvas directly
+      const uint8_t *plane_0 = reinterpret_cast<const uint8_t *>(frame->data[0]->GetCpuData());
+      const uint8_t *plane_1 = reinterpret_cast<const uint8_t *>(frame->data[1]->GetCpuData());
+      ctx->rtsp_stream_->UpdateYUV(plane_0, plane_1, frame->stride[0], frame->stride[1], data->timestamp);
       frame->deAllocator_.reset();
-      ctx->rtsp_stream_->UpdateYUV(image_data, data->timestamp);
-      delete[] image_data;
-      image_data = nullptr;
     } else {
       LOG(ERROR) << "color type must be set nv or bgr !!!";
       return -1;
@@ -215,6 +233,23 @@ int RtspSink::Process(CNFrameInfoPtr data) {
   return 0;
 }
 
+int RtspSink::SendPackets(RtspSinkContext* ctx, CNFrameInfoPtr data) {
+  if (data->datas.find(CNPacketsKey) == data->datas.end()) {
+    LOG(ERROR) << "[RtspSink] No packets attached to frames. Set output_packets of the source to true for passthrough.";
+    return -1;
+  }
+  CNPacketsVec packets = cnstream::any_cast<CNPacketsVec>(data->datas[CNPacketsKey]);
+  for (const auto& packet : packets) {
+    if (packet->codec != CNPacketCodec::H264) {
+      LOG(ERROR) << "[RtspSink] Only H.264 packets could be passed through.";
+      return -1;
+    }
+    // pts of packets are 90kHz, rtsp server takes milliseconds
+    ctx->rtsp_stream_->UpdatePacket(packet->data.data(), packet->data.size(), packet->pts / 90);
+  }
+  return 0;
+}
+
 bool RtspSink::CheckParamSet(const ModuleParamSet &paramSet) const {
   bool ret = true;
   ParametersChecker checker;
@@ -226,7 +261,7 @@ bool RtspSink::CheckParamSet(const ModuleParamSet &paramSet) const {
 
   std::string err_msg;
   if (!checker.IsNum({"http_port", "udp_port", "frame_rate", "kbit_rate", "gop_size", "view_cols", "view_rows",
-                      "device_id", "dst_width", "dst_height"},
+                      "device_id", "dst_width", "dst_height", "encode_threads"},
                      paramSet, err_msg, true)) {
     LOG(ERROR) << "[RtspSink] (ERROR) " << err_msg;
     ret = false;
@@ -240,9 +275,15 @@ bool RtspSink::CheckParamSet(const ModuleParamSet &paramSet) const {
   }
 
   if (paramSet.find("encoder_type") != paramSet.end()) {
-    if (paramSet.at("encoder_type") != "mlu" && paramSet.at("encoder_type") != "ffmpeg") {
+    if (paramSet.at("encoder_type") != "mlu" && paramSet.at("encoder_type") != "ffmpeg" &&
+        paramSet.at("encoder_type") != "passthrough") {
       LOG(ERROR) << "[RtspSink] (ERROR) Not support encoder type: \"" << paramSet.at("encoder_type")
-                 << "\". Choose from \"mlu\", \"ffmpeg\".";
+                 << "\". Choose from \"mlu\", \"ffmpeg\", \"passthrough\".";
+      ret = false;
+    }
+    if (paramSet.at("encoder_type") == "passthrough" && paramSet.find("view_mode") != paramSet.end() &&
+        paramSet.at("view_mode") == "mosaic") {
+      LOG(ERROR) << "[RtspSink] (ERROR) \"passthrough\" is not supported in mosaic mode.";
       ret = false;
     }
   }
@@ -262,9 +303,6 @@ bool RtspSink::CheckParamSet(const ModuleParamSet &paramSet) const {
       ret = false;
     }
     if (paramSet.at("view_mode") == "mosaic") {
-      if (paramSet.find("color_mode") != paramSet.end() && paramSet.at("color_mode") != "bgr") {
-        LOG(WARNING) << "[RtspSink] (WARNING) view mode is \"mosaic\". Only support plane type \"bgr\"!";
-      }
       if (paramSet.find("view_cols") == paramSet.end()) {
         LOG(WARNING) << "[RtspSink] (WARNING) View *column* number is not given. Default 4.";
       }
@@ -289,7 +327,9 @@ RtspSink::RtspSink(const std::string &name) : Module(name) {
   param_register_.Register("http_port", "Http port.");
   param_register_.Register("udp_port", "UDP port.");
   param_register_.Register("preproc_type", "Resize and colorspace convert type, e.g., cpu.");
-  param_register_.Register("encoder_type", "Encode type. It should be 'mlu' or 'ffmpeg'");
+  param_register_.Register("encoder_type",
+                           "Encode type. It should be 'mlu', 'ffmpeg' or 'passthrough'. 'passthrough' sends "
+                           "H.264 packets attached by the source without encoding.");
   param_register_.Register("dst_width", "The image width of the output.");
   param_register_.Register("dst_height", "The image height of the output.");
   param_register_.Register("color_mode", "Input picture color mode, include nv and bgr.");
@@ -304,6 +344,11 @@ RtspSink::RtspSink(const std::string &name) : Module(name) {
   param_register_.Register("gop_size",
                            "Group of pictures is known as GOP."
                            "gop_size is the number of frames between two I-frames.");
+  param_register_.Register("preset",
+                           "Preset of ffmpeg encoder, e.g. ultrafast, veryfast or medium. Default is veryfast.");
+  param_register_.Register("tune", "Tune of ffmpeg encoder, e.g. zerolatency or film. Default is zerolatency.");
+  param_register_.Register("encode_threads",
+                           "Threads of ffmpeg encoder. Default is 0, which means decided by ffmpeg.");
   hasTransmit_.store(0);  // for receive eos
 }
 
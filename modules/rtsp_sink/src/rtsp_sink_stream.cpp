@@ -59,13 +59,23 @@ bool RtspSinkJoinStream::Open(const RtspParam& rtsp_params) {
     LOG(INFO) << "[Rtsp SINK] Use FFMPEG encoder";
   else if (rtsp_params.enc_type == MLU)
     LOG(INFO) << "[Rtsp SINK] Use MLU encoder";
+  else if (rtsp_params.enc_type == PASSTHROUGH)
+    LOG(INFO) << "[Rtsp SINK] Pass source packets through";
   LOG(INFO) << "[Rtsp Sink] FrameRate: " << rtsp_params.frame_rate << "  GOP: " << rtsp_params.gop
             << "  KBPS: " << rtsp_params.kbps;
   LOG(INFO) << "==================================================================";
 
   ctx_ = StreamPipeCreate(rtsp_params);
-  canvas_ = cv::Mat(rtsp_params.dst_height, rtsp_params.dst_width, CV_8UC3);           // for bgr24
-  canvas_data_ = new uint8_t[rtsp_params.dst_height * rtsp_params.dst_width * 3 / 2];  // for nv21
+  // packets are sent by UpdatePacket, there is nothing to draw or refresh
+  if (rtsp_params.enc_type == PASSTHROUGH) return true;
+  if (is_mosaic_style_ && "nv" == rtsp_params.color_mode) {
+    // tiles are scaled from nv planes into the nv canvas, there is no bgr canvas
+    compositor_.reset(new MosaicCompositor(rtsp_params.dst_width, rtsp_params.dst_height, rtsp_params.view_cols,
+                                           rtsp_params.view_rows));
+  } else {
+    canvas_ = cv::Mat(rtsp_params.dst_height, rtsp_params.dst_width, CV_8UC3);           // for bgr24
+    canvas_data_ = new uint8_t[rtsp_params.dst_height * rtsp_params.dst_width * 3 / 2];  // for nv21
+  }
 
   if (("cpu" == rtsp_params.preproc_type && MULTI_THREAD) || "bgr" == rtsp_params.color_mode) {
     refresh_thread_ = new std::thread(&RtspSinkJoinStream::RefreshLoop, this);
@@ -108,10 +118,16 @@ void RtspSinkJoinStream::Close() {
   StreamPipeClose(ctx_);
   canvas_.release();
   delete[] canvas_data_;
+  canvas_data_ = nullptr;
+  compositor_.reset();
   LOG(INFO) << "Release stream resources !!!" << std::endl;
 }
 
 bool RtspSinkJoinStream::UpdateBGR(cv::Mat image, int64_t timestamp, int channel_id) {
+  if (compositor_) {
+    LOG(ERROR) << "[RtspSink] Mosaic canvas is nv, bgr images could not be drawn.";
+    return false;
+  }
   canvas_lock_.lock();
   if (is_mosaic_style_ && channel_id >= 0) {
     if (3 == rtsp_param_->view_cols && 2 == rtsp_param_->view_rows) {
@@ -146,9 +162,20 @@ bool RtspSinkJoinStream::UpdateBGR(cv::Mat image, int64_t timestamp, int channel
   return true;
 }
 
-bool RtspSinkJoinStream::UpdateYUV(uint8_t* image, int64_t timestamp) {
+bool RtspSinkJoinStream::UpdateMosaicYUV(const uint8_t* y, const uint8_t* uv, int width, int height, int y_stride,
+                                         int uv_stride, int channel_id) {
+  if (!compositor_) return false;
+  return compositor_->Update(channel_id, y, uv, width, height, y_stride, uv_stride);
+}
+
+bool RtspSinkJoinStream::UpdatePacket(const uint8_t* data, size_t size, int64_t timestamp) {
+  return StreamPipePutEncodedPacket(ctx_, data, size, timestamp) == 0;
+}
+
+bool RtspSinkJoinStream::UpdateYUV(const uint8_t* y, const uint8_t* uv, int y_stride, int uv_stride,
+                                   int64_t timestamp) {
   canvas_lock_.lock();
-  ResizeYuvNearest(image, canvas_data_);
+  ResizeYuvNearest(y, uv, y_stride, uv_stride, canvas_data_);
   if (!MULTI_THREAD) {
     EncodeFrameYUV(canvas_data_, timestamp);
   }
@@ -192,7 +219,11 @@ void RtspSinkJoinStream::RefreshLoop() {
     if (ctx_) {
       canvas_lock_.lock();
       if ("cpu" == rtsp_param_->preproc_type) {
-        if ("nv" == rtsp_param_->color_mode) {
+        if (compositor_) {
+          // only tiles updated since the last frame are copied
+          compositor_->Compose();
+          EncodeFrameYUV(compositor_->Canvas(), pts_us / 1000);
+        } else if ("nv" == rtsp_param_->color_mode) {
           EncodeFrameYUV(canvas_data_, pts_us / 1000);
         } else if ("bgr" == rtsp_param_->color_mode) {
           EncodeFrameBGR(canvas_, pts_us / 1000);
@@ -240,9 +271,16 @@ void RtspSinkJoinStream::Bgr2Yuv420nv(const cv::Mat& bgr, uint8_t* nv_data) {
   yuvI420.release();
 }
 
-void RtspSinkJoinStream::ResizeYuvNearest(uint8_t* src, uint8_t* dst) {
+void RtspSinkJoinStream::ResizeYuvNearest(const uint8_t* src_y, const uint8_t* src_uv, int src_y_stride,
+                                          int src_uv_stride, uint8_t* dst) {
   if (rtsp_param_->src_width == rtsp_param_->dst_width && rtsp_param_->src_height == rtsp_param_->dst_height) {
-    memcpy(dst, src, (rtsp_param_->dst_width * rtsp_param_->dst_height * 3 / 2) * sizeof(uint8_t));
+    int width = rtsp_param_->dst_width, height = rtsp_param_->dst_height;
+    if (src_y_stride == width && src_uv_stride == width && src_uv == src_y + width * height) {
+      memcpy(dst, src_y, width * height * 3 / 2);
+      return;
+    }
+    for (int i = 0; i < height; ++i) memcpy(dst + i * width, src_y + i * src_y_stride, width);
+    for (int i = 0; i < height / 2; ++i) memcpy(dst + (height + i) * width, src_uv + i * src_uv_stride, width);
     return;
   }
   int srcy, srcx, src_index;
@@ -250,20 +288,19 @@ void RtspSinkJoinStream::ResizeYuvNearest(uint8_t* src, uint8_t* dst) {
   int yrIntFloat_16 = (rtsp_param_->src_height << 16) / rtsp_param_->dst_height + 1;
 
   uint8_t* dst_uv = dst + rtsp_param_->dst_height * rtsp_param_->dst_width;
-  uint8_t* src_uv = src + rtsp_param_->src_height * rtsp_param_->src_width;
   uint8_t* dst_uv_yScanline = nullptr;
-  uint8_t* src_uv_yScanline = nullptr;
+  const uint8_t* src_uv_yScanline = nullptr;
   uint8_t* dst_y_slice = dst;
-  uint8_t* src_y_slice = nullptr;
+  const uint8_t* src_y_slice = nullptr;
   uint8_t* sp = nullptr;
-  uint8_t* dp = nullptr;
+  const uint8_t* dp = nullptr;
 
   for (int y = 0; y < (rtsp_param_->dst_height & ~7); ++y) {
     srcy = (y * yrIntFloat_16) >> 16;
-    src_y_slice = src + srcy * rtsp_param_->src_width;
+    src_y_slice = src_y + srcy * src_y_stride;
     if (0 == (y & 1)) {
       dst_uv_yScanline = dst_uv + (y / 2) * rtsp_param_->dst_width;
-      src_uv_yScanline = src_uv + (srcy / 2) * rtsp_param_->src_width;
+      src_uv_yScanline = src_uv + (srcy / 2) * src_uv_stride;
     }
     for (int x = 0; x < (rtsp_param_->dst_width & ~7); ++x) {
       srcx = (x * xrIntFloat_16) >> 16;
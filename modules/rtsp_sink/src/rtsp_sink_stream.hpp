@@ -40,6 +40,8 @@
 #include <string>
 #include <thread>
 
+#include "mosaic_compositor.hpp"
+
 namespace cnstream {
 
 struct RtspParam;
@@ -50,11 +52,17 @@ class RtspSinkJoinStream {
   bool Open(const RtspParam &rtsp_param);
   ~RtspSinkJoinStream();
   void Close();
-  bool UpdateYUV(uint8_t *image, int64_t timestamp);
+  bool UpdateYUV(const uint8_t *y, const uint8_t *uv, int y_stride, int uv_stride, int64_t timestamp);
   // bool UpdateYUVs(void *y, void *yu, int64_t timestamp);
   bool UpdateBGR(cv::Mat image, int64_t timestamp, int channel_id = -1);
+  // scale nv planes of the channel into its tile of the mosaic canvas, only used in mosaic mode with nv color mode
+  bool UpdateMosaicYUV(const uint8_t *y, const uint8_t *uv, int width, int height, int y_stride, int uv_stride,
+                       int channel_id);
+  // send an encoded packet as it is, only used by passthrough encoder
+  bool UpdatePacket(const uint8_t *data, size_t size, int64_t timestamp);
   void Bgr2Yuv420nv(const cv::Mat &bgr, uint8_t *nv_data);
-  void ResizeYuvNearest(uint8_t *src, uint8_t *dst);
+  void ResizeYuvNearest(const uint8_t *src_y, const uint8_t *src_uv, int src_y_stride, int src_uv_stride,
+                        uint8_t *dst);
 
  private:
   void RefreshLoop();
@@ -66,7 +74,8 @@ class RtspSinkJoinStream {
 
   std::mutex canvas_lock_;
   cv::Mat canvas_;
-  uint8_t *canvas_data_;
+  uint8_t *canvas_data_ = nullptr;
+  std::unique_ptr<MosaicCompositor> compositor_;
 
   std::thread *refresh_thread_ = nullptr;
   bool running_ = false;
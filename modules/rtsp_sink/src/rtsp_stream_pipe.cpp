@@ -25,6 +25,7 @@
 #include "cn_video_encoder.hpp"
 #include "ffmpeg_video_encoder.hpp"
 #include "live_rtsp_server.hpp"
+#include "passthrough_video_encoder.hpp"
 #include "rtsp_sink.hpp"
 #include "util/cnstream_time_utility.hpp"
 #include "video_encoder.hpp"
@@ -44,6 +45,8 @@ StreamPipeCtx *StreamPipeCreate(const RtspParam &rtsp_param) {
   StreamPipeCtx *pipe_ctx = new StreamPipeCtx;
   if (rtsp_param.enc_type == FFMPEG) {
     pipe_ctx->video_encoder = new FFmpegVideoEncoder(rtsp_param);
+  } else if (rtsp_param.enc_type == PASSTHROUGH) {
+    pipe_ctx->video_encoder = new PassthroughVideoEncoder(rtsp_param);
   } else {
     pipe_ctx->video_encoder = new CNVideoEncoder(rtsp_param);
   }
@@ -65,6 +68,14 @@ int StreamPipePutPacket(StreamPipeCtx *ctx, uint8_t *data, int64_t timestamp) {
   return 0;
 }
 
+int StreamPipePutEncodedPacket(StreamPipeCtx *ctx, const uint8_t *data, size_t size, int64_t timestamp) {
+  if (!ctx->init_flag) {
+    LOG(INFO) << "Init stream pipe firstly\n";
+    return -1;
+  }
+  return ctx->video_encoder->SendPacket(data, size, timestamp) ? 0 : -1;
+}
+
 /*
 int StreamPipePutPacketMlu(StreamPipeCtx *ctx, void *y, void *uv, int64_t timestamp) {
   if (!ctx->init_flag) {
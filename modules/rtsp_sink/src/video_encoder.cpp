@@ -129,6 +129,10 @@ bool VideoEncoder::SendFrame(uint8_t *data, int64_t timestamp) {
   if (sync_input_frame_ == nullptr) {
     sync_input_frame_ = NewFrame();
   }
+  if (sync_input_frame_ == nullptr) {
+    input_mutex_.unlock();
+    return false;
+  }
   sync_input_frame_->Fill(data, timestamp);
   EncodeFrame(sync_input_frame_);
   input_mutex_.unlock();
@@ -151,7 +155,48 @@ bool VideoEncoder::SendFrame(void *y, void *uv, int64_t timestamp) {
 }
 */
 
-bool VideoEncoder::PushOutputBuffer(uint8_t *data, size_t size, uint32_t frame_id, int64_t timestamp) {
+// start code at data[pos], 3 or 4 bytes, 0 if there is none
+static size_t StartCodeLength(const uint8_t *data, size_t size, size_t pos) {
+  if (pos + 3 <= size && data[pos] == 0 && data[pos + 1] == 0) {
+    if (data[pos + 2] == 1) return 3;
+    if (pos + 4 <= size && data[pos + 2] == 0 && data[pos + 3] == 1) return 4;
+  }
+  return 0;
+}
+
+bool VideoEncoder::SendPacket(const uint8_t *data, size_t size, int64_t timestamp) {
+  if (!running_) return false;
+  if (data == nullptr || size == 0) return false;
+  std::lock_guard<std::mutex> lk(input_mutex_);
+  if (init_timestamp_ == -1) {
+    init_timestamp_ = timestamp;
+    timestamp = 0;
+  } else {
+    timestamp -= init_timestamp_;
+  }
+
+  size_t nal_begin = StartCodeLength(data, size, 0);
+  if (nal_begin == 0) {
+    LOG(ERROR) << "SendPacket(): packet is not in Annex B format!";
+    return false;
+  }
+  for (size_t pos = nal_begin; pos < size;) {
+    size_t start_code = StartCodeLength(data, size, pos);
+    if (start_code == 0) {
+      ++pos;
+      continue;
+    }
+    if (pos > nal_begin) PushOutputBuffer(data + nal_begin, pos - nal_begin, packet_count_, timestamp);
+    pos += start_code;
+    nal_begin = pos;
+  }
+  if (size > nal_begin) PushOutputBuffer(data + nal_begin, size - nal_begin, packet_count_, timestamp);
+  packet_count_++;
+  Callback(NEW_FRAME);
+  return true;
+}
+
+bool VideoEncoder::PushOutputBuffer(const uint8_t *data, size_t size, uint32_t frame_id, int64_t timestamp) {
   if (!running_) return false;
   if (data == nullptr || size <= 0) {
     LOG(ERROR) << "PushOutputBuffer(): invalid parameters!";
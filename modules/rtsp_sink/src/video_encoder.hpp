@@ -44,11 +44,19 @@ class VideoEncoder {
 
   bool SendFrame(uint8_t *data, int64_t timestamp);
   bool SendFrame(void *y, void *uv, int64_t timestamp);
+  /**
+   * Deliver an encoded H.264 access unit (Annex B) without encoding, NAL units are pushed one by one.
+   */
+  bool SendPacket(const uint8_t *data, size_t size, int64_t timestamp);
   bool GetFrame(uint8_t *data, uint32_t max_size, uint32_t *size, int64_t *timestamp);
 
   virtual uint32_t GetBitRate() { return 0; }
 
   void SetCallback(std::function<void(Event)> func) { event_callback_ = func; }
+  /**
+   * Called with the timestamp and the latency in milliseconds from sending to encoding each frame.
+   */
+  void SetLatencyCallback(std::function<void(int64_t, double)> func) { latency_callback_ = func; }
 
  protected:
   class VideoFrame {
@@ -62,11 +70,14 @@ class VideoEncoder {
   virtual void EncodeFrame(VideoFrame *frame) = 0;
   // virtual void EncodeFrame(void *y, void *uv, int64_t timestamp) = 0;
 
-  bool PushOutputBuffer(uint8_t *data, size_t size, uint32_t frame_id, int64_t timestamp);
+  bool PushOutputBuffer(const uint8_t *data, size_t size, uint32_t frame_id, int64_t timestamp);
 
   void Callback(Event event) {
     if (event_callback_) event_callback_(event);
   }
+  void ReportLatency(int64_t timestamp, double latency_ms) {
+    if (latency_callback_) latency_callback_(timestamp, latency_ms);
+  }
 
  private:
   class CircularBuffer {
@@ -111,10 +122,13 @@ class VideoEncoder {
   uint32_t sync_output_frame_buffer_length_ = 0;
   bool sync_output_frame_new_ = false;
 
+  uint32_t packet_count_ = 0;
+
   uint32_t input_frames_dropped = 0;
   uint32_t output_frames_dropped = 0;
 
   std::function<void(Event)> event_callback_ = nullptr;
+  std::function<void(int64_t, double)> latency_callback_ = nullptr;
 };  // class VideoEncoder
 
 }  // namespace cnstream
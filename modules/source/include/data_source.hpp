@@ -52,6 +52,7 @@ extern "C" {
 #include "cnstream_frame_va.hpp"
 #include "cnstream_pipeline.hpp"
 #include "cnstream_source.hpp"
+#include "packet_buffer_pool.hpp"
 
 namespace cnstream {
 
@@ -75,6 +76,8 @@ struct DataSourceParam {
   uint32_t input_buf_number_ = 2;               ///< valid when decoder_type = DECODER_MLU
   uint32_t output_buf_number_ = 3;              ///< valid when decoder_type = DECODER_MLU
   bool apply_stride_align_for_scaler_ = false;  //< recommended for use on m200 platforms
+  bool output_packets_ = false;                 ///< attach compressed packets to frames, see CNPacketsKey
+  int rtsp_event_loop_num_ = 0;                 ///< rtsp streams share the live555 event loop threads if > 0
 };
 
 /**
@@ -113,6 +116,9 @@ class DataSource : public SourceModule, public ModuleCreator<DataSource> {
    *   input_buf_number: Optional. The input buffer number. The default value is 2.
    *   output_buf_number: Optional. The output buffer number. The default value is 3.
    *   apply_stride_align_for_scaler: Optional. Apply stride align for scaler on m220(m.2/edge).
+   *   output_packets: Optional. Whether the compressed packets are attached to frames (CNPacketsKey) besides
+   *                   decoded images, so they could be archived or sent without transcoding. The default value is
+   *                   false. Supported values are ``true`` and ``false``.
    * @endverbatim
    *
    * @return
@@ -314,6 +320,19 @@ class ESMemHandler : public SourceHandler {
    * @retval -2: Invalid data. Can not parse video infomations from `pkt`.
    */
   int Write(ESPacket *pkt);                // frame mode
+  /**
+   * @brief Sends data in frame mode without copying.
+   *
+   * @param pkt The data packet, ``pkt->data`` points into ``buffer``.
+   * @param buffer The buffer holding the data, acquired from ``PacketBufferPool::Instance()``. It is referenced until
+   *               the packet is decoded, and must not be modified by the caller after it is written.
+   *               ``PacketBufferPool::kPaddingSize`` bytes after the data are read by the decoder and should be zero.
+   *
+   * @retval 0: The data is write successfully,
+   * @retval -1: Write failed, maybe the handler is closed.
+   * @retval -2: Invalid data. Can not parse video infomations from `pkt`, or the data is not in `buffer`.
+   */
+  int Write(ESPacket *pkt, PacketBufferPtr buffer);  // frame mode
   /**
    * @brief Sends data in chunk mode.
    *
@@ -0,0 +1,100 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_SOURCE_PACKET_BUFFER_POOL_HPP_
+#define MODULES_SOURCE_PACKET_BUFFER_POOL_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * A buffer of compressed packets from PacketBufferPool, returned to the pool when the last reference is released.
+ * The capacity is followed by kPaddingSize bytes, as decoders of ffmpeg read over the end of packets.
+ */
+class PacketBuffer {
+ public:
+  uint8_t *Data() const { return data_; }
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  friend class PacketBufferPool;
+  PacketBuffer(uint8_t *data, size_t capacity, int slab) : data_(data), capacity_(capacity), slab_(slab) {}
+  ~PacketBuffer() = default;
+  uint8_t *data_;
+  size_t capacity_;
+  int slab_;  // -1 if the buffer is larger than the largest slab, it is freed instead of recycled
+};
+
+using PacketBufferPtr = std::shared_ptr<PacketBuffer>;
+
+/**
+ * Recycles packet buffers of all streams. Buffers are grouped in slabs of power-of-two capacities, from
+ * kMinSlabSize to kMaxSlabSize, a buffer is taken from the slab fitting the size and put back when it is released.
+ * Released buffers beyond the max cached bytes are freed.
+ */
+class PacketBufferPool {
+ public:
+  static constexpr size_t kPaddingSize = 64;  // not less than AV_INPUT_BUFFER_PADDING_SIZE
+  static constexpr size_t kMinSlabSize = 4 * 1024;
+  static constexpr size_t kMaxSlabSize = 8 * 1024 * 1024;
+
+  /**
+   * The pool shared by source handlers, which is never destroyed as buffers may be released at exit.
+   */
+  static PacketBufferPool *Instance();
+
+  explicit PacketBufferPool(size_t max_cached_bytes = 512 * 1024 * 1024);
+  ~PacketBufferPool();
+
+  /**
+   * Get a buffer of at least size bytes, the content is not initialized.
+   * @return nullptr if it is failed to allocate memory.
+   */
+  PacketBufferPtr Acquire(size_t size);
+
+  size_t GetCachedBytes() const { return cached_bytes_.load(); }
+  uint64_t GetAllocatedNum() const { return allocated_num_.load(); }
+  uint64_t GetRecycledNum() const { return recycled_num_.load(); }
+
+ private:
+  PacketBufferPool(const PacketBufferPool &) = delete;
+  PacketBufferPool &operator=(const PacketBufferPool &) = delete;
+  void Release(PacketBuffer *buffer);
+
+  struct Slab {
+    std::mutex mutex;
+    std::vector<PacketBuffer *> buffers;
+  };
+  std::vector<Slab> slabs_;
+  size_t max_cached_bytes_;
+  std::atomic<size_t> cached_bytes_{0};
+  std::atomic<uint64_t> allocated_num_{0};
+  std::atomic<uint64_t> recycled_num_{0};
+};  // class PacketBufferPool
+
+}  // namespace cnstream
+
+#endif  // MODULES_SOURCE_PACKET_BUFFER_POOL_HPP_
@@ -100,6 +100,13 @@ int ESMemHandler::Write(ESPacket *pkt) {
   return -1;
 }
 
+int ESMemHandler::Write(ESPacket *pkt, PacketBufferPtr buffer) {
+  if (impl_) {
+    return impl_->Write(pkt, std::move(buffer));
+  }
+  return -1;
+}
+
 int ESMemHandler::Write(unsigned char *data, int len) {
   if (impl_) {
     return impl_->Write(data, len);
@@ -156,10 +163,30 @@ int ESMemHandlerImpl::Write(ESPacket *pkt) {
       return -2;
     }
   }
+  // data of the caller is copied into a pooled buffer once, and the buffer is passed to the decoder
+  return Push(std::make_shared<EsPacket>(pkt));
+}
+
+int ESMemHandlerImpl::Write(ESPacket *pkt, PacketBufferPtr buffer) {
+  if (!pkt || !pkt->data || !pkt->size) {
+    return Write(pkt);
+  }
+  if (!buffer || pkt->data < buffer->Data() || pkt->data + pkt->size > buffer->Data() + buffer->Capacity()) {
+    MLOG(ERROR) << "Write: data of the packet is not in the buffer. stream id is " << stream_id_;
+    return -2;
+  }
+  if (parser_.Parse(pkt->data, pkt->size) < 0) {
+    return -2;
+  }
+  // the buffer of the caller is passed to the decoder without copying
+  return Push(std::make_shared<EsPacket>(pkt, std::move(buffer)));
+}
+
+int ESMemHandlerImpl::Push(std::shared_ptr<EsPacket> packet) {
   std::lock_guard<std::mutex> lk(queue_mutex_);
   int timeoutMs = 1000;
   while (running_.load() && queue_) {
-    if (queue_->Push(timeoutMs, std::make_shared<EsPacket>(pkt))) {
+    if (queue_->Push(timeoutMs, packet)) {
       return 0;
     }
   }
@@ -182,9 +209,12 @@ int ESMemHandlerImpl::SplitterOnNal(NalDesc &desc, bool eos) {
       pkt.size = desc.len;
       pkt.pts = pts_++;
     }
+    // nal units split from chunks are in pooled buffers of the splitter, and are queued without copying
+    std::shared_ptr<EsPacket> packet =
+        desc.buffer ? std::make_shared<EsPacket>(&pkt, desc.buffer) : std::make_shared<EsPacket>(&pkt);
     int timeoutMs = 1000;
     while (running_.load()) {
-      if (queue_->Push(timeoutMs, std::make_shared<EsPacket>(&pkt))) {
+      if (queue_->Push(timeoutMs, packet)) {
         return 0;
       }
     }
@@ -320,7 +350,7 @@ bool ESMemHandlerImpl::Process() {
 
   RecordStartTime(module_->GetName(), pkt.pts);
 
-  if (!decoder_->Process(&pkt)) {
+  if (!decoder_->ProcessPacket(&pkt, in->PaddedBuffer())) {
     return false;
   }
   return true;
@@ -76,6 +76,7 @@ class ESMemHandlerImpl : public IHandler, public H2645NalSplitter {
   }
 
   int Write(ESPacket *pkt);
+  int Write(ESPacket *pkt, PacketBufferPtr buffer);
   int Write(unsigned char *data, int len);
   int SplitterOnNal(NalDesc &desc, bool eos) override;
 
@@ -96,6 +97,7 @@ class ESMemHandlerImpl : public IHandler, public H2645NalSplitter {
   bool Process();
   bool Extract();
   void DecodeLoop();
+  int Push(std::shared_ptr<EsPacket> packet);
 
  private:
   /**/
@@ -28,7 +28,9 @@ extern "C" {
 }
 #endif
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -76,7 +78,7 @@ class FFmpegDemuxer : public IDemuxer {
 
   static int InterruptCallBack(void* ctx) {
     FFmpegDemuxer* demux = reinterpret_cast<FFmpegDemuxer*>(ctx);
-    if (demux->CheckTimeOut(GetTickCount())) {
+    if (demux->interrupted_ || demux->CheckTimeOut(GetTickCount())) {
       return 1;
     }
     return 0;
@@ -185,6 +187,10 @@ class FFmpegDemuxer : public IDemuxer {
     }
   }
 
+  void Interrupt() override {
+    interrupted_ = true;
+  }
+
   bool Process() override {
     bool ret = Extract();
     if (!ret) {
@@ -221,14 +227,15 @@ class FFmpegDemuxer : public IDemuxer {
   uint8_t max_receive_time_out_ = 3;
   bool find_pts_ = false;
   uint64_t pts_ = 0;
+  std::atomic<bool> interrupted_{false};
   FrameQueue *queue_ = nullptr;
   std::string url_name_;
 };  // class FFmpegDemuxer
 
 class Live555Demuxer : public IDemuxer, public IRtspCB {
  public:
-  Live555Demuxer(FrameQueue *queue, const std::string &url, int reconnect)
-    :IDemuxer(), queue_(queue), url_(url), reconnect_(reconnect) {
+  Live555Demuxer(FrameQueue *queue, const std::string &url, int reconnect, int event_loop_num)
+    :IDemuxer(), queue_(queue), url_(url), reconnect_(reconnect), event_loop_num_(event_loop_num) {
   }
 
   virtual ~Live555Demuxer() {
@@ -240,26 +247,15 @@ class Live555Demuxer : public IDemuxer, public IRtspCB {
     cnstream::OpenParam param;
     param.url = url_;
     param.reconnect = reconnect_;
+    param.eventLoopNum = event_loop_num_;
     param.cb = this;
     rtsp_session_.Open(param);
 
-    // waiting for stream info...
+    // waiting for stream info, woken up by the parser as soon as it is got or failed,
+    // and by closing and failing to connect, which interrupt the parser.
+    // exit_flag is set before the demuxer is interruptible, otherwise Interrupt is called.
     VideoStreamInfo info;
-    while (1) {
-      int ret = parser_.GetInfo(info);
-      if (-1 == ret) {
-        return false;
-      } else if (1 == ret) {
-        break;
-      }
-      if (exit_flag) {
-        break;
-      }
-      if (connect_failed_) {
-        return false;
-      }
-    }
-    if (exit_flag) {
+    if (exit_flag || 1 != parser_.WaitInfo(info, -1) || IsInterrupted() || connect_failed_) {
       return false;
     }
     this->SetInfo(info);
@@ -271,9 +267,21 @@ class Live555Demuxer : public IDemuxer, public IRtspCB {
     rtsp_session_.Close();
   }
 
+  void Interrupt() override {
+    {
+      std::lock_guard<std::mutex> lk(wait_mutex_);
+      interrupted_ = true;
+      wait_cond_.notify_all();
+    }
+    parser_.Interrupt();
+    if (queue_) queue_->Interrupt();
+  }
+
   bool Process() override {
-    usleep(100 * 1000);
-    return true;
+    // packets are written by the callbacks of rtsp session, wait for the end of stream or closing here
+    std::unique_lock<std::mutex> lk(wait_mutex_);
+    wait_cond_.wait(lk, [this] { return interrupted_ || eos_; });
+    return !eos_;
   }
 
  private:
@@ -290,7 +298,7 @@ class Live555Demuxer : public IDemuxer, public IRtspCB {
       ESPacket pkt;
       pkt.data = data;
       pkt.size = size;
-      pkt.flags = 0;
+      pkt.flags = (frame_info->flags & FrameInfo::FLAG_KEY_FRAME) ? ESPacket::FLAG_KEY_FRAME : 0;
       pkt.pts = frame_info->pts;
       this->Write(&pkt);
       if (!connect_done_) connect_done_.store(true);
@@ -298,6 +306,7 @@ class Live555Demuxer : public IDemuxer, public IRtspCB {
       if (!connect_done_) {
         // Failed to connect server...
         connect_failed_.store(true);
+        parser_.Interrupt();
         return;
       }
       ESPacket pkt;
@@ -310,18 +319,45 @@ class Live555Demuxer : public IDemuxer, public IRtspCB {
 
   int Write(ESPacket *pkt) {
     if (pkt && pkt->data && pkt->size) {
-        parser_.Parse(pkt->data, pkt->size);
+      // the shared event loop does not wait for the stream info probe, the bitstream is dropped if it does not keep up
+      parser_.Parse(pkt->data, pkt->size, event_loop_num_ == 0);
     }
-    if (queue_) {
-      queue_->Push(std::make_shared<EsPacket>(pkt));
+    if (!queue_) return 0;
+    if (event_loop_num_ > 0 && !(pkt->flags & ESPacket::FLAG_EOS)) {
+      // the shared event loop is not blocked by a slow decoder, packets are dropped until the next key frame
+      if (dropping_ && !(pkt->flags & ESPacket::FLAG_KEY_FRAME)) return -1;
+      dropping_ = !queue_->Push(0, std::make_shared<EsPacket>(pkt));
+      if (dropping_) {
+        MLOG(WARNING) << "Queue is full, drop packets until the next key frame. url: " << url_;
+        return -1;
+      }
+      return 0;
+    }
+    // blocked while the queue is full, until the decoder takes a packet or the handler is closed
+    if (!queue_->InterruptiblePush(std::make_shared<EsPacket>(pkt))) return -1;
+    if (pkt->flags & ESPacket::FLAG_EOS) {
+      std::lock_guard<std::mutex> lk(wait_mutex_);
+      eos_ = true;
+      wait_cond_.notify_all();
     }
     return 0;
   }
 
+  bool IsInterrupted() {
+    std::lock_guard<std::mutex> lk(wait_mutex_);
+    return interrupted_;
+  }
+
  private:
   FrameQueue *queue_ = nullptr;
   std::string url_;
   int reconnect_ = 0;
+  int event_loop_num_ = 0;
+  bool dropping_ = false;
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cond_;
+  bool interrupted_ = false;
+  bool eos_ = false;
   ParserHelper parser_;
   RtspSession rtsp_session_;
   std::atomic<bool> connect_done_{false};
@@ -388,13 +424,21 @@ bool RtspHandlerImpl::Open() {
 
 void RtspHandlerImpl::Close() {
   if (!demux_exit_flag_) {
-    demux_exit_flag_ = 1;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      demux_exit_flag_ = 1;
+      if (demuxer_) demuxer_->Interrupt();
+    }
     if (demux_thread_.joinable()) {
       demux_thread_.join();
     }
   }
   if (!decode_exit_flag_) {
-    decode_exit_flag_ = 1;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      decode_exit_flag_ = 1;
+    }
+    stream_info_cond_.notify_all();
     if (decode_thread_.joinable()) {
       decode_thread_.join();
     }
@@ -410,12 +454,17 @@ void RtspHandlerImpl::DemuxLoop() {
   if (use_ffmpeg_) {
     demuxer = std::make_shared<FFmpegDemuxer>(queue_, url_name_);
   } else {
-    demuxer = std::make_shared<Live555Demuxer>(queue_, url_name_, reconnect_);
+    demuxer = std::make_shared<Live555Demuxer>(queue_, url_name_, reconnect_, param_.rtsp_event_loop_num_);
   }
   if (!demuxer) {
     MLOG(ERROR) << "Failed to create demuxer";
     return;
   }
+  {
+    // interrupted by Close from now on, or exit_flag is already set
+    std::unique_lock<std::mutex> lk(mutex_);
+    demuxer_ = demuxer;
+  }
   if (!demuxer->PrepareResources(demux_exit_flag_)) {
     if (nullptr != module_) {
       Event e;
@@ -434,6 +483,7 @@ void RtspHandlerImpl::DemuxLoop() {
     demuxer->GetInfo(stream_info_);
     stream_info_set_ = true;
   }
+  stream_info_cond_.notify_all();
 
   MLOG(DEBUG) << "RTSP handler DemuxLoop.";
 
@@ -443,6 +493,10 @@ void RtspHandlerImpl::DemuxLoop() {
     }
   }
   demuxer->ClearResources(demux_exit_flag_);
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    demuxer_.reset();
+  }
   MLOG(DEBUG) << "RTSP handler DemuxLoop Exit";
 }
 
@@ -464,12 +518,9 @@ void RtspHandlerImpl::DecodeLoop() {
     }
   }
   // wait stream_info
-  while (!decode_exit_flag_) {
+  {
     std::unique_lock<std::mutex> lk(mutex_);
-    if (stream_info_set_) {
-      break;
-    }
-    usleep(1000);
+    stream_info_cond_.wait(lk, [this] { return stream_info_set_ || decode_exit_flag_; });
   }
   if (decode_exit_flag_) {
     return;
@@ -534,7 +585,7 @@ void RtspHandlerImpl::DecodeLoop() {
 
     RecordStartTime(module_->GetName(), pkt.pts);
 
-    if (!decoder_->Process(&pkt)) {
+    if (!decoder_->ProcessPacket(&pkt, in->PaddedBuffer())) {
       break;
     }
   }
@@ -31,7 +31,9 @@ extern "C" {
 }
 #endif
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -79,6 +81,8 @@ class RtspHandlerImpl : public IHandler {
 
  private:
   std::mutex mutex_;
+  std::condition_variable stream_info_cond_;
+  std::shared_ptr<IDemuxer> demuxer_;  // interrupted by Close
   bool stream_info_set_ = false;
   VideoStreamInfo stream_info_;
   BoundedQueue<std::shared_ptr<EsPacket>> *queue_ = nullptr;
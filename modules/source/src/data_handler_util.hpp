@@ -22,6 +22,7 @@
 #define _CNSTREAM_SOURCE_HANDLER_UTIL_HPP_
 
 #include <assert.h>
+#include <string.h>
 
 #include <atomic>
 #include <condition_variable>
@@ -31,20 +32,27 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <utility>
 
 #include "ffmpeg_parser.hpp"
 #include "data_source.hpp"
+#include "packet_buffer_pool.hpp"
 
 namespace cnstream {
 
 struct EsPacket {
+  // copy data of pkt into a buffer from PacketBufferPool, which is followed by zeroed padding
   explicit EsPacket(ESPacket *pkt) {
     if (pkt && pkt->data && pkt->size) {
-      pkt_.data = new(std::nothrow) unsigned char[pkt->size];
-      if (pkt_.data) {
+      buffer_ = PacketBufferPool::Instance()->Acquire(pkt->size);
+      if (buffer_) {
+        pkt_.data = buffer_->Data();
         memcpy(pkt_.data, pkt->data, pkt->size);
+        memset(pkt_.data + pkt->size, 0, PacketBufferPool::kPaddingSize);
         pkt_.size = pkt->size;
+        padded_ = true;
       } else {
+        pkt_.data = nullptr;
         pkt_.size = 0;
       }
       pkt_.pts = pkt->pts;
@@ -57,16 +65,22 @@ struct EsPacket {
     }
   }
 
-  ~EsPacket() {
-    if (pkt_.data) {
-      delete []pkt_.data, pkt_.data = nullptr;
-    }
-    pkt_.size = 0;
-    pkt_.flags = 0;
-    pkt_.pts = 0;
+  // data of pkt is in buffer already, e.g. a nal unit in a chunk, it is referenced instead of copied
+  EsPacket(ESPacket *pkt, PacketBufferPtr buffer) : buffer_(std::move(buffer)) {
+    pkt_ = *pkt;
+  }
+
+  /**
+   * Get the buffer holding the data if it is followed by zeroed padding, so that the buffer can be referenced by
+   * decoders of ffmpeg. Return nullptr otherwise.
+   */
+  PacketBufferPtr PaddedBuffer() const {
+    return padded_ ? buffer_ : nullptr;
   }
 
   ESPacket pkt_;
+  PacketBufferPtr buffer_;
+  bool padded_ = false;
 };
 
 template<typename T>
@@ -98,6 +112,23 @@ class BoundedQueue {
     return true;
   }
 
+  // blocked while the queue is full, return false if the queue is interrupted
+  bool InterruptiblePush(const T& x) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    notFull_.wait(lk, [this]() {return queue_.size() < maxSize_ || interrupted_; });
+    if (interrupted_) return false;
+    queue_.push(x);
+    notEmpty_.notify_one();
+    return true;
+  }
+
+  // wake up InterruptiblePush blocked in other threads, and fail the later ones
+  void Interrupt() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    interrupted_ = true;
+    notFull_.notify_all();
+  }
+
   T Pop() {
     std::unique_lock<std::mutex> lk(mutex_);
     notEmpty_.wait(lk, [this]() {return !queue_.empty(); });
@@ -137,6 +168,7 @@ class BoundedQueue {
   std::condition_variable notFull_;
   size_t maxSize_;
   std::queue<T> queue_;
+  bool interrupted_ = false;
 };
 
 using FrameQueue = BoundedQueue<std::shared_ptr<EsPacket>>;
@@ -146,6 +178,7 @@ class IDemuxer {
   virtual bool PrepareResources(std::atomic<int> &exit_flag) = 0;  // NOLINT
   virtual void ClearResources(std::atomic<int> &exit_flag) = 0;   // NOLINT
   virtual bool Process() = 0;  // process one frame
+  virtual void Interrupt() {}  // wake up PrepareResources or Process blocked in another thread, called on closing
   bool GetInfo(VideoStreamInfo &info) {  // NOLINT
     std::unique_lock<std::mutex> lk(mutex_);
     if (info_set_) {
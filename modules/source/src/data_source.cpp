@@ -55,6 +55,12 @@ DataSource::DataSource(const std::string &name) : SourceModule(name) {
   param_register_.Register("apply_stride_align_for_scaler",
                            "The output data will align the scaler(hardware on mlu220) requirements."
                            " Recommended for use with scaler on mlu220 platforms.");
+  param_register_.Register("output_packets",
+                           "Whether the compressed packets will be attached to frames besides decoded images."
+                           " It should be true or false.");
+  param_register_.Register("rtsp_event_loop_num",
+                           "How many live555 event loop threads are shared by all rtsp streams."
+                           " 0 by default, each rtsp stream runs its own event loop thread.");
 }
 
 DataSource::~DataSource() {}
@@ -151,6 +157,22 @@ bool DataSource::Open(ModuleParamSet paramSet) {
     param_.apply_stride_align_for_scaler_ = paramSet["apply_stride_align_for_scaler"] == "true";
   }
 
+  param_.output_packets_ = false;
+  if (paramSet.find("output_packets") != paramSet.end()) {
+    param_.output_packets_ = paramSet["output_packets"] == "true";
+  }
+
+  param_.rtsp_event_loop_num_ = 0;
+  if (paramSet.find("rtsp_event_loop_num") != paramSet.end()) {
+    std::stringstream ss;
+    ss << paramSet["rtsp_event_loop_num"];
+    ss >> param_.rtsp_event_loop_num_;
+    if (param_.rtsp_event_loop_num_ < 0) {
+      MLOG(ERROR) << "rtsp_event_loop_num : invalid";
+      return false;
+    }
+  }
+
   return true;
 }
 
@@ -177,7 +199,8 @@ bool DataSource::CheckParamSet(const ModuleParamSet &paramSet) const {
   }
 
   std::string err_msg;
-  if (!checker.IsNum({"interval", "input_buf_number", "output_buf_number"}, paramSet, err_msg, true)) {
+  if (!checker.IsNum({"interval", "input_buf_number", "output_buf_number", "rtsp_event_loop_num"}, paramSet, err_msg,
+                     true)) {
     MLOG(ERROR) << "[DataSource] " << err_msg;
     ret = false;
   }
@@ -201,6 +224,13 @@ bool DataSource::CheckParamSet(const ModuleParamSet &paramSet) const {
     }
   }
 
+  if (paramSet.find("output_packets") != paramSet.end()) {
+    if (paramSet.at("output_packets") != "true" && paramSet.at("output_packets") != "false") {
+      MLOG(ERROR) << "[DataSource] [output_packets] should be true or false";
+      ret = false;
+    }
+  }
+
   return ret;
 }
 
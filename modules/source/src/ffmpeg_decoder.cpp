@@ -58,6 +58,47 @@ static CNDataFormat PixelFmt2CnDataFormat(cncodecPixelFormat pformat) {
   return CNDataFormat::CN_INVALID;
 }
 
+void Decoder::SetPacketCodec(AVCodecID codec_id) {
+  switch (codec_id) {
+    case AV_CODEC_ID_H264:
+      packet_codec_ = CNPacketCodec::H264;
+      break;
+    case AV_CODEC_ID_HEVC:
+      packet_codec_ = CNPacketCodec::HEVC;
+      break;
+    case AV_CODEC_ID_MPEG4:
+      packet_codec_ = CNPacketCodec::MPEG4;
+      break;
+    case AV_CODEC_ID_MJPEG:
+      packet_codec_ = CNPacketCodec::MJPEG;
+      break;
+    default:
+      packet_codec_ = CNPacketCodec::UNKNOWN;
+      break;
+  }
+}
+
+void Decoder::AttachPacket(const uint8_t *data, size_t size, int64_t pts, bool key) {
+  if (!param_.output_packets_ || !data || !size) return;
+  std::shared_ptr<CNPacket> packet = std::make_shared<CNPacket>();
+  packet->data.assign(data, data + size);
+  packet->pts = pts;
+  packet->key = key;
+  packet->codec = packet_codec_;
+  std::lock_guard<std::mutex> lk(packets_mutex_);
+  packets_.push_back(std::move(packet));
+}
+
+void Decoder::TakePackets(CNFrameInfo *data) {
+  if (!param_.output_packets_) return;
+  CNPacketsVec packets;
+  {
+    std::lock_guard<std::mutex> lk(packets_mutex_);
+    packets.swap(packets_);
+  }
+  data->datas[CNPacketsKey] = packets;
+}
+
 bool MluDecoder::Create(AVStream *st, int interval) {
   if (!handler_) {
     return false;
@@ -102,6 +143,7 @@ bool MluDecoder::Create(AVStream *st, int interval) {
 }
 
 bool MluDecoder::Create(VideoStreamInfo *info, int interval) {
+  SetPacketCodec(info->codec_id);
   // create decoder
   if (info->codec_id == AV_CODEC_ID_MJPEG) {
     if (CreateJpegDecoder(info) != true) {
@@ -157,6 +199,7 @@ bool MluDecoder::Process(AVPacket *pkt, bool eos) {
     epkt.data = pkt->data;
     epkt.size = pkt->size;
     epkt.pts = pkt->pts;
+    if (pkt->flags & AV_PKT_FLAG_KEY) epkt.flags |= ESPacket::FLAG_KEY_FRAME;
   } else {
     epkt.flags |= ESPacket::FLAG_EOS;
   }
@@ -167,6 +210,9 @@ bool MluDecoder::Process(ESPacket *pkt) {
   if (cndec_abort_flag_.load() || cndec_error_flag_.load()) {
     return false;
   }
+  if (pkt && !(pkt->flags & ESPacket::FLAG_EOS)) {
+    AttachPacket(pkt->data, pkt->size, pkt->pts, pkt->flags & ESPacket::FLAG_KEY_FRAME);
+  }
   if (instance_) {
     cnvideoDecInput input;
     memset(&input, 0, sizeof(cnvideoDecInput));
@@ -483,6 +529,7 @@ int MluDecoder::ProcessFrame(cnvideoDecOutput *output, bool *reused) {
     MLOG(FATAL) << "MluDecoder:output type not supported";
   }
   data->datas[CNDataFramePtrKey] = dataframe;
+  TakePackets(data.get());
   handler_->SendFrameInfo(data);
   return 0;
 }
@@ -731,6 +778,7 @@ int MluDecoder::ProcessJpegFrame(cnjpegDecOutput *output, bool *reused) {
     MLOG(FATAL) << "MluDecoder:output type not supported";
   }
   data->datas[CNDataFramePtrKey] = dataframe;
+  TakePackets(data.get());
   handler_->SendFrameInfo(data);
   return 0;
 }
@@ -885,6 +933,7 @@ bool FFmpegCpuDecoder::Create(AVStream *st, int interval) {
 #else
   AVCodecID codec_id = st->codec->codec_id;
 #endif
+  SetPacketCodec(codec_id);
   // create decoder
   AVCodec *dec = avcodec_find_decoder(codec_id);
   if (!dec) {
@@ -964,11 +1013,40 @@ bool FFmpegCpuDecoder::Process(ESPacket *pkt) {
     packet.data = pkt->data;
     packet.size = pkt->size;
     packet.pts = pkt->pts;
+    if (pkt->flags & ESPacket::FLAG_KEY_FRAME) packet.flags |= AV_PKT_FLAG_KEY;
     return Process(&packet, false);
   }
   return Process(nullptr, true);
 }
 
+static void UnrefPacketBuffer(void *opaque, uint8_t *data) {
+  delete reinterpret_cast<PacketBufferPtr *>(opaque);
+}
+
+bool FFmpegCpuDecoder::ProcessPacket(ESPacket *pkt, const PacketBufferPtr &buffer) {
+  if (!buffer || !pkt || (pkt->flags & ESPacket::FLAG_EOS)) {
+    return Process(pkt);
+  }
+  // a refcounted packet is referenced by libavcodec, otherwise it is copied
+  PacketBufferPtr *ref = new (std::nothrow) PacketBufferPtr(buffer);
+  if (!ref) return Process(pkt);
+  AVPacket packet;
+  av_init_packet(&packet);
+  packet.buf = av_buffer_create(buffer->Data(), buffer->Capacity() + PacketBufferPool::kPaddingSize,
+                                UnrefPacketBuffer, ref, 0);
+  if (!packet.buf) {
+    delete ref;
+    return Process(pkt);
+  }
+  packet.data = pkt->data;
+  packet.size = pkt->size;
+  packet.pts = pkt->pts;
+  if (pkt->flags & ESPacket::FLAG_KEY_FRAME) packet.flags |= AV_PKT_FLAG_KEY;
+  bool ret = Process(&packet, false);
+  av_buffer_unref(&packet.buf);
+  return ret;
+}
+
 bool FFmpegCpuDecoder::Process(AVPacket *pkt, bool eos) {
   MLOG_IF(INFO, eos) << "[FFmpegCpuDecoder]  " << (int64_t)this << " send eos.";
   if (eos) {
@@ -989,6 +1067,7 @@ bool FFmpegCpuDecoder::Process(AVPacket *pkt, bool eos) {
     eos_got_.store(1);
     return false;
   }
+  AttachPacket(pkt->data, pkt->size, pkt->pts, pkt->flags & AV_PKT_FLAG_KEY);
   int got_frame = 0;
   int ret = avcodec_decode_video2(instance_, av_frame_, &got_frame, pkt);
   if (ret < 0) {
@@ -1194,6 +1273,7 @@ bool FFmpegCpuDecoder::ProcessFrame(AVFrame *frame) {
   dataframe->frame_id = frame_id_++;
   data->timestamp = frame->pts;
   data->datas[CNDataFramePtrKey] = dataframe;
+  TakePackets(data.get());
   if (sp_data) CNStreamFreeHost(sp_data);
   handler_->SendFrameInfo(data);
   return true;
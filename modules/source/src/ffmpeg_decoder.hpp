@@ -37,6 +37,7 @@ extern "C" {
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include "cn_jpeg_dec.h"
@@ -47,6 +48,7 @@ extern "C" {
 #include "data_source.hpp"
 #include "device/mlu_context.h"
 #include "ffmpeg_parser.hpp"
+#include "packet_buffer_pool.hpp"
 #include "perf_manager.hpp"
 
 namespace cnstream {
@@ -89,14 +91,37 @@ class Decoder {
   virtual bool Create(VideoStreamInfo *info, int interval) { return false; }
   virtual bool Process(AVPacket *pkt, bool eos) { return false; }
   virtual bool Process(ESPacket *pkt) { return false; }
+  /**
+   * Process a packet which data is at the beginning of buffer and followed by zeroed padding, decoders may reference
+   * the buffer instead of copying the data. buffer is nullptr if the data is not in such a buffer.
+   */
+  virtual bool ProcessPacket(ESPacket *pkt, const PacketBufferPtr &buffer) { return Process(pkt); }
   virtual void Destroy() = 0;
 
  protected:
+  /**
+   * Keep a copy of the compressed packet when packets are attached to frames (output_packets_).
+   * Called before the packet is fed to the decoder.
+   */
+  void AttachPacket(const uint8_t *data, size_t size, int64_t pts, bool key);
+  /**
+   * Move the packets kept since the last sent frame to the frame. Packets of discarded frames go with the next
+   * frame, packets kept after the last frame are dropped at eos.
+   */
+  void TakePackets(CNFrameInfo *data);
+  void SetPacketCodec(AVCodecID codec_id);
+
   IHandler *handler_;
   DataSourceParam param_;
   size_t interval_ = 1;
   size_t frame_count_ = 0;
   uint64_t frame_id_ = 0;
+
+ private:
+  // decoders of mlu send frames on callback threads
+  std::mutex packets_mutex_;
+  CNPacketsVec packets_;
+  CNPacketCodec packet_codec_ = CNPacketCodec::UNKNOWN;
 };
 
 class MluDecoder : public Decoder {
@@ -199,6 +224,7 @@ class FFmpegCpuDecoder : public Decoder {
   void Destroy() override;
   bool Process(ESPacket *pkt) override;
   bool Process(AVPacket *pkt, bool eos) override;
+  bool ProcessPacket(ESPacket *pkt, const PacketBufferPtr &buffer) override;
 
  private:
 #ifdef UNIT_TEST
@@ -58,6 +58,21 @@ size_t RingBuffer::Write(const void *data, const size_t bytes) {
       return -1;
     }
   }
+  return WriteLocked(data, bytes);
+}
+
+size_t RingBuffer::TryWrite(const void *data, const size_t bytes) {
+  if (bytes == 0) return 0;
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  if ((capacity_ - size_) < bytes) {
+    return -1;
+  }
+  return WriteLocked(data, bytes);
+}
+
+size_t RingBuffer::WriteLocked(const void *data, const size_t bytes) {
+  const auto capacity = capacity_;
   const auto bytes_to_write = bytes;
   if (bytes_to_write <= capacity - rear_) {
     memcpy(data_ + rear_, data, bytes_to_write);
@@ -161,17 +176,31 @@ class StreamParserImpl {
     }
   }
 
-  int Parse(unsigned char *bitstream, int size);
+  int Parse(unsigned char *bitstream, int size, bool block);
   int GetInfo(VideoStreamInfo &info);  // NOLINT
+  int WaitInfo(VideoStreamInfo &info, int timeout_ms);  // NOLINT
+  void Interrupt() {
+    std::lock_guard<std::mutex> lk(info_mutex_);
+    interrupted_ = true;
+    info_cond_.notify_all();
+  }
 
  private:
   void FindInfo();
+  void SetInfoGot(int info_got) {
+    std::lock_guard<std::mutex> lk(info_mutex_);
+    info_got_.store(info_got);
+    info_cond_.notify_all();
+  }
   static constexpr int io_buffer_size_ = 32768;
   std::string fmt_;
   RingBuffer *queue_ = nullptr;
   std::promise<VideoStreamInfo> promise_;
   std::atomic<int> info_got_{0};
   std::atomic<int> info_ready_{0};
+  std::mutex info_mutex_;
+  std::condition_variable info_cond_;
+  bool interrupted_ = false;
   VideoStreamInfo info_;
   std::thread thread_;
 };  // class StreamParserImpl
@@ -197,9 +226,9 @@ void StreamParser::Close() {
   }
 }
 
-int StreamParser::Parse(unsigned char *bitstream, int size) {
+int StreamParser::Parse(unsigned char *bitstream, int size, bool block) {
   if (impl_) {
-    return impl_->Parse(bitstream, size);
+    return impl_->Parse(bitstream, size, block);
   }
   return -1;
 }
@@ -211,6 +240,19 @@ int StreamParser::GetInfo(VideoStreamInfo &info) {
   return -1;
 }
 
+int StreamParser::WaitInfo(VideoStreamInfo &info, int timeout_ms) {
+  if (impl_) {
+    return impl_->WaitInfo(info, timeout_ms);
+  }
+  return -1;
+}
+
+void StreamParser::Interrupt() {
+  if (impl_) {
+    impl_->Interrupt();
+  }
+}
+
 static int read_packet(void *opaque, uint8_t *buf, int buf_size) {
   RingBuffer *queue_ = reinterpret_cast<RingBuffer*>(opaque);
   if (queue_) {
@@ -313,14 +355,14 @@ void StreamParserImpl::FindInfo() {
   avio = avio_alloc_context(io_buffer, io_buffer_size_, 0, this->queue_, &read_packet, nullptr, nullptr);
   if (!avio) {
     av_free(io_buffer);
-    info_got_.store(-1);
+    SetInfoGot(-1);
     return;
   }
   ic = avformat_alloc_context();
   if (!ic) {
     av_freep(&avio->buffer);
     av_free(avio);
-    info_got_.store(-1);
+    SetInfoGot(-1);
     return;
   }
   ic->pb = avio;
@@ -339,7 +381,7 @@ void StreamParserImpl::FindInfo() {
     av_free(avio);
     ic->pb = nullptr;
     avformat_close_input(&ic);
-    info_got_.store(-1);
+    SetInfoGot(-1);
     return;
   }
 
@@ -348,7 +390,7 @@ void StreamParserImpl::FindInfo() {
     av_free(avio);
     ic->pb = nullptr;
     avformat_close_input(&ic);
-    info_got_.store(-1);
+    SetInfoGot(-1);
     return;
   }
 
@@ -359,12 +401,12 @@ void StreamParserImpl::FindInfo() {
     av_free(avio);
     ic->pb = nullptr;
     avformat_close_input(&ic);
-    info_got_.store(-1);
+    SetInfoGot(-1);
     return;
   }
 
   promise_.set_value(info);
-  info_got_.store(1);
+  SetInfoGot(1);
 
   MLOG(INFO) << this << " codec_id = " << info.codec_id;
   MLOG(INFO) << this << " framerate = " << info.framerate.num << "/" << info.framerate.den;
@@ -376,7 +418,7 @@ void StreamParserImpl::FindInfo() {
   return;
 }
 
-int StreamParserImpl::Parse(unsigned char *buf, int size) {
+int StreamParserImpl::Parse(unsigned char *buf, int size, bool block) {
   if (info_got_.load() == -1) {
     MLOG(ERROR) << this << " Parse info failed.";
     return -1;
@@ -390,6 +432,12 @@ int StreamParserImpl::Parse(unsigned char *buf, int size) {
     return 0;
   }
   // feed frame-bitstream
+  if (!block) {
+    if (static_cast<int>(queue_->TryWrite(buf, size)) < 0) {
+      MLOG(WARNING) << this << " Parser buffer is full, drop " << size << " bytes";
+    }
+    return 0;
+  }
   int offset = 0;
   while (1) {
     int bytes = queue_->Write(buf + offset, size - offset);
@@ -423,6 +471,19 @@ int StreamParserImpl::GetInfo(VideoStreamInfo &info) {
   return 0;
 }
 
+int StreamParserImpl::WaitInfo(VideoStreamInfo &info, int timeout_ms) {
+  {
+    std::unique_lock<std::mutex> lk(info_mutex_);
+    auto pred = [this] { return info_got_.load() != 0 || interrupted_; };
+    if (timeout_ms < 0) {
+      info_cond_.wait(lk, pred);
+    } else {
+      info_cond_.wait_for(lk, std::chrono::milliseconds(timeout_ms), pred);
+    }
+  }
+  return GetInfo(info);
+}
+
 static int FindStartCode(unsigned char *buf) {
   if (buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] == 1) {
     return 4;
@@ -483,11 +544,7 @@ static int GetNaluH2645(unsigned char *buf, int len, bool isH264, std::vector<Na
   return 0;
 }
 
-H2645NalSplitter::~H2645NalSplitter() {
-  if (es_buffer_) {
-    delete[] es_buffer_, es_buffer_ = nullptr;
-  }
-}
+H2645NalSplitter::~H2645NalSplitter() {}
 
 int H2645NalSplitter::SplitterWriteFrame(unsigned char *buf, int len) {
   if (buf && len) {
@@ -515,24 +572,30 @@ int H2645NalSplitter::SplitterWriteFrame(unsigned char *buf, int len) {
 
 int H2645NalSplitter::SplitterWriteChunk(unsigned char *buf, int len) {
   static const int max_es_buffer_size = 1024 * 1024;
+  static const int min_chunk_buffer_size = 256 * 1024;
   if (buf && len) {
-    if (!es_buffer_) {
-      es_buffer_ = new(std::nothrow) unsigned char[max_es_buffer_size];
-      if (!es_buffer_) {
-        MLOG(ERROR) << "Failed to alloc es_buffer";
-        return -1;
-      }
-      es_len_ = 0;
-    }
     if (es_len_ + len > max_es_buffer_size) {
       MLOG(ERROR) << "Buffer overflow...FIXME";
       return -1;
     }
-    memcpy(es_buffer_ + es_len_, buf, len);
+    // nal units are sent as slices of es_buffer_ without copying, data after them is never changed, so chunks are
+    // appended to es_buffer_ until it is full, then only the incomplete nal unit is copied to a new buffer.
+    if (!es_buffer_ || es_start_ + es_len_ + len > static_cast<int>(es_buffer_->Capacity())) {
+      PacketBufferPtr buffer = PacketBufferPool::Instance()->Acquire(std::max(es_len_ + len, min_chunk_buffer_size));
+      if (!buffer) {
+        MLOG(ERROR) << "Failed to alloc es_buffer";
+        return -1;
+      }
+      if (es_len_) memcpy(buffer->Data(), es_buffer_->Data() + es_start_, es_len_);
+      es_buffer_ = buffer;
+      es_start_ = 0;
+    }
+    unsigned char *es_data = es_buffer_->Data() + es_start_;
+    memcpy(es_data + es_len_, buf, len);
     es_len_ += len;
 
     std::vector<NalDesc> vec_desc;
-    int ret = GetNaluH2645(es_buffer_, es_len_, isH264_, vec_desc);
+    int ret = GetNaluH2645(es_data, es_len_, isH264_, vec_desc);
     if (ret < 0) {
       MLOG(ERROR) << "Get h264/5 nalu failed.";
       return ret;
@@ -543,6 +606,7 @@ int H2645NalSplitter::SplitterWriteChunk(unsigned char *buf, int len) {
       vec_desc.pop_back();
 
       for (auto &it : vec_desc) {
+        it.buffer = es_buffer_;
         int ret = this->SplitterOnNal(it, false);
         if (ret < 0) {
           MLOG(ERROR) << "Write h264/5 nalu failed.";
@@ -550,10 +614,8 @@ int H2645NalSplitter::SplitterWriteChunk(unsigned char *buf, int len) {
         }
       }
 
-      if (desc.len != es_len_) {
-        memmove(es_buffer_, desc.nal, desc.len);
-        es_len_ = desc.len;
-      }
+      es_start_ += desc.nal - es_data;
+      es_len_ = desc.len;
     }
     return 0;
   }
@@ -561,8 +623,9 @@ int H2645NalSplitter::SplitterWriteChunk(unsigned char *buf, int len) {
   // flush data...
   if (es_buffer_ && es_len_) {
     NalDesc desc;
-    desc.nal = es_buffer_;
+    desc.nal = es_buffer_->Data() + es_start_;
     desc.len = es_len_;
+    desc.buffer = es_buffer_;
     if (es_len_ > 4) {
       int type_idx = (desc.nal[2] == 1) ? 3 : 4;
       if (isH264_) {
@@ -35,10 +35,13 @@ extern "C" {
 #include <thread>
 #include <future>
 #include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include "packet_buffer_pool.hpp"
+
 /**
  * one writer and one reader
  */
@@ -54,9 +57,14 @@ class RingBuffer {
     return capacity_;
   }
   size_t Write(const void *data, size_t bytes);
+  /**
+   * write all the bytes without waiting, return -1 if there is not enough space.
+   */
+  size_t TryWrite(const void *data, size_t bytes);
   size_t Read(void *data, size_t bytes);
 
  private:
+  size_t WriteLocked(const void *data, size_t bytes);
   RingBuffer(RingBuffer &&) = delete;
   RingBuffer& operator=(RingBuffer&&) = delete;
   RingBuffer(const RingBuffer &) = delete;
@@ -89,8 +97,21 @@ class StreamParser {
   ~StreamParser();
   int Open(std::string fmt = "");
   void Close();
-  int Parse(unsigned char *bitstream, int size);
+  /**
+   * feed the bitstream to probe the stream info. If block is false, the bitstream is dropped instead of waiting
+   * while the buffer is full, i.e. the probe does not keep up.
+   */
+  int Parse(unsigned char *bitstream, int size, bool block = true);
   int GetInfo(VideoStreamInfo &info);  // NOLINT
+  /**
+   * wait until stream info is got or failed, or the wait is interrupted, return 0 if it is not got
+   * in timeout_ms or interrupted, otherwise the same as GetInfo. timeout_ms < 0 means no timeout.
+   */
+  int WaitInfo(VideoStreamInfo &info, int timeout_ms);  // NOLINT
+  /**
+   * wake up WaitInfo blocked in another thread, and the later ones return at once.
+   */
+  void Interrupt();
 
  private:
   StreamParser(const StreamParser &) = delete;
@@ -111,7 +132,7 @@ class ParserHelper {
     return 0;
   }
 
-  int Parse(unsigned char *bitstream, int size) {
+  int Parse(unsigned char *bitstream, int size, bool block = true) {
     std::unique_lock<std::mutex> lk(mutex_status_);
     if (status_ == STATUS_INIT) {
       if (parser_.Open(fmt_) < 0) {
@@ -121,13 +142,11 @@ class ParserHelper {
     }
 
     if (status_ == STATUS_START) {
-      int ret = parser_.Parse(bitstream, size);
+      int ret = parser_.Parse(bitstream, size, block);
       if (ret < 0) {
         return -1;
       } else if (1 == ret) {
         status_ = STATUS_DONE;
-      } else {
-        usleep(1000 * 30);
       }
     }
     return 0;
@@ -146,6 +165,14 @@ class ParserHelper {
     return parser_.GetInfo(info);
   }
 
+  int WaitInfo(VideoStreamInfo &info, int timeout_ms) {  // NOLINT
+    std::unique_lock<std::mutex> lk(mutex_getinfo_);
+    return parser_.WaitInfo(info, timeout_ms);
+  }
+
+  // not locked, WaitInfo blocked in another thread holds the lock
+  void Interrupt() { parser_.Interrupt(); }
+
  private:
   ParserHelper(const ParserHelper&) = delete;
   ParserHelper& operator=(const ParserHelper&) = delete;
@@ -168,6 +195,7 @@ struct NalDesc {
   unsigned char *nal = nullptr;
   int len = 0;
   int type = -1;
+  PacketBufferPtr buffer;  // holds nal if it is in a pooled buffer
 };
 
 class H2645NalSplitter {
@@ -182,7 +210,8 @@ class H2645NalSplitter {
   virtual int SplitterOnNal(NalDesc &desc, bool eos) = 0;  // NOLINT
  private:
   bool isH264_ = true;
-  unsigned char *es_buffer_ = nullptr;
+  PacketBufferPtr es_buffer_;
+  int es_start_ = 0;  // offset of the incomplete nal unit in es_buffer_
   int es_len_ = 0;
 };  // class H2645NalSplitter
 
@@ -0,0 +1,101 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "packet_buffer_pool.hpp"
+
+#include <new>
+
+namespace cnstream {
+
+constexpr size_t PacketBufferPool::kPaddingSize;
+constexpr size_t PacketBufferPool::kMinSlabSize;
+constexpr size_t PacketBufferPool::kMaxSlabSize;
+
+PacketBufferPool *PacketBufferPool::Instance() {
+  static PacketBufferPool *pool = new PacketBufferPool();
+  return pool;
+}
+
+PacketBufferPool::PacketBufferPool(size_t max_cached_bytes) : max_cached_bytes_(max_cached_bytes) {
+  int slab_num = 1;
+  for (size_t capacity = kMinSlabSize; capacity < kMaxSlabSize; capacity <<= 1) slab_num++;
+  slabs_ = std::vector<Slab>(slab_num);
+}
+
+PacketBufferPool::~PacketBufferPool() {
+  for (auto &slab : slabs_) {
+    for (PacketBuffer *buffer : slab.buffers) {
+      delete[] buffer->data_;
+      delete buffer;
+    }
+  }
+}
+
+PacketBufferPtr PacketBufferPool::Acquire(size_t size) {
+  int slab = 0;
+  size_t capacity = kMinSlabSize;
+  while (capacity < size && capacity < kMaxSlabSize) {
+    capacity <<= 1;
+    slab++;
+  }
+  PacketBuffer *buffer = nullptr;
+  if (capacity < size) {
+    capacity = size;
+    slab = -1;
+  } else {
+    std::lock_guard<std::mutex> lk(slabs_[slab].mutex);
+    if (!slabs_[slab].buffers.empty()) {
+      buffer = slabs_[slab].buffers.back();
+      slabs_[slab].buffers.pop_back();
+    }
+  }
+  if (buffer) {
+    cached_bytes_ -= capacity;
+    recycled_num_++;
+  } else {
+    uint8_t *data = new (std::nothrow) uint8_t[capacity + kPaddingSize];
+    if (!data) return nullptr;
+    buffer = new (std::nothrow) PacketBuffer(data, capacity, slab);
+    if (!buffer) {
+      delete[] data;
+      return nullptr;
+    }
+    allocated_num_++;
+  }
+  return PacketBufferPtr(buffer, [this](PacketBuffer *buffer) { Release(buffer); });
+}
+
+void PacketBufferPool::Release(PacketBuffer *buffer) {
+  if (buffer->slab_ >= 0) {
+    // bytes are reserved before the buffer is cached, so buffers released together never exceed max cached bytes
+    size_t cached_bytes = cached_bytes_.load();
+    while (cached_bytes + buffer->capacity_ <= max_cached_bytes_) {
+      if (cached_bytes_.compare_exchange_weak(cached_bytes, cached_bytes + buffer->capacity_)) {
+        std::lock_guard<std::mutex> lk(slabs_[buffer->slab_].mutex);
+        slabs_[buffer->slab_].buffers.push_back(buffer);
+        return;
+      }
+    }
+  }
+  delete[] buffer->data_;
+  delete buffer;
+}
+
+}  // namespace cnstream
@@ -19,15 +19,29 @@
  *************************************************************************/
 
 #include "rtsp_client.hpp"
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
+
+#include "packet_buffer_pool.hpp"
 
 #ifdef HAVE_LIVE555
 
 #include "BasicUsageEnvironment.hh"
 #include "liveMedia.hh"
-#include "util/cnstream_timer.hpp"
+#include "util/cnstream_timer_wheel.hpp"
 
 // Forward function definitions:
 
@@ -81,7 +95,8 @@ class StreamClientState {
 // separate "StreamClientState" structure for each "RTSPClient".  To do this, we subclass "RTSPClient", and add a
 // "StreamClientState" field to the subclass:
 
-static cnstream::Timer s_rtspTimer;
+// liveness timers of all clients, postponed at each received frame
+static cnstream::TimerWheel s_rtspTimerWheel(std::chrono::milliseconds(10));
 
 class ourRTSPClient : public RTSPClient {
  public:
@@ -99,18 +114,22 @@ class ourRTSPClient : public RTSPClient {
   bool streammingPreferTcp = true;
   bool streammingOverTcp = true;
   bool setupOk = false;
-  char* eventLoopWatchVariable = nullptr;
   StreamClientState scs;
+  // called in the event loop when the stream is closed
+  std::function<void()> onClosed;
+  // called in the timer thread when no frame is received in livenessTimeoutMs
+  std::function<void()> onLivenessTimeout;
 
   // Use a timer to check liveness
   //
   int livenessTimeoutMs = 2000;
-  cnstream::timer_id timer_id_;
+  cnstream::TimerWheel::TimerId timer_id_ = 0;
   void resetLivenessTimer() {
-    s_rtspTimer.remove(timer_id_);
-    timer_id_ = s_rtspTimer.add(std::chrono::milliseconds(livenessTimeoutMs), [&](cnstream::timer_id) {
-      *eventLoopWatchVariable = 2;
+    // only the deadline is updated if the timer is not expired
+    if (s_rtspTimerWheel.Reschedule(timer_id_)) return;
+    timer_id_ = s_rtspTimerWheel.Add(std::chrono::milliseconds(livenessTimeoutMs), [this] {
       envir() << "Liveness timeout occured, shutdown stream...\n";
+      if (onLivenessTimeout) onLivenessTimeout();
     });
   }
   cnstream::IRtspCB* cb_ = nullptr;
@@ -428,8 +447,10 @@ void shutdownStream(RTSPClient* rtspClient, int exitCode) {
     }
   }
 
-  // leave the LIVE555 event loop
-  (*((ourRTSPClient*)rtspClient)->eventLoopWatchVariable) = 1;
+  // leave the LIVE555 event loop, or reconnect in the shared event loop
+  if (((ourRTSPClient*)rtspClient)->onClosed) {
+    ((ourRTSPClient*)rtspClient)->onClosed();
+  }
 
   env << *rtspClient << "Closing the stream.\n";
   Medium::close(rtspClient);
@@ -467,7 +488,7 @@ ourRTSPClient::ourRTSPClient(UsageEnvironment& env, char const* rtspURL, int ver
 
 ourRTSPClient::~ourRTSPClient() {
   envir() << "ourRTSPClient::~ourRTSPClient() called\n";
-  s_rtspTimer.remove(timer_id_);
+  s_rtspTimerWheel.Remove(timer_id_);
   delete authenticator_, authenticator_ = nullptr;
 }
 
@@ -527,6 +548,7 @@ DummySink::DummySink(UsageEnvironment& env, MediaSubsession& subsession, char co
       tmp += 4 + sps[i].sPropLength;
     }
   }
+  delete[] sps;
 }
 
 DummySink::~DummySink() {
@@ -570,7 +592,11 @@ void DummySink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes
 
   if (client->cb_ && cnstream::FrameInfo::INVALID != frameInfo.codec_type) {
     if (firstFrame) {
-      client->cb_->OnFrame(paramset, paramset_size, &frameInfo);
+      // no parameter sets in SDP, they are sent in the stream
+      if (paramset && paramset_size) {
+        frameInfo.flags = cnstream::FrameInfo::FLAG_KEY_FRAME;
+        client->cb_->OnFrame(paramset, paramset_size, &frameInfo);
+      }
       firstFrame = false;
     }
     /*H264/H265, video frame*/
@@ -579,6 +605,13 @@ void DummySink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes
     fReceiveBuffer[2] = 0x00;
     fReceiveBuffer[3] = 0x01;
     frameInfo.pts = fSubsession.getNormalPlayTime(presentationTime) * 90000;
+    // a NAL unit is received each time, parameter sets and IRAP pictures start a decodable sequence
+    int nal_type = frameInfo.codec_type == cnstream::FrameInfo::H264 ? (fReceiveBuffer[4] & 0x1f)
+                                                                      : ((fReceiveBuffer[4] >> 1) & 0x3f);
+    bool key = frameInfo.codec_type == cnstream::FrameInfo::H264 ? (nal_type == 5 || nal_type == 7 || nal_type == 8)
+                                                                  : (nal_type >= 16 && nal_type <= 23) ||
+                                                                        (nal_type >= 32 && nal_type <= 34);
+    frameInfo.flags = frameSize && key ? cnstream::FrameInfo::FLAG_KEY_FRAME : 0;
     client->cb_->OnFrame(fReceiveBuffer, frameSize + 4, &frameInfo);
   }
 
@@ -596,10 +629,407 @@ Boolean DummySink::continuePlaying() {
   return True;
 }
 
+// A LIVE555 event loop shared by RTSP sessions. LIVE555 objects of the sessions are only accessed in the loop thread,
+// other threads post tasks to the loop, which wake up the loop by an event trigger.
+class RtspEventLoop {
+ public:
+  // Acquire the event loop with the least sessions of loopNum loops, the loop is created if it is not running, and
+  // stops when all the sessions release it.
+  static std::shared_ptr<RtspEventLoop> Acquire(int loopNum) {
+    static std::mutex s_mutex;
+    static std::vector<std::weak_ptr<RtspEventLoop>> s_loops;
+    std::lock_guard<std::mutex> lk(s_mutex);
+    if (s_loops.size() < static_cast<size_t>(loopNum)) s_loops.resize(loopNum);
+    int index = 0;
+    long minSessionNum = LONG_MAX;  // NOLINT
+    for (int i = 0; i < loopNum; ++i) {
+      long sessionNum = s_loops[i].use_count();  // NOLINT
+      if (sessionNum < minSessionNum) {
+        minSessionNum = sessionNum;
+        index = i;
+      }
+    }
+    std::shared_ptr<RtspEventLoop> loop = s_loops[index].lock();
+    if (!loop) {
+      loop = std::make_shared<RtspEventLoop>();
+      if (!loop->Start()) return nullptr;
+      s_loops[index] = loop;
+    }
+    return loop;
+  }
+
+  RtspEventLoop() {}
+  ~RtspEventLoop() {
+    if (thread_.joinable()) {
+      Post([this] { watchVariable_ = 1; });
+      thread_.join();
+    }
+  }
+
+  bool Start() {
+    std::promise<bool> started;
+    std::future<bool> future = started.get_future();
+    thread_ = std::thread(&RtspEventLoop::Loop, this, &started);
+    if (!future.get()) {
+      thread_.join();
+      return false;
+    }
+    return true;
+  }
+
+  // tasks are run in the loop thread in the order they are posted, the event is triggered with the lock held, as the
+  // scheduler is deleted once the loop thread runs the stop task
+  void Post(std::function<void()> task) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!scheduler_) return;
+    tasks_.push_back(std::move(task));
+    scheduler_->triggerEvent(triggerId_, this);
+  }
+
+  UsageEnvironment* Env() { return env_; }
+
+ private:
+  static void TriggerHandler(void* clientData) {
+    RtspEventLoop* loop = reinterpret_cast<RtspEventLoop*>(clientData);
+    std::vector<std::function<void()>> tasks;
+    {
+      std::lock_guard<std::mutex> lk(loop->mutex_);
+      tasks.swap(loop->tasks_);
+    }
+    for (auto& task : tasks) task();
+  }
+
+  void Loop(std::promise<bool>* started) {
+    scheduler_ = BasicTaskScheduler::createNew();
+    env_ = BasicUsageEnvironment::createNew(*scheduler_);
+    triggerId_ = scheduler_->createEventTrigger(TriggerHandler);
+    started->set_value(triggerId_ != 0);
+    if (triggerId_ != 0) {
+      scheduler_->doEventLoop(&watchVariable_);
+    }
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (triggerId_ != 0) scheduler_->deleteEventTrigger(triggerId_);
+    env_->reclaim();
+    env_ = nullptr;
+    delete scheduler_;
+    scheduler_ = nullptr;
+  }
+
+  TaskScheduler* scheduler_ = nullptr;
+  UsageEnvironment* env_ = nullptr;
+  EventTriggerId triggerId_ = 0;
+  char watchVariable_ = 0;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::vector<std::function<void()>> tasks_;
+};
+
 #endif  // HAVE_LIVE555
 
 namespace cnstream {
 
+// Frames of a session go to the callback and the consumers through RtspFrameDispatcher, which keeps the parameter
+// sets and the last GOP of the stream. After each connection, frames before the first key frame are dropped, and the
+// cached parameter sets are sent before the key frame if the server has not sent them since connected. Key frames
+// are IRAP pictures, recovery point SEIs and H.264 I slices.
+class RtspFrameDispatcher : public IRtspCB {
+ public:
+  void Init(IRtspCB* cb, size_t gopCacheSize) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    cb_ = cb;
+    gopCacheSize_ = gopCacheSize;
+  }
+
+  // called before a connection starts
+  void OnConnect() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    waitKeyFrame_ = true;
+    paramSetsSent_ = false;
+    lastStart_ = false;
+    recoveryPending_ = false;
+    received_ = false;
+  }
+
+  // whether frames are received since the connection started
+  bool Received() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return received_;
+  }
+
+  void AddConsumer(IRtspCB* cb) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    Consumer consumer;
+    consumer.cb = cb;
+    if (!gop_.empty()) {
+      for (auto& frame : gop_) {
+        FrameInfo info = frame.info;
+        cb->OnFrame(frame.buffer->Data(), frame.size, &info);
+      }
+      consumer.waitKeyFrame = false;
+    }
+    consumers_.push_back(consumer);
+  }
+
+  void RemoveConsumer(IRtspCB* cb) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    consumers_.erase(std::remove_if(consumers_.begin(), consumers_.end(),
+                                    [cb](const Consumer& consumer) { return consumer.cb == cb; }),
+                     consumers_.end());
+  }
+
+  void OnFrame(unsigned char* data, size_t size, FrameInfo* frameInfo) override {
+    if (!data || !size || !frameInfo) {
+      // the end of stream has no frame info, empty frames are dropped
+      if (frameInfo) return;
+      IRtspCB* cb;
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (auto& consumer : consumers_) consumer.cb->OnFrame(data, size, frameInfo);
+        cb = cb_;
+      }
+      if (cb) cb->OnFrame(data, size, frameInfo);
+      return;
+    }
+    bool h264 = frameInfo->codec_type == FrameInfo::H264;
+    int type = GetNalType(data, size, h264);
+    bool paramSet = h264 ? (type == 7 || type == 8) : (type >= 32 && type <= 34);
+    bool irap = h264 ? type == 5 : (type >= 16 && type <= 23);
+    bool slice = h264 ? (type >= 1 && type <= 5) : (type >= 0 && type <= 31);
+    // cameras with intra refresh or open GOPs may never send IDR pictures, decoding also starts from a recovery point
+    // SEI, or an I slice of H.264
+    bool recovery = IsRecoveryPoint(data, size, h264);
+    bool startSlice = irap || (h264 && type == 1 && IsISlice(data, size));
+    FrameInfo startInfo = *frameInfo;  // start points which are not IRAP pictures are marked as key frames as well
+    if (recovery || startSlice) startInfo.flags |= FrameInfo::FLAG_KEY_FRAME;
+    frameInfo = &startInfo;
+    std::vector<unsigned char> paramSets;  // sent before the key frame
+    IRtspCB* cb;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      cb = cb_;
+      received_ = true;
+      bool keyFrameStart =
+          recovery || (startSlice && !recoveryPending_ && (!lastStart_ || IsFirstSlice(data, size, h264)));
+      if (paramSet) {
+        SaveParamSets(data, size, h264);
+        paramSetsSent_ = true;
+      } else if (keyFrameStart) {
+        GetParamSets(&paramSets);
+        if (paramSetsSent_) paramSets.clear();
+        StartGop(frameInfo);
+        paramSetsSent_ = true;
+        waitKeyFrame_ = false;
+      } else if (waitKeyFrame_) {
+        return;
+      }
+      if (slice) {
+        lastStart_ = startSlice;
+        recoveryPending_ = false;
+      } else if (!paramSet) {
+        lastStart_ = false;
+        recoveryPending_ = recovery;
+      }
+      if (!paramSet) CacheFrame(data, size, frameInfo);
+      for (auto& consumer : consumers_) {
+        if (consumer.waitKeyFrame) {
+          if (!keyFrameStart) continue;
+          // the consumer starts from the parameter sets cached before the key frame
+          std::vector<unsigned char> cached;
+          GetParamSets(&cached);
+          if (!cached.empty()) {
+            FrameInfo info = *frameInfo;
+            info.flags = FrameInfo::FLAG_KEY_FRAME;
+            consumer.cb->OnFrame(cached.data(), cached.size(), &info);
+          }
+          consumer.waitKeyFrame = false;
+        } else if (!paramSets.empty()) {
+          FrameInfo info = *frameInfo;
+          info.flags = FrameInfo::FLAG_KEY_FRAME;
+          consumer.cb->OnFrame(paramSets.data(), paramSets.size(), &info);
+        }
+        consumer.cb->OnFrame(data, size, frameInfo);
+      }
+    }
+    if (!cb) return;
+    if (!paramSets.empty()) {
+      FrameInfo info = *frameInfo;
+      info.flags = FrameInfo::FLAG_KEY_FRAME;
+      cb->OnFrame(paramSets.data(), paramSets.size(), &info);
+    }
+    cb->OnFrame(data, size, frameInfo);
+  }
+
+  void OnEvent(int type) override {
+    IRtspCB* cb;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      for (auto& consumer : consumers_) consumer.cb->OnEvent(type);
+      cb = cb_;
+    }
+    if (cb) cb->OnEvent(type);
+  }
+
+ private:
+  struct Consumer {
+    IRtspCB* cb = nullptr;
+    bool waitKeyFrame = true;
+  };
+
+  struct CachedFrame {
+    PacketBufferPtr buffer;
+    size_t size;
+    FrameInfo info;
+  };
+
+  static size_t StartCodeSize(const unsigned char* data, size_t size) { return (size > 3 && data[2] == 1) ? 3 : 4; }
+
+  // type of the first nal unit, data starts with a start code
+  static int GetNalType(const unsigned char* data, size_t size, bool h264) {
+    size_t offset = StartCodeSize(data, size);
+    if (size <= offset) return -1;
+    return h264 ? (data[offset] & 0x1f) : ((data[offset] >> 1) & 0x3f);
+  }
+
+  // whether the slice starts a picture, first_mb_in_slice of H.264 is 0, which is coded as a single bit 1 of ue(v), and
+  // first_slice_segment_in_pic_flag of H.265 is 1, both are the first bit after the nal unit header
+  static bool IsFirstSlice(const unsigned char* data, size_t size, bool h264) {
+    size_t offset = StartCodeSize(data, size) + (h264 ? 1 : 2);
+    if (size <= offset) return false;
+    return (data[offset] & 0x80) != 0;
+  }
+
+  // whether the nal unit is a SEI, of which the first message is a recovery point, i.e. payload type 6
+  static bool IsRecoveryPoint(const unsigned char* data, size_t size, bool h264) {
+    if (GetNalType(data, size, h264) != (h264 ? 6 : 39)) return false;
+    size_t offset = StartCodeSize(data, size) + (h264 ? 1 : 2);
+    int payloadType = 0;
+    for (; offset < size && data[offset] == 0xff; ++offset) payloadType += 255;
+    return offset < size && payloadType + data[offset] == 6;
+  }
+
+  // whether a H.264 slice is an I or SI slice, slice_type is the ue(v) after first_mb_in_slice, emulation prevention
+  // bytes are not expected in the first bytes of the slice header
+  static bool IsISlice(const unsigned char* data, size_t size) {
+    size_t offset = StartCodeSize(data, size) + 1;
+    if (size <= offset) return false;
+    size_t bit = 0;
+    uint32_t firstMb, sliceType;
+    if (!ReadUe(data + offset, size - offset, &bit, &firstMb)) return false;
+    if (!ReadUe(data + offset, size - offset, &bit, &sliceType)) return false;
+    return sliceType % 5 == 2 || sliceType % 5 == 4;
+  }
+
+  static bool ReadUe(const unsigned char* data, size_t size, size_t* bit, uint32_t* value) {
+    int zeros = 0;
+    for (;; ++zeros) {
+      if (*bit >= size * 8 || zeros > 31) return false;
+      bool one = (data[*bit / 8] >> (7 - *bit % 8)) & 1;
+      ++*bit;
+      if (one) break;
+    }
+    uint32_t suffix = 0;
+    for (int i = 0; i < zeros; ++i, ++*bit) {
+      if (*bit >= size * 8) return false;
+      suffix = (suffix << 1) | ((data[*bit / 8] >> (7 - *bit % 8)) & 1);
+    }
+    *value = (static_cast<uint32_t>(1) << zeros) - 1 + suffix;
+    return true;
+  }
+
+  // parameter sets are sent one by one or together, e.g. sprop-parameter-sets of SDP, each one starts with a start
+  // code, the last one of each type is kept
+  void SaveParamSets(const unsigned char* data, size_t size, bool h264) {
+    std::vector<size_t> starts;
+    for (size_t i = 0; i + 3 <= size; ++i) {
+      if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+        starts.push_back(i > 0 && data[i - 1] == 0 ? i - 1 : i);
+        i += 2;
+      }
+    }
+    for (size_t i = 0; i < starts.size(); ++i) {
+      size_t end = i + 1 < starts.size() ? starts[i + 1] : size;
+      int type = GetNalType(data + starts[i], end - starts[i], h264);
+      if (type < 0) continue;
+      paramSets_[type].assign(data + starts[i], data + end);
+    }
+  }
+
+  void GetParamSets(std::vector<unsigned char>* paramSets) {
+    // in the order of types, VPS, SPS, PPS of H.265 and SPS, PPS of H.264
+    for (auto& it : paramSets_) paramSets->insert(paramSets->end(), it.second.begin(), it.second.end());
+  }
+
+  void StartGop(FrameInfo* frameInfo) {
+    gop_.clear();
+    gopSize_ = 0;
+    gopValid_ = gopCacheSize_ > 0;
+    std::vector<unsigned char> paramSets;
+    GetParamSets(&paramSets);
+    if (!paramSets.empty()) {
+      FrameInfo info = *frameInfo;
+      info.flags = FrameInfo::FLAG_KEY_FRAME;
+      CacheFrame(paramSets.data(), paramSets.size(), &info);
+    }
+  }
+
+  void CacheFrame(const unsigned char* data, size_t size, FrameInfo* frameInfo) {
+    if (!gopValid_) return;
+    PacketBufferPtr buffer;
+    if (gopSize_ + size <= gopCacheSize_) buffer = PacketBufferPool::Instance()->Acquire(size);
+    if (!buffer) {
+      // the GOP is too large, nothing is cached until the next key frame
+      gop_.clear();
+      gopSize_ = 0;
+      gopValid_ = false;
+      return;
+    }
+    memcpy(buffer->Data(), data, size);
+    gop_.push_back({buffer, size, *frameInfo});
+    gopSize_ += size;
+  }
+
+  std::mutex mutex_;
+  IRtspCB* cb_ = nullptr;
+  std::vector<Consumer> consumers_;
+  std::map<int, std::vector<unsigned char>> paramSets_;  // by nal type, kept across connections
+  bool waitKeyFrame_ = true;
+  bool paramSetsSent_ = false;
+  bool lastStart_ = false;  // slices of a key frame are received one by one, a new one starts with the first slice
+  bool recoveryPending_ = false;  // a recovery point SEI is received, the slices after it are in the same GOP
+  bool received_ = false;
+  std::vector<CachedFrame> gop_;
+  size_t gopSize_ = 0;
+  size_t gopCacheSize_ = 0;
+  bool gopValid_ = false;
+};
+
+// Delay before reconnecting grows exponentially, and is randomized, so that sessions dropped together, e.g. cameras
+// behind the same switch, do not reconnect all at once.
+class ReconnectBackoff {
+ public:
+  ReconnectBackoff() : rng_(std::random_device()()) {}
+
+  void Init(int minDelayMs, int maxDelayMs) {
+    minDelayMs_ = std::max(minDelayMs, 1);
+    maxDelayMs_ = std::max(maxDelayMs, minDelayMs_);
+    attempt_ = 0;
+  }
+
+  void Reset() { attempt_ = 0; }
+
+  int NextDelayMs() {
+    int64_t delay = std::min<int64_t>(static_cast<int64_t>(minDelayMs_) << attempt_, maxDelayMs_);
+    if (delay < maxDelayMs_) attempt_++;
+    return static_cast<int>(delay / 2 + std::uniform_int_distribution<int64_t>(0, delay / 2)(rng_));
+  }
+
+ private:
+  std::minstd_rand rng_;
+  int minDelayMs_ = 100;
+  int maxDelayMs_ = 5000;
+  int attempt_ = 0;
+};
+
 class RtspSessionImpl {
  public:
   RtspSessionImpl() {}
@@ -609,6 +1039,11 @@ class RtspSessionImpl {
 #ifdef HAVE_LIVE555
     param_ = param;
     exit_flag_ = 0;
+    dispatcher_.Init(param_.cb, param_.gopCacheSize);
+    backoff_.Init(param_.reconnectMinDelayMs, param_.reconnectMaxDelayMs);
+    if (param_.eventLoopNum > 0) {
+      return OpenShared();
+    }
     thread_id_ = std::thread(&RtspSessionImpl::TaskRoutine, this);
     return 0;
 #else
@@ -618,32 +1053,44 @@ class RtspSessionImpl {
   }
   void Close() {
 #ifdef HAVE_LIVE555
-    exit_flag_ = 1;
+    if (loop_) {
+      CloseShared();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lk(reconnect_mutex_);
+      exit_flag_ = 1;
+      if (scheduler_) scheduler_->triggerEvent(stopTrigger_, this);
+    }
+    reconnect_cond_.notify_all();
     if (thread_id_.joinable()) {
-      this->eventLoopWatchVariable = 2;
       thread_id_.join();
     }
 #endif  // HAVE_LIVE555
   }
 
+  void AddConsumer(IRtspCB* cb) { dispatcher_.AddConsumer(cb); }
+  void RemoveConsumer(IRtspCB* cb) { dispatcher_.RemoveConsumer(cb); }
+
  private:
   void TaskRoutine() {
     int reconnect = param_.reconnect;
     while (!exit_flag_) {
       TaskRoutine_();
 
-      // FIXME, apply reconnect strategy
       if (reconnect < 0) {
         break;
       }
       --reconnect;
-      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+      // wait before reconnecting, woken up at once when the session is closed
+      if (dispatcher_.Received()) backoff_.Reset();
+      std::unique_lock<std::mutex> lk(reconnect_mutex_);
+      reconnect_cond_.wait_for(lk, std::chrono::milliseconds(backoff_.NextDelayMs()),
+                               [this] { return exit_flag_ != 0; });
     }
 
     std::cout << "TaskRoutine exit" << std::endl;
-    if(param_.cb) {
-      param_.cb->OnFrame(nullptr, 0, nullptr);
-    }
+    dispatcher_.OnFrame(nullptr, 0, nullptr);
   }
 
   void TaskRoutine_() {
@@ -656,36 +1103,41 @@ class RtspSessionImpl {
     if (!env) {
       return;
     }
-    // Begin by creating a "RTSPClient" object.  Note that there is a separate "RTSPClient" object for each stream that
-    // we wish to receive (even if more than stream uses the same "rtsp://" URL).
-    RTSPClient* rtspClient =
-        ourRTSPClient::createNew(*env, param_.url.c_str(), RTSP_CLIENT_VERBOSITY_LEVEL, "cnstream");
+    this->eventLoopWatchVariable = 0;
+    dispatcher_.OnConnect();
+    ourRTSPClient* rtspClient = CreateClient(env);
     if (rtspClient == NULL) {
-      *env << "Failed to create a RTSP client for URL \"" << param_.url.c_str() << "\": " << env->getResultMsg()
-           << "\n";
       return;
     }
-
-    this->eventLoopWatchVariable = 0;
-    ((ourRTSPClient*)rtspClient)->eventLoopWatchVariable = &this->eventLoopWatchVariable;
-    ((ourRTSPClient*)rtspClient)->livenessTimeoutMs = param_.livenessTimeoutMs;
-    ((ourRTSPClient*)rtspClient)->streammingPreferTcp = param_.streammingPreferTcp;
-    ((ourRTSPClient*)rtspClient)->streammingOverTcp = true;
-    ((ourRTSPClient*)rtspClient)->setupOk = false;
-    ((ourRTSPClient*)rtspClient)->cb_ = param_.cb;
+    rtspClient->onClosed = [this] { this->eventLoopWatchVariable = 1; };
+    // the closing thread and the timer thread stop the loop by an event trigger, the client removes the timer before
+    // the scheduler is deleted
+    EventTriggerId stopTrigger = scheduler->createEventTrigger(StopHandler);
+    {
+      std::lock_guard<std::mutex> lk(reconnect_mutex_);
+      scheduler_ = scheduler;
+      stopTrigger_ = stopTrigger;
+      if (exit_flag_) this->eventLoopWatchVariable = 2;
+    }
+    rtspClient->onLivenessTimeout = [scheduler, stopTrigger, this] { scheduler->triggerEvent(stopTrigger, this); };
 
     // Next, send a RTSP "DESCRIBE" command, to get a SDP description for the stream.
     // Note that this command - like all RTSP commands - is sent asynchronously; we do not block, waiting for a
     // response. Instead, the following function call returns immediately, and we handle the RTSP response later, from
     // within the event loop:
-    rtspClient->sendDescribeCommand(continueAfterDESCRIBE, ((ourRTSPClient*)rtspClient)->authenticator_);
+    rtspClient->sendDescribeCommand(continueAfterDESCRIBE, rtspClient->authenticator_);
 
     env->taskScheduler().doEventLoop(&this->eventLoopWatchVariable);
+    {
+      std::lock_guard<std::mutex> lk(reconnect_mutex_);
+      scheduler_ = NULL;
+    }
 
     //In case that client stops the session...
     if (this->eventLoopWatchVariable == 2) {
       shutdownStream(rtspClient);
     }
+    scheduler->deleteEventTrigger(stopTrigger);
 
     if (env) {
       env->reclaim();
@@ -698,13 +1150,146 @@ class RtspSessionImpl {
 #endif  // HAVE_LIVE555
   }
 
+#ifdef HAVE_LIVE555
+  static void StopHandler(void* clientData) {
+    reinterpret_cast<RtspSessionImpl*>(clientData)->eventLoopWatchVariable = 2;
+  }
+
+  ourRTSPClient* CreateClient(UsageEnvironment* env) {
+    // Begin by creating a "RTSPClient" object.  Note that there is a separate "RTSPClient" object for each stream that
+    // we wish to receive (even if more than stream uses the same "rtsp://" URL).
+    ourRTSPClient* rtspClient =
+        ourRTSPClient::createNew(*env, param_.url.c_str(), RTSP_CLIENT_VERBOSITY_LEVEL, "cnstream");
+    if (rtspClient == NULL) {
+      *env << "Failed to create a RTSP client for URL \"" << param_.url.c_str() << "\": " << env->getResultMsg()
+           << "\n";
+      return NULL;
+    }
+    rtspClient->livenessTimeoutMs = param_.livenessTimeoutMs;
+    rtspClient->streammingPreferTcp = param_.streammingPreferTcp;
+    rtspClient->streammingOverTcp = true;
+    rtspClient->setupOk = false;
+    rtspClient->cb_ = &dispatcher_;
+    return rtspClient;
+  }
+
+  // Sessions share the event loops, LIVE555 objects of the session are only accessed in the loop thread.
+  int OpenShared() {
+    loop_ = RtspEventLoop::Acquire(param_.eventLoopNum);
+    if (!loop_) {
+      std::cout << "Failed to start RTSP event loop" << std::endl;
+      return -1;
+    }
+    reconnect_ = param_.reconnect;
+    finished_ = false;
+    token_ = std::make_shared<LoopToken>();
+    token_->loop = loop_.get();
+    loop_->Post([this] { StartClient(); });
+    return 0;
+  }
+
+  void CloseShared() {
+    {
+      // no task is posted by timer callbacks after the close task, which is the last one to access the session
+      std::lock_guard<std::mutex> lk(token_->mutex);
+      token_->loop = nullptr;
+    }
+    std::promise<void> closed;
+    loop_->Post([this, &closed] {
+      exit_flag_ = 1;
+      if (reconnectTask_) {
+        loop_->Env()->taskScheduler().unscheduleDelayedTask(reconnectTask_);
+      }
+      if (client_) {
+        shutdownStream(client_);
+      }
+      Finish();
+      closed.set_value();
+    });
+    closed.get_future().wait();
+    loop_.reset();
+  }
+
+  static void ReconnectHandler(void* clientData) {
+    RtspSessionImpl* session = reinterpret_cast<RtspSessionImpl*>(clientData);
+    session->reconnectTask_ = NULL;
+    session->StartClient();
+  }
+
+  void StartClient() {
+    if (exit_flag_) return;
+    dispatcher_.OnConnect();
+    client_ = CreateClient(loop_->Env());
+    if (client_ == NULL) {
+      OnClientClosed();
+      return;
+    }
+    client_->onClosed = [this] { OnClientClosed(); };
+    uint64_t connection = ++connection_;
+    std::shared_ptr<LoopToken> token = token_;
+    // called in the timer thread, which never holds the loop, the loop is released by the session only
+    client_->onLivenessTimeout = [this, token, connection] {
+      std::lock_guard<std::mutex> lk(token->mutex);
+      if (!token->loop) return;
+      token->loop->Post([this, connection] {
+        // the client may be closed, or another one is connecting, before the task is run
+        if (client_ && connection_ == connection) shutdownStream(client_);
+      });
+    };
+    client_->sendDescribeCommand(continueAfterDESCRIBE, client_->authenticator_);
+  }
+
+  void OnClientClosed() {
+    client_ = NULL;
+    if (exit_flag_) return;
+    // the same reconnect strategy as the session thread, without blocking the shared loop
+    if (reconnect_ < 0) {
+      Finish();
+      return;
+    }
+    --reconnect_;
+    if (dispatcher_.Received()) backoff_.Reset();
+    reconnectTask_ =
+        loop_->Env()->taskScheduler().scheduleDelayedTask(backoff_.NextDelayMs() * 1000, ReconnectHandler, this);
+  }
+
+  void Finish() {
+    if (finished_) return;
+    finished_ = true;
+    std::cout << "RTSP session finished" << std::endl;
+    dispatcher_.OnFrame(nullptr, 0, nullptr);
+  }
+#endif  // HAVE_LIVE555
+
  private:
   OpenParam param_;
   std::thread thread_id_;
   volatile char exit_flag_ = 0;
+  std::mutex reconnect_mutex_;
+  std::condition_variable reconnect_cond_;
   // by default, print verbose output from each "RTSPClient"
   int RTSP_CLIENT_VERBOSITY_LEVEL = 1;
   char eventLoopWatchVariable = 0;
+  RtspFrameDispatcher dispatcher_;
+  ReconnectBackoff backoff_;
+#ifdef HAVE_LIVE555
+  // the loop of a session, cleared when the session is closed
+  struct LoopToken {
+    std::mutex mutex;
+    RtspEventLoop* loop = nullptr;
+  };
+  // scheduler of the running loop of the session thread, guarded by reconnect_mutex_
+  TaskScheduler* scheduler_ = NULL;
+  EventTriggerId stopTrigger_ = 0;
+  // used in the shared event loop
+  std::shared_ptr<RtspEventLoop> loop_;
+  std::shared_ptr<LoopToken> token_;
+  uint64_t connection_ = 0;  // increased each time a client is created
+  ourRTSPClient* client_ = NULL;
+  TaskToken reconnectTask_ = NULL;
+  int reconnect_ = 0;
+  bool finished_ = false;
+#endif  // HAVE_LIVE555
 };
 
 RtspSession::RtspSession() {}
@@ -728,4 +1313,16 @@ void RtspSession::Close() {
   }
 }
 
+void RtspSession::AddConsumer(IRtspCB* cb) {
+  if (impl_ && cb) {
+    impl_->AddConsumer(cb);
+  }
+}
+
+void RtspSession::RemoveConsumer(IRtspCB* cb) {
+  if (impl_) {
+    impl_->RemoveConsumer(cb);
+  }
+}
+
 }  // namespace cnstream
@@ -20,6 +20,8 @@
 #ifndef CNSTREAM_RTSP_CLIENT_H_
 #define CNSTREAM_RTSP_CLIENT_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace cnstream {
@@ -47,7 +49,19 @@ struct OpenParam {
                     */
   bool streammingPreferTcp = true;
   int reconnect = 0;
+  int reconnectMinDelayMs = 100;  /* delay before reconnecting grows exponentially from reconnectMinDelayMs to
+                                   * reconnectMaxDelayMs, randomized in [delay / 2, delay], and is reset once
+                                   * frames are received
+                                   */
+  int reconnectMaxDelayMs = 5000;
   int livenessTimeoutMs = 2000;
+  size_t gopCacheSize = 0;  /* bytes of the last GOP cached for consumers added by AddConsumer, the GOP is not cached
+                             * if it is 0 or the GOP is larger, parameter sets are always cached
+                             */
+  int eventLoopNum = 0; /* 0: the session runs its own event loop thread,
+                         * >0: sessions share eventLoopNum event loop threads, callbacks of cb are called in the
+                         *     shared threads and should not block
+                         */
   IRtspCB *cb = nullptr;
 };
 
@@ -59,6 +73,12 @@ class RtspSession {
 
   int Open(const OpenParam &param);
   void Close();
+  /* Add a consumer of frames besides cb of OpenParam. The cached GOP, or else the parameter sets with the next key
+   * frame, are sent to the consumer first, so it starts decoding at once. Callbacks of the consumer are called in
+   * the same thread as cb, and should not block.
+   */
+  void AddConsumer(IRtspCB *cb);
+  void RemoveConsumer(IRtspCB *cb);
 
  private:
   RtspSession(const RtspSession &) = delete;
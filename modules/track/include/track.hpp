@@ -27,8 +27,9 @@
  */
 
 #include <memory>
+#include <mutex>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "cnstream_core.hpp"
 #include "cnstream_frame.hpp"
@@ -47,6 +48,14 @@ using CNFrameInfoPtr = std::shared_ptr<CNFrameInfo>;
 /// Pointer for infer object
 using CNInferObjectPtr = std::shared_ptr<CNInferObject>;
 
+/**
+ *  @brief Tracking statistics of one stream
+ */
+struct TrackerStreamStats {
+  uint32_t track_num = 0;   ///< Number of alive tracks
+  size_t memory_usage = 0;  ///< Approximate memory usage of the tracks and their features in bytes
+};
+
 /**
  *  @brief Tracker is a module for realtime tracking
  *   It would be MLU feature extracting if the model_path provided,
@@ -75,7 +84,17 @@ class Tracker : public Module, public ModuleCreator<Tracker> {
    *
    *  @param paramSet :
    * @verbatim
-   * track_name: Class name for track, "FeatureMatch" provided
+   * track_name: Class name for track, "FeatureMatch", "IoUMatch" and "KCF" provided.
+               "IoUMatch" matches objects by IoU only, it needs neither model nor frame data
+   * max_tracks: FeatureMatch only, max number of objects kept by the tracker of each stream,
+                 the least recently updated ones are evicted when exceeded. 0 means unlimited, default 0
+   * parallel_threshold: FeatureMatch only, feature match costs are computed on a shared worker pool when there
+                         are at least this number of objects in one frame. 0 means always serial, default 0
+   * max_iou_distance: Tracks and detections with IoU distance larger than it are never matched, default 0.7
+   * max_age: Number of continuous missed frames before a track is deleted, default 30
+   * n_init: Number of continuous matched frames before a track is confirmed, default 3
+   * high_score_threshold: IoUMatch only, objects with score not lower than it are matched first, default 0.5
+   * low_score_threshold: IoUMatch only, objects with score lower than it are not tracked, default 0.1
    * model_path: Offline model path
    * func_name:  Function name defined in the offline model, could be found in the cambricon_twins description file
                It is "subnet0" for the most case
@@ -104,6 +123,15 @@ class Tracker : public Module, public ModuleCreator<Tracker> {
    */
   int Process(std::shared_ptr<CNFrameInfo> data) override;
 
+  /**
+   * @brief Release the tracking context of the stream
+   *
+   * @param data : Pointer to the eos frame info
+   *
+   * @return None
+   */
+  void OnEos(std::shared_ptr<CNFrameInfo> data) override;
+
   /**
    * @brief Check ParamSet for a module.
    *
@@ -113,16 +141,36 @@ class Tracker : public Module, public ModuleCreator<Tracker> {
    */
   bool CheckParamSet(const ModuleParamSet &paramSet) const override;
 
+  /**
+   * @brief Get tracking statistics of a stream, FeatureMatch only
+   *
+   * @param stream_id : Id of the stream
+   * @param stats : Statistics of the stream
+   *
+   * @return Returns false if the stream is not being tracked by FeatureMatch, otherwise returns true
+   */
+  bool GetStreamStats(const std::string &stream_id, TrackerStreamStats *stats);
+
  private:
   TrackerContext *GetContext(CNFrameInfoPtr data);
-  std::unordered_map<int, TrackerContext *> contexts_;
+  /* Indexed by stream index. Frames of one stream are always processed by the same thread,
+     so each slot is read without lock by that thread. Slots are only written with contexts_mutex_ held,
+     which GetStreamStats holds as well */
+  std::vector<TrackerContext *> contexts_;
+  std::mutex contexts_mutex_;
   std::shared_ptr<edk::ModelLoader> model_loader_ = nullptr;
-  std::mutex mutex_;
   int device_id_ = 0;
   std::string model_path_ = "";
   std::string func_name_ = "";
   std::string track_name_ = "";
   float max_cosine_distance_ = 0.2;
+  int max_tracks_ = 0;
+  int parallel_threshold_ = 0;
+  float max_iou_distance_ = 0.7;
+  int max_age_ = 30;
+  int n_init_ = 3;
+  float high_score_threshold_ = 0.5;
+  float low_score_threshold_ = 0.1;
 };  // class Tracker
 
 }  // namespace cnstream
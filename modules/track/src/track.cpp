@@ -19,6 +19,7 @@
  *************************************************************************/
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -30,6 +31,7 @@
 namespace cnstream {
 
 struct TrackerContext {
+  std::string stream_id;
   std::unique_ptr<edk::EasyTrack> processer_ = nullptr;
   TrackerContext() = default;
   ~TrackerContext() = default;
@@ -46,9 +48,24 @@ Tracker::Tracker(const std::string &name) : Module(name) {
                            "The offline model path. Normally offline model is a file"
                            " with cambricon extension.");
   param_register_.Register("func_name", "The offline model function name, usually is 'subnet0'.");
-  param_register_.Register("track_name", "Track algorithm name. Choose from FeatureMatch and KCF.");
+  param_register_.Register("track_name", "Track algorithm name. Choose from FeatureMatch, IoUMatch and KCF.");
   param_register_.Register("device_id", "Which device will be used. If there is only one device, it might be 0.");
   param_register_.Register("max_cosine_distance", "Threshold of cosine distance.");
+  param_register_.Register("max_tracks",
+                           "FeatureMatch only. Max number of objects kept by the tracker of each stream,"
+                           " the least recently updated ones are evicted when exceeded. 0 means unlimited.");
+  param_register_.Register("parallel_threshold",
+                           "FeatureMatch only. Feature match costs are computed on a shared worker pool when there"
+                           " are at least this number of objects in one frame. 0 means always serial.");
+  param_register_.Register("max_iou_distance",
+                           "Threshold of IoU distance, tracks and detections farther than it are never matched.");
+  param_register_.Register("max_age", "Number of continuous missed frames before a track is deleted.");
+  param_register_.Register("n_init", "Number of continuous matched frames before a track is confirmed.");
+  param_register_.Register("high_score_threshold",
+                           "IoUMatch only. Detections with score not lower than it are matched first"
+                           " and could start new tracks.");
+  param_register_.Register("low_score_threshold",
+                           "IoUMatch only. Detections with score lower than it are not tracked.");
 }
 
 Tracker::~Tracker() { Close(); }
@@ -59,7 +76,7 @@ TrackerContext *Tracker::GetContext(CNFrameInfoPtr data) {
     g_tl_mlu_env->SetDeviceId(device_id_);
     g_tl_mlu_env->ConfigureForThisThread();
   }
-  if (!g_tl_feature_extractor) {
+  if (!g_tl_feature_extractor && "IoUMatch" != track_name_) {
     if (!model_loader_) {
       LOG(INFO) << "[FeatureExtractor] model not set, extract feature on CPU";
       g_tl_feature_extractor.reset(new FeatureExtractor());
@@ -68,33 +85,77 @@ TrackerContext *Tracker::GetContext(CNFrameInfoPtr data) {
     }
   }
 
-  TrackerContext *ctx = nullptr;
-  std::unique_lock<std::mutex> guard(mutex_);
-  auto search = contexts_.find(data->GetStreamIndex());
-  if (data->GetStreamIndex() >= GetMaxStreamNumber()) {
+  uint32_t stream_idx = data->GetStreamIndex();
+  if (stream_idx >= contexts_.size()) {
     return nullptr;
   }
-  if (search != contexts_.end()) {
+  TrackerContext *ctx = contexts_[stream_idx];
+  if (ctx && ctx->stream_id == data->stream_id) {
     // context exists
-    ctx = search->second;
-  } else {
-    ctx = new TrackerContext;
-    if ("KCF" == track_name_) {
+    return ctx;
+  }
+  if (ctx) {
+    // stream index is reused by a new stream before eos of the old one arrived
+    LOG(WARNING) << "[Tracker] Stream index " << stream_idx << " is reused by stream " << data->stream_id
+                 << ", reset tracking context of stream " << ctx->stream_id;
+    std::lock_guard<std::mutex> lk(contexts_mutex_);
+    delete ctx;
+    contexts_[stream_idx] = nullptr;
+  }
+
+  ctx = new TrackerContext;
+  ctx->stream_id = data->stream_id;
+  if ("KCF" == track_name_) {
 #ifdef ENABLE_KCF
-      ctx->processer_.reset(new edk::KcfTrack);
-      dynamic_cast<edk::KcfTrack *>(ctx->processer_.get())->SetModel(model_loader_, device_id_);
-      contexts_[data->GetStreamIndex()] = ctx;
+    ctx->processer_.reset(new edk::KcfTrack);
+    dynamic_cast<edk::KcfTrack *>(ctx->processer_.get())->SetModel(model_loader_, device_id_);
 #endif
-    } else {  // "FeatureMatch by default"
-      edk::FeatureMatchTrack *track = new edk::FeatureMatchTrack;
-      track->SetParams(max_cosine_distance_, 100, 0.7, 30, 3);
-      ctx->processer_.reset(track);
-      contexts_[data->GetStreamIndex()] = ctx;
-    }
+  } else if ("IoUMatch" == track_name_) {
+    edk::IoUMatchTrack *track = new edk::IoUMatchTrack;
+    track->SetParams(max_iou_distance_, max_age_, n_init_, high_score_threshold_, low_score_threshold_);
+    ctx->processer_.reset(track);
+  } else {  // "FeatureMatch by default"
+    edk::FeatureMatchTrack *track = new edk::FeatureMatchTrack;
+    track->SetParams(max_cosine_distance_, 100, max_iou_distance_, max_age_, n_init_, max_tracks_);
+    track->SetParallelThreshold(parallel_threshold_ > 0 ? parallel_threshold_ : 0);
+    ctx->processer_.reset(track);
   }
+  std::lock_guard<std::mutex> lk(contexts_mutex_);
+  contexts_[stream_idx] = ctx;
   return ctx;
 }
 
+void Tracker::OnEos(std::shared_ptr<CNFrameInfo> data) {
+  uint32_t stream_idx = data->GetStreamIndex();
+  if (stream_idx >= contexts_.size()) return;
+  TrackerContext *ctx = contexts_[stream_idx];
+  if (ctx && ctx->stream_id == data->stream_id) {
+    auto fm_track = dynamic_cast<edk::FeatureMatchTrack *>(ctx->processer_.get());
+    if (fm_track) {
+      VLOG(2) << "[Tracker] Release context of stream " << ctx->stream_id << ", tracks: " << fm_track->GetTrackNum()
+              << ", memory usage: " << fm_track->GetMemoryUsage() << " bytes";
+    }
+    std::lock_guard<std::mutex> lk(contexts_mutex_);
+    delete ctx;
+    contexts_[stream_idx] = nullptr;
+  }
+}
+
+bool Tracker::GetStreamStats(const std::string &stream_id, TrackerStreamStats *stats) {
+  if (!stats) return false;
+  std::lock_guard<std::mutex> lk(contexts_mutex_);
+  for (auto ctx : contexts_) {
+    if (!ctx || ctx->stream_id != stream_id) continue;
+    // FeatureMatchTrack getters hold its own lock, so they are safe to call while the stream is being processed
+    auto fm_track = dynamic_cast<edk::FeatureMatchTrack *>(ctx->processer_.get());
+    if (!fm_track) return false;
+    stats->track_num = fm_track->GetTrackNum();
+    stats->memory_usage = fm_track->GetMemoryUsage();
+    return true;
+  }
+  return false;
+}
+
 bool Tracker::Open(ModuleParamSet paramSet) {
   if (paramSet.find("model_path") != paramSet.end()) {
     model_path_ = paramSet["model_path"];
@@ -114,11 +175,46 @@ bool Tracker::Open(ModuleParamSet paramSet) {
     device_id_ = std::stoi(paramSet["device_id"]);
   }
 
+  if (paramSet.find("max_tracks") != paramSet.end()) {
+    max_tracks_ = std::stoi(paramSet["max_tracks"]);
+  }
+
+  if (paramSet.find("parallel_threshold") != paramSet.end()) {
+    parallel_threshold_ = std::stoi(paramSet["parallel_threshold"]);
+  }
+
+  if (paramSet.find("max_iou_distance") != paramSet.end()) {
+    max_iou_distance_ = std::stof(paramSet["max_iou_distance"]);
+  }
+
+  if (paramSet.find("max_age") != paramSet.end()) {
+    max_age_ = std::stoi(paramSet["max_age"]);
+  }
+
+  if (paramSet.find("n_init") != paramSet.end()) {
+    n_init_ = std::stoi(paramSet["n_init"]);
+  }
+
+  if (paramSet.find("high_score_threshold") != paramSet.end()) {
+    high_score_threshold_ = std::stof(paramSet["high_score_threshold"]);
+  }
+
+  if (paramSet.find("low_score_threshold") != paramSet.end()) {
+    low_score_threshold_ = std::stof(paramSet["low_score_threshold"]);
+  }
+
   track_name_ = "FeatureMatch";
   if (paramSet.find("track_name") != paramSet.end()) {
     track_name_ = paramSet["track_name"];
   }
 
+  {
+    std::lock_guard<std::mutex> lk(contexts_mutex_);
+    if (contexts_.empty()) {
+      contexts_.resize(GetMaxStreamNumber(), nullptr);
+    }
+  }
+
   if (!model_path_.empty()) {
     try {
       model_loader_ = std::make_shared<edk::ModelLoader>(model_path_, func_name_);
@@ -140,12 +236,27 @@ void Tracker::Close() {
   if (g_tl_mlu_env) {
     g_tl_mlu_env.reset();
   }
-  for (auto &pair : contexts_) {
-    delete pair.second;
+  std::lock_guard<std::mutex> lk(contexts_mutex_);
+  for (auto &ctx : contexts_) {
+    delete ctx;
   }
   contexts_.clear();
 }
 
+static void ToDetectObjects(const CNObjsVec &objs, std::vector<edk::DetectObject> *detects) {
+  detects->reserve(objs.size());
+  for (const auto &obj : objs) {
+    edk::DetectObject det;
+    det.label = obj->GetClassId();
+    det.score = obj->score;
+    det.bbox.x = obj->bbox.x;
+    det.bbox.y = obj->bbox.y;
+    det.bbox.width = obj->bbox.w;
+    det.bbox.height = obj->bbox.h;
+    detects->push_back(std::move(det));
+  }
+}
+
 int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
   CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
   if (frame->width <= 0 || frame->height <= 0) {
@@ -179,23 +290,27 @@ int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
     g_tl_feature_extractor->ExtractFeature(*frame->ImageBGR(), objs, &features);
 
     std::vector<edk::DetectObject> in, out;
-    for (size_t i = 0; i < objs.size(); i++) {
-      edk::DetectObject obj;
-      obj.label = std::stoi(objs[i]->id);
-      obj.score = objs[i]->score;
-      obj.bbox.x = objs[i]->bbox.x;
-      obj.bbox.y = objs[i]->bbox.y;
-      obj.bbox.width = objs[i]->bbox.w;
-      obj.bbox.height = objs[i]->bbox.h;
-      obj.feature = features[i];
-      in.push_back(obj);
+    ToDetectObjects(objs, &in);
+    for (size_t i = 0; i < in.size(); i++) {
+      in[i].feature = std::move(features[i]);
     }
 
     edk::TrackFrame tframe;
     ctx->processer_->UpdateFrame(tframe, in, &out);
 
     for (size_t i = 0; i < out.size(); i++) {
-      objs[out[i].detect_id]->track_id = std::to_string(out[i].track_id);
+      objs[out[i].detect_id]->SetTrackId(out[i].track_id);
+    }
+  } else if (track_name_ == "IoUMatch") {
+    // only bounding boxes and scores are used, frame data is never touched
+    std::vector<edk::DetectObject> in, out;
+    ToDetectObjects(objs, &in);
+
+    edk::TrackFrame tframe;
+    ctx->processer_->UpdateFrame(tframe, in, &out);
+
+    for (size_t i = 0; i < out.size(); i++) {
+      objs[out[i].detect_id]->SetTrackId(out[i].track_id);
     }
   } else if (track_name_ == "KCF") {
 #ifdef ENABLE_KCF
@@ -204,16 +319,7 @@ int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
       return -1;
     }
     std::vector<edk::DetectObject> in, out;
-    for (size_t i = 0; i < objs.size(); i++) {
-      edk::DetectObject obj;
-      obj.label = std::stoi(objs[i]->id);
-      obj.score = objs[i]->score;
-      obj.bbox.x = objs[i]->bbox.x;
-      obj.bbox.y = objs[i]->bbox.y;
-      obj.bbox.width = objs[i]->bbox.w;
-      obj.bbox.height = objs[i]->bbox.h;
-      in.push_back(obj);
-    }
+    ToDetectObjects(objs, &in);
 
     edk::TrackFrame tframe;
     tframe.data = frame->data[0]->GetMutableMluData();
@@ -228,8 +334,8 @@ int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
     objs.clear();
     for (size_t i = 0; i < out.size(); i++) {
       std::shared_ptr<CNInferObject> obj = std::make_shared<CNInferObject>();
-      obj->id = std::to_string(out[i].label);
-      obj->track_id = std::to_string(out[i].track_id);
+      obj->SetClassId(out[i].label);
+      obj->SetTrackId(out[i].track_id);
       obj->score = out[i].score;
       obj->bbox.x = out[i].bbox.x;
       obj->bbox.y = out[i].bbox.y;
@@ -261,7 +367,7 @@ bool Tracker::CheckParamSet(const ModuleParamSet &paramSet) const {
 
   if (paramSet.find("track_name") != paramSet.end()) {
     std::string track_name = paramSet.at("track_name");
-    if (track_name != "FeatureMatch" && track_name != "KCF") {
+    if (track_name != "FeatureMatch" && track_name != "IoUMatch" && track_name != "KCF") {
       LOG(ERROR) << "[Tracker] [track_name] : Unsupported tracker type " << track_name;
       ret = false;
     }
@@ -281,6 +387,43 @@ bool Tracker::CheckParamSet(const ModuleParamSet &paramSet) const {
       ret = false;
     }
   }
+
+  if (paramSet.find("max_tracks") != paramSet.end()) {
+    if (!checker.IsNum({"max_tracks"}, paramSet, err_msg)) {
+      LOG(ERROR) << "[Tracker] " << err_msg;
+      ret = false;
+    }
+  }
+
+  if (paramSet.find("parallel_threshold") != paramSet.end()) {
+    if (!checker.IsNum({"parallel_threshold"}, paramSet, err_msg)) {
+      LOG(ERROR) << "[Tracker] " << err_msg;
+      ret = false;
+    }
+  }
+
+  for (const char *key : {"max_iou_distance", "max_age", "n_init"}) {
+    if (paramSet.find(key) != paramSet.end()) {
+      if (!checker.IsNum({key}, paramSet, err_msg)) {
+        LOG(ERROR) << "[Tracker] " << err_msg;
+        ret = false;
+      }
+    }
+  }
+
+  if (paramSet.find("high_score_threshold") != paramSet.end()) {
+    if (!checker.IsNum({"high_score_threshold"}, paramSet, err_msg)) {
+      LOG(ERROR) << "[Tracker] " << err_msg;
+      ret = false;
+    }
+  }
+
+  if (paramSet.find("low_score_threshold") != paramSet.end()) {
+    if (!checker.IsNum({"low_score_threshold"}, paramSet, err_msg)) {
+      LOG(ERROR) << "[Tracker] " << err_msg;
+      ret = false;
+    }
+  }
   return ret;
 }
 
@@ -0,0 +1,71 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "cnstream_frame_va.hpp"
+
+namespace cnstream {
+
+/*
+ * Ids of objects are set by the tracker and read by the following modules every frame.
+ * Compares keeping them as integers with formatting them to strings when they are set.
+ */
+TEST(CoreFrameBenchmark, InferObjId) {
+  const int obj_num = 200;
+  const int frame_num = 1000;
+  CNObjsVec objs;
+  for (int i = 0; i < obj_num; ++i) {
+    objs.push_back(std::make_shared<CNInferObject>());
+  }
+
+  int64_t sum_string = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < frame_num; ++n) {
+    for (int i = 0; i < obj_num; ++i) {
+      objs[i]->SetClassId(std::to_string(i % 80));
+      objs[i]->SetTrackId(std::to_string(n + i));
+      sum_string += objs[i]->GetClassId() + objs[i]->GetTrackId();
+    }
+  }
+  std::chrono::duration<double, std::micro> string_cost = std::chrono::steady_clock::now() - start;
+
+  int64_t sum_int = 0;
+  start = std::chrono::steady_clock::now();
+  for (int n = 0; n < frame_num; ++n) {
+    for (int i = 0; i < obj_num; ++i) {
+      objs[i]->SetClassId(i % 80);
+      objs[i]->SetTrackId(n + i);
+      sum_int += objs[i]->GetClassId() + objs[i]->GetTrackId();
+    }
+  }
+  std::chrono::duration<double, std::micro> int_cost = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(sum_string, sum_int);
+  std::cout << "[InferObjId] " << obj_num << " objects per frame, string id: " << string_cost.count() / frame_num
+            << " us/frame, integer id: " << int_cost.count() / frame_num << " us/frame" << std::endl;
+}
+
+}  // namespace cnstream
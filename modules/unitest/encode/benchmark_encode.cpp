@@ -0,0 +1,194 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ffmpeg_encoder.hpp"
+#include "image_preproc.hpp"
+#include "snapshot_encoder.hpp"
+#include "test_base.hpp"
+
+namespace cnstream {
+
+TEST(EncodeBenchmark, FFmpegEncoderThroughput) {
+  constexpr uint32_t width = 640, height = 360;
+  constexpr int frame_num = 100;
+  std::string output_dir = GetExePath() + "/encode_output";
+  mkdir(output_dir.c_str(), 0755);
+  std::vector<uint8_t> yuv(width * height * 3 / 2);
+  for (size_t i = 0; i < yuv.size(); ++i) yuv[i] = static_cast<uint8_t>(i * 7 % 251);
+  for (int stream_num : {1, 4, 8, 16, 32}) {
+    std::vector<std::unique_ptr<FFmpegEncoder>> encoders;
+    std::atomic<int> packet_num{0};
+    for (int i = 0; i < stream_num; ++i) {
+      FFmpegEncoder::Param param;
+      param.width = width;
+      param.height = height;
+      param.preset = "ultrafast";
+      param.thread_num = 1;
+      param.file_name = output_dir + "/throughput_" + std::to_string(i) + ".mp4";
+      encoders.emplace_back(new FFmpegEncoder(param));
+      encoders.back()->SetPacketCallback([&packet_num](int64_t) { ++packet_num; });
+      ASSERT_TRUE(encoders.back()->Open());
+    }
+    // one thread for each stream, as module process threads do
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (auto &encoder : encoders) {
+      FFmpegEncoder *enc = encoder.get();
+      threads.emplace_back([&yuv, enc]() {
+        for (int i = 0; i < frame_num; ++i) {
+          EXPECT_TRUE(enc->SendFrame(yuv.data(), yuv.data() + width * height, width, i));
+        }
+        enc->Close();
+      });
+    }
+    for (auto &th : threads) th.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(stream_num * frame_num, packet_num.load());
+    std::cout << "[FFmpegEncoder] " << stream_num << " streams " << width << "x" << height << ": "
+              << stream_num * frame_num * 1000.0 / ms << " fps in total" << std::endl;
+  }
+}
+
+// smooth random planes, stride is larger than width
+static void FillYuv(uint32_t width, uint32_t height, uint32_t stride, std::vector<uint8_t> *yuv) {
+  yuv->assign(stride * height * 3 / 2, 0);
+  cv::Mat y(height, width, CV_8UC1, yuv->data(), stride);
+  cv::Mat uv(height / 2, width / 2, CV_8UC2, yuv->data() + stride * height, stride);
+  cv::randu(y, 0, 256);
+  cv::randu(uv, 0, 256);
+  cv::GaussianBlur(y, y, cv::Size(5, 5), 1.5);
+  cv::GaussianBlur(uv, uv, cv::Size(5, 5), 1.5);
+}
+
+// nearest neighbour resize on a contiguous nv12 image, which ImagePreproc used before the planes were resized by
+// opencv. It is only kept here as the baseline.
+static void ResizeYuvNearest(const ImagePreproc::ImagePreprocParam &param, const uint8_t *src, uint8_t *dst) {
+  uint32_t x_ratio = (param.src_width << 16) / param.dst_width + 1;
+  uint32_t y_ratio = (param.src_height << 16) / param.dst_height + 1;
+  const uint8_t *src_uv = src + param.src_height * param.src_width;
+  uint8_t *dst_uv = dst + param.dst_height * param.dst_width;
+  for (uint32_t y = 0; y < param.dst_height; ++y) {
+    uint32_t src_row = (y * y_ratio) >> 16;
+    const uint8_t *src_y_line = src + src_row * param.src_width;
+    uint8_t *dst_y_line = dst + y * param.dst_width;
+    const uint8_t *src_uv_line = src_uv + (src_row / 2) * param.src_width;
+    uint8_t *dst_uv_line = dst_uv + (y / 2) * param.dst_width;
+    for (uint32_t x = 0; x < param.dst_width; ++x) {
+      uint32_t src_col = (x * x_ratio) >> 16;
+      dst_y_line[x] = src_y_line[src_col];
+      if (!(y & 1) && !(x & 1)) {
+        dst_uv_line[x] = src_uv_line[src_col / 2 * 2];
+        dst_uv_line[x + 1] = src_uv_line[src_col / 2 * 2 + 1];
+      }
+    }
+  }
+}
+
+TEST(EncodeBenchmark, Yuv2YuvResize) {
+  ImagePreproc::ImagePreprocParam params;
+  params.src_pix_fmt = NV12;
+  params.dst_pix_fmt = NV12;
+  params.src_width = 1920;
+  params.src_height = 1080;
+  params.dst_width = 1280;
+  params.dst_height = 720;
+  std::vector<uint8_t> src;
+  FillYuv(params.src_width, params.src_height, params.src_width, &src);
+  const uint8_t *src_y = src.data(), *src_uv = src.data() + params.src_width * params.src_height;
+  std::vector<uint8_t> dst(params.dst_width * params.dst_height * 3 / 2);
+  constexpr int loop = 100;
+
+  for (bool use_ffmpeg : {false, true}) {
+    params.use_ffmpeg = use_ffmpeg;
+    ImagePreproc preproc(params);
+    ASSERT_TRUE(preproc.Init());
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop; ++i) {
+      ASSERT_TRUE(preproc.Yuv2Yuv(src_y, src_uv, dst.data()));
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[ImagePreproc] 1080p to 720p " << (use_ffmpeg ? "swscale" : "opencv") << ": " << ms / loop
+              << " ms" << std::endl;
+  }
+  // nearest neighbour on a contiguous copy, which was used before
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < loop; ++i) {
+    std::vector<uint8_t> copy(src);
+    ResizeYuvNearest(params, copy.data(), dst.data());
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "[ImagePreproc] 1080p to 720p nearest: " << ms / loop << " ms" << std::endl;
+}
+
+// NV12 image of color gradients, the same as decoded frames
+static std::vector<uint8_t> GradientNV12(int width, int height) {
+  std::vector<uint8_t> yuv(width * height * 3 / 2);
+  for (int r = 0; r < height; ++r) {
+    for (int c = 0; c < width; ++c) yuv[r * width + c] = 16 + (r + c) * 219 / (width + height);
+  }
+  uint8_t *uv = yuv.data() + width * height;
+  for (int r = 0; r < height / 2; ++r) {
+    for (int c = 0; c < width / 2; ++c) {
+      uv[r * width + 2 * c] = 16 + c * 448 / width;
+      uv[r * width + 2 * c + 1] = 16 + r * 448 / height;
+    }
+  }
+  return yuv;
+}
+
+TEST(EncodeBenchmark, SnapshotCropThroughput) {
+  constexpr int width = 1920, height = 1080, crop_num = 2000;
+  constexpr int crop_width = 128, crop_height = 256;
+  std::string dir = GetExePath() + "/encode_output";
+  mkdir(dir.c_str(), 0755);
+  std::vector<uint8_t> yuv = GradientNV12(width, height);
+  for (uint32_t thread_num : {1, 2, 4}) {
+    SnapshotEncoder::Param param;
+    param.thread_num = thread_num;
+    SnapshotEncoder encoder(param);
+    ASSERT_TRUE(encoder.Open());
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < crop_num; ++i) {
+      cv::Rect roi(i * 97 % (width - crop_width), i * 61 % (height - crop_height), crop_width, crop_height);
+      EXPECT_TRUE(encoder.Submit(yuv.data(), yuv.data() + width * height, width, height, width, false, roi,
+                                 dir + "/snapshot_obj_" + std::to_string(i % 16) + ".jpg"));
+    }
+    encoder.Close();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(static_cast<uint64_t>(crop_num), encoder.EncodedNum());
+    std::cout << "[SnapshotEncoder] " << thread_num << " threads, " << crop_width << "x" << crop_height
+              << " crops of " << width << "x" << height << " nv12: " << crop_num * 1000.0 / ms << " crops/s"
+              << std::endl;
+  }
+}
+
+}  // namespace cnstream
@@ -21,6 +21,8 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+
 #include <cstdlib>
 #include <ctime>
 #include <memory>
@@ -48,10 +50,12 @@ TEST(CNEncodeTest, InitFailedCase) {
   cnencode_param.stream_id = "0";
   cnencode_param.device_id = 0;
 
-  cnencode_param.dst_pix_fmt = NV12;
+  // cpu jpeg encoder takes bgr24 and yuv420sp
+  cnencode_param.dst_pix_fmt = RGB24;
   CNEncode cpu_encode(cnencode_param);
   EXPECT_FALSE(cpu_encode.Init());
 
+  cnencode_param.dst_pix_fmt = NV12;
   {
     cnencode_param.encoder_type = "mlu";
     CNEncode mlu_encode(cnencode_param);
@@ -90,4 +94,65 @@ TEST(CNEncodeTest, UpdateFailedCase) {
   EXPECT_FALSE(mlu_encode.Update(nullptr, nullptr, 0, false));
   EXPECT_TRUE(mlu_encode.Update(nullptr, nullptr, 0, true));
 }
+
+TEST(CNEncodeTest, CpuVideoEncode) {
+  CNEncode::CNEncodeParam cnencode_param;
+  cnencode_param.dst_width = 352;
+  cnencode_param.dst_height = 288;
+  cnencode_param.dst_stride = 352;
+  cnencode_param.encoder_type = "cpu";
+  cnencode_param.codec_type = H264;
+  cnencode_param.stream_id = "cpu_video";
+  cnencode_param.output_dir = GetExePath() + "/encode_output";
+  {
+    cnencode_param.dst_pix_fmt = BGR24;
+    CNEncode encode(cnencode_param);
+    EXPECT_FALSE(encode.Init());
+  }
+  cnencode_param.dst_pix_fmt = NV12;
+  CNEncode encode(cnencode_param);
+  ASSERT_TRUE(encode.Init());
+  std::vector<uint8_t> yuv(352 * 288 * 3 / 2, 128);
+  cv::Mat img(288, 352, CV_8UC3, cv::Scalar(0, 0, 0));
+  EXPECT_FALSE(encode.Update(img, 0));
+  for (int i = 0; i < 50; ++i) {
+    memset(yuv.data(), i * 5, 352 * 288);
+    EXPECT_TRUE(encode.Update(yuv.data(), yuv.data() + 352 * 288, i, false));
+  }
+  EXPECT_TRUE(encode.Update(nullptr, nullptr, 0, true));
+  // file is finished at eos
+  struct stat file_stat;
+  ASSERT_EQ(0, stat((cnencode_param.output_dir + "/encode_stream_cpu_video.mp4").c_str(), &file_stat));
+  EXPECT_GT(file_stat.st_size, 0);
+}
+
+TEST(CNEncodeTest, CpuJpegEncode) {
+  CNEncode::CNEncodeParam cnencode_param;
+  cnencode_param.dst_width = 352;
+  cnencode_param.dst_height = 288;
+  cnencode_param.dst_stride = 352;
+  cnencode_param.dst_pix_fmt = NV12;
+  cnencode_param.encoder_type = "cpu";
+  cnencode_param.codec_type = JPEG;
+  cnencode_param.stream_id = "cpu_jpeg";
+  cnencode_param.output_dir = GetExePath() + "/encode_output";
+  std::string prefix = cnencode_param.output_dir + "/stream_cpu_jpeg_frame_";
+  std::vector<uint8_t> yuv(352 * 288 * 3 / 2, 128);
+  cv::Mat img(288, 352, CV_8UC3, cv::Scalar(0, 0, 255));
+  {
+    CNEncode encode(cnencode_param);
+    ASSERT_TRUE(encode.Init());
+    EXPECT_TRUE(encode.Update(yuv.data(), yuv.data() + 352 * 288, 0, false));
+    EXPECT_TRUE(encode.Update(img, 1));
+    EXPECT_TRUE(encode.Update(nullptr, nullptr, 0, true));
+    // snapshots are written before the encoder is destroyed
+  }
+  for (int i = 1; i <= 2; ++i) {
+    cv::Mat decoded = cv::imread(prefix + std::to_string(i) + ".jpg");
+    ASSERT_FALSE(decoded.empty());
+    EXPECT_EQ(352, decoded.cols);
+    EXPECT_EQ(288, decoded.rows);
+  }
+}
+
 }  // namespace cnstream
@@ -21,8 +21,12 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+
 #include <cstdlib>
 #include <ctime>
+#include <fstream>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <utility>
@@ -84,6 +88,37 @@ TEST(EncodeModule, OpenCloseFailedCase) {
   params["device_id"] = "-1";
   EXPECT_FALSE(module.Open(params));
   module.Close();
+  params.clear();
+
+  // segment recording and event clip are supported by cpu video encoding only
+  params["codec_type"] = "jpeg";
+  params["segment_duration"] = "10";
+  EXPECT_FALSE(module.Open(params));
+  module.Close();
+  params["codec_type"] = "h264";
+  params["event_pre_seconds"] = "5";
+  params["event_buffer_size"] = "0";
+  EXPECT_FALSE(module.Open(params));
+  module.Close();
+  params.clear();
+
+  // snapshot parameters of cpu jpeg encoding
+  params["codec_type"] = "jpeg";
+  params["jpeg_quality"] = "0";
+  EXPECT_FALSE(module.Open(params));
+  module.Close();
+  params["jpeg_quality"] = "75";
+  params["snapshot_drop_policy"] = "random";
+  EXPECT_FALSE(module.Open(params));
+  module.Close();
+  params["snapshot_drop_policy"] = "newest";
+  params["snapshot_objects"] = "true";
+  EXPECT_TRUE(module.Open(params));
+  module.Close();
+  params["codec_type"] = "h264";
+  EXPECT_FALSE(module.Open(params));
+  module.Close();
+  params.clear();
 
   // deprecated parameter
   params["dump_dir"] = "";
@@ -242,6 +277,52 @@ TEST(EncodeModule, CheckParamSetFailedCase) {
   EXPECT_FALSE(ptr->CheckParamSet(params));
   params.clear();
 
+  params["encode_threads"] = "not_digit";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params.clear();
+
+  params["input_queue_size"] = "not_digit";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params.clear();
+
+  params["segment_duration"] = "1.5";
+  params["segment_num"] = "10";
+  params["event_pre_seconds"] = "5";
+  params["event_post_seconds"] = "10";
+  params["event_buffer_size"] = "32";
+  EXPECT_TRUE(ptr->CheckParamSet(params));
+  params["segment_duration"] = "-1";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params["segment_duration"] = "1.5";
+  params["event_pre_seconds"] = "not_digit";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params.clear();
+
+  params["codec_type"] = "jpeg";
+  params["jpeg_quality"] = "90";
+  params["snapshot_threads"] = "4";
+  params["snapshot_queue_size"] = "16";
+  params["snapshot_drop_policy"] = "oldest";
+  params["snapshot_objects"] = "true";
+  EXPECT_TRUE(ptr->CheckParamSet(params));
+  params["snapshot_drop_policy"] = "random";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params["snapshot_drop_policy"] = "newest";
+  params["snapshot_threads"] = "not_digit";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params["snapshot_threads"] = "4";
+  params["codec_type"] = "h264";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params.clear();
+
+  // mpeg4 is encoded on cpu only
+  params["codec_type"] = "mpeg4";
+  EXPECT_TRUE(ptr->CheckParamSet(params));
+  params["encoder_type"] = "mlu";
+  params["device_id"] = "0";
+  EXPECT_FALSE(ptr->CheckParamSet(params));
+  params.clear();
+
   params["dst_width"] = "1281";
   params["dst_height"] = "720";
   params["preproc_type"] = "cpu";
@@ -337,7 +418,7 @@ TEST(ModuleEncode, ProcessCpuEncode) {
   dst_wh_vec.push_back({"720", "480"});
   dst_wh_vec.push_back({"1920", "1080"});
   dst_wh_vec.push_back({"360", "240"});
-  std::vector<std::string> codec_type_vec = {"h264", "hevc", "jpeg"};
+  std::vector<std::string> codec_type_vec = {"h264", "hevc", "mpeg4", "jpeg"};
   std::vector<std::string> use_ffmpeg_vec = {"true", "false"};
   ModuleParamSet params;
   params["output_dir"] = GetExePath() + "/encode_output";
@@ -391,4 +472,92 @@ TEST(ModuleEncode, ProcessMluEncode) {
     }
   }
 }
+
+TEST(ModuleEncode, ProcessCpuEncodeStreamAddedAgain) {
+  const uint32_t width = 352, height = 288;
+  const std::string stream_id = "cpu_encode_again";
+  const std::string output_dir = GetExePath() + "/encode_output";
+  ModuleParamSet params;
+  params["output_dir"] = output_dir;
+  params["encoder_type"] = "cpu";
+  params["preproc_type"] = "cpu";
+  params["codec_type"] = "h264";
+  params["dst_width"] = std::to_string(width);
+  params["dst_height"] = std::to_string(height);
+  params["device_id"] = "-1";
+  std::shared_ptr<Module> ptr = std::make_shared<Encode>(gname);
+  ASSERT_TRUE(ptr->Open(params));
+
+  size_t nbytes = ALIGN(width, DEC_ALIGNMENT) * height * 3 / 2;
+  edk::MluMemoryOp mem_op;
+  void *src = mem_op.AllocMlu(nbytes, 1);
+  // the encoder of the stream is closed by eos, the stream added again is encoded by a new one
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < 10; ++i) {
+      auto data = cnstream::CNFrameInfo::Create(stream_id);
+      std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+      data->SetStreamIndex(0);
+      frame->frame_id = i;
+      data->timestamp = i;
+      frame->width = width;
+      frame->height = height;
+      frame->stride[0] = ALIGN(width, DEC_ALIGNMENT);
+      frame->stride[1] = ALIGN(width, DEC_ALIGNMENT);
+      frame->ptr_mlu[0] = src;
+      frame->ptr_mlu[1] = reinterpret_cast<void*>(reinterpret_cast<uint8_t*>(src) + frame->stride[0] * height);
+      frame->ctx.dev_type = DevContext::DevType::MLU;
+      frame->ctx.ddr_channel = g_channel_id;
+      frame->ctx.dev_id = g_device_id;
+      frame->fmt = CN_PIXEL_FORMAT_YUV420_NV21;
+      frame->CopyToSyncMem();
+      data->datas[CNDataFramePtrKey] = frame;
+      EXPECT_EQ(1, ptr->Process(data)) << "round " << round << ", frame " << i;
+    }
+    auto data_eos = cnstream::CNFrameInfo::Create(stream_id, true);
+    EXPECT_EQ(1, ptr->Process(data_eos)) << "round " << round;
+    // file is finished at eos
+    struct stat file_stat;
+    ASSERT_EQ(0, stat((output_dir + "/encode_stream_" + stream_id + ".mp4").c_str(), &file_stat));
+    EXPECT_GT(file_stat.st_size, 0);
+  }
+  mem_op.FreeMlu(src);
+  ptr->Close();
+}
+
+TEST(ModuleEncode, PassthroughStreamAddedAgain) {
+  const std::string stream_id = "passthrough_again";
+  const std::string output_dir = GetExePath() + "/encode_output";
+  ModuleParamSet params;
+  params["output_dir"] = output_dir;
+  params["passthrough"] = "true";
+  std::shared_ptr<Encode> ptr = std::make_shared<Encode>(gname);
+  ASSERT_TRUE(ptr->Open(params));
+  EXPECT_FALSE(ptr->SaveEventClip(stream_id));
+
+  std::vector<std::vector<uint8_t>> streams = {{0, 0, 0, 1, 0x65, 0x88, 0x84}, {0, 0, 0, 1, 0x65, 0x88, 0x80, 0x40}};
+  for (auto &stream : streams) {
+    auto data = cnstream::CNFrameInfo::Create(stream_id);
+    std::shared_ptr<CNPacket> packet = std::make_shared<CNPacket>();
+    packet->data = stream;
+    packet->key = true;
+    packet->codec = CNPacketCodec::H264;
+    data->datas[CNPacketsKey] = CNPacketsVec{packet};
+    EXPECT_EQ(1, ptr->Process(data));
+    // packets are written as they are, event clips need encoding
+    EXPECT_FALSE(ptr->SaveEventClip(stream_id));
+    auto data_eos = cnstream::CNFrameInfo::Create(stream_id, true);
+    EXPECT_EQ(1, ptr->Process(data_eos));
+  }
+  ptr->Close();
+
+  // the stream added again after eos is written to a new file, the earlier one is kept
+  std::vector<std::string> file_names = {output_dir + "/passthrough_stream_" + stream_id + ".h264",
+                                         output_dir + "/passthrough_stream_" + stream_id + "_1.h264"};
+  for (size_t i = 0; i < file_names.size(); ++i) {
+    std::ifstream file(file_names[i], std::ios::binary);
+    ASSERT_TRUE(file.is_open()) << file_names[i];
+    std::vector<uint8_t> written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(written == streams[i]) << file_names[i];
+  }
+}
 }  // namespace cnstream
@@ -291,4 +291,70 @@ TEST(EncodePreprocTest, Yuv2Yuv) {
   delete[] src;
   delete[] dst;
 }
+
+// smooth random planes, stride is larger than width
+static void FillYuv(uint32_t width, uint32_t height, uint32_t stride, std::vector<uint8_t> *yuv) {
+  yuv->assign(stride * height * 3 / 2, 0);
+  cv::Mat y(height, width, CV_8UC1, yuv->data(), stride);
+  cv::Mat uv(height / 2, width / 2, CV_8UC2, yuv->data() + stride * height, stride);
+  cv::randu(y, 0, 256);
+  cv::randu(uv, 0, 256);
+  cv::GaussianBlur(y, y, cv::Size(5, 5), 1.5);
+  cv::GaussianBlur(uv, uv, cv::Size(5, 5), 1.5);
+}
+
+static double MeanAbsDiff(const uint8_t *a, const uint8_t *b, uint32_t width, uint32_t height, uint32_t stride) {
+  double sum = 0;
+  for (uint32_t r = 0; r < height; ++r) {
+    for (uint32_t c = 0; c < width; ++c) {
+      sum += std::abs(a[r * stride + c] - b[r * stride + c]);
+    }
+  }
+  return sum / (width * height);
+}
+
+TEST(EncodePreprocTest, Yuv2YuvResizeMatchSwscale) {
+  std::vector<std::pair<uint32_t, uint32_t>> src_wh = {{1920, 1080}, {1920, 1080}, {640, 360}};
+  std::vector<std::pair<uint32_t, uint32_t>> dst_wh = {{1280, 720}, {960, 540}, {1920, 1080}};
+  for (size_t i = 0; i < src_wh.size(); ++i) {
+    ImagePreproc::ImagePreprocParam params;
+    params.src_pix_fmt = NV12;
+    params.dst_pix_fmt = NV12;
+    params.src_width = src_wh[i].first;
+    params.src_height = src_wh[i].second;
+    params.src_stride = params.src_width + 64;
+    params.dst_width = dst_wh[i].first;
+    params.dst_height = dst_wh[i].second;
+    params.dst_stride = params.dst_width;
+    std::vector<uint8_t> src;
+    FillYuv(params.src_width, params.src_height, params.src_stride, &src);
+    const uint8_t *src_y = src.data(), *src_uv = src.data() + params.src_stride * params.src_height;
+
+    ImagePreproc preproc(params);
+    ASSERT_TRUE(preproc.Init());
+    std::vector<uint8_t> dst(params.dst_stride * params.dst_height * 3 / 2);
+    ASSERT_TRUE(preproc.Yuv2Yuv(src_y, src_uv, dst.data()));
+
+    // reference is area interpolation of libswscale
+    SwsContext *sws = sws_getContext(params.src_width, params.src_height, AV_PIX_FMT_NV12, params.dst_width,
+                                     params.dst_height, AV_PIX_FMT_NV12, SWS_AREA, nullptr, nullptr, nullptr);
+    ASSERT_TRUE(sws != nullptr);
+    std::vector<uint8_t> ref(dst.size());
+    const uint8_t *src_data[4] = {src_y, src_uv, nullptr, nullptr};
+    int src_linesize[4] = {static_cast<int>(params.src_stride), static_cast<int>(params.src_stride), 0, 0};
+    uint8_t *ref_data[4] = {ref.data(), ref.data() + params.dst_stride * params.dst_height, nullptr, nullptr};
+    int ref_linesize[4] = {static_cast<int>(params.dst_stride), static_cast<int>(params.dst_stride), 0, 0};
+    sws_scale(sws, src_data, src_linesize, 0, params.src_height, ref_data, ref_linesize);
+    sws_freeContext(sws);
+
+    double y_diff = MeanAbsDiff(dst.data(), ref_data[0], params.dst_width, params.dst_height, params.dst_stride);
+    double uv_diff = MeanAbsDiff(dst.data() + params.dst_stride * params.dst_height, ref_data[1], params.dst_width,
+                                 params.dst_height / 2, params.dst_stride);
+    EXPECT_LT(y_diff, 1.5) << src_wh[i].first << "x" << src_wh[i].second << " to " << dst_wh[i].first << "x"
+                           << dst_wh[i].second;
+    EXPECT_LT(uv_diff, 1.5) << src_wh[i].first << "x" << src_wh[i].second << " to " << dst_wh[i].first << "x"
+                            << dst_wh[i].second;
+  }
+}
+
 }  // namespace cnstream
@@ -0,0 +1,104 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "passthrough_writer.hpp"
+#include "test_base.hpp"
+
+namespace cnstream {
+
+static std::shared_ptr<CNPacket> MakePacket(std::vector<uint8_t> data, bool key) {
+  std::shared_ptr<CNPacket> packet = std::make_shared<CNPacket>();
+  packet->data = std::move(data);
+  packet->key = key;
+  packet->codec = CNPacketCodec::H264;
+  return packet;
+}
+
+static std::vector<uint8_t> ReadAll(const std::string &file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+TEST(PassthroughWriter, MakeSei) {
+  // emulation prevention bytes are inserted into the payload
+  std::string payload("pts=0");
+  payload += std::string(3, '\0');
+  std::vector<uint8_t> sei = PassthroughWriter::MakeSei(CNPacketCodec::H264, payload);
+  std::vector<uint8_t> head = {0, 0, 0, 1, 6, 5, 24};
+  ASSERT_GT(sei.size(), head.size());
+  EXPECT_TRUE(std::equal(head.begin(), head.end(), sei.begin()));
+  std::vector<uint8_t> tail = {0, 0, 3, 0, 0x80};
+  EXPECT_TRUE(std::equal(tail.rbegin(), tail.rend(), sei.rbegin()));
+
+  std::vector<uint8_t> hevc = PassthroughWriter::MakeSei(CNPacketCodec::HEVC, std::string(300, 'a'));
+  std::vector<uint8_t> hevc_head = {0, 0, 0, 1, 39 << 1, 1, 5, 255, 316 - 255};
+  EXPECT_TRUE(std::equal(hevc_head.begin(), hevc_head.end(), hevc.begin()));
+  EXPECT_TRUE(PassthroughWriter::MakeSei(CNPacketCodec::MJPEG, payload).empty());
+}
+
+TEST(PassthroughWriter, WriteWithMetadata) {
+  std::string dir = GetExePath() + "/encode_output";
+  mkdir(dir.c_str(), 0755);
+  std::vector<uint8_t> sps_idr = {0, 0, 0, 1, 0x67, 1, 2, 0, 0, 1, 0x65, 9, 9};
+  std::vector<uint8_t> slice = {0, 0, 0, 1, 0x41, 7};
+  CNPacketsVec packets = {MakePacket(sps_idr, true), MakePacket(slice, false)};
+  std::shared_ptr<CNInferObject> obj = std::make_shared<CNInferObject>();
+  obj->SetClassId(2);
+  obj->SetTrackId(5);
+  obj->score = 0.5;
+  obj->bbox = {0.25, 0.5, 0.125, 0.25};
+  CNObjsVec objs = {obj};
+  std::string text = PassthroughWriter::FormatMetadata(3600, objs);
+  EXPECT_EQ("pts=3600;2,5,0.5,0.25,0.5,0.125,0.25", text);
+
+  PassthroughWriter plain(dir + "/passthrough_plain", false);
+  ASSERT_TRUE(plain.Write(packets, 3600, &objs));
+  plain.Close();
+  EXPECT_EQ(dir + "/passthrough_plain.h264", plain.FileName());
+  std::vector<uint8_t> expected = sps_idr;
+  expected.insert(expected.end(), slice.begin(), slice.end());
+  EXPECT_TRUE(expected == ReadAll(plain.FileName()));
+  // the closed file is not truncated by later packets
+  EXPECT_FALSE(plain.Write(packets, 7200, &objs));
+  EXPECT_TRUE(expected == ReadAll(plain.FileName()));
+
+  // sei goes before the first slice of the last packet
+  PassthroughWriter writer(dir + "/passthrough_meta", true);
+  ASSERT_TRUE(writer.Write(packets, 3600, &objs));
+  writer.Close();
+  std::vector<uint8_t> sei = PassthroughWriter::MakeSei(CNPacketCodec::H264, text);
+  expected = sps_idr;
+  expected.insert(expected.end(), sei.begin(), sei.end());
+  expected.insert(expected.end(), slice.begin(), slice.end());
+  EXPECT_TRUE(expected == ReadAll(writer.FileName()));
+  EXPECT_EQ(expected.size(), writer.WrittenBytes());
+}
+
+}  // namespace cnstream
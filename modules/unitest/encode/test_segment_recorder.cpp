@@ -0,0 +1,317 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ffmpeg_encoder.hpp"
+#include "segment_recorder.hpp"
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+namespace cnstream {
+
+static constexpr int kGop = 25;
+static const AVRational kTimeBase = {1, 25};
+
+// synthetic packet of frame index, one key frame every kGop frames
+static EncodedPacketPtr MakePacket(int64_t index, size_t size = 100) {
+  std::shared_ptr<EncodedPacket> packet = std::make_shared<EncodedPacket>();
+  packet->data.resize(size);
+  for (size_t i = 0; i < size; ++i) packet->data[i] = static_cast<uint8_t>((index * 7 + i) % 251);
+  packet->pts = packet->dts = index;
+  packet->duration = 1;
+  packet->key = index % kGop == 0;
+  return packet;
+}
+
+static SegmentRecorder::StreamInfo SyntheticStream() {
+  SegmentRecorder::StreamInfo info;
+  info.codec_id = AV_CODEC_ID_MPEG4;
+  info.width = 64;
+  info.height = 64;
+  info.time_base = kTimeBase;
+  return info;
+}
+
+static bool FileExists(const std::string &file_name) { return access(file_name.c_str(), F_OK) == 0; }
+
+// returns number of packets in the file, -1 if failed. first_key is set if the first packet is key frame
+static int ReadPackets(const std::string &file_name, bool *first_key) {
+  AVFormatContext *ctx = nullptr;
+  if (avformat_open_input(&ctx, file_name.c_str(), nullptr, nullptr) < 0) return -1;
+  AVPacket packet;
+  av_init_packet(&packet);
+  packet.data = nullptr;
+  packet.size = 0;
+  int num = 0;
+  while (av_read_frame(ctx, &packet) >= 0) {
+    if (num++ == 0 && first_key) *first_key = packet.flags & AV_PKT_FLAG_KEY;
+    av_packet_unref(&packet);
+  }
+  avformat_close_input(&ctx);
+  return num;
+}
+
+static std::string OutputPrefix(const std::string &name) {
+  char *path = getcwd(NULL, 0);
+  std::string prefix = std::string(path ? path : ".") + "/" + name;
+  free(path);
+  return prefix;
+}
+
+TEST(SegmentRecorderTest, PacketRingBoundedByDuration) {
+  PacketRing ring(2 * kGop, 0);
+  // packets before the first key frame are dropped
+  ring.Push(MakePacket(kGop - 1));
+  EXPECT_TRUE(ring.Empty());
+  for (int i = 0; i < 8 * kGop; ++i) ring.Push(MakePacket(i));
+  // the rest still covers max_duration after a gop is dropped
+  EXPECT_EQ(ring.GopNum(), 3u);
+  EXPECT_EQ(ring.StartPts(), 5 * kGop);
+  EXPECT_GE(ring.Duration(), 2 * kGop);
+  EXPECT_EQ(ring.Bytes(), 3u * kGop * 100);
+
+  std::vector<EncodedPacketPtr> packets = ring.Since(6 * kGop + 10);
+  ASSERT_EQ(packets.size(), 2u * kGop);
+  EXPECT_TRUE(packets.front()->key);
+  EXPECT_EQ(packets.front()->pts, 6 * kGop);
+  EXPECT_EQ(packets.back()->pts, 8 * kGop - 1);
+  // starts from the first gop if pts is earlier than the ring
+  packets = ring.Since(0);
+  ASSERT_EQ(packets.size(), 3u * kGop);
+  EXPECT_EQ(packets.front()->pts, 5 * kGop);
+
+  ring.Clear();
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_EQ(ring.Bytes(), 0u);
+}
+
+TEST(SegmentRecorderTest, PacketRingBoundedByBytes) {
+  PacketRing ring(100 * kGop, 3 * kGop * 100 / 2);
+  for (int i = 0; i < 4 * kGop; ++i) {
+    ring.Push(MakePacket(i));
+    EXPECT_TRUE(ring.Bytes() <= 3u * kGop * 100 / 2 || ring.GopNum() == 1);
+  }
+  EXPECT_EQ(ring.GopNum(), 1u);
+  EXPECT_EQ(ring.StartPts(), 3 * kGop);
+  // the latest gop is kept even if it exceeds max_bytes
+  PacketRing small(100 * kGop, 100);
+  for (int i = 0; i < kGop; ++i) small.Push(MakePacket(i));
+  EXPECT_EQ(small.GopNum(), 1u);
+  EXPECT_EQ(small.Bytes(), kGop * 100u);
+}
+
+TEST(SegmentRecorderTest, OpenFailedCase) {
+  SegmentRecorder::Param param;
+  param.file_prefix = OutputPrefix("segment_open_failed");
+  {
+    SegmentRecorder recorder(param);
+    EXPECT_FALSE(recorder.Open(SyntheticStream()));
+  }
+  param.segment_duration = 1;
+  {
+    SegmentRecorder::StreamInfo info = SyntheticStream();
+    info.time_base = {0, 1};
+    SegmentRecorder recorder(param);
+    EXPECT_FALSE(recorder.Open(info));
+  }
+  SegmentRecorder recorder(param);
+  ASSERT_TRUE(recorder.Open(SyntheticStream()));
+  EXPECT_FALSE(recorder.Open(SyntheticStream()));
+  // event clip is disabled
+  recorder.Write(MakePacket(0));
+  EXPECT_FALSE(recorder.SaveClip(param.file_prefix + "_clip.mp4", 1, 1));
+  recorder.Close();
+  std::remove((param.file_prefix + "_0.mp4").c_str());
+}
+
+TEST(SegmentRecorderTest, RollSegments) {
+  SegmentRecorder::Param param;
+  param.file_prefix = OutputPrefix("segment_roll");
+  param.segment_duration = 2;
+  {
+    SegmentRecorder recorder(param);
+    ASSERT_TRUE(recorder.Open(SyntheticStream()));
+    // segment starts at key frame
+    for (int i = kGop - 5; i < 11 * kGop; ++i) recorder.Write(MakePacket(i));
+    recorder.Close();
+    EXPECT_EQ(recorder.DroppedPackets(), 0u);
+  }
+  for (int i = 0; i < 5; ++i) {
+    std::string file_name = param.file_prefix + "_" + std::to_string(i) + ".mp4";
+    bool first_key = false;
+    EXPECT_EQ(ReadPackets(file_name, &first_key), 2 * kGop) << file_name;
+    EXPECT_TRUE(first_key) << file_name;
+    std::remove(file_name.c_str());
+  }
+  EXPECT_FALSE(FileExists(param.file_prefix + "_5.mp4"));
+
+  // only the latest segments are kept
+  param.segment_num = 2;
+  {
+    SegmentRecorder recorder(param);
+    ASSERT_TRUE(recorder.Open(SyntheticStream()));
+    for (int i = 0; i < 10 * kGop; ++i) recorder.Write(MakePacket(i));
+  }
+  for (int i = 0; i < 5; ++i) {
+    std::string file_name = param.file_prefix + "_" + std::to_string(i) + ".mp4";
+    EXPECT_EQ(FileExists(file_name), i >= 3) << file_name;
+    std::remove(file_name.c_str());
+  }
+}
+
+TEST(SegmentRecorderTest, EventClip) {
+  SegmentRecorder::Param param;
+  param.file_prefix = OutputPrefix("segment_event");
+  param.buffer_duration = 3;
+  std::string clip_name = param.file_prefix + "_clip.mp4";
+  std::string clip2_name = param.file_prefix + "_clip2.mp4";
+  {
+    SegmentRecorder recorder(param);
+    EXPECT_FALSE(recorder.SaveClip(clip_name, 2, 1));
+    ASSERT_TRUE(recorder.Open(SyntheticStream()));
+    // nothing is recorded yet
+    EXPECT_FALSE(recorder.SaveClip(clip_name, 2, 1));
+    for (int i = 0; i < 6 * kGop; ++i) recorder.Write(MakePacket(i));
+    // event at frame 149, clip starts from the key frame at or before frame 99 and ends at frame 174
+    EXPECT_TRUE(recorder.SaveClip(clip_name, 2, 1));
+    // pre seconds are limited by buffer, clip without post seconds is finished at once
+    EXPECT_TRUE(recorder.SaveClip(clip2_name, 100, 0));
+    for (int i = 6 * kGop; i < 10 * kGop; ++i) recorder.Write(MakePacket(i));
+  }
+  bool first_key = false;
+  EXPECT_EQ(ReadPackets(clip_name, &first_key), 4 * kGop);
+  EXPECT_TRUE(first_key);
+  EXPECT_EQ(ReadPackets(clip2_name, &first_key), 4 * kGop);
+  EXPECT_TRUE(first_key);
+  // continuous recording is disabled
+  EXPECT_FALSE(FileExists(param.file_prefix + "_0.mp4"));
+  std::remove(clip_name.c_str());
+  std::remove(clip2_name.c_str());
+}
+
+TEST(SegmentRecorderTest, RollSegmentsWithClips) {
+  SegmentRecorder::Param param;
+  param.file_prefix = OutputPrefix("segment_clips");
+  param.segment_duration = 1;
+  param.buffer_duration = 2;
+  {
+    SegmentRecorder recorder(param);
+    ASSERT_TRUE(recorder.Open(SyntheticStream()));
+    // files are written by the writer thread while segments roll and clips are saved
+    for (int i = 0; i < 20 * kGop; ++i) {
+      recorder.Write(MakePacket(i, 20000));
+      if (i % (5 * kGop) == 0) {
+        EXPECT_TRUE(recorder.SaveClip(param.file_prefix + "_clip" + std::to_string(i) + ".mp4", 1, 1));
+      }
+    }
+    // waits until all files are finished
+    recorder.Close();
+    EXPECT_EQ(recorder.DroppedPackets(), 0u);
+  }
+  for (int i = 0; i < 20; ++i) {
+    std::string file_name = param.file_prefix + "_" + std::to_string(i) + ".mp4";
+    bool first_key = false;
+    EXPECT_EQ(ReadPackets(file_name, &first_key), kGop) << file_name;
+    EXPECT_TRUE(first_key) << file_name;
+    std::remove(file_name.c_str());
+  }
+  for (int i = 0; i < 20 * kGop; i += 5 * kGop) {
+    std::string clip_name = param.file_prefix + "_clip" + std::to_string(i) + ".mp4";
+    bool first_key = false;
+    EXPECT_GT(ReadPackets(clip_name, &first_key), kGop) << clip_name;
+    EXPECT_TRUE(first_key) << clip_name;
+    std::remove(clip_name.c_str());
+  }
+}
+
+TEST(SegmentRecorderTest, RecordEncodedVideo) {
+  FFmpegEncoder::Param param;
+  param.width = 64;
+  param.height = 64;
+  param.codec_type = MPEG4;
+  param.frame_rate = 25;
+  param.gop = kGop;
+  param.record.file_prefix = OutputPrefix("segment_encode");
+  param.record.segment_duration = 1;
+  param.record.buffer_duration = 2;
+  std::string clip_name = param.record.file_prefix + "_clip.mp4";
+  std::vector<uint8_t> image(param.width * param.height * 3 / 2, 128);
+  std::mutex mtx;
+  std::condition_variable cond;
+  int packet_num = 0;
+  {
+    FFmpegEncoder encoder(param);
+    EXPECT_FALSE(encoder.SaveClip(clip_name, 1, 1));
+    // packets are recorded before the callback is called
+    encoder.SetPacketCallback([&](int64_t) {
+      std::lock_guard<std::mutex> lk(mtx);
+      ++packet_num;
+      cond.notify_one();
+    });
+    ASSERT_TRUE(encoder.Open());
+    for (int i = 0; i < 4 * kGop; ++i) {
+      image[i % image.size()] = i;
+      ASSERT_TRUE(encoder.SendFrame(image.data(), image.data() + param.width * param.height, param.width, i));
+      if (i == 2 * kGop + 10) {
+        // packets are encoded asynchronously, wait until two gops are recorded
+        std::unique_lock<std::mutex> lk(mtx);
+        ASSERT_TRUE(cond.wait_for(lk, std::chrono::seconds(10), [&] { return packet_num >= 2 * kGop; }));
+        lk.unlock();
+        EXPECT_TRUE(encoder.SaveClip(clip_name, 1, 1));
+      }
+    }
+    encoder.Close();
+    EXPECT_FALSE(encoder.SaveClip(clip_name, 1, 1));
+  }
+  int total = 0;
+  for (int i = 0; i < 4; ++i) {
+    std::string file_name = param.record.file_prefix + "_" + std::to_string(i) + ".mp4";
+    bool first_key = false;
+    int num = ReadPackets(file_name, &first_key);
+    EXPECT_EQ(num, kGop) << file_name;
+    EXPECT_TRUE(first_key) << file_name;
+    total += num;
+    std::remove(file_name.c_str());
+  }
+  EXPECT_EQ(total, 4 * kGop);
+  bool first_key = false;
+  EXPECT_GE(ReadPackets(clip_name, &first_key), 2 * kGop);
+  EXPECT_TRUE(first_key);
+  std::remove(clip_name.c_str());
+}
+
+}  // namespace cnstream
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
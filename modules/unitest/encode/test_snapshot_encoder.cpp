@@ -0,0 +1,153 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#if (CV_MAJOR_VERSION >= 3)
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "snapshot_encoder.hpp"
+#include "test_base.hpp"
+
+namespace cnstream {
+
+static std::string SnapshotDir() {
+  std::string dir = GetExePath() + "/encode_output";
+  mkdir(dir.c_str(), 0755);
+  return dir;
+}
+
+// NV12 image of color gradients, the same as decoded frames
+static std::vector<uint8_t> GradientNV12(int width, int height) {
+  std::vector<uint8_t> yuv(width * height * 3 / 2);
+  for (int r = 0; r < height; ++r) {
+    for (int c = 0; c < width; ++c) yuv[r * width + c] = 16 + (r + c) * 219 / (width + height);
+  }
+  uint8_t *uv = yuv.data() + width * height;
+  for (int r = 0; r < height / 2; ++r) {
+    for (int c = 0; c < width / 2; ++c) {
+      uv[r * width + 2 * c] = 16 + c * 448 / width;
+      uv[r * width + 2 * c + 1] = 16 + r * 448 / height;
+    }
+  }
+  return yuv;
+}
+
+TEST(SnapshotEncoderTest, OpenFailedCase) {
+  SnapshotEncoder::Param param;
+  param.thread_num = 0;
+  SnapshotEncoder zero_thread(param);
+  EXPECT_FALSE(zero_thread.Open());
+
+  param.thread_num = 1;
+  SnapshotEncoder encoder(param);
+  std::vector<uint8_t> yuv = GradientNV12(64, 64);
+  EXPECT_FALSE(encoder.Submit(yuv.data(), yuv.data() + 64 * 64, 64, 64, 64, false, cv::Rect(), "not_opened.jpg"));
+  ASSERT_TRUE(encoder.Open());
+  EXPECT_FALSE(encoder.Open());
+  // roi out of the image, stride less than width
+  EXPECT_FALSE(encoder.Submit(yuv.data(), yuv.data() + 64 * 64, 64, 64, 64, false, cv::Rect(64, 0, 8, 8), "a.jpg"));
+  EXPECT_FALSE(encoder.Submit(yuv.data(), yuv.data() + 64 * 64, 64, 64, 32, false, cv::Rect(), "b.jpg"));
+  EXPECT_FALSE(encoder.Submit(cv::Mat(), cv::Rect(), "c.jpg"));
+  encoder.Close();
+  EXPECT_EQ(0u, encoder.EncodedNum());
+}
+
+TEST(SnapshotEncoderTest, EncodeWholeFrameAndCrop) {
+  constexpr int width = 352, height = 288;
+  std::string dir = SnapshotDir();
+  std::vector<uint8_t> yuv = GradientNV12(width, height);
+  cv::Mat nv12(height * 3 / 2, width, CV_8UC1, yuv.data());
+  cv::Mat bgr;
+  cv::cvtColor(nv12, bgr, cv::COLOR_YUV2BGR_NV12);
+
+  SnapshotEncoder::Param param;
+  param.quality = 95;
+  SnapshotEncoder encoder(param);
+  ASSERT_TRUE(encoder.Open());
+  std::atomic<int> done{0};
+  auto on_done = [&done]() { ++done; };
+  EXPECT_TRUE(encoder.Submit(yuv.data(), yuv.data() + width * height, width, height, width, false, cv::Rect(),
+                             dir + "/snapshot_nv12.jpg", on_done));
+  // roi is aligned to even and clipped to the image
+  EXPECT_TRUE(encoder.Submit(yuv.data(), yuv.data() + width * height, width, height, width, false,
+                             cv::Rect(101, 51, 99, 300), dir + "/snapshot_crop.jpg", on_done));
+  EXPECT_TRUE(encoder.Submit(bgr, cv::Rect(100, 50, 100, 100), dir + "/snapshot_bgr.jpg", on_done));
+  encoder.Close();
+  EXPECT_EQ(3u, encoder.EncodedNum());
+  EXPECT_EQ(3, done.load());
+
+  // colors are kept, jpeg takes full range yuv converted from video range
+  cv::Mat whole = cv::imread(dir + "/snapshot_nv12.jpg");
+  ASSERT_EQ(width, whole.cols);
+  ASSERT_EQ(height, whole.rows);
+  cv::Mat diff;
+  cv::absdiff(whole, bgr, diff);
+  cv::Scalar mean = cv::mean(diff);
+  EXPECT_LT(mean[0] + mean[1] + mean[2], 3 * 4.0);
+
+  cv::Mat crop = cv::imread(dir + "/snapshot_crop.jpg");
+  EXPECT_EQ(100, crop.cols);
+  EXPECT_EQ(288 - 50, crop.rows);
+  cv::Mat bgr_crop = cv::imread(dir + "/snapshot_bgr.jpg");
+  ASSERT_EQ(100, bgr_crop.cols);
+  ASSERT_EQ(100, bgr_crop.rows);
+  cv::absdiff(bgr_crop, bgr(cv::Rect(100, 50, 100, 100)), diff);
+  mean = cv::mean(diff);
+  EXPECT_LT(mean[0] + mean[1] + mean[2], 3 * 4.0);
+}
+
+TEST(SnapshotEncoderTest, DropPolicy) {
+  constexpr int width = 1280, height = 720, submit_num = 50;
+  std::string dir = SnapshotDir();
+  std::vector<uint8_t> yuv = GradientNV12(width, height);
+  for (auto policy : {SnapshotEncoder::DropPolicy::NONE, SnapshotEncoder::DropPolicy::NEWEST,
+                      SnapshotEncoder::DropPolicy::OLDEST}) {
+    SnapshotEncoder::Param param;
+    param.thread_num = 1;
+    param.queue_size = 1;
+    param.drop_policy = policy;
+    SnapshotEncoder encoder(param);
+    ASSERT_TRUE(encoder.Open());
+    for (int i = 0; i < submit_num; ++i) {
+      EXPECT_TRUE(encoder.Submit(yuv.data(), yuv.data() + width * height, width, height, width, false, cv::Rect(),
+                                 dir + "/snapshot_drop_" + std::to_string(i % 4) + ".jpg"));
+    }
+    encoder.Close();
+    EXPECT_EQ(static_cast<uint64_t>(submit_num), encoder.EncodedNum() + encoder.DroppedNum());
+    if (policy == SnapshotEncoder::DropPolicy::NONE) {
+      EXPECT_EQ(0u, encoder.DroppedNum());
+    } else {
+      // submitting is much faster than encoding whole frames
+      EXPECT_GT(encoder.DroppedNum(), 0u);
+    }
+  }
+}
+
+}  // namespace cnstream
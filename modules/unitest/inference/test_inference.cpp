@@ -436,7 +436,7 @@ TEST(Inferencer, ProcessObject) {
   std::string image_path = GetExePath() + g_image_path;
 
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = "1";
+  obj->SetClassId(1);
   obj->score = 0.8;
   obj->bbox.x = 0.1;
   obj->bbox.y = 0.1;
@@ -0,0 +1,205 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client_handler.hpp"
+#include "cnstream_frame_va.hpp"
+#include "cnstream_pipeline.hpp"
+#include "module_ipc.hpp"
+
+namespace cnstream {
+
+/*
+ * Throughput of sending frames to two servers: the client process sends frames of kStreamNum streams as fast as the
+ * fast server releases them, and the slow server receives kSlowStreamId only with drop oldest backpressure.
+ */
+static const char* kFastBenchSocket = "benchmark_ipc_fanout_fast";
+static const char* kSlowBenchSocket = "benchmark_ipc_fanout_slow";
+static const char* kSlowStreamId = "1";
+static constexpr uint32_t kStreamNum = 3;
+static constexpr uint64_t kFramesPerStream = 2000;
+static constexpr int kSlowSinkDelayMs = 20;
+static constexpr int kWidth = 320;
+static constexpr int kHeight = 240;
+
+class FanOutSinkForBenchmark : public Module, public ModuleCreator<FanOutSinkForBenchmark> {
+ public:
+  explicit FanOutSinkForBenchmark(const std::string& name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override {
+    if (param_set.find("delay_ms") != param_set.end()) delay_ms_ = std::stoi(param_set["delay_ms"]);
+    return true;
+  }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    if (!data->IsEos() && delay_ms_) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+    return 0;
+  }
+
+  int delay_ms_ = 0;
+};
+
+class FanOutBenchmarkEosObserver : public StreamMsgObserver {
+ public:
+  explicit FanOutBenchmarkEosObserver(uint32_t stream_num) : stream_num_(stream_num) {}
+  void Update(const StreamMsg& smsg) override {
+    if (smsg.type == StreamMsgType::EOS_MSG && ++eos_num_ == stream_num_) wakener_.set_value();
+  }
+  bool WaitForEos() {
+    return std::future_status::ready == wakener_.get_future().wait_for(std::chrono::seconds(60));
+  }
+
+ private:
+  uint32_t stream_num_;
+  uint32_t eos_num_ = 0;
+  std::promise<void> wakener_;
+};
+
+namespace {
+
+int ServerProcess(bool slow) {
+  Pipeline pipeline(slow ? "fanout_benchmark_slow_pipeline" : "fanout_benchmark_fast_pipeline");
+  CNModuleConfig ipc_config;
+  ipc_config.name = "ipc";
+  ipc_config.className = "cnstream::ModuleIPC";
+  ipc_config.next = {"sink"};
+  ipc_config.parameters = {{"ipc_type", "server"}, {"memmap_type", "cpu"}};
+  if (slow) {
+    ipc_config.parameters["socket_address"] = kSlowBenchSocket;
+    ipc_config.parameters["stream_ids"] = kSlowStreamId;
+    ipc_config.parameters["backpressure"] = "drop_oldest";
+  } else {
+    ipc_config.parameters["socket_address"] = kFastBenchSocket;
+  }
+  ipc_config.maxInputQueueSize = 0;
+  ipc_config.parallelism = 0;
+
+  CNModuleConfig sink_config;
+  sink_config.name = "sink";
+  sink_config.className = "cnstream::FanOutSinkForBenchmark";
+  if (slow) sink_config.parameters = {{"delay_ms", std::to_string(kSlowSinkDelayMs)}};
+  sink_config.maxInputQueueSize = 20;
+  sink_config.parallelism = 1;
+
+  if (0 != pipeline.BuildPipeline({ipc_config, sink_config})) return 1;
+  ModuleIPC* ipc = dynamic_cast<ModuleIPC*>(pipeline.GetModule("ipc"));
+  if (!ipc) return 2;
+  uint32_t stream_num = slow ? 1 : kStreamNum;
+  ipc->SetStreamCount(stream_num);
+  FanOutBenchmarkEosObserver observer(stream_num);
+  pipeline.SetStreamMsgObserver(&observer);
+  if (!pipeline.Start()) return 3;
+  bool all_eos = observer.WaitForEos();
+  pipeline.Stop();
+  return all_eos ? 0 : 4;
+}
+
+std::shared_ptr<CNFrameInfo> MakeFrame(uint32_t stream_idx, uint64_t frame_id, std::vector<uint8_t>* pixels) {
+  std::shared_ptr<CNFrameInfo> data = CNFrameInfo::Create(std::to_string(stream_idx));
+  data->SetStreamIndex(stream_idx);
+  data->timestamp = frame_id;
+  std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+  frame->frame_id = frame_id;
+  frame->fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame->width = kWidth;
+  frame->height = kHeight;
+  frame->stride[0] = frame->stride[1] = kWidth;
+  frame->ctx.dev_type = DevContext::CPU;
+  uint8_t* ptr = pixels->data();
+  for (int i = 0; i < frame->GetPlanes(); ++i) {
+    frame->data[i].reset(new CNSyncedMemory(frame->GetPlaneBytes(i)));
+    frame->data[i]->SetCpuData(ptr);
+    ptr += frame->GetPlaneBytes(i);
+  }
+  data->datas[CNDataFramePtrKey] = frame;
+  return data;
+}
+
+}  // namespace
+
+TEST(IPCFanOutBenchmark, SlowServerDropsOldest) {
+  pid_t fast_pid = fork();
+  ASSERT_GE(fast_pid, 0);
+  if (0 == fast_pid) {
+    _exit(ServerProcess(false));
+  }
+  pid_t slow_pid = fork();
+  ASSERT_GE(slow_pid, 0);
+  if (0 == slow_pid) {
+    _exit(ServerProcess(true));
+  }
+
+  ModuleIPC client("client");
+  ModuleParamSet param = {{"ipc_type", "client"},
+                          {"memmap_type", "cpu"},
+                          {"socket_address", std::string(kFastBenchSocket) + "," + kSlowBenchSocket},
+                          {"max_cachedframe_size", "4"}};
+  ASSERT_TRUE(client.Open(param));
+  ASSERT_EQ(2u, client.GetIPCHandlers().size());
+  auto fast_handler = std::dynamic_pointer_cast<IPCClientHandler>(client.GetIPCHandlers()[0]);
+  auto slow_handler = std::dynamic_pointer_cast<IPCClientHandler>(client.GetIPCHandlers()[1]);
+  ASSERT_TRUE(fast_handler != nullptr && slow_handler != nullptr);
+  std::shared_ptr<IPCFrameCache> frame_cache = fast_handler->GetFrameCache();
+
+  std::vector<uint8_t> pixels(kWidth * kHeight * 3 / 2, 0x5a);
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t frame_id = 0; frame_id < kFramesPerStream; ++frame_id) {
+    for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+      client.Process(MakeFrame(stream_idx, frame_id, &pixels));
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+    std::shared_ptr<CNFrameInfo> eos_data = CNFrameInfo::Create(std::to_string(stream_idx), true);
+    eos_data->SetStreamIndex(stream_idx);
+    client.Process(eos_data);
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (frame_cache->Size() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(0u, frame_cache->Size());
+  uint64_t dropped_frame_num = slow_handler->GetDroppedFrameNum();
+  uint64_t fallback_frame_num = frame_cache->GetFallbackFrameNum();
+  client.Close();
+
+  for (pid_t pid : {fast_pid, slow_pid}) {
+    int status;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+  }
+  std::cout << "[IPCFanOut] " << kStreamNum * kFramesPerStream / seconds << " fps sent to 2 servers, "
+            << dropped_frame_num << " frames dropped for the slow server, " << fallback_frame_num
+            << " frames not in the frame ring" << std::endl;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,131 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cnsocket.hpp"
+#include "ipc_handler.hpp"
+#include "ipc_protocol.hpp"
+#include "module_ipc.hpp"
+
+namespace cnstream {
+
+class IPCProtocolHandler : public IPCHandler {
+ public:
+  explicit IPCProtocolHandler(ModuleIPC* ipc_module) : IPCHandler(IPC_CLIENT, ipc_module) {}
+  bool Open() override { return true; }
+  void Close() override {}
+  void Shutdown() override {}
+  void RecvPackageLoop() override {}
+  bool Send() override { return true; }
+  void SendPackageLoop() override {}
+  void SetProtocolVersion(uint16_t version) { protocol_version_.store(version); }
+  using IPCHandler::EncodePackage;
+  using IPCHandler::ParseStringToPackage;
+  using IPCHandler::RecvPackage;
+  using IPCHandler::SendPackage;
+};
+
+static FrameInfoPackage MakeDataPackage(const std::string& stream_id, uint64_t frame_id) {
+  FrameInfoPackage pkg;
+  pkg.pkg_type = PKG_DATA;
+  pkg.stream_idx = 3;
+  pkg.stream_id = stream_id;
+  pkg.frame_id = frame_id;
+  pkg.flags = 0;
+  pkg.timestamp = 123456789;
+  pkg.fmt = CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV12;
+  pkg.width = 1920;
+  pkg.height = 1080;
+  for (int i = 0; i < CN_MAX_PLANES; i++) pkg.stride[i] = i < 2 ? 1920 : 0;
+  pkg.ctx.dev_type = DevContext::DevType::MLU;
+  pkg.ctx.dev_id = 1;
+  pkg.ctx.ddr_channel = 2;
+  pkg.mem_map_type = MEMMAP_CPU;
+  pkg.mlu_mem_handle = nullptr;
+  pkg.shm_slot = 7;
+  pkg.shm_generation = 9;
+  return pkg;
+}
+
+TEST(IPCProtocolBenchmark, Throughput) {
+  std::shared_ptr<ModuleIPC> ipc = std::make_shared<ModuleIPC>("ipc");
+  constexpr int kMsgNum = 100000;
+  const FrameInfoPackage pkg = MakeDataPackage("stream_0", 0);
+
+  for (uint16_t version : {static_cast<uint16_t>(0), kIPCProtocolVersion}) {
+    const std::string protocol = version ? "binary" : "json";
+    IPCProtocolHandler sender(ipc.get()), receiver(ipc.get());
+    sender.SetProtocolVersion(version);
+    receiver.SetProtocolVersion(version);
+
+    // encode and decode only
+    std::vector<char> msg;
+    FrameInfoPackage parsed;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kMsgNum; ++i) {
+      ASSERT_TRUE(sender.EncodePackage(pkg, &msg));
+      if (version) {
+        IPCMsgHeader header;
+        memcpy(&header, msg.data(), sizeof(header));
+        ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+      } else {
+        ASSERT_TRUE(receiver.ParseStringToPackage(std::string(msg.data()), &parsed));
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[IPCProtocol] " << protocol << " encode and decode: " << kMsgNum / seconds << " msgs/s, "
+              << msg.size() << " bytes per msg" << std::endl;
+
+    // through unix socket
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    CNSocket send_socket, recv_socket;
+    send_socket.socket_fd_ = fds[0];
+    recv_socket.socket_fd_ = fds[1];
+    start = std::chrono::steady_clock::now();
+    std::thread recv_thread([&]() {
+      FrameInfoPackage recv_pkg;
+      for (int i = 0; i < kMsgNum; ++i) {
+        ASSERT_TRUE(receiver.RecvPackage(&recv_socket, &recv_pkg));
+        ASSERT_EQ(PKG_DATA, recv_pkg.pkg_type);
+      }
+    });
+    for (int i = 0; i < kMsgNum; ++i) ASSERT_TRUE(sender.SendPackage(&send_socket, pkg));
+    recv_thread.join();
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[IPCProtocol] " << protocol << " through unix socket: " << kMsgNum / seconds << " msgs/s"
+              << std::endl;
+    close(fds[0]);
+    close(fds[1]);
+  }
+}
+
+}  // namespace cnstream
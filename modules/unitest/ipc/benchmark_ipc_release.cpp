@@ -0,0 +1,174 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client_handler.hpp"
+#include "cnstream_frame_va.hpp"
+#include "cnstream_pipeline.hpp"
+#include "module_ipc.hpp"
+
+namespace cnstream {
+
+/*
+ * Throughput of releasing shared memory across processes: the client process sends frames of kStreamNum streams as
+ * fast as the server releases them, the server process runs a pipeline of ModuleIPC and a sink.
+ */
+static const char* kReleaseBenchSocket = "benchmark_ipc_release";
+static constexpr uint32_t kStreamNum = 4;
+static constexpr uint64_t kFramesPerStream = 2000;
+static constexpr size_t kMaxCachedFrames = 8;
+static constexpr int kWidth = 320;
+static constexpr int kHeight = 240;
+
+class ReleaseSinkForBenchmark : public Module, public ModuleCreator<ReleaseSinkForBenchmark> {
+ public:
+  explicit ReleaseSinkForBenchmark(const std::string& name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override { return 0; }
+};
+
+class ReleaseBenchmarkEosObserver : public StreamMsgObserver {
+ public:
+  void Update(const StreamMsg& smsg) override {
+    if (smsg.type == StreamMsgType::EOS_MSG && ++eos_num_ == kStreamNum) wakener_.set_value();
+  }
+  bool WaitForEos() {
+    return std::future_status::ready == wakener_.get_future().wait_for(std::chrono::seconds(60));
+  }
+
+ private:
+  uint32_t eos_num_ = 0;
+  std::promise<void> wakener_;
+};
+
+namespace {
+
+int ServerProcess() {
+  Pipeline pipeline("release_benchmark_pipeline");
+  CNModuleConfig ipc_config;
+  ipc_config.name = "ipc";
+  ipc_config.className = "cnstream::ModuleIPC";
+  ipc_config.next = {"sink"};
+  ipc_config.parameters = {{"ipc_type", "server"}, {"memmap_type", "cpu"}, {"socket_address", kReleaseBenchSocket}};
+  ipc_config.maxInputQueueSize = 0;
+  ipc_config.parallelism = 0;
+
+  CNModuleConfig sink_config;
+  sink_config.name = "sink";
+  sink_config.className = "cnstream::ReleaseSinkForBenchmark";
+  sink_config.maxInputQueueSize = 20;
+  sink_config.parallelism = 2;
+
+  if (0 != pipeline.BuildPipeline({ipc_config, sink_config})) return 1;
+  ModuleIPC* ipc = dynamic_cast<ModuleIPC*>(pipeline.GetModule("ipc"));
+  if (!ipc) return 2;
+  ipc->SetStreamCount(kStreamNum);
+  ReleaseBenchmarkEosObserver observer;
+  pipeline.SetStreamMsgObserver(&observer);
+  if (!pipeline.Start()) return 3;
+  bool all_eos = observer.WaitForEos();
+  pipeline.Stop();
+  return all_eos ? 0 : 4;
+}
+
+std::shared_ptr<CNFrameInfo> MakeFrame(uint32_t stream_idx, uint64_t frame_id, std::vector<uint8_t>* pixels) {
+  std::shared_ptr<CNFrameInfo> data = CNFrameInfo::Create(std::to_string(stream_idx));
+  data->SetStreamIndex(stream_idx);
+  data->timestamp = frame_id;
+  std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+  frame->frame_id = frame_id;
+  frame->fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame->width = kWidth;
+  frame->height = kHeight;
+  frame->stride[0] = frame->stride[1] = kWidth;
+  frame->ctx.dev_type = DevContext::CPU;
+  uint8_t* ptr = pixels->data();
+  for (int i = 0; i < frame->GetPlanes(); ++i) {
+    frame->data[i].reset(new CNSyncedMemory(frame->GetPlaneBytes(i)));
+    frame->data[i]->SetCpuData(ptr);
+    ptr += frame->GetPlaneBytes(i);
+  }
+  data->datas[CNDataFramePtrKey] = frame;
+  return data;
+}
+
+}  // namespace
+
+TEST(IPCReleaseBenchmark, Throughput) {
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (0 == pid) {
+    _exit(ServerProcess());
+  }
+
+  ModuleIPC client("client");
+  ModuleParamSet param = {{"ipc_type", "client"},
+                          {"memmap_type", "cpu"},
+                          {"socket_address", kReleaseBenchSocket},
+                          {"max_cachedframe_size", std::to_string(kMaxCachedFrames)}};
+  ASSERT_TRUE(client.Open(param));
+  auto handler = std::dynamic_pointer_cast<IPCClientHandler>(client.GetIPCHandler());
+  ASSERT_TRUE(handler != nullptr);
+
+  std::vector<uint8_t> pixels(kWidth * kHeight * 3 / 2, 0x5a);
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t frame_id = 0; frame_id < kFramesPerStream; ++frame_id) {
+    for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+      client.Process(MakeFrame(stream_idx, frame_id, &pixels));
+    }
+  }
+  for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+    std::shared_ptr<CNFrameInfo> eos_data = CNFrameInfo::Create(std::to_string(stream_idx), true);
+    eos_data->SetStreamIndex(stream_idx);
+    client.Process(eos_data);
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (handler->GetCachedFrameNum() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  EXPECT_EQ(0u, handler->GetCachedFrameNum());
+  uint64_t frame_num = kStreamNum * kFramesPerStream;
+  uint64_t release_pkg_num = handler->GetReleasePackageNum();
+  client.Close();
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  std::cout << "[IPCRelease] " << frame_num / seconds << " fps of " << kStreamNum << " streams, " << frame_num
+            << " frames released with " << release_pkg_num << " release packages" << std::endl;
+}
+
+}  // namespace cnstream
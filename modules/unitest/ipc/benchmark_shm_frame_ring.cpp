@@ -0,0 +1,179 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "shm_frame_ring.hpp"
+
+namespace cnstream {
+
+static const char* kRingSocket = "benchmark_shm_frame_ring";
+
+/*
+ * Cross process benchmark of passing frames, the same as ModuleIPC with memmap_type cpu: the producer writes a frame
+ * to shared memory and sends a message, the consumer maps and reads it, then sends a release message back.
+ * Frames are passed with shared memory of each frame (shm_open, ftruncate, mmap by both processes and shm_unlink)
+ * or with the frame ring (mapped once). Messages are through pipes.
+ */
+namespace {
+
+struct FrameMsg {
+  int32_t slot;
+  uint32_t generation;
+  uint64_t frame_id;
+};
+
+constexpr size_t kFrameBytes = 1920 * 1080 * 3 / 2;
+constexpr size_t kShmBytes = (kFrameBytes + 64 * 1024 - 1) / (64 * 1024) * (64 * 1024);
+constexpr int kFrameNum = 200;
+constexpr uint32_t kInflight = 4;
+
+std::string FrameShmName(uint64_t frame_id) { return "/test_shm_frame_ring_frame_" + std::to_string(frame_id); }
+
+bool ReadAll(int fd, void* buf, size_t size) { return read(fd, buf, size) == static_cast<ssize_t>(size); }
+bool WriteAll(int fd, const void* buf, size_t size) { return write(fd, buf, size) == static_cast<ssize_t>(size); }
+
+// consumer process, touch first and last byte of each frame, and release it
+void Consume(bool ring, int msg_fd, int release_fd) {
+  ShmFrameRing frame_ring;
+  if (ring && !frame_ring.Map(ShmFrameRing::NameOf(kRingSocket))) _exit(1);
+  uint64_t checksum = 0;
+  for (int i = 0; i < kFrameNum; ++i) {
+    FrameMsg msg;
+    if (!ReadAll(msg_fd, &msg, sizeof(msg))) _exit(1);
+    if (ring) {
+      uint8_t* ptr = frame_ring.Slot(msg.slot, msg.generation);
+      if (!ptr) _exit(1);
+      checksum += ptr[0] + ptr[kFrameBytes - 1];
+    } else {
+      int fd = shm_open(FrameShmName(msg.frame_id).c_str(), O_RDWR, S_IRUSR | S_IWUSR);
+      if (fd < 0) _exit(1);
+      void* ptr = mmap(NULL, kShmBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (ptr == MAP_FAILED) _exit(1);
+      checksum += reinterpret_cast<uint8_t*>(ptr)[0] + reinterpret_cast<uint8_t*>(ptr)[kFrameBytes - 1];
+      munmap(ptr, kShmBytes);
+      close(fd);
+    }
+    if (!WriteAll(release_fd, &msg, sizeof(msg))) _exit(1);
+  }
+  _exit(checksum ? 2 : 1);
+}
+
+struct BenchResult {
+  double fps;
+  double avg_latency_us;
+};
+
+// frame latency is from starting to write the frame to receiving the release of it
+BenchResult Produce(bool ring, int msg_fd, int release_fd, ShmFrameRing* frame_ring) {
+  std::vector<uint8_t> frame(kFrameBytes, 0x5a);
+  std::vector<std::chrono::steady_clock::time_point> start_time(kFrameNum);
+  std::vector<void*> frame_ptr(kFrameNum, nullptr);
+  std::vector<int> frame_fd(kFrameNum, -1);
+  double total_latency_us = 0;
+  int released = 0;
+  auto release_one = [&]() {
+    FrameMsg msg;
+    EXPECT_TRUE(ReadAll(release_fd, &msg, sizeof(msg)));
+    total_latency_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+                                                                   start_time[msg.frame_id]).count();
+    if (ring) {
+      EXPECT_TRUE(frame_ring->Release(msg.slot));
+    } else {
+      munmap(frame_ptr[msg.frame_id], kShmBytes);
+      close(frame_fd[msg.frame_id]);
+      shm_unlink(FrameShmName(msg.frame_id).c_str());
+    }
+    ++released;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kFrameNum; ++i) {
+    while (static_cast<uint32_t>(i - released) >= kInflight) release_one();
+    start_time[i] = std::chrono::steady_clock::now();
+    FrameMsg msg = {-1, 0, static_cast<uint64_t>(i)};
+    uint8_t* dst = nullptr;
+    if (ring) {
+      msg.slot = frame_ring->Acquire(&msg.generation);
+      EXPECT_GE(msg.slot, 0);
+      dst = frame_ring->Slot(msg.slot, msg.generation);
+    } else {
+      frame_fd[i] = shm_open(FrameShmName(i).c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+      EXPECT_GE(frame_fd[i], 0);
+      EXPECT_EQ(0, ftruncate(frame_fd[i], kShmBytes));
+      frame_ptr[i] = mmap(NULL, kShmBytes, PROT_READ | PROT_WRITE, MAP_SHARED, frame_fd[i], 0);
+      dst = reinterpret_cast<uint8_t*>(frame_ptr[i]);
+    }
+    memcpy(dst, frame.data(), kFrameBytes);
+    EXPECT_TRUE(WriteAll(msg_fd, &msg, sizeof(msg)));
+  }
+  while (released < kFrameNum) release_one();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return {kFrameNum / seconds, total_latency_us / kFrameNum};
+}
+
+}  // namespace
+
+TEST(ShmFrameRingBenchmark, CrossProcess) {
+  for (bool ring : {false, true}) {
+    int msg_pipe[2], release_pipe[2];
+    ASSERT_EQ(0, pipe(msg_pipe));
+    ASSERT_EQ(0, pipe(release_pipe));
+    ShmFrameRing frame_ring;
+    if (ring) {
+      ASSERT_TRUE(frame_ring.Create(ShmFrameRing::NameOf(kRingSocket), kInflight, kFrameBytes));
+    }
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (0 == pid) {
+      close(msg_pipe[1]);
+      close(release_pipe[0]);
+      Consume(ring, msg_pipe[0], release_pipe[1]);
+    }
+    close(msg_pipe[0]);
+    close(release_pipe[1]);
+    BenchResult result = Produce(ring, msg_pipe[1], release_pipe[0], &frame_ring);
+    int status;
+    waitpid(pid, &status, 0);
+    EXPECT_EQ(2, WEXITSTATUS(status));
+    close(msg_pipe[1]);
+    close(release_pipe[0]);
+    if (ring) {
+      EXPECT_EQ(kInflight, frame_ring.FreeSlotNum());
+    }
+
+    std::cout << "[ShmFrameRing] 1080p nv12 across processes with " << (ring ? "frame ring" : "shared memory per frame")
+              << ": " << result.fps << " fps, average latency " << result.avg_latency_us << " us" << std::endl;
+  }
+}
+
+}  // namespace cnstream
@@ -0,0 +1,280 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client_handler.hpp"
+#include "cnstream_frame_va.hpp"
+#include "cnstream_pipeline.hpp"
+#include "ipc_handler.hpp"
+#include "ipc_protocol.hpp"
+#include "module_ipc.hpp"
+
+namespace cnstream {
+
+TEST(IPCFanOut, EncodeDecodeHello) {
+  FrameInfoPackage pkg;
+  pkg.pkg_type = PKG_HELLO;
+  pkg.protocol_version = kIPCProtocolVersion;
+  pkg.ring_name = "/cnstream_ring_test";
+  pkg.stream_ids = {"0", "stream_1"};
+  pkg.backpressure = IPC_BACKPRESSURE_DROP_OLDEST;
+  std::vector<char> msg;
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  IPCMsgHeader header;
+  memcpy(&header, msg.data(), sizeof(header));
+  FrameInfoPackage parsed;
+  ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  EXPECT_EQ(PKG_HELLO, parsed.pkg_type);
+  EXPECT_EQ(kIPCProtocolVersion, parsed.protocol_version);
+  EXPECT_EQ(pkg.ring_name, parsed.ring_name);
+  EXPECT_EQ(pkg.stream_ids, parsed.stream_ids);
+  EXPECT_EQ(IPC_BACKPRESSURE_DROP_OLDEST, parsed.backpressure);
+
+  // hello of version 3 has no ring name, streams or backpressure
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg, 0, kIPCReleaseBatchVersion));
+  memcpy(&header, msg.data(), sizeof(header));
+  EXPECT_EQ(sizeof(IPCHelloPayload), header.payload_size);
+  FrameInfoPackage legacy;
+  ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &legacy));
+  EXPECT_TRUE(legacy.ring_name.empty());
+  EXPECT_TRUE(legacy.stream_ids.empty());
+  EXPECT_EQ(IPC_BACKPRESSURE_BLOCK, legacy.backpressure);
+
+  // stream ids are out of payload
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  memcpy(&header, msg.data(), sizeof(header));
+  header.payload_size -= 1;
+  EXPECT_FALSE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+}
+
+/*
+ * One client process sends frames of kStreamNum streams to two server processes. The fast server receives all
+ * streams and blocks the client while it has max cached frames, the slow one receives kSlowStreamId only with drop
+ * oldest backpressure, so the client is not stalled by it. Frames are copied to shared memory once, and released
+ * after both servers release them.
+ */
+static const char* kFastSocket = "test_ipc_fanout_fast";
+static const char* kSlowSocket = "test_ipc_fanout_slow";
+static const char* kSlowStreamId = "1";
+static constexpr uint32_t kStreamNum = 3;
+static constexpr uint64_t kFramesPerStream = 200;
+static constexpr int kAggregateFps = 600;
+static constexpr int kSlowSinkDelayMs = 20;
+static constexpr int kWidth = 320;
+static constexpr int kHeight = 240;
+
+class FanOutSinkForTest : public Module, public ModuleCreator<FanOutSinkForTest> {
+ public:
+  explicit FanOutSinkForTest(const std::string& name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override {
+    if (param_set.find("delay_ms") != param_set.end()) delay_ms_ = std::stoi(param_set["delay_ms"]);
+    return true;
+  }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    if (data->IsEos()) return 0;
+    if (delay_ms_) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+    CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = last_frame_ids_.find(data->stream_id);
+    // frames of a stream are in order, even if some are dropped
+    if (iter != last_frame_ids_.end() && frame->frame_id <= iter->second) disordered_ = true;
+    last_frame_ids_[data->stream_id] = frame->frame_id;
+    frame_num_++;
+    return 0;
+  }
+
+  int delay_ms_ = 0;
+  std::mutex mutex_;
+  std::map<std::string, uint64_t> last_frame_ids_;
+  bool disordered_ = false;
+  uint64_t frame_num_ = 0;
+};
+
+class FanOutEosObserver : public StreamMsgObserver {
+ public:
+  explicit FanOutEosObserver(uint32_t stream_num) : stream_num_(stream_num) {}
+  void Update(const StreamMsg& smsg) override {
+    if (smsg.type == StreamMsgType::EOS_MSG && ++eos_num_ == stream_num_) wakener_.set_value();
+  }
+  bool WaitForEos() {
+    return std::future_status::ready == wakener_.get_future().wait_for(std::chrono::seconds(30));
+  }
+
+ private:
+  uint32_t stream_num_;
+  uint32_t eos_num_ = 0;
+  std::promise<void> wakener_;
+};
+
+namespace {
+
+// returns 0 if frames received by the sink are as expected
+int ServerProcess(bool slow) {
+  Pipeline pipeline(slow ? "fanout_slow_pipeline" : "fanout_fast_pipeline");
+  CNModuleConfig ipc_config;
+  ipc_config.name = "ipc";
+  ipc_config.className = "cnstream::ModuleIPC";
+  ipc_config.next = {"sink"};
+  ipc_config.parameters = {{"ipc_type", "server"}, {"memmap_type", "cpu"}};
+  if (slow) {
+    ipc_config.parameters["socket_address"] = kSlowSocket;
+    ipc_config.parameters["stream_ids"] = kSlowStreamId;
+    ipc_config.parameters["backpressure"] = "drop_oldest";
+  } else {
+    ipc_config.parameters["socket_address"] = kFastSocket;
+  }
+  ipc_config.maxInputQueueSize = 0;
+  ipc_config.parallelism = 0;
+
+  CNModuleConfig sink_config;
+  sink_config.name = "sink";
+  sink_config.className = "cnstream::FanOutSinkForTest";
+  if (slow) sink_config.parameters = {{"delay_ms", std::to_string(kSlowSinkDelayMs)}};
+  sink_config.maxInputQueueSize = 20;
+  sink_config.parallelism = 1;
+
+  if (0 != pipeline.BuildPipeline({ipc_config, sink_config})) return 1;
+  ModuleIPC* ipc = dynamic_cast<ModuleIPC*>(pipeline.GetModule("ipc"));
+  FanOutSinkForTest* sink = dynamic_cast<FanOutSinkForTest*>(pipeline.GetModule("sink"));
+  if (!ipc || !sink) return 2;
+  uint32_t stream_num = slow ? 1 : kStreamNum;
+  ipc->SetStreamCount(stream_num);
+  FanOutEosObserver observer(stream_num);
+  pipeline.SetStreamMsgObserver(&observer);
+  if (!pipeline.Start()) return 3;
+  bool all_eos = observer.WaitForEos();
+  pipeline.Stop();
+  if (!all_eos) return 4;
+  if (sink->disordered_) return 5;
+  if (slow) {
+    // only frames of the subscribed stream, some of them are dropped
+    if (sink->last_frame_ids_.size() != 1 || !sink->last_frame_ids_.count(kSlowStreamId)) return 6;
+    return sink->frame_num_ > 0 && sink->frame_num_ < kFramesPerStream ? 0 : 7;
+  }
+  return sink->frame_num_ == kStreamNum * kFramesPerStream ? 0 : 8;
+}
+
+std::shared_ptr<CNFrameInfo> MakeFrame(uint32_t stream_idx, uint64_t frame_id, std::vector<uint8_t>* pixels) {
+  std::shared_ptr<CNFrameInfo> data = CNFrameInfo::Create(std::to_string(stream_idx));
+  data->SetStreamIndex(stream_idx);
+  data->timestamp = frame_id;
+  std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+  frame->frame_id = frame_id;
+  frame->fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame->width = kWidth;
+  frame->height = kHeight;
+  frame->stride[0] = frame->stride[1] = kWidth;
+  frame->ctx.dev_type = DevContext::CPU;
+  uint8_t* ptr = pixels->data();
+  for (int i = 0; i < frame->GetPlanes(); ++i) {
+    frame->data[i].reset(new CNSyncedMemory(frame->GetPlaneBytes(i)));
+    frame->data[i]->SetCpuData(ptr);
+    ptr += frame->GetPlaneBytes(i);
+  }
+  data->datas[CNDataFramePtrKey] = frame;
+  return data;
+}
+
+}  // namespace
+
+TEST(IPCFanOut, SlowServerDropsOldest) {
+  pid_t fast_pid = fork();
+  ASSERT_GE(fast_pid, 0);
+  if (0 == fast_pid) {
+    _exit(ServerProcess(false));
+  }
+  pid_t slow_pid = fork();
+  ASSERT_GE(slow_pid, 0);
+  if (0 == slow_pid) {
+    _exit(ServerProcess(true));
+  }
+
+  ModuleIPC client("client");
+  ModuleParamSet param = {{"ipc_type", "client"},
+                          {"memmap_type", "cpu"},
+                          {"socket_address", std::string(kFastSocket) + "," + kSlowSocket},
+                          {"max_cachedframe_size", "4"}};
+  ASSERT_TRUE(client.CheckParamSet(param));
+  ASSERT_TRUE(client.Open(param));
+  ASSERT_EQ(2u, client.GetIPCHandlers().size());
+  auto fast_handler = std::dynamic_pointer_cast<IPCClientHandler>(client.GetIPCHandlers()[0]);
+  auto slow_handler = std::dynamic_pointer_cast<IPCClientHandler>(client.GetIPCHandlers()[1]);
+  ASSERT_TRUE(fast_handler != nullptr && slow_handler != nullptr);
+  std::shared_ptr<IPCFrameCache> frame_cache = fast_handler->GetFrameCache();
+  EXPECT_EQ(frame_cache, slow_handler->GetFrameCache());
+  EXPECT_TRUE(slow_handler->IsSubscribed(kSlowStreamId));
+  EXPECT_FALSE(slow_handler->IsSubscribed("0"));
+
+  std::vector<uint8_t> pixels(kWidth * kHeight * 3 / 2, 0x5a);
+  auto interval = std::chrono::microseconds(1000000 / kAggregateFps);
+  auto next_time = std::chrono::steady_clock::now();
+  for (uint64_t frame_id = 0; frame_id < kFramesPerStream; ++frame_id) {
+    for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+      std::this_thread::sleep_until(next_time);
+      next_time += interval;
+      client.Process(MakeFrame(stream_idx, frame_id, &pixels));
+    }
+  }
+  for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+    std::shared_ptr<CNFrameInfo> eos_data = CNFrameInfo::Create(std::to_string(stream_idx), true);
+    eos_data->SetStreamIndex(stream_idx);
+    client.Process(eos_data);
+  }
+
+  // servers exit after all frames are done and released
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while ((!fast_handler->GetServerState() || !slow_handler->GetServerState()) &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(fast_handler->GetServerState());
+  EXPECT_TRUE(slow_handler->GetServerState());
+  EXPECT_EQ(0u, frame_cache->Size());
+  EXPECT_EQ(0u, fast_handler->GetDroppedFrameNum());
+  // the client is not stalled by the slow server, frames of it are dropped instead
+  EXPECT_GT(slow_handler->GetDroppedFrameNum(), 0u);
+  // a frame kept for the only stream of the slow server has a slot of the ring
+  EXPECT_EQ(0u, frame_cache->GetFallbackFrameNum());
+  client.Close();
+
+  for (pid_t pid : {fast_pid, slow_pid}) {
+    int status;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+  }
+}
+
+}  // namespace cnstream
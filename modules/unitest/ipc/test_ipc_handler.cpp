@@ -207,6 +207,47 @@ TEST(IPCHandler, SerializeToString) {
   EXPECT_TRUE(handler->SerializeToString(pkg, &str));
 }
 
+TEST(IPCHandler, SerializeFrameRingSlot) {
+  std::shared_ptr<ModuleIPC> ipc = std::make_shared<ModuleIPC>("ipc");
+  auto handler = std::make_shared<IPCHandlerTest>(IPC_CLIENT, ipc.get());
+  FrameInfoPackage pkg;
+  pkg.pkg_type = PKG_DATA;
+  pkg.stream_idx = 0;
+  pkg.stream_id = "0";
+  pkg.frame_id = 3;
+  pkg.timestamp = 0;
+  pkg.fmt = CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV12;
+  pkg.width = 1920;
+  pkg.height = 1080;
+  pkg.stride[0] = 1920;
+  pkg.stride[1] = 1920;
+  pkg.mem_map_type = MEMMAP_CPU;
+  pkg.mlu_mem_handle = nullptr;
+  std::string str;
+
+  // not in the frame ring, shm_slot is not serialized
+  ASSERT_TRUE(handler->SerializeToString(pkg, &str));
+  EXPECT_EQ(std::string::npos, str.find("shm_slot"));
+  FrameInfoPackage parsed;
+  ASSERT_TRUE(handler->ParseStringToPackage(str, &parsed));
+  EXPECT_EQ(-1, parsed.shm_slot);
+
+  pkg.shm_slot = 5;
+  pkg.shm_generation = 42;
+  ASSERT_TRUE(handler->SerializeToString(pkg, &str));
+  ASSERT_TRUE(handler->ParseStringToPackage(str, &parsed));
+  EXPECT_EQ(5, parsed.shm_slot);
+  EXPECT_EQ(42u, parsed.shm_generation);
+  EXPECT_EQ(3u, parsed.frame_id);
+
+  // slot without generation
+  std::string json_str =
+      "{\"pkg_type\":0,\"stream_id\":\"0\",\"stream_idx\":0,\"frame_id\":0,\"flags\":0,\"timestamp\":0,\"data_fmt\":0,"
+      "\"width\":1920,\"height\":1080,\"strides\":[1920,1920],\"dev_type\":0,\"dev_id\":0,"
+      "\"ddr_channel\":0,\"mem_map_type\":0,\"mlu_mem_handle\":\"0\",\"shm_slot\":1}";
+  EXPECT_FALSE(handler->ParseStringToPackage(json_str, &parsed));
+}
+
 TEST(IPCHandler, PreparePackageToSend) {
   std::shared_ptr<ModuleIPC> ipc = std::make_shared<ModuleIPC>("ipc");
   auto handler = std::make_shared<IPCHandlerTest>(IPC_CLIENT, ipc.get());
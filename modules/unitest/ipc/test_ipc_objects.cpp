@@ -0,0 +1,337 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "client_handler.hpp"
+#include "cnsocket.hpp"
+#include "ipc_handler.hpp"
+#include "ipc_protocol.hpp"
+#include "module_ipc.hpp"
+#include "shm_frame_ring.hpp"
+
+namespace cnstream {
+
+static const char* kObjectsSocket = "test_ipc_objects";
+static constexpr int kWidth = 64;
+static constexpr int kHeight = 32;
+
+class ObjectsClientHandler : public IPCClientHandler {
+ public:
+  explicit ObjectsClientHandler(ModuleIPC* ipc_module) : IPCClientHandler(IPC_CLIENT, ipc_module) {}
+  void SetProtocolVersion(uint16_t version) { protocol_version_.store(version); }
+  bool SendTo(CNSocket* socket) {
+    return socket->SendData(send_buf_.data(), send_buf_.size()) == static_cast<int>(send_buf_.size());
+  }
+  bool ReleaseSlot(int slot) { return frame_ring_ && frame_ring_->Release(slot); }
+};
+
+class ObjectsServerHandler : public IPCHandler {
+ public:
+  explicit ObjectsServerHandler(ModuleIPC* ipc_module) : IPCHandler(IPC_SERVER, ipc_module) {}
+  bool Open() override { return true; }
+  void Close() override {}
+  void Shutdown() override {}
+  void RecvPackageLoop() override {}
+  bool Send() override { return true; }
+  void SendPackageLoop() override {}
+  void SetProtocolVersion(uint16_t version) { protocol_version_.store(version); }
+  using IPCHandler::RecvPackage;
+  using IPCHandler::SendPackage;
+};
+
+// objects of frame, feature_dim decides whether the objects fit in the slot after the pixels
+static CNObjsVec MakeObjects(uint64_t frame_id, size_t feature_dim) {
+  CNObjsVec objs;
+  for (int i = 0; i < 3; ++i) {
+    std::shared_ptr<CNInferObject> obj = std::make_shared<CNInferObject>();
+    obj->SetClassId(i);
+    obj->SetTrackId(static_cast<int>(frame_id) * 10 + i);
+    obj->score = 0.5f + i * 0.1f;
+    obj->bbox = {0.1f * i, 0.2f, 0.3f, 0.4f + frame_id * 0.01f};
+    CNInferAttr attr;
+    attr.id = i;
+    attr.value = static_cast<int>(frame_id);
+    attr.score = 0.9f;
+    obj->AddAttribute("color", attr);
+    obj->AddExtraAttribute("plate", "frame_" + std::to_string(frame_id));
+    obj->AddFeature("reid", CNInferFeature(feature_dim, static_cast<float>(frame_id + i)));
+    objs.push_back(obj);
+  }
+  // labels which are not integers are sent as strings
+  objs[0]->SetClassId("person");
+  return objs;
+}
+
+static bool SameObjects(const CNObjsVec& expected, const CNObjsVec& objs) {
+  if (expected.size() != objs.size()) return false;
+  for (size_t i = 0; i < objs.size(); ++i) {
+    const auto& a = expected[i];
+    const auto& b = objs[i];
+    if (a->GetClassIdStr() != b->GetClassIdStr() || a->GetTrackIdStr() != b->GetTrackIdStr() ||
+        a->GetClassId() != b->GetClassId() || a->GetTrackId() != b->GetTrackId() || a->score != b->score ||
+        a->bbox.x != b->bbox.x || a->bbox.y != b->bbox.y || a->bbox.w != b->bbox.w || a->bbox.h != b->bbox.h) {
+      return false;
+    }
+    CNInferAttr attr = b->GetAttribute("color");
+    CNInferAttr expected_attr = a->GetAttribute("color");
+    if (b->GetAttributes().size() != 1 || attr.id != expected_attr.id || attr.value != expected_attr.value ||
+        attr.score != expected_attr.score) {
+      return false;
+    }
+    if (b->GetExtraAttributes() != a->GetExtraAttributes() || b->GetFeatures() != a->GetFeatures()) return false;
+  }
+  return true;
+}
+
+TEST(IPCObjects, EncodeDecode) {
+  CNObjsVec objs = MakeObjects(1, 128), parsed;
+  std::string buf;
+  EncodeIPCObjects(objs, &buf);
+  ASSERT_TRUE(DecodeIPCObjects(buf.data(), buf.size(), &parsed));
+  EXPECT_TRUE(SameObjects(objs, parsed));
+  EXPECT_EQ("person", parsed[0]->GetClassIdStr());
+  EXPECT_EQ(-1, parsed[0]->GetClassId());
+  EXPECT_EQ("1", parsed[1]->GetClassIdStr());
+
+  // ids which are not plain integers keep their strings
+  objs[1]->SetClassId("12abc");
+  objs[1]->SetTrackId("007");
+  objs[2]->SetClassId("007");
+  EncodeIPCObjects(objs, &buf);
+  ASSERT_TRUE(DecodeIPCObjects(buf.data(), buf.size(), &parsed));
+  EXPECT_TRUE(SameObjects(objs, parsed));
+  EXPECT_EQ("12abc", parsed[1]->GetClassIdStr());
+  EXPECT_EQ(-1, parsed[1]->GetClassId());
+  EXPECT_EQ("007", parsed[1]->GetTrackIdStr());
+  EXPECT_EQ(7, parsed[1]->GetTrackId());
+  EXPECT_EQ("007", parsed[2]->GetClassIdStr());
+  EXPECT_EQ(2, parsed[2]->GetTrackId() % 10);
+  objs = MakeObjects(1, 128);
+
+  // no objects
+  EncodeIPCObjects(CNObjsVec(), &buf);
+  EXPECT_EQ(sizeof(IPCObjectsHeader), buf.size());
+  ASSERT_TRUE(DecodeIPCObjects(buf.data(), buf.size(), &parsed));
+  EXPECT_TRUE(parsed.empty());
+
+  // truncated objects
+  EncodeIPCObjects(objs, &buf);
+  for (size_t size : {static_cast<size_t>(0), sizeof(IPCObjectsHeader), buf.size() / 2, buf.size() - 1}) {
+    EXPECT_FALSE(DecodeIPCObjects(buf.data(), size, &parsed));
+  }
+  // object number is out of buffer
+  IPCObjectsHeader header = {0xffffffff, 0};
+  memcpy(&buf[0], &header, sizeof(header));
+  EXPECT_FALSE(DecodeIPCObjects(buf.data(), buf.size(), &parsed));
+}
+
+TEST(IPCObjects, EncodeDecodeMessage) {
+  FrameInfoPackage pkg;
+  pkg.pkg_type = PKG_DATA;
+  pkg.stream_id = "0";
+  pkg.frame_id = 1;
+  pkg.fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  pkg.mem_map_type = MEMMAP_CPU;
+  pkg.has_pixels = false;
+  EncodeIPCObjects(MakeObjects(1, 4), &pkg.objects);
+  std::vector<char> msg;
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  IPCMsgHeader header;
+  memcpy(&header, msg.data(), sizeof(header));
+  FrameInfoPackage parsed;
+  ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  EXPECT_FALSE(parsed.has_pixels);
+  EXPECT_EQ(pkg.objects, parsed.objects);
+  EXPECT_EQ(0u, parsed.slot_objects_size);
+
+  // objects in the slot are not in the message
+  pkg.has_pixels = true;
+  pkg.slot_objects_size = pkg.objects.size();
+  pkg.slot_objects_offset = 4096;
+  pkg.objects.clear();
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  memcpy(&header, msg.data(), sizeof(header));
+  ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  EXPECT_TRUE(parsed.has_pixels);
+  EXPECT_TRUE(parsed.objects.empty());
+  EXPECT_EQ(pkg.slot_objects_size, parsed.slot_objects_size);
+  EXPECT_EQ(4096u, parsed.slot_objects_offset);
+
+  // peer of version 1 gets neither objects nor metadata only frames
+  pkg.objects = "objects";
+  pkg.has_pixels = false;
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg, 0, 1));
+  memcpy(&header, msg.data(), sizeof(header));
+  EXPECT_EQ(sizeof(IPCFramePayload) + pkg.stream_id.size(), header.payload_size);
+  ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  EXPECT_TRUE(parsed.has_pixels);
+  EXPECT_TRUE(parsed.objects.empty());
+
+  // objects or extension are out of payload
+  pkg.slot_objects_size = 0;
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  memcpy(&header, msg.data(), sizeof(header));
+  header.payload_size -= 1;
+  EXPECT_FALSE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  header.payload_size = sizeof(IPCFramePayload) + pkg.stream_id.size();
+  EXPECT_FALSE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+}
+
+/*
+ * Objects round trip from the client process to the server process, as ModuleIPC does: frames with pixels in the
+ * frame ring and objects after them in the slot, frames with large features whose objects are in the message,
+ * frames of metadata only and frames without objects. The server checks every frame, and releases it.
+ */
+namespace {
+
+struct RoundTripCase {
+  bool metadata_only;
+  bool has_objects;
+  size_t feature_dim;
+  bool objects_in_slot;
+};
+
+const RoundTripCase kCases[] = {
+    {false, true, 16, true}, {false, true, 20000, false}, {true, true, 16, false}, {false, false, 0, false}};
+constexpr int kFrameNum = sizeof(kCases) / sizeof(kCases[0]);
+
+std::shared_ptr<CNFrameInfo> MakeFrame(uint64_t frame_id, std::vector<uint8_t>* pixels) {
+  std::shared_ptr<CNFrameInfo> data = CNFrameInfo::Create("stream_0");
+  data->SetStreamIndex(0);
+  data->timestamp = frame_id;
+  std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+  frame->frame_id = frame_id;
+  frame->fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame->width = kWidth;
+  frame->height = kHeight;
+  frame->stride[0] = frame->stride[1] = kWidth;
+  frame->ctx.dev_type = DevContext::CPU;
+  pixels->assign(frame->GetBytes(), static_cast<uint8_t>(frame_id + 1));
+  uint8_t* ptr = pixels->data();
+  for (int i = 0; i < frame->GetPlanes(); ++i) {
+    frame->data[i].reset(new CNSyncedMemory(frame->GetPlaneBytes(i)));
+    frame->data[i]->SetCpuData(ptr);
+    ptr += frame->GetPlaneBytes(i);
+  }
+  data->datas[CNDataFramePtrKey] = frame;
+  return data;
+}
+
+// returns the number of the failed check, 0 if all frames are received as expected
+int ServerProcess(int fd) {
+  ObjectsServerHandler server(nullptr);
+  server.SetSocketAddress(kObjectsSocket);
+  server.SetProtocolVersion(kIPCProtocolVersion);
+  CNSocket socket;
+  socket.socket_fd_ = fd;
+  for (int i = 0; i < kFrameNum; ++i) {
+    const RoundTripCase& c = kCases[i];
+    FrameInfoPackage pkg;
+    if (!server.RecvPackage(&socket, &pkg) || PKG_DATA != pkg.pkg_type) return 1;
+    if (pkg.has_pixels == c.metadata_only) return 2;
+    if ((pkg.slot_objects_size > 0) != c.objects_in_slot) return 3;
+
+    std::shared_ptr<CNFrameInfo> data = CNFrameInfo::Create(pkg.stream_id);
+    server.PackageToCNData(pkg, data);
+    CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+    if (frame->frame_id != static_cast<uint64_t>(i) || frame->width != kWidth || frame->height != kHeight) return 4;
+    if (c.metadata_only) {
+      if (frame->data[0]) return 5;
+    } else {
+      const uint8_t* pixels = reinterpret_cast<const uint8_t*>(frame->data[1]->GetCpuData());
+      if (!pixels || pixels[frame->GetPlaneBytes(1) - 1] != i + 1) return 6;
+    }
+    auto iter = data->datas.find(CNObjsVecKey);
+    if (c.has_objects) {
+      if (iter == data->datas.end()) return 7;
+      if (!SameObjects(MakeObjects(i, c.feature_dim), cnstream::any_cast<CNObjsVec>(iter->second))) return 8;
+    } else if (iter != data->datas.end()) {
+      return 9;
+    }
+
+    FrameInfoPackage release;
+    release.pkg_type = PKG_RELEASE_MEM;
+    release.stream_id = pkg.stream_id;
+    release.frame_id = pkg.frame_id;
+    if (!server.SendPackage(&socket, release)) return 10;
+  }
+  return 0;
+}
+
+}  // namespace
+
+TEST(IPCObjects, CrossProcessRoundTrip) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (0 == pid) {
+    close(fds[0]);
+    _exit(ServerProcess(fds[1]));
+  }
+  close(fds[1]);
+
+  ObjectsClientHandler client(nullptr);
+  client.SetSocketAddress(kObjectsSocket);
+  client.SetMaxCachedFrameSize(2);
+  client.SetProtocolVersion(kIPCProtocolVersion);
+  CNSocket socket;
+  socket.socket_fd_ = fds[0];
+  for (int i = 0; i < kFrameNum; ++i) {
+    const RoundTripCase& c = kCases[i];
+    std::vector<uint8_t> pixels;
+    std::shared_ptr<CNFrameInfo> data = MakeFrame(i, &pixels);
+    if (c.has_objects) data->datas[CNObjsVecKey] = MakeObjects(i, c.feature_dim);
+    client.SetMetadataOnly(c.metadata_only);
+    CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+    if (!c.metadata_only) {
+      client.CopyToSharedMem(data);
+      ASSERT_GE(frame->shm_slot, 0);
+    }
+    client.PreparePackageToSend(PKG_DATA, data);
+    ASSERT_TRUE(client.SendTo(&socket));
+
+    FrameInfoPackage release;
+    ObjectsServerHandler receiver(nullptr);
+    if (!receiver.RecvPackage(&socket, &release)) break;
+    EXPECT_EQ(PKG_RELEASE_MEM, release.pkg_type);
+    EXPECT_EQ(static_cast<uint64_t>(i), release.frame_id);
+    if (!c.metadata_only) {
+      EXPECT_TRUE(client.ReleaseSlot(frame->shm_slot));
+    }
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  close(fds[0]);
+}
+
+}  // namespace cnstream
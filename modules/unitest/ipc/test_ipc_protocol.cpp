@@ -0,0 +1,225 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cnsocket.hpp"
+#include "ipc_handler.hpp"
+#include "ipc_protocol.hpp"
+#include "module_ipc.hpp"
+
+namespace cnstream {
+
+class IPCProtocolHandler : public IPCHandler {
+ public:
+  explicit IPCProtocolHandler(ModuleIPC* ipc_module) : IPCHandler(IPC_CLIENT, ipc_module) {}
+  bool Open() override { return true; }
+  void Close() override {}
+  void Shutdown() override {}
+  void RecvPackageLoop() override {}
+  bool Send() override { return true; }
+  void SendPackageLoop() override {}
+  void SetProtocolVersion(uint16_t version) { protocol_version_.store(version); }
+  using IPCHandler::EncodePackage;
+  using IPCHandler::RecvPackage;
+  using IPCHandler::SendPackage;
+};
+
+static FrameInfoPackage MakeDataPackage(const std::string& stream_id, uint64_t frame_id) {
+  FrameInfoPackage pkg;
+  pkg.pkg_type = PKG_DATA;
+  pkg.stream_idx = 3;
+  pkg.stream_id = stream_id;
+  pkg.frame_id = frame_id;
+  pkg.flags = 0;
+  pkg.timestamp = 123456789;
+  pkg.fmt = CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV12;
+  pkg.width = 1920;
+  pkg.height = 1080;
+  for (int i = 0; i < CN_MAX_PLANES; i++) pkg.stride[i] = i < 2 ? 1920 : 0;
+  pkg.ctx.dev_type = DevContext::DevType::MLU;
+  pkg.ctx.dev_id = 1;
+  pkg.ctx.ddr_channel = 2;
+  pkg.mem_map_type = MEMMAP_CPU;
+  pkg.mlu_mem_handle = nullptr;
+  pkg.shm_slot = 7;
+  pkg.shm_generation = 9;
+  return pkg;
+}
+
+static bool Decode(const std::vector<char>& msg, FrameInfoPackage* pkg) {
+  if (msg.size() < sizeof(IPCMsgHeader)) return false;
+  IPCMsgHeader header;
+  memcpy(&header, msg.data(), sizeof(header));
+  if (!CheckIPCMsgHeader(header) || sizeof(header) + header.payload_size != msg.size()) return false;
+  return DecodeIPCMessage(header, msg.data() + sizeof(header), pkg);
+}
+
+TEST(IPCProtocol, EncodeDecode) {
+  std::vector<char> msg;
+  // stream id is not limited by SOCK_BUFSIZE
+  FrameInfoPackage pkg = MakeDataPackage(std::string(1000, 's'), 42);
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  EXPECT_EQ(sizeof(IPCMsgHeader) + sizeof(IPCFramePayload) + 1000 + sizeof(IPCFrameExtPayload), msg.size());
+  EXPECT_NE('{', msg[0]);
+  FrameInfoPackage parsed;
+  ASSERT_TRUE(Decode(msg, &parsed));
+  EXPECT_EQ(PKG_DATA, parsed.pkg_type);
+  EXPECT_EQ(pkg.stream_id, parsed.stream_id);
+  EXPECT_EQ(pkg.stream_idx, parsed.stream_idx);
+  EXPECT_EQ(pkg.frame_id, parsed.frame_id);
+  EXPECT_EQ(pkg.timestamp, parsed.timestamp);
+  EXPECT_EQ(pkg.fmt, parsed.fmt);
+  EXPECT_EQ(pkg.width, parsed.width);
+  EXPECT_EQ(pkg.height, parsed.height);
+  for (int i = 0; i < CN_MAX_PLANES; i++) EXPECT_EQ(pkg.stride[i], parsed.stride[i]);
+  EXPECT_EQ(pkg.ctx.dev_type, parsed.ctx.dev_type);
+  EXPECT_EQ(pkg.ctx.dev_id, parsed.ctx.dev_id);
+  EXPECT_EQ(pkg.ctx.ddr_channel, parsed.ctx.ddr_channel);
+  EXPECT_EQ(pkg.mem_map_type, parsed.mem_map_type);
+  EXPECT_EQ(pkg.shm_slot, parsed.shm_slot);
+  EXPECT_EQ(pkg.shm_generation, parsed.shm_generation);
+
+  // eos
+  pkg = MakeDataPackage("1", 0);
+  pkg.flags = CN_FRAME_FLAG_EOS;
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  ASSERT_TRUE(Decode(msg, &parsed));
+  EXPECT_EQ(static_cast<size_t>(CN_FRAME_FLAG_EOS), parsed.flags);
+
+  FrameInfoPackage release;
+  release.pkg_type = PKG_RELEASE_MEM;
+  release.stream_id = "2";
+  release.stream_idx = 2;
+  release.frame_id = 5;
+  ASSERT_TRUE(EncodeIPCMessage(release, &msg));
+  ASSERT_TRUE(Decode(msg, &parsed));
+  EXPECT_EQ(PKG_RELEASE_MEM, parsed.pkg_type);
+  EXPECT_EQ("2", parsed.stream_id);
+  EXPECT_EQ(5u, parsed.frame_id);
+
+  FrameInfoPackage exit_pkg;
+  exit_pkg.pkg_type = PKG_EXIT;
+  ASSERT_TRUE(EncodeIPCMessage(exit_pkg, &msg));
+  EXPECT_EQ(sizeof(IPCMsgHeader), msg.size());
+  ASSERT_TRUE(Decode(msg, &parsed));
+  EXPECT_EQ(PKG_EXIT, parsed.pkg_type);
+
+  // hello is padded for legacy peer
+  FrameInfoPackage hello;
+  hello.pkg_type = PKG_HELLO;
+  hello.protocol_version = kIPCProtocolVersion;
+  ASSERT_TRUE(EncodeIPCMessage(hello, &msg, SOCK_BUFSIZE));
+  EXPECT_EQ(static_cast<size_t>(SOCK_BUFSIZE), msg.size());
+  ASSERT_TRUE(Decode(msg, &parsed));
+  EXPECT_EQ(PKG_HELLO, parsed.pkg_type);
+  EXPECT_EQ(kIPCProtocolVersion, parsed.protocol_version);
+
+  FrameInfoPackage invalid;
+  EXPECT_FALSE(EncodeIPCMessage(invalid, &msg));
+  EXPECT_TRUE(msg.empty());
+  EXPECT_FALSE(EncodeIPCMessage(hello, nullptr));
+}
+
+TEST(IPCProtocol, DecodeInvalid) {
+  std::vector<char> msg;
+  ASSERT_TRUE(EncodeIPCMessage(MakeDataPackage("0", 0), &msg));
+  IPCMsgHeader header;
+  memcpy(&header, msg.data(), sizeof(header));
+  FrameInfoPackage parsed;
+
+  IPCMsgHeader bad = header;
+  bad.magic[0] = '{';
+  EXPECT_FALSE(CheckIPCMsgHeader(bad));
+  bad = header;
+  bad.payload_size = kIPCMaxPayloadSize + 1;
+  EXPECT_FALSE(CheckIPCMsgHeader(bad));
+
+  // payload is too short for the type
+  bad = header;
+  bad.payload_size = sizeof(IPCFramePayload) - 1;
+  EXPECT_FALSE(DecodeIPCMessage(bad, msg.data() + sizeof(header), &parsed));
+  // stream id is out of payload
+  bad = header;
+  bad.payload_size = sizeof(IPCFramePayload);
+  EXPECT_FALSE(DecodeIPCMessage(bad, msg.data() + sizeof(header), &parsed));
+  bad = header;
+  bad.pkg_type = 100;
+  EXPECT_FALSE(DecodeIPCMessage(bad, msg.data() + sizeof(header), &parsed));
+  EXPECT_FALSE(DecodeIPCMessage(header, nullptr, &parsed));
+
+  // trailing bytes of newer version are ignored
+  msg.resize(msg.size() + 16, 0);
+  header.payload_size += 16;
+  EXPECT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  EXPECT_EQ("0", parsed.stream_id);
+}
+
+TEST(IPCProtocol, RecvLegacyAndBinary) {
+  std::shared_ptr<ModuleIPC> ipc = std::make_shared<ModuleIPC>("ipc");
+  IPCProtocolHandler sender(ipc.get()), receiver(ipc.get());
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  CNSocket send_socket, recv_socket;
+  send_socket.socket_fd_ = fds[0];
+  recv_socket.socket_fd_ = fds[1];
+
+  // a receiver tells legacy json packages and binary messages apart
+  FrameInfoPackage pkg = MakeDataPackage("legacy", 1);
+  ASSERT_TRUE(sender.SendPackage(&send_socket, pkg));
+  sender.SetProtocolVersion(kIPCProtocolVersion);
+  pkg.stream_id = "binary";
+  ASSERT_TRUE(sender.SendPackage(&send_socket, pkg));
+  FrameInfoPackage exit_pkg;
+  exit_pkg.pkg_type = PKG_EXIT;
+  ASSERT_TRUE(sender.SendPackage(&send_socket, exit_pkg));
+
+  FrameInfoPackage parsed;
+  ASSERT_TRUE(receiver.RecvPackage(&recv_socket, &parsed));
+  EXPECT_EQ(PKG_DATA, parsed.pkg_type);
+  EXPECT_EQ("legacy", parsed.stream_id);
+  EXPECT_EQ(7, parsed.shm_slot);
+  ASSERT_TRUE(receiver.RecvPackage(&recv_socket, &parsed));
+  EXPECT_EQ(PKG_DATA, parsed.pkg_type);
+  EXPECT_EQ("binary", parsed.stream_id);
+  EXPECT_EQ(1u, parsed.frame_id);
+  ASSERT_TRUE(receiver.RecvPackage(&recv_socket, &parsed));
+  EXPECT_EQ(PKG_EXIT, parsed.pkg_type);
+
+  // legacy json package is limited to SOCK_BUFSIZE bytes
+  sender.SetProtocolVersion(0);
+  std::vector<char> msg;
+  EXPECT_FALSE(sender.EncodePackage(MakeDataPackage(std::string(SOCK_BUFSIZE, 's'), 0), &msg));
+  EXPECT_TRUE(msg.empty());
+
+  // broken connection
+  close(fds[0]);
+  EXPECT_FALSE(receiver.RecvPackage(&recv_socket, &parsed));
+  close(fds[1]);
+}
+
+}  // namespace cnstream
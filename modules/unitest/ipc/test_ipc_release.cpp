@@ -0,0 +1,246 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client_handler.hpp"
+#include "cnstream_frame_va.hpp"
+#include "cnstream_pipeline.hpp"
+#include "ipc_handler.hpp"
+#include "ipc_protocol.hpp"
+#include "module_ipc.hpp"
+
+namespace cnstream {
+
+TEST(IPCRelease, AddReleasedFrame) {
+  std::vector<ReleaseRange> ranges;
+  for (uint64_t frame_id : {3, 4, 5}) AddReleasedFrame(&ranges, 0, frame_id);
+  ASSERT_EQ(1u, ranges.size());
+  EXPECT_EQ(3u, ranges[0].first_frame_id);
+  EXPECT_EQ(3u, ranges[0].frame_num);
+
+  // frames of other streams interleaved, and a frame done earlier than the one before it
+  AddReleasedFrame(&ranges, 1, 10);
+  AddReleasedFrame(&ranges, 0, 6);
+  AddReleasedFrame(&ranges, 1, 9);
+  AddReleasedFrame(&ranges, 0, 2);
+  ASSERT_EQ(2u, ranges.size());
+  EXPECT_EQ(2u, ranges[0].first_frame_id);
+  EXPECT_EQ(5u, ranges[0].frame_num);
+  EXPECT_EQ(1u, ranges[1].stream_idx);
+  EXPECT_EQ(9u, ranges[1].first_frame_id);
+  EXPECT_EQ(2u, ranges[1].frame_num);
+
+  // a gap starts a new range
+  AddReleasedFrame(&ranges, 0, 9);
+  ASSERT_EQ(3u, ranges.size());
+  EXPECT_EQ(0u, ranges[2].stream_idx);
+  EXPECT_EQ(9u, ranges[2].first_frame_id);
+  EXPECT_EQ(1u, ranges[2].frame_num);
+}
+
+TEST(IPCRelease, EncodeDecodeBatch) {
+  FrameInfoPackage pkg;
+  pkg.pkg_type = PKG_RELEASE_BATCH;
+  pkg.release_ranges = {{0, 4, 100}, {3, 1, 7}};
+  std::vector<char> msg;
+  ASSERT_TRUE(EncodeIPCMessage(pkg, &msg));
+  IPCMsgHeader header;
+  memcpy(&header, msg.data(), sizeof(header));
+  EXPECT_EQ(sizeof(IPCReleaseBatchPayload) + 2 * sizeof(ReleaseRange), header.payload_size);
+  FrameInfoPackage parsed;
+  ASSERT_TRUE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  EXPECT_EQ(PKG_RELEASE_BATCH, parsed.pkg_type);
+  ASSERT_EQ(2u, parsed.release_ranges.size());
+  EXPECT_EQ(100u, parsed.release_ranges[0].first_frame_id);
+  EXPECT_EQ(4u, parsed.release_ranges[0].frame_num);
+  EXPECT_EQ(3u, parsed.release_ranges[1].stream_idx);
+
+  // ranges are out of payload
+  header.payload_size -= 1;
+  EXPECT_FALSE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+  header.payload_size = sizeof(IPCReleaseBatchPayload) - 1;
+  EXPECT_FALSE(DecodeIPCMessage(header, msg.data() + sizeof(header), &parsed));
+}
+
+/*
+ * Stress of releasing shared memory across processes: the client process sends frames of kStreamNum streams at
+ * kAggregateFps in total, the server process runs a pipeline of ModuleIPC and a sink, and releases each frame when
+ * it is done. Processed frames cached by the client never exceed max_cachedframe_size, and all of them are released
+ * in the end.
+ */
+static const char* kReleaseSocket = "test_ipc_release";
+static constexpr uint32_t kStreamNum = 4;
+static constexpr int kAggregateFps = 1000;
+static constexpr uint64_t kFramesPerStream = 500;
+static constexpr size_t kMaxCachedFrames = 8;
+static constexpr int kWidth = 320;
+static constexpr int kHeight = 240;
+
+class ReleaseSinkForTest : public Module, public ModuleCreator<ReleaseSinkForTest> {
+ public:
+  explicit ReleaseSinkForTest(const std::string& name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    if (!data->IsEos()) frame_num_++;
+    return 0;
+  }
+
+  std::atomic<uint64_t> frame_num_{0};
+};
+
+class ReleaseEosObserver : public StreamMsgObserver {
+ public:
+  void Update(const StreamMsg& smsg) override {
+    if (smsg.type == StreamMsgType::EOS_MSG && ++eos_num_ == kStreamNum) wakener_.set_value();
+  }
+  bool WaitForEos() {
+    return std::future_status::ready == wakener_.get_future().wait_for(std::chrono::seconds(30));
+  }
+
+ private:
+  uint32_t eos_num_ = 0;
+  std::promise<void> wakener_;
+};
+
+namespace {
+
+// returns 0 if all frames are received by the sink
+int ServerProcess() {
+  Pipeline pipeline("release_pipeline");
+  CNModuleConfig ipc_config;
+  ipc_config.name = "ipc";
+  ipc_config.className = "cnstream::ModuleIPC";
+  ipc_config.next = {"sink"};
+  ipc_config.parameters = {{"ipc_type", "server"}, {"memmap_type", "cpu"}, {"socket_address", kReleaseSocket}};
+  ipc_config.maxInputQueueSize = 0;
+  ipc_config.parallelism = 0;
+
+  CNModuleConfig sink_config;
+  sink_config.name = "sink";
+  sink_config.className = "cnstream::ReleaseSinkForTest";
+  sink_config.maxInputQueueSize = 20;
+  sink_config.parallelism = 2;
+
+  if (0 != pipeline.BuildPipeline({ipc_config, sink_config})) return 1;
+  ModuleIPC* ipc = dynamic_cast<ModuleIPC*>(pipeline.GetModule("ipc"));
+  ReleaseSinkForTest* sink = dynamic_cast<ReleaseSinkForTest*>(pipeline.GetModule("sink"));
+  if (!ipc || !sink) return 2;
+  ipc->SetStreamCount(kStreamNum);
+  ReleaseEosObserver observer;
+  pipeline.SetStreamMsgObserver(&observer);
+  if (!pipeline.Start()) return 3;
+  bool all_eos = observer.WaitForEos();
+  pipeline.Stop();
+  if (!all_eos) return 4;
+  return sink->frame_num_.load() == kStreamNum * kFramesPerStream ? 0 : 5;
+}
+
+std::shared_ptr<CNFrameInfo> MakeFrame(uint32_t stream_idx, uint64_t frame_id, std::vector<uint8_t>* pixels) {
+  std::shared_ptr<CNFrameInfo> data = CNFrameInfo::Create(std::to_string(stream_idx));
+  data->SetStreamIndex(stream_idx);
+  data->timestamp = frame_id;
+  std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+  frame->frame_id = frame_id;
+  frame->fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame->width = kWidth;
+  frame->height = kHeight;
+  frame->stride[0] = frame->stride[1] = kWidth;
+  frame->ctx.dev_type = DevContext::CPU;
+  uint8_t* ptr = pixels->data();
+  for (int i = 0; i < frame->GetPlanes(); ++i) {
+    frame->data[i].reset(new CNSyncedMemory(frame->GetPlaneBytes(i)));
+    frame->data[i]->SetCpuData(ptr);
+    ptr += frame->GetPlaneBytes(i);
+  }
+  data->datas[CNDataFramePtrKey] = frame;
+  return data;
+}
+
+}  // namespace
+
+TEST(IPCRelease, BoundedAt1000Fps) {
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (0 == pid) {
+    _exit(ServerProcess());
+  }
+
+  ModuleIPC client("client");
+  ModuleParamSet param = {{"ipc_type", "client"},
+                          {"memmap_type", "cpu"},
+                          {"socket_address", kReleaseSocket},
+                          {"max_cachedframe_size", std::to_string(kMaxCachedFrames)}};
+  ASSERT_TRUE(client.Open(param));
+  auto handler = std::dynamic_pointer_cast<IPCClientHandler>(client.GetIPCHandler());
+  ASSERT_TRUE(handler != nullptr);
+
+  std::vector<uint8_t> pixels(kWidth * kHeight * 3 / 2, 0x5a);
+  size_t max_cached = 0;
+  auto interval = std::chrono::microseconds(1000000 / kAggregateFps);
+  auto next_time = std::chrono::steady_clock::now();
+  for (uint64_t frame_id = 0; frame_id < kFramesPerStream; ++frame_id) {
+    for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+      std::this_thread::sleep_until(next_time);
+      next_time += interval;
+      client.Process(MakeFrame(stream_idx, frame_id, &pixels));
+      max_cached = std::max(max_cached, handler->GetCachedFrameNum());
+    }
+  }
+  for (uint32_t stream_idx = 0; stream_idx < kStreamNum; ++stream_idx) {
+    std::shared_ptr<CNFrameInfo> eos_data = CNFrameInfo::Create(std::to_string(stream_idx), true);
+    eos_data->SetStreamIndex(stream_idx);
+    client.Process(eos_data);
+  }
+
+  // server exits after all frames are done and released
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (!handler->GetServerState() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(handler->GetServerState());
+  EXPECT_EQ(0u, handler->GetCachedFrameNum());
+  EXPECT_LE(max_cached, kMaxCachedFrames);
+  uint64_t frame_num = kStreamNum * kFramesPerStream;
+  uint64_t release_pkg_num = handler->GetReleasePackageNum();
+  EXPECT_GT(release_pkg_num, 0u);
+  EXPECT_LE(release_pkg_num, frame_num);
+  client.Close();
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+}  // namespace cnstream
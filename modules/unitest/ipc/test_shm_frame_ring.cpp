@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "shm_frame_ring.hpp"
+
+namespace cnstream {
+
+static const char* kRingSocket = "test_shm_frame_ring";
+
+TEST(ShmFrameRing, NameOf) {
+  EXPECT_EQ("/cnstream_ipc_ring_test", ShmFrameRing::NameOf("test"));
+  EXPECT_EQ("/cnstream_ipc_ring__tmp_ipc.sock", ShmFrameRing::NameOf("/tmp/ipc.sock"));
+}
+
+TEST(ShmFrameRing, AcquireRelease) {
+  ShmFrameRing producer;
+  EXPECT_FALSE(producer.Create(ShmFrameRing::NameOf(kRingSocket), 0, 1024));
+  ASSERT_TRUE(producer.Create(ShmFrameRing::NameOf(kRingSocket), 3, 1000));
+  EXPECT_EQ(3u, producer.SlotNum());
+  EXPECT_EQ(64u * 1024, producer.SlotSize());
+
+  std::vector<int> slots;
+  std::vector<uint32_t> generations;
+  for (int i = 0; i < 3; ++i) {
+    uint32_t generation = 0;
+    int slot = producer.Acquire(&generation);
+    ASSERT_GE(slot, 0);
+    EXPECT_NE(0u, generation);
+    slots.push_back(slot);
+    generations.push_back(generation);
+    memset(producer.Slot(slot, generation), 'a' + slot, producer.SlotSize());
+  }
+  uint32_t generation = 0;
+  EXPECT_EQ(-1, producer.Acquire(&generation));
+  EXPECT_EQ(0u, producer.FreeSlotNum());
+
+  ShmFrameRing consumer;
+  ASSERT_TRUE(consumer.Map(ShmFrameRing::NameOf(kRingSocket)));
+  EXPECT_EQ(producer.SlotNum(), consumer.SlotNum());
+  EXPECT_EQ(producer.SlotSize(), consumer.SlotSize());
+  for (int i = 0; i < 3; ++i) {
+    uint8_t* ptr = consumer.Slot(slots[i], generations[i]);
+    ASSERT_TRUE(ptr != nullptr);
+    EXPECT_EQ('a' + slots[i], ptr[0]);
+    EXPECT_EQ('a' + slots[i], ptr[consumer.SlotSize() - 1]);
+  }
+  EXPECT_TRUE(consumer.Slot(3, generations[0]) == nullptr);
+  EXPECT_TRUE(consumer.Slot(-1, generations[0]) == nullptr);
+  EXPECT_TRUE(consumer.Slot(slots[0], 0) == nullptr);
+  // only the producer owns slots
+  EXPECT_EQ(-1, consumer.Acquire(&generation));
+  EXPECT_FALSE(consumer.Release(slots[0]));
+
+  EXPECT_TRUE(producer.Release(slots[1]));
+  EXPECT_FALSE(producer.Release(slots[1]));
+  EXPECT_FALSE(producer.Release(3));
+  EXPECT_EQ(1u, producer.FreeSlotNum());
+  // the reused slot has a new generation, the old one is stale
+  EXPECT_EQ(slots[1], producer.Acquire(&generation));
+  EXPECT_NE(generations[1], generation);
+  EXPECT_TRUE(consumer.Slot(slots[1], generations[1]) == nullptr);
+  EXPECT_TRUE(consumer.Slot(slots[1], generation) != nullptr);
+
+  // the ring is removed by the producer
+  producer.Close();
+  EXPECT_FALSE(producer.IsOpened());
+  ShmFrameRing another;
+  EXPECT_FALSE(another.Map(ShmFrameRing::NameOf(kRingSocket)));
+  consumer.Close();
+}
+
+TEST(ShmFrameRing, MapInvalid) {
+  const std::string name = ShmFrameRing::NameOf(kRingSocket);
+  int fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(0, ftruncate(fd, 4096));
+  close(fd);
+  ShmFrameRing consumer;
+  EXPECT_FALSE(consumer.Map(name));
+  shm_unlink(name.c_str());
+}
+
+}  // namespace cnstream
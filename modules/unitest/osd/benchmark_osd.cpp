@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_OPENCV
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#if (CV_MAJOR_VERSION >= 3)
+#include "opencv2/imgcodecs/imgcodecs.hpp"
+#endif
+#else
+#error OpenCV required
+#endif
+#include "cnfont.hpp"
+#include "cnosd.hpp"
+#include "cnstream_frame_va.hpp"
+#include "osd_canvas.hpp"
+
+namespace cnstream {
+
+// installed by tools/pre_required_helper.sh
+static constexpr const char *gfont_path = "/usr/include/wqy-zenhei.ttc";
+
+#ifdef HAVE_FREETYPE
+TEST(OsdBenchmark, CnFontPutText) {
+  if (access(gfont_path, R_OK) != 0) {
+    GTEST_SKIP() << "Font " << gfont_path << " not found, it is installed by tools/pre_required_helper.sh";
+  }
+  const int label_num = 1000;
+  char text[] = "person 行人 0.98";
+  cv::Mat image(1080, 1920, CV_8UC3, cv::Scalar(0, 0, 0));
+  CnFont font;
+  ASSERT_TRUE(font.Init(gfont_path));
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < label_num; ++i) {
+    cv::Point pos((i % 8) * 240, 40 + (i / 8) * 8);
+    font.putText(image, text, pos, cv::Scalar(255, 255, 255));
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "CnFont draws " << label_num << " labels on 1080p frame: "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+}
+#endif
+
+TEST(OsdBenchmark, CnOsdDrawBands) {
+  const int obj_num = 200;
+  const int frame_num = 50;
+  const int width = 1920, height = 1080;
+  std::vector<std::string> labels = {"person", "car", "bus", "bicycle", "motorbike", "truck"};
+  CnOsd banded_osd(labels), whole_osd(labels);
+  whole_osd.SetBandRows(0);
+
+  // objects move slowly and keep their labels, so layouts of labels are reused
+  std::vector<CNObjsVec> frames(frame_num);
+  for (int n = 0; n < frame_num; ++n) {
+    for (int i = 0; i < obj_num; ++i) {
+      auto obj = std::make_shared<CNInferObject>();
+      obj->SetClassId(i % labels.size());
+      obj->SetTrackId(i);
+      obj->score = 0.5 + (i % 50) * 0.01;
+      obj->bbox = {(i % 20) * 0.05f + n * 0.0002f, (i / 20) * 0.1f, 0.04, 0.08};
+      frames[n].push_back(obj);
+    }
+  }
+
+  double banded_ms = 0, whole_ms = 0;
+  for (int n = 0; n < frame_num; ++n) {
+    cv::Mat banded_image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    cv::Mat whole_image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    BgrCanvas banded_canvas(&banded_image), whole_canvas(&whole_image);
+    auto start = std::chrono::steady_clock::now();
+    banded_osd.DrawLabel(&banded_canvas, frames[n]);
+    auto mid = std::chrono::steady_clock::now();
+    whole_osd.DrawLabel(&whole_canvas, frames[n]);
+    auto end = std::chrono::steady_clock::now();
+    banded_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+    whole_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+  }
+  std::cout << "Osd draws " << obj_num << " objects per frame, average latency: banded " << banded_ms / frame_num
+            << " ms, whole image " << whole_ms / frame_num << " ms" << std::endl;
+}
+
+}  // namespace cnstream
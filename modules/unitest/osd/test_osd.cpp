@@ -21,9 +21,14 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
+#include <cstring>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #ifdef HAVE_OPENCV
 #include "opencv2/highgui/highgui.hpp"
@@ -34,15 +39,20 @@
 #else
 #error OpenCV required
 #endif
+#include "cnfont.hpp"
+#include "cnosd.hpp"
 #include "cnstream_frame_va.hpp"
 #include "cnstream_module.hpp"
 #include "osd.hpp"
+#include "osd_canvas.hpp"
 #include "test_base.hpp"
 
 namespace cnstream {
 
 static constexpr const char *gname = "osd";
 static constexpr const char *glabel_path = "../../modules/unitest/osd/test_label.txt";
+// installed by tools/pre_required_helper.sh
+static constexpr const char *gfont_path = "/usr/include/wqy-zenhei.ttc";
 
 TEST(Osd, Construct) {
   std::shared_ptr<Module> osd = std::make_shared<Osd>(gname);
@@ -118,20 +128,20 @@ TEST(Osd, Process) {
 
   CNObjsVec objs;
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(11);
+  obj->SetClassId(11);
   CNInferBoundingBox bbox = {0.6, 0.4, 0.6, 0.3};
   obj->bbox = bbox;
   objs.push_back(obj);
 
   auto obj2 = std::make_shared<CNInferObject>();
-  obj2->id = std::to_string(12);
+  obj2->SetClassId(12);
   bbox = {0.1, -0.2, 0.3, 0.4};
   obj2->bbox = bbox;
   objs.push_back(obj2);
 
   for (int i = 0; i < 5; ++i) {
     auto obj = std::make_shared<CNInferObject>();
-    obj->id = std::to_string(i);
+    obj->SetClassId(i);
     float val = i * 0.1;
     CNInferBoundingBox bbox = {val, val, val, val};
     obj->bbox = bbox;
@@ -153,6 +163,136 @@ TEST(Osd, Process) {
   EXPECT_EQ(osd->Process(data), -1);
 }
 
+static std::shared_ptr<CNFrameInfo> CreateNV12Frame(uint8_t* yuv, int width, int height) {
+  auto data = cnstream::CNFrameInfo::Create(std::to_string(0));
+  std::shared_ptr<CNDataFrame> frame(new (std::nothrow) CNDataFrame());
+  data->SetStreamIndex(0);
+  frame->frame_id = 1;
+  data->timestamp = 1000;
+  frame->width = width;
+  frame->height = height;
+  frame->ptr_cpu[0] = yuv;
+  frame->ptr_cpu[1] = yuv + width * height;
+  frame->stride[0] = frame->stride[1] = width;
+  frame->ctx.dev_type = DevContext::DevType::CPU;
+  frame->fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame->CopyToSyncMem();
+  data->datas[CNDataFramePtrKey] = frame;
+
+  CNObjsVec objs;
+  for (int i = 0; i < 5; ++i) {
+    auto obj = std::make_shared<CNInferObject>();
+    obj->SetClassId(i);
+    obj->score = 0.9;
+    float val = i * 0.15 + 0.05;
+    obj->bbox = {val, val, 0.15, 0.1};
+    objs.push_back(obj);
+  }
+  data->datas[cnstream::CNObjsVecKey] = objs;
+  return data;
+}
+
+TEST(Osd, ProcessNV) {
+  int width = 1920;
+  int height = 1080;
+  std::string label_path = GetExePath() + glabel_path;
+  std::vector<uint8_t> yuv(width * height * 3 / 2, 128);
+  memset(yuv.data(), 64, width * height);
+
+  // draw on bgr image as reference
+  std::shared_ptr<Module> bgr_osd = std::make_shared<Osd>(gname);
+  ModuleParamSet param;
+  param["label_path"] = label_path;
+  ASSERT_TRUE(bgr_osd->Open(param));
+  auto bgr_data = CreateNV12Frame(yuv.data(), width, height);
+  EXPECT_EQ(bgr_osd->Process(bgr_data), 0);
+  CNDataFramePtr bgr_frame = cnstream::any_cast<CNDataFramePtr>(bgr_data->datas[CNDataFramePtrKey]);
+  ASSERT_TRUE(bgr_frame->HasBGRImage());
+
+  std::shared_ptr<Module> nv_osd = std::make_shared<Osd>(gname);
+  param["color_mode"] = "nv";
+  ASSERT_TRUE(nv_osd->Open(param));
+  auto nv_data = CreateNV12Frame(yuv.data(), width, height);
+  EXPECT_EQ(nv_osd->Process(nv_data), 0);
+  CNDataFramePtr nv_frame = cnstream::any_cast<CNDataFramePtr>(nv_data->datas[CNDataFramePtrKey]);
+  // drawn on planes, no BGR image is created
+  EXPECT_FALSE(nv_frame->HasBGRImage());
+  const uint8_t* y_plane = static_cast<const uint8_t*>(nv_frame->data[0]->GetCpuData());
+  const uint8_t* uv_plane = static_cast<const uint8_t*>(nv_frame->data[1]->GetCpuData());
+  EXPECT_NE(memcmp(y_plane, yuv.data(), width * height), 0);
+  EXPECT_NE(memcmp(uv_plane, yuv.data() + width * height, width * height / 2), 0);
+
+  // looks the same as drawing on bgr image, except chroma subsampling on edges
+  cv::Mat diff;
+  cv::absdiff(*nv_frame->ImageBGR(), *bgr_frame->ImageBGR(), diff);
+  cv::Scalar mean_diff = cv::mean(diff);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_LT(mean_diff.val[c], 2.0);
+  }
+}
+
+TEST(Osd, CnOsdDrawBands) {
+  const int obj_num = 200;
+  const int frame_num = 5;
+  const int width = 1920, height = 1080;
+  std::vector<std::string> labels = {"person", "car", "bus", "bicycle", "motorbike", "truck"};
+  CnOsd banded_osd(labels), whole_osd(labels);
+  whole_osd.SetBandRows(0);
+
+  // objects move slowly and keep their labels, so layouts of labels are reused
+  for (int n = 0; n < frame_num; ++n) {
+    CNObjsVec objs;
+    for (int i = 0; i < obj_num; ++i) {
+      auto obj = std::make_shared<CNInferObject>();
+      obj->SetClassId(i % labels.size());
+      obj->SetTrackId(i);
+      obj->score = 0.5 + (i % 50) * 0.01;
+      obj->bbox = {(i % 20) * 0.05f + n * 0.0002f, (i / 20) * 0.1f, 0.04, 0.08};
+      objs.push_back(obj);
+    }
+    cv::Mat banded_image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    cv::Mat whole_image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    BgrCanvas banded_canvas(&banded_image), whole_canvas(&whole_image);
+    banded_osd.DrawLabel(&banded_canvas, objs);
+    whole_osd.DrawLabel(&whole_canvas, objs);
+
+    // texts are rendered once and blended to every band, drawing band by band is the same as drawing at once
+    cv::Mat diff;
+    cv::absdiff(banded_image, whole_image, diff);
+    EXPECT_EQ(cv::countNonZero(diff.reshape(1)), 0);
+    EXPECT_GT(cv::countNonZero(banded_image.reshape(1)), 0);
+  }
+}
+
+TEST(Osd, CnOsdLabelCache) {
+  const int width = 1920, height = 1080;
+  std::vector<std::string> labels = {"person", "car", "bus"};
+  CnOsd cached_osd(labels);
+  auto obj = std::make_shared<CNInferObject>();
+  obj->SetClassId(0);
+  obj->SetTrackId(3);
+  obj->score = 0.5;
+  obj->bbox = {0.1, 0.1, 0.2, 0.2};
+  cv::Mat image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+  BgrCanvas canvas(&image);
+  cached_osd.DrawLabel(&canvas, {obj});
+
+  // class and score of the track change, the label changes with them
+  for (auto change : {std::make_pair(1, 0.5f), std::make_pair(1, 0.93f), std::make_pair(1, 0.931f)}) {
+    obj->SetClassId(change.first);
+    obj->score = change.second;
+    cv::Mat cached_image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    cv::Mat fresh_image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    BgrCanvas cached_canvas(&cached_image), fresh_canvas(&fresh_image);
+    CnOsd fresh_osd(labels);
+    cached_osd.DrawLabel(&cached_canvas, {obj});
+    fresh_osd.DrawLabel(&fresh_canvas, {obj});
+    cv::Mat diff;
+    cv::absdiff(cached_image, fresh_image, diff);
+    EXPECT_EQ(cv::countNonZero(diff.reshape(1)), 0);
+  }
+}
+
 TEST(Osd, ProcessSecondary) {
   // create osd
   std::shared_ptr<Module> osd = std::make_shared<Osd>(gname);
@@ -183,7 +323,7 @@ TEST(Osd, ProcessSecondary) {
 
   CNObjsVec objs;
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(11);
+  obj->SetClassId(11);
   CNInferBoundingBox bbox = {0.6, 0.4, 0.6, 0.3};
   obj->bbox = bbox;
   cnstream::CNInferAttr attr;
@@ -194,7 +334,7 @@ TEST(Osd, ProcessSecondary) {
   objs.push_back(obj);
 
   auto obj2 = std::make_shared<CNInferObject>();
-  obj2->id = std::to_string(12);
+  obj2->SetClassId(12);
   bbox = {0.1, -0.2, 0.3, 0.4};
   obj2->bbox = bbox;
   cnstream::CNInferAttr attr2;
@@ -206,7 +346,7 @@ TEST(Osd, ProcessSecondary) {
 
   for (int i = 0; i < 5; ++i) {
     auto obj = std::make_shared<CNInferObject>();
-    obj->id = std::to_string(i);
+    obj->SetClassId(i);
     float val = i * 0.1;
     CNInferBoundingBox bbox = {val, val, val, val};
     obj->bbox = bbox;
@@ -262,8 +402,60 @@ TEST(Osd, CheckParamSet) {
   EXPECT_FALSE(osd->CheckParamSet(param));
   param.clear();
 
+  param["color_mode"] = "nv";
+  EXPECT_TRUE(osd->CheckParamSet(param));
+  param["color_mode"] = "bgr";
+  EXPECT_TRUE(osd->CheckParamSet(param));
+  param["color_mode"] = "rgb";
+  EXPECT_FALSE(osd->CheckParamSet(param));
+  param.clear();
+
   param["test_param"] = "test";
   EXPECT_TRUE(osd->CheckParamSet(param));
 }
 
+#ifdef HAVE_FREETYPE
+TEST(Osd, CnFontPutText) {
+  if (access(gfont_path, R_OK) != 0) {
+    GTEST_SKIP() << "Font " << gfont_path << " not found, it is installed by tools/pre_required_helper.sh";
+  }
+  const int label_num = 1000;
+  char text[] = "person 行人 0.98";
+  cv::Mat image(1080, 1920, CV_8UC3, cv::Scalar(0, 0, 0));
+  CnFont font;
+  ASSERT_TRUE(font.Init(gfont_path));
+  uint32_t width = 0, height = 0;
+  ASSERT_TRUE(font.GetTextSize(text, &width, &height));
+  EXPECT_GT(width, 0u);
+  EXPECT_GT(height, 0u);
+
+  for (int i = 0; i < label_num; ++i) {
+    cv::Point pos((i % 8) * 240, 40 + (i / 8) * 8);
+    EXPECT_EQ(font.putText(image, text, pos, cv::Scalar(255, 255, 255)), 0);
+  }
+  EXPECT_GT(cv::countNonZero(image.reshape(1)), 0);
+
+  // glyphs are shared by fonts of other threads, they draw the same pixels
+  std::vector<cv::Mat> images(4);
+  std::vector<std::thread> threads;
+  for (auto &img : images) {
+    img = cv::Mat(1080, 1920, CV_8UC3, cv::Scalar(0, 0, 0));
+    threads.emplace_back([&img, &text]() {
+      CnFont thread_font;
+      ASSERT_TRUE(thread_font.Init(gfont_path));
+      for (int i = 0; i < label_num; ++i) {
+        cv::Point pos((i % 8) * 240, 40 + (i / 8) * 8);
+        thread_font.putText(img, text, pos, cv::Scalar(255, 255, 255));
+      }
+    });
+  }
+  for (auto &th : threads) th.join();
+  for (auto &img : images) {
+    cv::Mat diff;
+    cv::absdiff(img, image, diff);
+    EXPECT_EQ(cv::countNonZero(diff.reshape(1)), 0);
+  }
+}
+#endif
+
 }  // namespace cnstream
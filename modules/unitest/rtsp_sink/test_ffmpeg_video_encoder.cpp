@@ -0,0 +1,96 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "ffmpeg_video_encoder.hpp"
+#include "rtsp_sink.hpp"
+
+namespace cnstream {
+
+static RtspParam EncoderParam(ColorFormat color_format) {
+  RtspParam param;
+  param.color_format = color_format;
+  param.codec_type = H264;
+  param.enc_type = FFMPEG;
+  param.dst_width = 352;
+  param.dst_height = 288;
+  param.frame_rate = 25;
+  param.gop = 25;
+  param.kbps = 512;
+  param.encode_threads = 1;
+  return param;
+}
+
+static void EncodeFrames(FFmpegVideoEncoder *encoder, int bytes_per_frame, int frame_num) {
+  std::vector<uint8_t> image(bytes_per_frame);
+  for (int i = 0; i < frame_num; ++i) {
+    for (int p = 0; p < bytes_per_frame; ++p) image[p] = static_cast<uint8_t>((p + i * 3) % 220 + 16);
+    ASSERT_TRUE(encoder->SendFrame(image.data(), i * 40));
+  }
+}
+
+TEST(RtspSinkFFmpegEncoder, EncodeNV12WithoutConverting) {
+  constexpr int frame_num = 50;
+  RtspParam param = EncoderParam(NV12);
+  FFmpegVideoEncoder encoder(param);
+  // nv12 is taken by libx264 directly
+  EXPECT_FALSE(encoder.ConvertsFrame());
+  int latency_num = 0;
+  double max_latency = 0;
+  encoder.SetLatencyCallback([&](int64_t timestamp, double latency_ms) {
+    ++latency_num;
+    if (latency_ms > max_latency) max_latency = latency_ms;
+  });
+  encoder.Start();
+  uint32_t size = 0;
+  int64_t timestamp = 0;
+  // a client is waiting for frames
+  encoder.GetFrame(nullptr, 0, &size, &timestamp);
+  EncodeFrames(&encoder, param.dst_width * param.dst_height * 3 / 2, frame_num);
+
+  // zerolatency, each frame is encoded when it is sent
+  EXPECT_EQ(frame_num, latency_num);
+  EXPECT_GT(max_latency, 0);
+  std::vector<uint8_t> packet(0x100000);
+  ASSERT_TRUE(encoder.GetFrame(packet.data(), packet.size(), &size, &timestamp));
+  EXPECT_GT(size, 0u);
+  encoder.Stop();
+}
+
+TEST(RtspSinkFFmpegEncoder, EncodeBGRWithConverting) {
+  constexpr int frame_num = 10;
+  RtspParam param = EncoderParam(BGR24);
+  param.preset = "ultrafast";
+  param.encode_threads = 0;
+  FFmpegVideoEncoder encoder(param);
+  EXPECT_TRUE(encoder.ConvertsFrame());
+  int latency_num = 0;
+  encoder.SetLatencyCallback([&](int64_t timestamp, double latency_ms) { ++latency_num; });
+  encoder.Start();
+  EncodeFrames(&encoder, param.dst_width * param.dst_height * 3, frame_num);
+  EXPECT_EQ(frame_num, latency_num);
+  encoder.Stop();
+}
+
+}  // namespace cnstream
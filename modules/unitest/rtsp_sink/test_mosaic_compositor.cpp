@@ -0,0 +1,129 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "mosaic_compositor.hpp"
+
+namespace cnstream {
+
+TEST(RtspSinkMosaicCompositor, Layout) {
+  auto tiles = MosaicCompositor::Layout(1920, 1080, 4, 4);
+  ASSERT_EQ(16u, tiles.size());
+  EXPECT_EQ(480, tiles[5].x);
+  EXPECT_EQ(270 & ~1, tiles[5].y);
+  EXPECT_EQ(480, tiles[5].w);
+  EXPECT_EQ(270 & ~1, tiles[5].h);
+
+  // the first channel takes 2 x 2 cells of 3 x 3
+  tiles = MosaicCompositor::Layout(1920, 1080, 3, 2);
+  ASSERT_EQ(6u, tiles.size());
+  EXPECT_EQ(1280, tiles[0].w);
+  EXPECT_EQ(720, tiles[0].h);
+  EXPECT_EQ(1280, tiles[1].x);
+  EXPECT_EQ(0, tiles[1].y);
+  EXPECT_EQ(1280, tiles[2].x);
+  EXPECT_EQ(360, tiles[2].y);
+  for (int i = 3; i < 6; ++i) {
+    EXPECT_EQ((i - 3) * 640, tiles[i].x);
+    EXPECT_EQ(720, tiles[i].y);
+  }
+  EXPECT_TRUE(MosaicCompositor::Layout(1920, 1080, 0, 2).empty());
+}
+
+TEST(RtspSinkMosaicCompositor, UpdateOnlyNewTiles) {
+  constexpr int width = 640, height = 480, src_w = 352, src_h = 288;
+  MosaicCompositor compositor(width, height, 2, 2);
+  ASSERT_EQ(4u, compositor.TileNum());
+  // black canvas
+  EXPECT_EQ(16, compositor.Canvas()[0]);
+  EXPECT_EQ(128, compositor.Canvas()[width * height]);
+  EXPECT_EQ(0, compositor.Compose());
+
+  std::vector<uint8_t> frame(src_w * src_h * 3 / 2);
+  std::fill(frame.begin(), frame.begin() + src_w * src_h, 200);
+  for (size_t i = src_w * src_h; i < frame.size(); i += 2) {
+    frame[i] = 60;
+    frame[i + 1] = 90;
+  }
+  const uint8_t *uv = frame.data() + src_w * src_h;
+  EXPECT_FALSE(compositor.Update(4, frame.data(), uv, src_w, src_h, src_w, src_w));
+  EXPECT_FALSE(compositor.Update(0, frame.data(), uv, src_w, src_h, src_w - 2, src_w));
+  EXPECT_FALSE(compositor.Update(0, nullptr, uv, src_w, src_h, src_w, src_w));
+
+  ASSERT_TRUE(compositor.Update(3, frame.data(), uv, src_w, src_h, src_w, src_w));
+  EXPECT_EQ(1, compositor.Compose());
+  EXPECT_EQ(0, compositor.Compose());
+  const uint8_t *canvas = compositor.Canvas();
+  const uint8_t *canvas_uv = canvas + width * height;
+  // tile 3 is the bottom right quarter, others are still black
+  EXPECT_EQ(200, canvas[(height - 1) * width + width - 1]);
+  EXPECT_EQ(200, canvas[height / 2 * width + width / 2]);
+  EXPECT_EQ(16, canvas[height / 2 * width + width / 2 - 1]);
+  EXPECT_EQ(16, canvas[(height / 2 - 1) * width + width / 2]);
+  EXPECT_EQ(60, canvas_uv[height / 4 * width + width / 2]);
+  EXPECT_EQ(90, canvas_uv[height / 4 * width + width / 2 + 1]);
+  EXPECT_EQ(128, canvas_uv[height / 4 * width + width / 2 - 1]);
+
+  // channels are updated concurrently
+  std::vector<std::thread> threads;
+  for (int channel = 0; channel < 4; ++channel) {
+    threads.emplace_back([&, channel]() {
+      for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(compositor.Update(channel, frame.data(), uv, src_w, src_h, src_w, src_w));
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  EXPECT_EQ(4, compositor.Compose());
+  EXPECT_EQ(200, canvas[0]);
+  EXPECT_EQ(60, canvas_uv[0]);
+}
+
+TEST(RtspSinkMosaicCompositor, UpdateWithUvStride) {
+  constexpr int width = 640, height = 480, src_w = 352, src_h = 288;
+  constexpr int y_stride = 384, uv_stride = 448;
+  MosaicCompositor compositor(width, height, 1, 1);
+  // padding of both planes differs from the pixels, it should never be read
+  std::vector<uint8_t> y(y_stride * src_h, 255), uv(uv_stride * src_h / 2, 255);
+  for (int r = 0; r < src_h; ++r) std::fill(y.begin() + r * y_stride, y.begin() + r * y_stride + src_w, 200);
+  for (int r = 0; r < src_h / 2; ++r) {
+    for (int c = 0; c < src_w; c += 2) {
+      uv[r * uv_stride + c] = 60;
+      uv[r * uv_stride + c + 1] = 90;
+    }
+  }
+  EXPECT_FALSE(compositor.Update(0, y.data(), uv.data(), src_w, src_h, y_stride, src_w - 2));
+  ASSERT_TRUE(compositor.Update(0, y.data(), uv.data(), src_w, src_h, y_stride, uv_stride));
+  EXPECT_EQ(1, compositor.Compose());
+  const uint8_t *canvas = compositor.Canvas();
+  const uint8_t *canvas_uv = canvas + width * height;
+  for (int i = 0; i < width * height; ++i) ASSERT_EQ(200, canvas[i]) << "y " << i;
+  for (int i = 0; i < width * height / 2; i += 2) {
+    ASSERT_EQ(60, canvas_uv[i]) << "u " << i;
+    ASSERT_EQ(90, canvas_uv[i + 1]) << "v " << i;
+  }
+}
+
+}  // namespace cnstream
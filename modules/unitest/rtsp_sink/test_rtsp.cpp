@@ -352,6 +352,19 @@ TEST(RTSP, RTSP) {
   params["color_mode"] = "rgb";
   params["encoder_type"] = "mlu";
   TestAllCase(ptr, params, __LINE__);
+
+  params.clear();
+  params["view_mode"] = "mosaic";
+  params["frame_rate"] = "25";
+  params["kbit_rate"] = "512";
+  params["gop_size"] = "30";
+  params["dst_width"] = "352";
+  params["dst_height"] = "288";
+  params["color_mode"] = "nv";
+  params["view_rows"] = "2";
+  params["view_cols"] = "2";
+  params["encoder_type"] = "ffmpeg";
+  TestAllCase(ptr, params, __LINE__);
 }
 
 }  // namespace cnstream
@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "data_handler_util.hpp"
+#include "packet_buffer_pool.hpp"
+
+namespace cnstream {
+
+/*
+ * Packets/sec of 4K HEVC at 100 streams: each stream has a thread writing packets of a 60 frames GOP, an I frame of
+ * 600KB and P frames of 40KB, to a queue, and a thread taking them out, as the handlers and decoders do. Packets are
+ * copied into pooled buffers by EsPacket, the baseline allocates a buffer for each packet.
+ */
+TEST(PacketBufferPoolBenchmark, Packets4KHevc100Streams) {
+  constexpr int kStreamNum = 100;
+  constexpr int kPacketsPerStream = 600;
+  constexpr int kGopSize = 60;
+  constexpr size_t kIFrameSize = 600 * 1024;
+  constexpr size_t kPFrameSize = 40 * 1024;
+  std::vector<unsigned char> frame(kIFrameSize, 0x5a);
+
+  struct RawPacket {
+    explicit RawPacket(ESPacket *pkt) : data(new unsigned char[pkt->size]) {
+      memcpy(data.get(), pkt->data, pkt->size);
+      size = pkt->size;
+    }
+    std::unique_ptr<unsigned char[]> data;
+    int size;
+  };
+
+  auto run = [&](bool pooled) {
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> bytes{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < kStreamNum; ++s) {
+      auto pooled_queue = std::make_shared<FrameQueue>(60);
+      auto raw_queue = std::make_shared<BoundedQueue<std::shared_ptr<RawPacket>>>(60);
+      threads.emplace_back([&, pooled_queue, raw_queue] {
+        for (int i = 0; i < kPacketsPerStream; ++i) {
+          ESPacket pkt;
+          pkt.data = frame.data();
+          pkt.size = i % kGopSize ? kPFrameSize : kIFrameSize;
+          pkt.pts = i;
+          if (pooled) {
+            pooled_queue->Push(std::make_shared<EsPacket>(&pkt));
+          } else {
+            raw_queue->Push(std::make_shared<RawPacket>(&pkt));
+          }
+        }
+      });
+      threads.emplace_back([&, pooled_queue, raw_queue] {
+        for (int i = 0; i < kPacketsPerStream; ++i) {
+          if (pooled) {
+            std::shared_ptr<EsPacket> packet = pooled_queue->Pop();
+            bytes += packet->pkt_.size;
+          } else {
+            std::shared_ptr<RawPacket> packet = raw_queue->Pop();
+            bytes += packet->size;
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(static_cast<uint64_t>(kStreamNum) * (kPacketsPerStream / kGopSize) *
+                  (kIFrameSize + (kGopSize - 1) * kPFrameSize),
+              bytes.load());
+    return kStreamNum * kPacketsPerStream / seconds;
+  };
+
+  PacketBufferPool *pool = PacketBufferPool::Instance();
+  uint64_t allocated_num = pool->GetAllocatedNum();
+  double pooled_pps = run(true);
+  allocated_num = pool->GetAllocatedNum() - allocated_num;
+  double raw_pps = run(false);
+  std::cout << "[PacketBufferPool] 4K HEVC packets of " << kStreamNum << " streams: " << pooled_pps
+            << " packets/s with pooled buffers (" << allocated_num << " buffers allocated), " << raw_pps
+            << " packets/s with a buffer allocated for each packet" << std::endl;
+  // buffers are recycled, at most the packets in queues and in flight are allocated
+  EXPECT_LT(allocated_num, static_cast<uint64_t>(kStreamNum) * 64 * 2);
+}
+
+}  // namespace cnstream
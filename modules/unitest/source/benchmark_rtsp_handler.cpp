@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifdef HAVE_LIVE555
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BasicUsageEnvironment.hh"
+#include "data_source.hpp"
+#include "liveMedia.hh"
+#include "loopback_rtsp_server.hpp"
+#include "test_base.hpp"
+
+namespace cnstream {
+
+static constexpr const char *g_rtsp_h264_path = "../../modules/unitest/source/data/img.h264";
+static constexpr portNumBits g_rtsp_bench_port = 8655;
+
+class FrameArrivalObserver : public IModuleObserver {
+ public:
+  void notify(std::shared_ptr<CNFrameInfo> data) override {
+    if (data->IsEos()) return;
+    std::lock_guard<std::mutex> lk(mutex_);
+    arrivals_.emplace_back(std::chrono::steady_clock::now(), data->timestamp);
+  }
+  std::vector<std::pair<std::chrono::steady_clock::time_point, int64_t>> GetArrivals() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return arrivals_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::pair<std::chrono::steady_clock::time_point, int64_t>> arrivals_;
+};
+
+/*
+ * Latency from the loopback server to the output of DataSource. The server sends frames in real time, so a frame
+ * arrives later than the fastest one by the time it waits between the rtsp session, the demuxer and the decoder.
+ */
+TEST(RtspHandlerBenchmark, LoopbackLatency) {
+  LoopbackRtspServer server(g_rtsp_bench_port);
+  ASSERT_TRUE(server.Start(GetExePath() + g_rtsp_h264_path));
+
+  DataSource source("source");
+  ModuleParamSet param = {{"output_type", "cpu"}, {"decoder_type", "cpu"}, {"device_id", "-1"}};
+  ASSERT_TRUE(source.Open(param));
+  FrameArrivalObserver observer;
+  source.SetObserver(&observer);
+
+  constexpr size_t kFrameNum = 20;
+  std::string url = server.Url();
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(0, source.AddSource(RtspHandler::Create(&source, "0", url, false, 0)));
+  auto deadline = start + std::chrono::seconds(20);
+  while (observer.GetArrivals().size() < kFrameNum && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  source.RemoveSource("0");
+  source.Close();
+  server.Stop();
+
+  auto arrivals = observer.GetArrivals();
+  ASSERT_GE(arrivals.size(), kFrameNum);
+  double first_frame_ms = std::chrono::duration<double, std::milli>(arrivals[0].first - start).count();
+  // frames queued while the stream info is parsed are skipped, the rest are in steady state
+  std::vector<double> offsets;
+  for (size_t i = arrivals.size() / 2; i < arrivals.size(); ++i) {
+    double arrival_ms = std::chrono::duration<double, std::milli>(arrivals[i].first - start).count();
+    offsets.push_back(arrival_ms - arrivals[i].second / 90.0);
+  }
+  double min_offset = *std::min_element(offsets.begin(), offsets.end());
+  double max_lag_ms = 0, total_lag_ms = 0;
+  for (double offset : offsets) {
+    max_lag_ms = std::max(max_lag_ms, offset - min_offset);
+    total_lag_ms += offset - min_offset;
+  }
+  std::cout << "[RtspHandler] first frame in " << first_frame_ms << " ms, frame lag in steady state: mean "
+            << total_lag_ms / offsets.size() << " ms, max " << max_lag_ms << " ms" << std::endl;
+}
+
+}  // namespace cnstream
+
+#endif  // HAVE_LIVE555
@@ -0,0 +1,114 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_UNITEST_SOURCE_LOOPBACK_RTSP_SERVER_HPP_
+#define MODULES_UNITEST_SOURCE_LOOPBACK_RTSP_SERVER_HPP_
+
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BasicUsageEnvironment.hh"
+#include "liveMedia.hh"
+
+namespace cnstream {
+
+// Serve the h264 file repeated kRepeatNum times from memory, so that the stream lasts long enough
+class LoopbackSubsession : public H264VideoFileServerMediaSubsession {
+ public:
+  LoopbackSubsession(UsageEnvironment &env, const std::string &file_name)
+      : H264VideoFileServerMediaSubsession(env, file_name.c_str(), False) {
+    std::ifstream file(file_name, std::ios::binary);
+    std::vector<unsigned char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    for (int i = 0; i < kRepeatNum; ++i) data_.insert(data_.end(), content.begin(), content.end());
+  }
+
+ protected:
+  FramedSource *createNewStreamSource(unsigned clientSessionId, unsigned &estBitrate) override {
+    estBitrate = 500;
+    ByteStreamMemoryBufferSource *source =
+        ByteStreamMemoryBufferSource::createNew(envir(), data_.data(), data_.size(), False);
+    if (!source) return nullptr;
+    return H264VideoStreamFramer::createNew(envir(), source);
+  }
+
+ private:
+  static constexpr int kRepeatNum = 200;
+  std::vector<unsigned char> data_;
+};
+
+// Serve a h264 file on loopback in the way of LiveRtspServer at rtsp://127.0.0.1:port/loopback, each client reads the
+// stream from the beginning. The server can be stopped and started again on the same port.
+class LoopbackRtspServer {
+ public:
+  explicit LoopbackRtspServer(portNumBits port) : port_(port) {}
+  ~LoopbackRtspServer() { Stop(); }
+
+  bool Start(const std::string &file_name) {
+    quit_ = 0;
+    std::promise<bool> started;
+    std::future<bool> future = started.get_future();
+    thread_ = std::thread(&LoopbackRtspServer::Run, this, file_name, &started);
+    if (!future.get()) {
+      thread_.join();
+      return false;
+    }
+    return true;
+  }
+  void Stop() {
+    quit_ = 1;
+    if (thread_.joinable()) thread_.join();
+  }
+
+  std::string Url() const { return "rtsp://127.0.0.1:" + std::to_string(port_) + "/loopback"; }
+
+ private:
+  void Run(const std::string &file_name, std::promise<bool> *started) {
+    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
+    UsageEnvironment *env = BasicUsageEnvironment::createNew(*scheduler);
+    RTSPServer *server = RTSPServer::createNew(*env, port_);
+    if (server) {
+      ServerMediaSession *sms = ServerMediaSession::createNew(*env, "loopback", "loopback", "loopback session");
+      sms->addSubsession(new LoopbackSubsession(*env, file_name));
+      server->addServerMediaSession(sms);
+      // the subsession reads the stream in a nested event loop to generate the SDP, which goes wrong if other clients
+      // send DESCRIBE meanwhile, so it is generated before clients connect
+      delete[] sms->generateSDPDescription();
+      started->set_value(true);
+      env->taskScheduler().doEventLoop(&quit_);
+      Medium::close(server);
+    } else {
+      started->set_value(false);
+    }
+    env->reclaim();
+    delete scheduler;
+  }
+
+  portNumBits port_;
+  std::thread thread_;
+  char quit_ = 0;
+};
+
+}  // namespace cnstream
+
+#endif  // MODULES_UNITEST_SOURCE_LOOPBACK_RTSP_SERVER_HPP_
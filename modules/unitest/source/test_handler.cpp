@@ -22,6 +22,7 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <thread>
@@ -32,6 +33,7 @@
 #include "data_handler_mem.hpp"
 #include "data_handler_rtsp.hpp"
 #include "data_source.hpp"
+#include "ffmpeg_parser.hpp"
 #include "test_base.hpp"
 
 namespace cnstream {
@@ -125,6 +127,22 @@ TEST(RtspHandler, CheckTimeOut) {
 }
 #endif
 
+TEST(RingBuffer, TryWrite) {
+  RingBuffer buffer(8);
+  const uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  EXPECT_EQ(6u, buffer.TryWrite(data, 6));
+  // not enough space, nothing is written
+  EXPECT_EQ(static_cast<size_t>(-1), buffer.TryWrite(data, 3));
+  EXPECT_EQ(6u, buffer.Size());
+  uint8_t out[8];
+  EXPECT_EQ(4u, buffer.Read(out, 4));
+  // wraps around the end of the buffer
+  EXPECT_EQ(6u, buffer.TryWrite(data + 2, 6));
+  EXPECT_EQ(8u, buffer.Read(out, 8));
+  const uint8_t expected[8] = {5, 6, 3, 4, 5, 6, 7, 8};
+  EXPECT_EQ(0, memcmp(expected, out, 8));
+}
+
 TEST(DataHandlerFile, PrepareResources) {
   DataSource src(gname);
   std::string h264_path = GetExePath() + "../../modules/unitest/source/data/img.h264";
@@ -22,6 +22,7 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <thread>
@@ -70,4 +71,41 @@ TEST(DataHandlerMem, Write) {
   fclose(fp);
 }
 
+TEST(DataHandlerMem, WriteBuffer) {
+  DataSource src(gname);
+  ModuleParamSet param;
+  ResetParam(param);
+  ASSERT_TRUE(src.CheckParamSet(param));
+  ASSERT_TRUE(src.Open(param));
+  auto handler = ESMemHandler::Create(&src, std::to_string(0));
+  ASSERT_TRUE(handler != nullptr);
+  auto memHandler = std::dynamic_pointer_cast<cnstream::ESMemHandler>(handler);
+  EXPECT_EQ(memHandler->Open(), true);
+  EXPECT_EQ(memHandler->SetDataType(ESMemHandler::H264), 0);
+  std::string video_path = GetExePath() + gh264_path;
+  FILE *fp = fopen(video_path.c_str(), "rb");
+  ASSERT_TRUE(fp != nullptr);
+  unsigned char buf[16];
+  ESPacket pkt;
+  pkt.data = buf;
+  pkt.size = sizeof(buf);
+  // the data must be in the buffer
+  EXPECT_EQ(memHandler->Write(&pkt, nullptr), -2);
+  EXPECT_EQ(memHandler->Write(&pkt, PacketBufferPool::Instance()->Acquire(sizeof(buf))), -2);
+  while (!feof(fp)) {
+    // read into pooled buffers, which are queued to the decoder without copying
+    PacketBufferPtr buffer = PacketBufferPool::Instance()->Acquire(4096);
+    ASSERT_TRUE(buffer != nullptr);
+    pkt.data = buffer->Data();
+    pkt.size = fread(pkt.data, 1, 4096, fp);
+    if (pkt.size <= 0) break;
+    memset(pkt.data + pkt.size, 0, PacketBufferPool::kPaddingSize);
+    pkt.pts++;
+    EXPECT_EQ(memHandler->Write(&pkt, buffer), 0);
+  }
+  EXPECT_EQ(memHandler->Write(nullptr, nullptr), 0);
+  memHandler->Close();
+  fclose(fp);
+}
+
 }  // namespace cnstream
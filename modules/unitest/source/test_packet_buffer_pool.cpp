@@ -0,0 +1,172 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data_handler_util.hpp"
+#include "ffmpeg_parser.hpp"
+#include "packet_buffer_pool.hpp"
+
+namespace cnstream {
+
+TEST(PacketBufferPool, Recycle) {
+  PacketBufferPool pool(1024 * 1024);
+  uint8_t *data = nullptr;
+  {
+    PacketBufferPtr buffer = pool.Acquire(5000);
+    ASSERT_TRUE(buffer != nullptr);
+    EXPECT_EQ(8192u, buffer->Capacity());
+    // padding is writable
+    memset(buffer->Data(), 0, buffer->Capacity() + PacketBufferPool::kPaddingSize);
+    data = buffer->Data();
+  }
+  EXPECT_EQ(8192u, pool.GetCachedBytes());
+  // the released buffer is taken by a size of the same slab
+  PacketBufferPtr buffer = pool.Acquire(8000);
+  EXPECT_EQ(data, buffer->Data());
+  EXPECT_EQ(1u, pool.GetAllocatedNum());
+  EXPECT_EQ(1u, pool.GetRecycledNum());
+  EXPECT_EQ(0u, pool.GetCachedBytes());
+
+  // larger than the largest slab, freed when it is released
+  size_t large_size = PacketBufferPool::kMaxSlabSize + 1;
+  PacketBufferPtr large = pool.Acquire(large_size);
+  ASSERT_TRUE(large != nullptr);
+  EXPECT_EQ(large_size, large->Capacity());
+  large.reset();
+  EXPECT_EQ(0u, pool.GetCachedBytes());
+
+  // no more than max cached bytes are kept
+  std::vector<PacketBufferPtr> buffers;
+  for (int i = 0; i < 3; ++i) buffers.push_back(pool.Acquire(512 * 1024));
+  buffers.clear();
+  EXPECT_EQ(1024u * 1024u, pool.GetCachedBytes());
+}
+
+TEST(PacketBufferPool, EsPacketPadding) {
+  std::vector<unsigned char> data(1000, 0xff);
+  ESPacket pkt;
+  pkt.data = data.data();
+  pkt.size = data.size();
+  pkt.pts = 10;
+  pkt.flags = ESPacket::FLAG_KEY_FRAME;
+  EsPacket packet(&pkt);
+  ASSERT_TRUE(packet.PaddedBuffer() != nullptr);
+  EXPECT_EQ(packet.pkt_.data, packet.PaddedBuffer()->Data());
+  EXPECT_EQ(0, memcmp(packet.pkt_.data, data.data(), data.size()));
+  for (size_t i = 0; i < PacketBufferPool::kPaddingSize; ++i) EXPECT_EQ(0, packet.pkt_.data[data.size() + i]);
+  EXPECT_EQ(10u, packet.pkt_.pts);
+  EXPECT_EQ(static_cast<uint32_t>(ESPacket::FLAG_KEY_FRAME), packet.pkt_.flags);
+
+  // a slice of a buffer is not padded with zeros
+  EsPacket slice(&pkt, packet.buffer_);
+  EXPECT_TRUE(slice.PaddedBuffer() == nullptr);
+  EXPECT_EQ(pkt.data, slice.pkt_.data);
+}
+
+class NalCollectorForTest : public H2645NalSplitter {
+ public:
+  int SplitterOnNal(NalDesc &desc, bool eos) override {
+    if (eos) {
+      eos_ = true;
+      return 0;
+    }
+    if (!desc.buffer) no_buffer_num_++;
+    nals_.emplace_back(desc.nal, desc.nal + desc.len);
+    buffers_.push_back(desc.buffer);
+    return 0;
+  }
+
+  std::vector<std::vector<unsigned char>> nals_;
+  std::vector<PacketBufferPtr> buffers_;
+  int no_buffer_num_ = 0;
+  bool eos_ = false;
+};
+
+TEST(PacketBufferPool, SplitChunksWithoutCopy) {
+  // h264 nal units of random sizes, written in chunks of random sizes
+  std::mt19937 rng(7);
+  std::vector<std::vector<unsigned char>> nals;
+  std::vector<unsigned char> stream;
+  for (int i = 0; i < 300; ++i) {
+    std::vector<unsigned char> nal = {0, 0, 0, 1, static_cast<unsigned char>(i % 10 ? 0x41 : 0x65)};
+    size_t size = std::uniform_int_distribution<size_t>(10, 20000)(rng);
+    for (size_t j = 0; j < size; ++j) nal.push_back(static_cast<unsigned char>(rng() % 0xfe + 2));
+    stream.insert(stream.end(), nal.begin(), nal.end());
+    nals.push_back(std::move(nal));
+  }
+  NalCollectorForTest collector;
+  collector.SplitterInit(true);
+  size_t offset = 0;
+  while (offset < stream.size()) {
+    int len = std::min<size_t>(std::uniform_int_distribution<size_t>(100, 50000)(rng), stream.size() - offset);
+    ASSERT_EQ(0, collector.SplitterWriteChunk(stream.data() + offset, len));
+    offset += len;
+  }
+  ASSERT_EQ(0, collector.SplitterWriteChunk(nullptr, 0));
+  EXPECT_TRUE(collector.eos_);
+  ASSERT_EQ(nals.size(), collector.nals_.size());
+  for (size_t i = 0; i < nals.size(); ++i) EXPECT_EQ(nals[i], collector.nals_[i]) << "nal " << i;
+  // all nal units are slices of pooled buffers, which are shared by several nal units
+  EXPECT_EQ(0, collector.no_buffer_num_);
+  std::vector<PacketBuffer *> distinct;
+  for (auto &buffer : collector.buffers_) distinct.push_back(buffer.get());
+  std::sort(distinct.begin(), distinct.end());
+  distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+  EXPECT_LT(distinct.size() * 4, nals.size());
+}
+
+TEST(PacketBufferPool, ReleaseConcurrently) {
+  constexpr int kThreadNum = 8;
+  constexpr int kBufferNum = 64;
+  constexpr size_t kMaxCachedBytes = 1024 * 1024;
+  PacketBufferPool pool(kMaxCachedBytes);
+  std::vector<std::vector<PacketBufferPtr>> buffers(kThreadNum);
+  for (auto &thread_buffers : buffers) {
+    for (int i = 0; i < kBufferNum; ++i) thread_buffers.push_back(pool.Acquire(64 * 1024));
+  }
+  std::atomic<int> ready{0};
+  std::vector<std::thread> threads;
+  for (auto &thread_buffers : buffers) {
+    threads.emplace_back([&] {
+      ready++;
+      while (ready.load() < kThreadNum) std::this_thread::yield();
+      thread_buffers.clear();
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  // buffers released together fill the cache exactly, never more than max cached bytes
+  EXPECT_EQ(kMaxCachedBytes, pool.GetCachedBytes());
+  std::vector<PacketBufferPtr> recycled;
+  for (size_t i = 0; i < kMaxCachedBytes / (64 * 1024); ++i) recycled.push_back(pool.Acquire(64 * 1024));
+  EXPECT_EQ(recycled.size(), pool.GetRecycledNum());
+  EXPECT_EQ(0u, pool.GetCachedBytes());
+}
+
+}  // namespace cnstream
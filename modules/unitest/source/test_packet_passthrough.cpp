@@ -0,0 +1,153 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cnstream_frame_va.hpp"
+#include "cnstream_module.hpp"
+#include "cnstream_pipeline.hpp"
+#include "data_source.hpp"
+#include "test_base.hpp"
+
+namespace cnstream {
+
+static constexpr const char *g_h264_path = "../../modules/unitest/source/data/img.h264";
+
+class EosObserverForPassthrough : public StreamMsgObserver {
+ public:
+  void Update(const StreamMsg &smsg) override {
+    if (smsg.type == StreamMsgType::EOS_MSG) wakener_.set_value();
+  }
+  void WaitForEos() { wakener_.get_future().get(); }
+
+ private:
+  std::promise<void> wakener_;
+};
+
+class PacketCollectorForTest : public Module, public ModuleCreator<PacketCollectorForTest> {
+ public:
+  explicit PacketCollectorForTest(const std::string &name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    std::lock_guard<std::mutex> lk(mtx_);
+    ++frame_num_;
+    if (data->datas.find(CNPacketsKey) != data->datas.end()) {
+      CNPacketsVec packets = any_cast<CNPacketsVec>(data->datas[CNPacketsKey]);
+      packets_.insert(packets_.end(), packets.begin(), packets.end());
+    }
+    return 0;
+  }
+
+  std::mutex mtx_;
+  size_t frame_num_ = 0;
+  CNPacketsVec packets_;
+};
+
+static std::vector<uint8_t> ReadFile(const std::string &file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+TEST(SourcePassthrough, BitExactH264) {
+  std::string output_dir = GetExePath() + "passthrough_output";
+  Pipeline pipeline("passthrough_pipeline");
+
+  CNModuleConfig source_config;
+  source_config.name = "source";
+  source_config.className = "cnstream::DataSource";
+  source_config.next = {"collector"};
+  source_config.parameters = {{"decoder_type", "cpu"}, {"output_type", "cpu"}, {"output_packets", "true"}};
+  source_config.maxInputQueueSize = 0;
+  source_config.parallelism = 0;
+
+  CNModuleConfig collector_config;
+  collector_config.name = "collector";
+  collector_config.className = "cnstream::PacketCollectorForTest";
+  collector_config.next = {"encode"};
+  collector_config.maxInputQueueSize = 20;
+  collector_config.parallelism = 1;
+
+  CNModuleConfig encode_config;
+  encode_config.name = "encode";
+  encode_config.className = "cnstream::Encode";
+  encode_config.parameters = {{"passthrough", "true"}, {"output_dir", output_dir}};
+  encode_config.maxInputQueueSize = 20;
+  encode_config.parallelism = 1;
+
+  ASSERT_EQ(0, pipeline.BuildPipeline({source_config, collector_config, encode_config}));
+  DataSource *source = dynamic_cast<DataSource *>(pipeline.GetModule("source"));
+  PacketCollectorForTest *collector = dynamic_cast<PacketCollectorForTest *>(pipeline.GetModule("collector"));
+  ASSERT_NE(nullptr, source);
+  ASSERT_NE(nullptr, collector);
+
+  EosObserverForPassthrough observer;
+  pipeline.SetStreamMsgObserver(&observer);
+  ASSERT_TRUE(pipeline.Start());
+  std::string file_name = GetExePath() + g_h264_path;
+  auto handler = FileHandler::Create(source, "0", file_name, 30, false);
+  ASSERT_NE(nullptr, handler);
+  ASSERT_EQ(0, source->AddSource(handler));
+  observer.WaitForEos();
+  pipeline.Stop();
+
+  // every packet read from the file is attached once, the first one is the key frame
+  ASSERT_GT(collector->frame_num_, 0u);
+  ASSERT_FALSE(collector->packets_.empty());
+  EXPECT_TRUE(collector->packets_.front()->key);
+  std::vector<uint8_t> packets_data;
+  for (const auto &packet : collector->packets_) {
+    EXPECT_EQ(CNPacketCodec::H264, packet->codec);
+    packets_data.insert(packets_data.end(), packet->data.begin(), packet->data.end());
+  }
+  std::vector<uint8_t> source_data = ReadFile(file_name);
+  EXPECT_TRUE(source_data == packets_data);
+
+  // archived without transcoding
+  std::vector<uint8_t> output_data = ReadFile(output_dir + "/passthrough_stream_0.h264");
+  ASSERT_EQ(source_data.size(), output_data.size());
+  EXPECT_TRUE(source_data == output_data);
+}
+
+TEST(SourcePassthrough, NoPacketsByDefault) {
+  DataSource source("source_without_packets");
+  ModuleParamSet param;
+  EXPECT_TRUE(source.Open(param));
+  EXPECT_FALSE(source.GetSourceParam().output_packets_);
+  param["output_packets"] = "true";
+  EXPECT_TRUE(source.CheckParamSet(param));
+  source.Close();
+  EXPECT_TRUE(source.Open(param));
+  EXPECT_TRUE(source.GetSourceParam().output_packets_);
+  source.Close();
+  param["output_packets"] = "yes";
+  EXPECT_FALSE(source.CheckParamSet(param));
+}
+
+}  // namespace cnstream
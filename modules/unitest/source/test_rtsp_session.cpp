@@ -0,0 +1,295 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifdef HAVE_LIVE555
+
+#include <dirent.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BasicUsageEnvironment.hh"
+#include "data_source.hpp"
+#include "liveMedia.hh"
+#include "loopback_rtsp_server.hpp"
+#include "rtsp_client.hpp"
+#include "test_base.hpp"
+
+namespace cnstream {
+
+static constexpr const char *g_rtsp_h264_path = "../../modules/unitest/source/data/img.h264";
+static constexpr portNumBits g_rtsp_port = 8654;
+
+class RtspFrameCounterForTest : public IRtspCB {
+ public:
+  void OnFrame(unsigned char *data, size_t size, FrameInfo *frame_info) override {
+    if (data && size && frame_info) {
+      frame_num_++;
+      if (frame_info->flags & FrameInfo::FLAG_KEY_FRAME) key_frame_num_++;
+    } else {
+      eos_num_++;
+    }
+  }
+  void OnEvent(int type) override {}
+
+  std::atomic<uint64_t> frame_num_{0};
+  std::atomic<uint64_t> key_frame_num_{0};
+  std::atomic<uint64_t> eos_num_{0};
+};
+
+static int GetThreadNum() {
+  int thread_num = 0;
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir) return -1;
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') thread_num++;
+  }
+  closedir(dir);
+  return thread_num;
+}
+
+TEST(RtspSession, SharedEventLoop) {
+  LoopbackRtspServer server(g_rtsp_port);
+  ASSERT_TRUE(server.Start(GetExePath() + g_rtsp_h264_path));
+
+  constexpr int kSessionNum = 120;
+  constexpr int kEventLoopNum = 2;
+  std::vector<std::unique_ptr<RtspFrameCounterForTest>> counters;
+  std::vector<std::unique_ptr<RtspSession>> sessions;
+  int thread_num = GetThreadNum();
+  for (int i = 0; i < kSessionNum; ++i) {
+    counters.emplace_back(new RtspFrameCounterForTest);
+    sessions.emplace_back(new RtspSession);
+    OpenParam param;
+    param.url = server.Url();
+    param.eventLoopNum = kEventLoopNum;
+    param.cb = counters.back().get();
+    ASSERT_EQ(0, sessions.back()->Open(param));
+  }
+  // sessions run in the shared event loops, instead of a thread for each one
+  EXPECT_LE(GetThreadNum() - thread_num, kEventLoopNum);
+
+  // every session receives the parameter sets and frames
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  int received_num = 0;
+  while (std::chrono::steady_clock::now() < deadline) {
+    received_num = 0;
+    for (auto &counter : counters) {
+      if (counter->key_frame_num_ > 0 && counter->frame_num_ > 10) received_num++;
+    }
+    if (received_num == kSessionNum) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(kSessionNum, received_num);
+
+  for (auto &session : sessions) session->Close();
+  for (auto &counter : counters) EXPECT_EQ(1u, counter->eos_num_.load());
+  sessions.clear();
+  // event loops stop after all sessions are closed
+  EXPECT_LE(GetThreadNum(), thread_num);
+  server.Stop();
+}
+
+class RtspFrameRecorderForTest : public IRtspCB {
+ public:
+  struct Record {
+    std::chrono::steady_clock::time_point time;
+    bool key;
+    int nal_type;  // of the first nal unit
+  };
+  void OnFrame(unsigned char *data, size_t size, FrameInfo *frame_info) override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (data && size > 4 && frame_info) {
+      records_.push_back({std::chrono::steady_clock::now(), (frame_info->flags & FrameInfo::FLAG_KEY_FRAME) != 0,
+                          data[4] & 0x1f});
+    } else if (!data) {
+      eos_num_++;
+    }
+  }
+  void OnEvent(int type) override {}
+  std::vector<Record> GetRecords() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return records_;
+  }
+  bool WaitForRecords(size_t num) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (GetRecords().size() < num) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+  }
+  int GetEosNum() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return eos_num_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<Record> records_;
+  int eos_num_ = 0;
+};
+
+// frames start from the parameter sets, and no frame is sent before the first key frame
+static void ExpectStartFromKeyFrame(const std::vector<RtspFrameRecorderForTest::Record> &records, size_t start) {
+  ASSERT_LT(start, records.size());
+  EXPECT_EQ(7, records[start].nal_type);
+  for (size_t i = start; i < records.size() && records[i].nal_type != 5; ++i) {
+    EXPECT_TRUE(records[i].key) << "frame " << i << " before the key frame";
+  }
+}
+
+/*
+ * The server is killed and started again, the session reconnects after the server is back, in its own thread and in
+ * the shared event loop. Frames after reconnecting start from the parameter sets and the key frame.
+ */
+TEST(RtspSession, ReconnectAfterServerRestart) {
+  std::string file_name = GetExePath() + g_rtsp_h264_path;
+  for (int event_loop_num : {0, 1}) {
+    LoopbackRtspServer server(g_rtsp_port);
+    ASSERT_TRUE(server.Start(file_name));
+    RtspFrameRecorderForTest recorder;
+    RtspSession session;
+    OpenParam param;
+    param.url = server.Url();
+    param.reconnect = 100;
+    param.livenessTimeoutMs = 500;
+    param.reconnectMaxDelayMs = 500;
+    param.eventLoopNum = event_loop_num;
+    param.cb = &recorder;
+    ASSERT_EQ(0, session.Open(param));
+    ASSERT_TRUE(recorder.WaitForRecords(20));
+    ExpectStartFromKeyFrame(recorder.GetRecords(), 0);
+
+    // the session keeps reconnecting while the server is down
+    server.Stop();
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    size_t frame_num = recorder.GetRecords().size();
+    auto restart = std::chrono::steady_clock::now();
+    ASSERT_TRUE(server.Start(file_name));
+    ASSERT_TRUE(recorder.WaitForRecords(frame_num + 20));
+
+    auto records = recorder.GetRecords();
+    size_t start = frame_num;
+    while (start < records.size() && records[start].time < restart) start++;
+    // frames are received again in the 10s of WaitForRecords, without the end of stream
+    ASSERT_LT(start, records.size());
+    ExpectStartFromKeyFrame(records, start);
+    EXPECT_EQ(0, recorder.GetEosNum());
+
+    session.Close();
+    EXPECT_EQ(1, recorder.GetEosNum());
+    server.Stop();
+  }
+}
+
+TEST(RtspSession, LateConsumer) {
+  LoopbackRtspServer server(g_rtsp_port);
+  ASSERT_TRUE(server.Start(GetExePath() + g_rtsp_h264_path));
+  RtspFrameRecorderForTest recorder;
+  RtspSession session;
+  OpenParam param;
+  param.url = server.Url();
+  param.gopCacheSize = 1 << 20;
+  param.cb = &recorder;
+  ASSERT_EQ(0, session.Open(param));
+  ASSERT_TRUE(recorder.WaitForRecords(13));
+
+  // the cached GOP is sent to the consumer at once
+  RtspFrameRecorderForTest consumer;
+  session.AddConsumer(&consumer);
+  auto records = consumer.GetRecords();
+  ASSERT_GE(records.size(), 2u);
+  ExpectStartFromKeyFrame(records, 0);
+  EXPECT_TRUE(consumer.WaitForRecords(records.size() + 10));
+  session.RemoveConsumer(&consumer);
+
+  session.Close();
+  EXPECT_EQ(0, consumer.GetEosNum());
+  EXPECT_EQ(1, recorder.GetEosNum());
+  server.Stop();
+}
+
+// Write the h264 file with the IDR slices turned into non-IDR I slices, as the stream of a camera with intra refresh
+// or open GOPs, a recovery point SEI is inserted before each of them if recovery_point is true.
+static std::string WriteStreamWithoutIdr(const std::string &file_name, bool recovery_point) {
+  std::ifstream file(file_name, std::ios::binary);
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  // recovery_frame_cnt 0, exact_match_flag 1, broken_link_flag 0 and changing_slice_group_idc 0
+  const unsigned char sei[] = {0, 0, 0, 1, 0x06, 0x06, 0x01, 0xc4, 0x80};
+  std::vector<unsigned char> out;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (i + 3 < data.size() && data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1 && (data[i + 3] & 0x1f) == 5) {
+      if (recovery_point) out.insert(out.end(), sei, sei + sizeof(sei));
+      out.insert(out.end(), {0, 0, 1, static_cast<unsigned char>((data[i + 3] & 0xe0) | 1)});
+      i += 3;
+      continue;
+    }
+    out.push_back(data[i]);
+  }
+  std::string out_name = GetExePath() + (recovery_point ? "recovery_point.h264" : "no_idr.h264");
+  std::ofstream(out_name, std::ios::binary).write(reinterpret_cast<const char *>(out.data()), out.size());
+  return out_name;
+}
+
+/*
+ * Cameras with intra refresh or open GOPs send no IDR pictures, frames start from the I slice, or from the recovery
+ * point SEI before it.
+ */
+TEST(RtspSession, StreamWithoutIdr) {
+  for (bool recovery_point : {false, true}) {
+    std::string file_name = WriteStreamWithoutIdr(GetExePath() + g_rtsp_h264_path, recovery_point);
+    LoopbackRtspServer server(g_rtsp_port);
+    ASSERT_TRUE(server.Start(file_name));
+    RtspFrameRecorderForTest recorder;
+    RtspSession session;
+    OpenParam param;
+    param.url = server.Url();
+    param.cb = &recorder;
+    ASSERT_EQ(0, session.Open(param));
+    EXPECT_TRUE(recorder.WaitForRecords(20));
+    session.Close();
+    server.Stop();
+    std::remove(file_name.c_str());
+
+    auto records = recorder.GetRecords();
+    size_t start = 0;
+    while (start < records.size() && (records[start].nal_type == 7 || records[start].nal_type == 8)) start++;
+    ASSERT_LT(start, records.size());
+    // the start point is the first frame, and is marked as a key frame
+    EXPECT_EQ(recovery_point ? 6 : 1, records[start].nal_type);
+    EXPECT_TRUE(records[start].key);
+  }
+}
+
+}  // namespace cnstream
+
+#endif  // HAVE_LIVE555
@@ -221,6 +221,13 @@ TEST(CoreFrame, InferObjGetAttribute) {
   EXPECT_EQ(infer_attr.id, value.id);
   EXPECT_EQ(infer_attr.value, value.value);
   EXPECT_EQ(infer_attr.score, value.score);
+
+  // get all attributes
+  EXPECT_TRUE(infer_obj.AddAttribute("test_key2", value));
+  auto attributes = infer_obj.GetAttributes();
+  ASSERT_EQ(attributes.size(), 2u);
+  EXPECT_NE(attributes[0].first, attributes[1].first);
+  EXPECT_EQ(attributes[0].second.score, value.score);
 }
 
 TEST(CoreFrame, InferObjAddExtraAttribute) {
@@ -266,6 +273,63 @@ TEST(CoreFrame, InferObjAddAndGetfeature) {
   EXPECT_EQ(infer_obj.GetFeature("feature2"), infer_feature2);
 }
 
+TEST(CoreFrame, InferObjClassIdAndTrackId) {
+  CNInferObject infer_obj;
+  // not set
+  EXPECT_EQ(infer_obj.GetClassId(), -1);
+  EXPECT_EQ(infer_obj.GetTrackId(), -1);
+  EXPECT_EQ(infer_obj.GetClassIdStr(), "");
+  EXPECT_EQ(infer_obj.GetTrackIdStr(), "");
+
+  // set by string
+  infer_obj.SetClassId("3");
+  infer_obj.SetTrackId("15");
+  EXPECT_EQ(infer_obj.GetClassId(), 3);
+  EXPECT_EQ(infer_obj.GetTrackId(), 15);
+  EXPECT_EQ(infer_obj.GetClassIdStr(), "3");
+  infer_obj.SetTrackId("not a number");
+  EXPECT_EQ(infer_obj.GetTrackId(), -1);
+  EXPECT_EQ(infer_obj.GetTrackIdStr(), "not a number");
+
+  // set by integer, strings are formatted when asked for
+  infer_obj.SetClassId(7);
+  infer_obj.SetTrackId(-1);
+  EXPECT_EQ(infer_obj.GetClassId(), 7);
+  EXPECT_EQ(infer_obj.GetClassIdStr(), "7");
+  EXPECT_EQ(infer_obj.GetTrackId(), -1);
+  EXPECT_EQ(infer_obj.GetTrackIdStr(), "-1");
+
+  // the deprecated strings are kept in sync
+  EXPECT_EQ(infer_obj.id, "7");
+  EXPECT_EQ(infer_obj.track_id, "-1");
+
+  // only whole integers in the int range are parsed, the strings are kept as they are
+  infer_obj.SetClassId("12abc");
+  EXPECT_EQ(infer_obj.GetClassId(), -1);
+  EXPECT_EQ(infer_obj.GetClassIdStr(), "12abc");
+  infer_obj.SetClassId("99999999999");
+  EXPECT_EQ(infer_obj.GetClassId(), -1);
+  infer_obj.SetTrackId("007");
+  EXPECT_EQ(infer_obj.GetTrackId(), 7);
+  EXPECT_EQ(infer_obj.GetTrackIdStr(), "007");
+
+  // the last one wins
+  infer_obj.SetClassId("person");
+  EXPECT_EQ(infer_obj.GetClassId(), -1);
+  infer_obj.SetClassId(8);
+  EXPECT_EQ(infer_obj.GetClassIdStr(), "8");
+  infer_obj.SetClassId("");
+  EXPECT_EQ(infer_obj.GetClassId(), -1);
+  EXPECT_EQ(infer_obj.GetClassIdStr(), "");
+
+  // strings written directly by old code are parsed while the integers are not set
+  CNInferObject old_obj;
+  old_obj.id = "5";
+  old_obj.track_id = "12";
+  EXPECT_EQ(old_obj.GetClassId(), 5);
+  EXPECT_EQ(old_obj.GetTrackId(), 12);
+}
+
 TEST(CoreFrame, SetAndGetFlowDepth) {
   int flow_depth = 32;
   SetFlowDepth(flow_depth);
@@ -0,0 +1,85 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "easytrack/easy_track.h"
+#include "feature_match_objects.hpp"
+
+namespace cnstream {
+
+static size_t GetRSSBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+/*
+ * Runs FeatureMatch for a million frames with objects replaced continually,
+ * the tracker should neither keep more tracks than max_tracks nor grow the memory.
+ */
+TEST(TrackerBenchmark, FeatureMatchSoak) {
+  const int frame_num = 1000000;
+  const int warmup_frame_num = 10000;
+  const int obj_num = 2;
+  const uint32_t max_tracks = 16;
+  edk::FeatureMatchTrack track;
+  track.SetParams(kFeatureMatchCosineDistance, kFeatureMatchNNBudget, 0.7, 30, 3, max_tracks);
+
+  std::mt19937 rng(12345);
+  auto features = GenRandomFeatures(64, &rng);
+  size_t rss_after_warmup = 0;
+  size_t max_memory_usage = 0;
+  edk::Objects in, out;
+  edk::TrackFrame tframe;
+  for (int n = 0; n < frame_num; ++n) {
+    GenReplacedObjects(n, obj_num, features, &in);
+    out.clear();
+    track.UpdateFrame(tframe, in, &out);
+    ASSERT_EQ(out.size(), in.size());
+    ASSERT_LE(track.GetTrackNum(), max_tracks);
+    if (n % 1000 == 0) max_memory_usage = std::max(max_memory_usage, track.GetMemoryUsage());
+    if (n == warmup_frame_num) rss_after_warmup = GetRSSBytes();
+  }
+  size_t rss_end = GetRSSBytes();
+  EXPECT_LE(max_memory_usage, FeatureMatchMemoryBound(max_tracks, obj_num));
+  EXPECT_LE(rss_end, rss_after_warmup + 4 * 1024 * 1024);
+}
+
+TEST(TrackerBenchmark, FeatureMatchParallelLatency) {
+  std::mt19937 rng(12345);
+  for (int obj_num : {50, 200, 500}) {
+    double serial_ms, parallel_ms;
+    CompareSerialParallel(obj_num, 10, &rng, &serial_ms, &parallel_ms);
+    std::cout << "FeatureMatch " << obj_num << " objects, average latency per frame: serial " << serial_ms
+              << " ms, parallel " << parallel_ms << " ms" << std::endl;
+  }
+}
+
+}  // namespace cnstream
@@ -0,0 +1,130 @@
+/*************************************************************************
+ * Copyright (C) [2020] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_UNITEST_TRACK_FEATURE_MATCH_OBJECTS_HPP_
+#define MODULES_UNITEST_TRACK_FEATURE_MATCH_OBJECTS_HPP_
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "easytrack/easy_track.h"
+
+namespace cnstream {
+
+static constexpr float kFeatureMatchCosineDistance = 0.2f;
+static constexpr int kFeatureMatchFeatureDim = 128;
+static constexpr int kFeatureMatchNNBudget = 100;
+
+inline std::vector<std::vector<float>> GenRandomFeatures(int num, std::mt19937 *rng) {
+  std::uniform_real_distribution<float> dist(0, 1);
+  std::vector<std::vector<float>> features(num, std::vector<float>(kFeatureMatchFeatureDim));
+  for (auto &feature : features) {
+    for (auto &val : feature) val = dist(*rng);
+  }
+  return features;
+}
+
+// Objects move slowly and are replaced by new ones every 50 frames
+inline void GenReplacedObjects(int frame_idx, int obj_num, const std::vector<std::vector<float>> &features,
+                               edk::Objects *objs) {
+  int generation = frame_idx / 50;
+  objs->clear();
+  for (int i = 0; i < obj_num; ++i) {
+    edk::DetectObject obj;
+    obj.label = i;
+    obj.score = 0.9;
+    obj.bbox.x = 0.1 + 0.4 * i + 0.002 * (frame_idx % 50);
+    obj.bbox.y = 0.1 * (generation % 8);
+    obj.bbox.width = 0.1;
+    obj.bbox.height = 0.1;
+    obj.feature = features[(generation * obj_num + i) % features.size()];
+    objs->push_back(obj);
+  }
+}
+
+// Upper bound of FeatureMatchTrack::GetMemoryUsage, features of each track are bounded by nn_budget
+inline size_t FeatureMatchMemoryBound(uint32_t max_tracks, int obj_num) {
+  return (max_tracks + obj_num) * (sizeof(float) * kFeatureMatchFeatureDim + 64) * kFeatureMatchNNBudget + 64 * 1024;
+}
+
+// Objects are placed on a grid and move slowly
+inline void GenGridObjects(int frame_idx, const std::vector<std::vector<float>> &features, edk::Objects *objs) {
+  const int obj_num = features.size();
+  const int grid = std::ceil(std::sqrt(obj_num));
+  const float size = 1.0 / grid;
+  objs->clear();
+  for (int i = 0; i < obj_num; ++i) {
+    edk::DetectObject obj;
+    obj.label = 0;
+    obj.score = 0.9;
+    obj.bbox.x = (i % grid) * size + 0.01 * size * frame_idx;
+    obj.bbox.y = (i / grid) * size;
+    obj.bbox.width = 0.8 * size;
+    obj.bbox.height = 0.8 * size;
+    obj.feature = features[i];
+    objs->push_back(obj);
+  }
+}
+
+/*
+ * Tracks the same grid objects serially and on the worker pool, expects exactly the same result.
+ * Average latency per frame of both modes is returned in milliseconds.
+ */
+inline void CompareSerialParallel(int obj_num, int frame_num, std::mt19937 *rng, double *serial_ms,
+                                  double *parallel_ms) {
+  edk::FeatureMatchTrack serial_track, parallel_track;
+  serial_track.SetParams(kFeatureMatchCosineDistance, kFeatureMatchNNBudget, 0.7, 30, 3);
+  parallel_track.SetParams(kFeatureMatchCosineDistance, kFeatureMatchNNBudget, 0.7, 30, 3);
+  parallel_track.SetParallelThreshold(1);
+
+  auto features = GenRandomFeatures(obj_num, rng);
+  *serial_ms = 0;
+  *parallel_ms = 0;
+  edk::Objects in, serial_out, parallel_out;
+  edk::TrackFrame tframe;
+  for (int n = 0; n < frame_num; ++n) {
+    GenGridObjects(n, features, &in);
+    serial_out.clear();
+    parallel_out.clear();
+    auto start = std::chrono::steady_clock::now();
+    serial_track.UpdateFrame(tframe, in, &serial_out);
+    auto mid = std::chrono::steady_clock::now();
+    parallel_track.UpdateFrame(tframe, in, &parallel_out);
+    auto end = std::chrono::steady_clock::now();
+    *serial_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+    *parallel_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+
+    ASSERT_EQ(serial_out.size(), parallel_out.size());
+    for (size_t i = 0; i < serial_out.size(); ++i) {
+      EXPECT_EQ(serial_out[i].detect_id, parallel_out[i].detect_id);
+      EXPECT_EQ(serial_out[i].track_id, parallel_out[i].track_id);
+    }
+  }
+  *serial_ms /= frame_num;
+  *parallel_ms /= frame_num;
+}
+
+}  // namespace cnstream
+
+#endif  // MODULES_UNITEST_TRACK_FEATURE_MATCH_OBJECTS_HPP_
@@ -21,8 +21,11 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <memory>
+#include <random>
 #include <string>
+#include <vector>
 
 #ifdef HAVE_OPENCV
 #include "opencv2/highgui/highgui.hpp"
@@ -37,6 +40,7 @@
 #include "cnstream_frame_va.hpp"
 #include "cnstream_module.hpp"
 #include "easyinfer/mlu_memory_op.h"
+#include "feature_match_objects.hpp"
 #include "test_base.hpp"
 #include "track.hpp"
 
@@ -49,6 +53,7 @@ static constexpr const char *g_dsmodel_path =
 static constexpr const char *g_kcfmodel_path = "../../data/models/MLU270/KCF/yuv2gray.cambricon";
 static constexpr const char *ds_track = "FeatureMatch";
 static constexpr const char *kcf_track = "KCF";
+static constexpr const char *iou_track = "IoUMatch";
 static constexpr const char *img_path = "../../data/images/19.jpg";
 static constexpr int g_dev_id = 0;
 static constexpr int g_channel_id = 0;
@@ -86,6 +91,20 @@ TEST(Tracker, CheckParamSet) {
 
   param["max_cosine_distance"] = std::to_string(g_max_cosine_distance);
   EXPECT_TRUE(track->CheckParamSet(param));
+
+  param["parallel_threshold"] = "fake_threshold";
+  EXPECT_FALSE(track->CheckParamSet(param));
+
+  param["parallel_threshold"] = "100";
+  EXPECT_TRUE(track->CheckParamSet(param));
+
+  param["track_name"] = iou_track;
+  param["high_score_threshold"] = "fake_threshold";
+  EXPECT_FALSE(track->CheckParamSet(param));
+
+  param["high_score_threshold"] = "0.6";
+  param["low_score_threshold"] = "0.2";
+  EXPECT_TRUE(track->CheckParamSet(param));
 }
 
 TEST(Tracker, OpenClose) {
@@ -141,7 +160,7 @@ std::shared_ptr<CNFrameInfo> GenTestData(int iter, int obj_num) {
   CNObjsVec objs;
   for (int i = 0; i < obj_num; ++i) {
     auto obj = std::make_shared<CNInferObject>();
-    obj->id = std::to_string(i);
+    obj->SetClassId(i);
     float val = i * 0.1 + 0.01;
     CNInferBoundingBox bbox = {val, val, val, val};
     obj->bbox = bbox;
@@ -174,7 +193,7 @@ std::shared_ptr<CNFrameInfo> GenTestYUVData(int iter, int obj_num) {
   CNObjsVec objs;
   for (int i = 0; i < obj_num; ++i) {
     auto obj = std::make_shared<CNInferObject>();
-    obj->id = std::to_string(i);
+    obj->SetClassId(i);
     float val = i * 0.1 + 0.01;
     CNInferBoundingBox bbox = {val, val, val, val};
     obj->bbox = bbox;
@@ -207,7 +226,7 @@ std::shared_ptr<CNFrameInfo> GenTestImageData() {
 
   CNObjsVec objs;
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(1);
+  obj->SetClassId(1);
   CNInferBoundingBox bbox = {0.2, 0.2, 0.6, 0.6};
   obj->bbox = bbox;
   objs.push_back(obj);
@@ -234,7 +253,7 @@ TEST(Tracker, ProcessMluFeature) {
     CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
     for (size_t idx = 0; idx < objs.size(); ++idx) {
       auto& obj = objs[idx];
-      EXPECT_FALSE(obj->track_id.empty());
+      EXPECT_FALSE(obj->GetTrackIdStr().empty());
     }
   }
 }
@@ -254,7 +273,7 @@ TEST(Tracker, ProcessCpuFeature) {
     CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
     for (size_t idx = 0; idx < objs.size(); ++idx) {
       auto& obj = objs[idx];
-      EXPECT_FALSE(obj->track_id.empty());
+      EXPECT_FALSE(obj->GetTrackIdStr().empty());
     }
   }
 }
@@ -312,7 +331,7 @@ TEST(Tracker, ProcessFeatureMatchCPU2) {
 
   CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(5);
+  obj->SetClassId(5);
   CNInferBoundingBox bbox = {0.6, 0.6, -0.1, -0.1};
   obj->bbox = bbox;
   objs.push_back(obj);
@@ -333,7 +352,7 @@ TEST(Tracker, ProcessFeatureMatchCPU3) {
 
   CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(6);
+  obj->SetClassId(6);
   CNInferBoundingBox bbox = {0.6, 0.6, 0.6, 0.6};
   obj->bbox = bbox;
   objs.push_back(obj);
@@ -356,7 +375,7 @@ TEST(Tracker, ProcessFeatureMatchCPU4) {
     CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
     for (size_t idx = 0; idx < objs.size(); ++idx) {
       auto& obj = objs[idx];
-      EXPECT_FALSE(obj->track_id.empty());
+      EXPECT_FALSE(obj->GetTrackIdStr().empty());
     }
   }
 }
@@ -409,7 +428,7 @@ TEST(Tracker, ProcessFeatureMatchMLU2) {
   EXPECT_EQ(track->Process(data), 0);
   auto obj = std::make_shared<CNInferObject>();
   CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
-  obj->id = std::to_string(5);
+  obj->SetClassId(5);
   CNInferBoundingBox bbox = {0.6, 0.6, -0.1, -0.1};
   obj->bbox = bbox;
   objs.push_back(obj);
@@ -451,9 +470,213 @@ TEST(Tracker, ProcessFeatureMatchMLU4) {
     CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
     for (size_t idx = 0; idx < objs.size(); ++idx) {
       auto& obj = objs[idx];
-      EXPECT_FALSE(obj->track_id.empty());
+      EXPECT_FALSE(obj->GetTrackIdStr().empty());
+    }
+  }
+}
+
+TEST(Tracker, ProcessIoUMatch) {
+  // create track
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = iou_track;
+  ASSERT_TRUE(track->Open(param));
+
+  int obj_num = 4;
+  int repeat_time = 10;
+  for (int n = 0; n < repeat_time; ++n) {
+    auto data = GenTestData(n, obj_num);
+    CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+    for (auto &obj : objs) obj->score = 0.9;
+    // frame data is not needed by IoUMatch
+    CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
+    frame->fmt = CN_PIXEL_FORMAT_YUV420_NV21;
+    EXPECT_EQ(track->Process(data), 0);
+    for (auto &obj : objs) {
+      EXPECT_FALSE(obj->GetTrackIdStr().empty());
+      // objects are confirmed after matched 3 times in a row
+      if (n > 2) EXPECT_NE(obj->GetTrackId(), -1);
+    }
+  }
+  track->Close();
+}
+
+TEST(Tracker, ProcessIoUMatchLowScore) {
+  // create track
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = iou_track;
+  param["high_score_threshold"] = "0.5";
+  param["low_score_threshold"] = "0.1";
+  ASSERT_TRUE(track->Open(param));
+
+  int obj_num = 3;
+  int repeat_time = 5;
+  for (int n = 0; n < repeat_time; ++n) {
+    auto data = GenTestData(n, obj_num);
+    CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+    for (auto &obj : objs) obj->score = 0.05;
+    EXPECT_EQ(track->Process(data), 0);
+    // low score objects never start a track
+    for (auto &obj : objs) {
+      EXPECT_EQ(obj->GetTrackId(), -1);
+    }
+  }
+  track->Close();
+}
+
+TEST(Tracker, ProcessIoUMatchParams) {
+  // create track
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = iou_track;
+  param["max_iou_distance"] = "0.5";
+  param["max_age"] = "10";
+  param["n_init"] = "1";
+  ASSERT_TRUE(track->CheckParamSet(param));
+  ASSERT_TRUE(track->Open(param));
+
+  int obj_num = 4;
+  int repeat_time = 5;
+  for (int n = 0; n < repeat_time; ++n) {
+    auto data = GenTestData(n, obj_num);
+    CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+    for (auto &obj : objs) obj->score = 0.9;
+    EXPECT_EQ(track->Process(data), 0);
+    // objects are confirmed after matched once
+    for (auto &obj : objs) {
+      if (n > 0) EXPECT_NE(obj->GetTrackId(), -1);
+    }
+  }
+  track->Close();
+
+  param["n_init"] = "three";
+  EXPECT_FALSE(track->CheckParamSet(param));
+}
+
+TEST(Tracker, ProcessIoUMatchEmptyBox) {
+  // create track
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = iou_track;
+  ASSERT_TRUE(track->Open(param));
+
+  int obj_num = 2;
+  int repeat_time = 5;
+  for (int n = 0; n < repeat_time; ++n) {
+    auto data = GenTestData(n, obj_num);
+    CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+    for (auto &obj : objs) {
+      obj->score = 0.9;
+      obj->bbox.h = 0;
+    }
+    EXPECT_EQ(track->Process(data), 0);
+    // boxes without area are reported without track
+    for (auto &obj : objs) {
+      EXPECT_EQ(obj->GetTrackId(), -1);
     }
   }
+  track->Close();
+}
+
+TEST(Tracker, ReleaseContextOnEos) {
+  // create track
+  std::shared_ptr<Tracker> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = iou_track;
+  ASSERT_TRUE(track->Open(param));
+
+  int obj_num = 2;
+  for (int round = 0; round < 2; ++round) {
+    for (int n = 0; n < 5; ++n) {
+      auto data = GenTestData(n, obj_num);
+      CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
+      for (auto &obj : objs) obj->score = 0.9;
+      EXPECT_EQ(track->Process(data), 0);
+      // tracks restart from tentative state after eos
+      if (n == 0) {
+        for (auto &obj : objs) EXPECT_EQ(obj->GetTrackId(), -1);
+      }
+    }
+    auto eos = CNFrameInfo::Create(std::to_string(0), true);
+    eos->SetStreamIndex(g_channel_id);
+    track->OnEos(eos);
+  }
+  track->Close();
+}
+
+TEST(Tracker, FeatureMatchMaxTracks) {
+  const int frame_num = 2000;
+  const int obj_num = 2;
+  const uint32_t max_tracks = 16;
+  edk::FeatureMatchTrack track;
+  track.SetParams(kFeatureMatchCosineDistance, kFeatureMatchNNBudget, 0.7, 30, 3, max_tracks);
+
+  std::mt19937 rng(12345);
+  auto features = GenRandomFeatures(64, &rng);
+  size_t max_memory_usage = 0;
+  edk::Objects in, out;
+  edk::TrackFrame tframe;
+  for (int n = 0; n < frame_num; ++n) {
+    GenReplacedObjects(n, obj_num, features, &in);
+    out.clear();
+    track.UpdateFrame(tframe, in, &out);
+    ASSERT_EQ(out.size(), in.size());
+    ASSERT_LE(track.GetTrackNum(), max_tracks);
+    max_memory_usage = std::max(max_memory_usage, track.GetMemoryUsage());
+  }
+  EXPECT_LE(max_memory_usage, FeatureMatchMemoryBound(max_tracks, obj_num));
+}
+
+TEST(Tracker, FeatureMatchParallel) {
+  std::mt19937 rng(12345);
+  for (int obj_num : {50, 200}) {
+    double serial_ms, parallel_ms;
+    CompareSerialParallel(obj_num, 10, &rng, &serial_ms, &parallel_ms);
+  }
+}
+
+TEST(Tracker, GetStreamStats) {
+  std::shared_ptr<Tracker> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = ds_track;
+  param["max_tracks"] = "3";
+  ASSERT_TRUE(track->Open(param));
+
+  TrackerStreamStats stats;
+  const std::string stream_id = std::to_string(g_channel_id);
+  EXPECT_FALSE(track->GetStreamStats(stream_id, nullptr));
+  EXPECT_FALSE(track->GetStreamStats(stream_id, &stats));
+
+  int obj_num = 4;
+  for (int n = 0; n < 10; ++n) {
+    auto data = GenTestData(n, obj_num);
+    EXPECT_EQ(track->Process(data), 0);
+  }
+  ASSERT_TRUE(track->GetStreamStats(stream_id, &stats));
+  EXPECT_GT(stats.track_num, 0u);
+  EXPECT_LE(stats.track_num, 3u);
+  EXPECT_GT(stats.memory_usage, 0u);
+  EXPECT_FALSE(track->GetStreamStats("not_exist", &stats));
+
+  // statistics are gone with the tracking context
+  auto eos = CNFrameInfo::Create(stream_id, true);
+  eos->SetStreamIndex(g_channel_id);
+  track->OnEos(eos);
+  EXPECT_FALSE(track->GetStreamStats(stream_id, &stats));
+  track->Close();
+}
+
+TEST(Tracker, GetStreamStatsIoUMatch) {
+  std::shared_ptr<Tracker> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = iou_track;
+  ASSERT_TRUE(track->Open(param));
+  auto data = GenTestData(0, 2);
+  EXPECT_EQ(track->Process(data), 0);
+  TrackerStreamStats stats;
+  EXPECT_FALSE(track->GetStreamStats(std::to_string(g_channel_id), &stats));
+  track->Close();
 }
 
 #ifdef ENABLE_KCF
@@ -492,7 +715,7 @@ std::shared_ptr<CNFrameInfo> GenTestYUVMLUData(int iter, int obj_num) {
   CNObjsVec objs;
   for (int i = 0; i < obj_num; ++i) {
     auto obj = std::make_shared<CNInferObject>();
-    obj->id = std::to_string(i);
+    obj->SetClassId(i);
     float val = i * 0.1 + 0.01;
     CNInferBoundingBox bbox = {val, val, val, val};
     obj->bbox = bbox;
@@ -575,7 +798,7 @@ TEST(Tracker, ProcessKCFMLU2) {
 
   CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(5);
+  obj->SetClassId(5);
   CNInferBoundingBox bbox = {0.6, 0.6, -0.1, -0.1};
   obj->bbox = bbox;
   objs.push_back(obj);
@@ -603,7 +826,7 @@ TEST(Tracker, ProcessKCFMLU3) {
 
   CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
   auto obj = std::make_shared<CNInferObject>();
-  obj->id = std::to_string(6);
+  obj->SetClassId(6);
   CNInferBoundingBox bbox = {0.6, 0.6, 0.6, 0.6};
   obj->bbox = bbox;
   objs.push_back(obj);
@@ -654,7 +877,7 @@ TEST(Tracker, ProcessKCFMLU5) {
     EXPECT_EQ(track->Process(data), 0);
     CNObjsVec objs = cnstream::any_cast<CNObjsVec>(data->datas[CNObjsVecKey]);
     for (auto &obj : objs) {
-      EXPECT_FALSE(obj->track_id.empty());
+      EXPECT_FALSE(obj->GetTrackIdStr().empty());
     }
     // free MLUmemory
     CNDataFramePtr frame = cnstream::any_cast<CNDataFramePtr>(data->datas[CNDataFramePtrKey]);
@@ -28,7 +28,7 @@
 class CarFilter : public cnstream::ObjFilter {
  public:
   bool Filter(const cnstream::CNFrameInfoPtr& finfo, const cnstream::CNInferObjectPtr& obj) override {
-    int id = atoi(obj->id.c_str());
+    int id = obj->GetClassId();
     if (6 == id)
       return true;  // cars will be inferenced.
     else if (5 == id)
@@ -62,7 +62,7 @@ int PostprocClassification::Execute(const std::vector<float*>& net_outputs,
   if (0 == label) return -1;
   DLOG(INFO) << "label = " << label + 1 << " score = " << mscore;
   auto obj = std::make_shared<cnstream::CNInferObject>();
-  obj->id = std::to_string(label);
+  obj->SetClassId(label);
   obj->score = mscore;
 
   cnstream::CNObjsVec objs;
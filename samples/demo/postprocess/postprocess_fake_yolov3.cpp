@@ -68,7 +68,7 @@ int PostprocFakeYolov3::Execute(const std::vector<float*>& net_outputs, const st
   for (decltype(box_num) bi = 0; bi < box_num; ++bi) {
     if (threshold_ > 0 && data[2] < threshold_) continue;
     std::shared_ptr<cnstream::CNInferObject> object = std::make_shared<cnstream::CNInferObject>();
-    object->id = std::to_string(data[1]);
+    object->SetClassId(static_cast<int>(data[1]));
     object->score = data[2];
     object->bbox.x = data[3];
     object->bbox.y = data[4];
@@ -105,7 +105,7 @@ int PostprocSsd::Execute(const std::vector<float*>& net_outputs, const std::shar
     if (h <= 0) continue;
 
     std::shared_ptr<cnstream::CNInferObject> obj = std::make_shared<cnstream::CNInferObject>();
-    obj->id = std::to_string(label);
+    obj->SetClassId(label);
     obj->score = score;
     obj->bbox.x = x;
     obj->bbox.y = y;
@@ -127,7 +127,7 @@ int PostprocSsd::Execute(const std::vector<float*>& net_outputs, const std::shar
     if (data[1] == 0) continue;
     if (threshold_ > 0 && data[2] < threshold_) continue;
     std::shared_ptr<cnstream::CNInferObject> object = std::make_shared<cnstream::CNInferObject>();
-    object->id = std::to_string(data[1] - 1);
+    object->SetClassId(static_cast<int>(data[1] - 1));
     object->score = data[2];
     object->bbox.x = data[3];
     object->bbox.y = data[4];
@@ -71,7 +71,7 @@ class PostprocYolov3 : public cnstream::Postproc {
       bottom = std::max(0.0f, bottom);
 
       auto obj = std::make_shared<cnstream::CNInferObject>();
-      obj->id = std::to_string(static_cast<int>(net_output[64 + box_idx * box_step + 1]));
+      obj->SetClassId(static_cast<int>(net_output[64 + box_idx * box_step + 1]));
       obj->score = net_output[64 + box_idx * box_step + 2];
 
       obj->bbox.x = left;